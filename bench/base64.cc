@@ -0,0 +1,46 @@
+#include <string>
+
+#include "bench.h"
+#include "utils/base64.h"
+
+using namespace twilight;
+
+namespace
+{
+// the size of a large avatar or sticker upload
+constexpr usize IMAGE = 4 << 20;
+
+std::string image()
+{
+  std::string s(IMAGE, '\0');
+  for (usize i = 0; i < IMAGE; ++i) s[i] = static_cast<char>(i * 2654435761u >> 13);
+  return s;
+}
+}  // namespace
+
+BENCHMARK(base64Encode)
+{
+  std::string data = image();
+  std::string out(base64::encodedSize(data.size()), '\0');
+  for (usize i = 0; i < state.iterations; ++i) {
+    base64::encode(reinterpret_cast<const u8*>(data.data()), data.size(), out.data());
+    bench::doNotOptimize(out);
+  }
+  state.bytes = data.size();
+}
+
+BENCHMARK(base64Decode)
+{
+  std::string encoded = base64::encode(image());
+  std::string out(base64::decodedSize(encoded), '\0');
+  for (usize i = 0; i < state.iterations; ++i)
+    bench::doNotOptimize(base64::decode(encoded, reinterpret_cast<u8*>(out.data())));
+  state.bytes = encoded.size();
+}
+
+BENCHMARK(base64DataUri)
+{
+  std::string data = image();
+  for (usize i = 0; i < state.iterations; ++i) bench::doNotOptimize(base64::dataUri("image/png", data));
+  state.bytes = data.size();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utils/types.h"
+
+namespace twilight::bench
+{
+struct State {
+  // the benchmark body must run its hot loop exactly this many times
+  usize iterations = 0;
+  // bytes processed per iteration, enables the throughput column
+  usize bytes = 0;
+  // free-form numbers reported next to the timings, e.g. encoded sizes
+  std::vector<std::pair<std::string, f64>> counters{};
+
+  inline void counter(std::string name, f64 value) { counters.emplace_back(std::move(name), value); }
+};
+
+using Fn = void (*)(State&);
+
+struct Case {
+  const char* name;
+  Fn fn;
+};
+
+inline std::vector<Case>& registry()
+{
+  static std::vector<Case> cases;
+  return cases;
+}
+
+struct Register {
+  Register(const char* name, Fn fn) { registry().push_back({name, fn}); }
+};
+
+// operator new calls made by the calling thread so far, the harness reports them per iteration. C libraries that
+// malloc directly, like zlib, aren't seen
+usize allocations() noexcept;
+
+// keeps the compiler from optimizing away a result
+template <typename T>
+inline void doNotOptimize(T&& value) noexcept
+{
+  asm volatile("" : : "r"(&value) : "memory");
+}
+}  // namespace twilight::bench
+
+#define BENCHMARK(fn)                                          \
+  static void fn(twilight::bench::State&);                     \
+  static twilight::bench::Register fn##Register{#fn, fn};      \
+  static void fn(twilight::bench::State& state)
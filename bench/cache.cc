@@ -0,0 +1,135 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "bench.h"
+#include "cache/cache.h"
+#include "corpus.h"
+#include "etf/writer.h"
+#include "gateway/shard.h"
+#include "json/writer.h"
+
+using namespace twilight;
+using namespace twilight::gateway;
+
+namespace
+{
+const Intent INTENTS = Intent::GUILDS | Intent::GUILD_MEMBERS | Intent::GUILD_PRESENCES;
+
+// a fresh cache per iteration, so this is the cost of a cold GUILD_CREATE including decoding
+void ingestGuild(bench::State& state, Encoding encoding, const std::string& msg)
+{
+  Shard shard({.encoding = encoding});
+  cache::Cache::Stats stats;
+  for (usize i = 0; i < state.iterations; ++i) {
+    cache::Cache cache(INTENTS);
+    cache.ingest(*shard.decode(msg));
+    stats = cache.stats();
+  }
+  state.bytes = msg.size();
+  state.counter("members", stats.members);
+  state.counter("bytes/member", static_cast<f64>(stats.bytes) / stats.members);
+}
+
+template <typename W>
+void ingestPresences(bench::State& state, Encoding encoding)
+{
+  Shard shard({.encoding = encoding});
+  cache::Cache cache(INTENTS);
+  cache.ingest(*shard.decode(bench::corpus::guildCreate<W>(1000)));
+
+  std::vector<std::string> updates;
+  for (u64 i = 0; i < 64; ++i) updates.push_back(bench::corpus::presenceUpdate<W>(i * 7));
+  for (usize i = 0; i < state.iterations; ++i) cache.ingest(*shard.decode(updates[i % updates.size()]));
+}
+
+// a guild filled through REQUEST_GUILD_MEMBERS, 1000 members per chunk like discord sends them
+template <typename W>
+void ingestChunks(bench::State& state, Encoding encoding)
+{
+  constexpr u32 CHUNKS = 50;
+  std::vector<std::string> chunks;
+  for (u32 i = 0; i < CHUNKS; ++i)
+    chunks.push_back(bench::corpus::membersChunk<W>(i * 1000ull, 1000, i, CHUNKS, "0.1"));
+  std::string guild = bench::corpus::guildCreate<W>(0);
+
+  Shard shard({.encoding = encoding});
+  usize members = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (usize i = 0; i < state.iterations; ++i) {
+    cache::Cache cache(INTENTS);
+    cache.ingest(*shard.decode(guild));
+    for (const auto& chunk : chunks) cache.ingest(*shard.decode(chunk));
+    members = cache.stats().members;
+  }
+  f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+  state.bytes = 0;
+  for (const auto& chunk : chunks) state.bytes += chunk.size();
+  state.counter("members", members);
+  state.counter("members/s", members * state.iterations / seconds);
+}
+
+std::string memberUpdate(u64 i)
+{
+  json::Writer w;
+  bench::corpus::dispatch(w, "GUILD_MEMBER_UPDATE", 300 + i);
+  w.beginObject().key("guild_id").snowflake(bench::corpus::GUILD_ID).key("nick").value("churn " + std::to_string(i));
+  w.key("roles").beginArray().snowflake(bench::corpus::snowflake(1000 + i % 16)).endArray().key("user");
+  bench::corpus::user(w, i % 1000);
+  w.endObject().endObject();
+  return w.take();
+}
+
+// member lookups plus a permission check from the benchmark thread, optionally while a shard thread applies
+// GUILD_MEMBER_UPDATEs to the same guild as fast as it can
+void reads(bench::State& state, bool churn)
+{
+  Shard shard({.encoding = Encoding::JSON});
+  cache::Cache cache(INTENTS);
+  cache.ingest(*shard.decode(bench::corpus::guildCreate<json::Writer>(1000)));
+
+  std::vector<std::string> updates;
+  for (u64 i = 0; i < 256; ++i) updates.push_back(memberUpdate(i * 13));
+
+  std::atomic<bool> stop{false};
+  std::atomic<usize> applied{0};
+  std::jthread writer;
+  if (churn) {
+    writer = std::jthread([&] {
+      Shard own({.encoding = Encoding::JSON});
+      usize n = 0;
+      while (!stop.load(std::memory_order_relaxed)) cache.ingest(*own.decode(updates[n++ % updates.size()]));
+      applied = n;
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  u64 sink = 0;
+  for (usize i = 0; i < state.iterations; ++i) {
+    cache::Epoch::Guard guard;
+    const cache::Guild* g = cache.guild(bench::corpus::GUILD_ID);
+    if (auto m = g->member(bench::corpus::snowflake(i * 7 % 1000)))
+      sink += static_cast<u64>(g->permissions(*m)) + g->string(m->nick).size();
+  }
+  f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+  stop = true;
+  if (writer.joinable())
+    writer.join();
+  bench::doNotOptimize(sink);
+  if (churn)
+    state.counter("updates/s", applied / seconds);
+}
+}  // namespace
+
+BENCHMARK(cacheJsonGuildCreate) { ingestGuild(state, Encoding::JSON, bench::corpus::guildCreate<json::Writer>(1000)); }
+BENCHMARK(cacheEtfGuildCreate) { ingestGuild(state, Encoding::ETF, bench::corpus::guildCreate<etf::Writer>(1000)); }
+
+BENCHMARK(cacheJsonPresenceUpdate) { ingestPresences<json::Writer>(state, Encoding::JSON); }
+BENCHMARK(cacheEtfPresenceUpdate) { ingestPresences<etf::Writer>(state, Encoding::ETF); }
+
+BENCHMARK(cacheJsonMembersChunks) { ingestChunks<json::Writer>(state, Encoding::JSON); }
+BENCHMARK(cacheEtfMembersChunks) { ingestChunks<etf::Writer>(state, Encoding::ETF); }
+
+BENCHMARK(cacheMemberReads) { reads(state, false); }
+BENCHMARK(cacheMemberReadsUnderChurn) { reads(state, true); }
@@ -0,0 +1,52 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "corpus.h"
+#include "gateway/dispatcher.h"
+#include "gateway/shard.h"
+#include "json/writer.h"
+
+using namespace twilight;
+using namespace twilight::gateway;
+
+namespace
+{
+// about what a handler that looks something up and replies spends on the CPU
+constexpr std::chrono::microseconds WORK{5};
+
+void busy(std::chrono::nanoseconds d) noexcept
+{
+  for (auto end = std::chrono::steady_clock::now() + d; std::chrono::steady_clock::now() < end;) {
+  }
+}
+
+// PRESENCE_UPDATEs from 64 members round robin, as a busy guild sends them, through a dispatcher whose handler takes
+// WORK. handled/msg is the share of them handlers got
+void presences(bench::State& state, bool coalesce)
+{
+  std::vector<std::string> updates;
+  for (u64 i = 0; i < 64; ++i) updates.push_back(bench::corpus::presenceUpdate<json::Writer>(i));
+  Shard shard({.encoding = Encoding::JSON});
+  Dispatcher dispatcher;
+  if (coalesce)
+    dispatcher.setCoalescing(std::chrono::seconds{1});
+  usize handled = 0;
+  dispatcher.on<PresenceUpdate>([&](const PresenceUpdate& e) {
+    busy(WORK);
+    handled += e.d.find("status").has_value();
+  });
+  dispatcher.attach(shard);
+
+  for (usize i = 0; i < state.iterations; ++i) shard.handle(*shard.decode(updates[i % updates.size()]));
+  bench::doNotOptimize(handled);
+  state.bytes = updates[0].size();
+  state.counter("handled/msg", static_cast<f64>(handled) / state.iterations);
+  if (coalesce)
+    state.counter("merged", dispatcher.coalescer()->merged());
+}
+}  // namespace
+
+BENCHMARK(coalescerPresencesOff) { presences(state, false); }
+BENCHMARK(coalescerPresencesOn) { presences(state, true); }
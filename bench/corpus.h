@@ -0,0 +1,291 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "utils/types.h"
+
+// synthetic gateway and REST traffic shaped after real payloads. builders are templates over the writer so the JSON
+// and ETF corpora carry exactly the same data
+namespace twilight::bench::corpus
+{
+constexpr u64 GUILD_ID = 1081283487204929537ull;
+
+inline u64 snowflake(u64 i) noexcept { return 175928847299117063ull + i * 4194304ull * 977; }
+
+template <typename W>
+inline void user(W& w, u64 i)
+{
+  std::string name = "user" + std::to_string(i);
+  w.beginObject()
+    .key("id")
+    .snowflake(snowflake(i))
+    .key("username")
+    .value(name)
+    .key("global_name")
+    .value("User Number " + std::to_string(i))
+    .key("avatar")
+    .value("a_1269e74af4df7417b13759eae50c83dc")
+    .key("discriminator")
+    .value("0")
+    .key("public_flags")
+    .value(i % 3 ? 0 : 64)
+    .key("bot")
+    .value(i % 17 == 0)
+    .endObject();
+}
+
+template <typename W>
+inline void member(W& w, u64 i)
+{
+  w.beginObject().key("user");
+  user(w, i);
+  if (i % 5 == 0)
+    w.key("nick").value("nickname " + std::to_string(i));
+  else
+    w.key("nick").value(nullptr);
+  w.key("roles").beginArray();
+  for (u64 r = 0; r < i % 4; ++r) w.snowflake(snowflake(1000 + r));
+  w.endArray()
+    .key("joined_at")
+    .value("2023-03-05T17:22:01.163000+00:00")
+    .key("deaf")
+    .value(false)
+    .key("mute")
+    .value(false)
+    .key("flags")
+    .value(0)
+    .endObject();
+}
+
+template <typename W>
+inline void presence(W& w, u64 i)
+{
+  w.beginObject()
+    .key("user")
+    .beginObject()
+    .key("id")
+    .snowflake(snowflake(i))
+    .endObject()
+    .key("status")
+    .value(i % 2 ? "online" : "idle")
+    .key("client_status")
+    .beginObject()
+    .key("desktop")
+    .value("online")
+    .endObject()
+    .key("activities")
+    .beginArray()
+    .beginObject()
+    .key("name")
+    .value("Visual Studio Code")
+    .key("type")
+    .value(0)
+    .key("created_at")
+    .value(1700000000000ull + i)
+    .endObject()
+    .endArray()
+    .endObject();
+}
+
+template <typename W>
+inline void dispatch(W& w, const char* t, u64 s)
+{
+  w.beginObject().key("t").value(t).key("s").value(s).key("op").value(0).key("d");
+}
+
+template <typename W>
+inline std::string guildCreate(u64 members)
+{
+  W w;
+  dispatch(w, "GUILD_CREATE", 2);
+  w.beginObject()
+    .key("id")
+    .snowflake(GUILD_ID)
+    .key("name")
+    .value("twilight bench")
+    .key("member_count")
+    .value(members)
+    .key("large")
+    .value(members > 250);
+
+  w.key("roles").beginArray();
+  for (u64 r = 0; r < 16; ++r) {
+    w.beginObject()
+      .key("id")
+      .snowflake(snowflake(1000 + r))
+      .key("name")
+      .value("role " + std::to_string(r))
+      .key("permissions")
+      .value("2248473465835073")
+      .key("position")
+      .value(r)
+      .key("color")
+      .value(0x5865F2)
+      .key("hoist")
+      .value(r % 2 == 0)
+      .endObject();
+  }
+  w.endArray();
+
+  w.key("channels").beginArray();
+  for (u64 c = 0; c < 48; ++c) {
+    w.beginObject()
+      .key("id")
+      .snowflake(snowflake(5000 + c))
+      .key("type")
+      .value(c % 8 ? 0 : 2)
+      .key("name")
+      .value("channel-" + std::to_string(c))
+      .key("position")
+      .value(c)
+      .key("parent_id")
+      .value(nullptr)
+      .key("topic")
+      .value("a channel topic with \"quotes\" and unicode \xe2\x9c\xa8")
+      .endObject();
+  }
+  w.endArray();
+
+  w.key("members").beginArray();
+  for (u64 i = 0; i < members; ++i) member(w, i);
+  w.endArray();
+
+  w.key("presences").beginArray();
+  for (u64 i = 0; i < members; i += 2) presence(w, i);
+  w.endArray();
+
+  w.endObject().endObject();
+  return w.take();
+}
+
+// members [first, first + count) as chunk `index` of `total`, the way REQUEST_GUILD_MEMBERS answers
+template <typename W>
+inline std::string membersChunk(u64 first, u64 count, u32 index, u32 total, const std::string& nonce)
+{
+  W w;
+  dispatch(w, "GUILD_MEMBERS_CHUNK", 400 + index);
+  w.beginObject().key("guild_id").snowflake(GUILD_ID).key("members").beginArray();
+  for (u64 i = first; i < first + count; ++i) member(w, i);
+  w.endArray().key("chunk_index").value(index).key("chunk_count").value(total).key("nonce").value(nonce);
+  w.endObject().endObject();
+  return w.take();
+}
+
+template <typename W>
+inline std::string presenceUpdate(u64 i)
+{
+  W w;
+  dispatch(w, "PRESENCE_UPDATE", 100 + i);
+  presence(w, i);
+  w.endObject();
+  return w.take();
+}
+
+template <typename W>
+inline void message(W& w, u64 i)
+{
+  w.beginObject()
+    .key("id")
+    .snowflake(snowflake(900000 + i))
+    .key("channel_id")
+    .snowflake(snowflake(5000))
+    .key("guild_id")
+    .snowflake(GUILD_ID)
+    .key("author");
+  user(w, i);
+  w.key("member");
+  member(w, i);
+  w.key("content")
+    .value("hello world, this is message number " + std::to_string(i))
+    .key("timestamp")
+    .value("2024-01-01T00:00:00.000000+00:00")
+    .key("tts")
+    .value(false)
+    .key("mentions")
+    .beginArray()
+    .endArray()
+    .key("attachments")
+    .beginArray()
+    .endArray()
+    .key("embeds")
+    .beginArray()
+    .endArray()
+    .endObject();
+}
+
+template <typename W>
+inline std::string messageCreate(u64 i)
+{
+  W w;
+  dispatch(w, "MESSAGE_CREATE", 200 + i);
+  message(w, i);
+  w.endObject();
+  return w.take();
+}
+
+// the body of POST /channels/{id}/messages
+template <typename W>
+inline std::string createdMessage(u64 i)
+{
+  W w;
+  message(w, i);
+  return w.take();
+}
+
+// the body of GET /channels/{id}/messages?limit={count}
+template <typename W>
+inline std::string channelMessages(u64 count)
+{
+  W w;
+  w.beginArray();
+  for (u64 i = 0; i < count; ++i) message(w, i);
+  w.endArray();
+  return w.take();
+}
+
+// `body` as the REST API sends it, cloudflare and ratelimit headers included. `headers` are extra header lines, and
+// when they set a transfer encoding `body` must already be encoded with it
+inline std::string restResponse(std::string_view body, std::string_view headers = {})
+{
+  std::string raw =
+    "HTTP/1.1 200 OK\r\n"
+    "Date: Mon, 19 Oct 2026 12:00:00 GMT\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: keep-alive\r\n"
+    "x-ratelimit-bucket: 80c17d2f203122d936070c88c8d10f33\r\n"
+    "x-ratelimit-limit: 5\r\n"
+    "x-ratelimit-remaining: 4\r\n"
+    "x-ratelimit-reset: 1760875201.123\r\n"
+    "x-ratelimit-reset-after: 1.000\r\n"
+    "Via: 1.1 google\r\n"
+    "Alt-Svc: h3=\":443\"; ma=86400\r\n"
+    "CF-Cache-Status: DYNAMIC\r\n"
+    "Server: cloudflare\r\n";
+  raw += headers;
+  if (!headers.contains("Transfer-Encoding")) {
+    raw += "Content-Length: ";
+    raw += std::to_string(body.size());
+    raw += "\r\n";
+  }
+  raw += "\r\n";
+  raw += body;
+  return raw;
+}
+
+// `body` in chunks of `size` bytes, for Transfer-Encoding: chunked
+inline std::string chunked(std::string_view body, usize size)
+{
+  std::string out;
+  char len[20];
+  for (usize pos = 0; pos < body.size(); pos += size) {
+    std::string_view chunk = body.substr(pos, size);
+    out.append(len, std::snprintf(len, sizeof(len), "%zx\r\n", chunk.size()));
+    out += chunk;
+    out += "\r\n";
+  }
+  out += "0\r\n\r\n";
+  return out;
+}
+}  // namespace twilight::bench::corpus
@@ -0,0 +1,88 @@
+#include <random>
+#include <string>
+
+#include "bench.h"
+#include "crypto/ed25519.h"
+#include "crypto/sha1.h"
+#include "utils/random.h"
+
+using namespace twilight;
+
+namespace
+{
+std::string input(usize size)
+{
+  std::string s(size, '\0');
+  for (usize i = 0; i < size; ++i) s[i] = static_cast<char>(i * 131 + (i >> 7));
+  return s;
+}
+
+void hashSha1(bench::State& state, usize size)
+{
+  std::string data = input(size);
+  for (usize i = 0; i < state.iterations; ++i) bench::doNotOptimize(crypto::Sha1::hash(data));
+  state.bytes = size;
+  state.counter("sha-ni", crypto::Sha1::backend() == "sha-ni");
+}
+}  // namespace
+
+// a websocket handshake key
+BENCHMARK(sha1Handshake) { hashSha1(state, 60); }
+BENCHMARK(sha1Attachment4K) { hashSha1(state, 4096); }
+BENCHMARK(sha1Attachment1M) { hashSha1(state, 1 << 20); }
+
+BENCHMARK(ed25519Verify)
+{
+  constexpr std::string_view TIMESTAMP = "1700000000";
+  constexpr std::string_view BODY = R"({"type":2,"id":"1234567890123456789","data":{"name":"ping","type":1}})";
+  auto key = crypto::KeyPair::generate();
+  crypto::Verifier verifier(key.publicKey());
+  auto signature = key.sign(TIMESTAMP, BODY);
+
+  usize ok = 0;
+  for (usize i = 0; i < state.iterations; ++i) ok += verifier.verify(signature, TIMESTAMP, BODY);
+  bench::doNotOptimize(ok);
+  state.bytes = TIMESTAMP.size() + BODY.size();
+}
+
+// what rand<u8, 4>() used to be: one mt19937 shared by every thread, without a lock
+BENCHMARK(randomMaskMt19937)
+{
+  static std::mt19937 rng(std::random_device{}());
+  // u8 isn't an IntType the distributions take
+  static std::uniform_int_distribution<unsigned> dist(0, 255);
+  for (usize i = 0; i < state.iterations; ++i) {
+    std::array<u8, 4> mask;
+    for (u8& b : mask) b = static_cast<u8>(dist(rng));
+    bench::doNotOptimize(mask);
+  }
+  state.bytes = 4;
+}
+
+// one websocket frame mask
+BENCHMARK(randomMask)
+{
+  for (usize i = 0; i < state.iterations; ++i) bench::doNotOptimize(rand<u8, 4>());
+  state.bytes = 4;
+}
+
+// masks for a batch of 64 frames at once
+BENCHMARK(randomMaskBatch)
+{
+  std::array<u8, 64 * 4> masks;
+  for (usize i = 0; i < state.iterations; ++i) {
+    randomBytes(masks.data(), masks.size());
+    bench::doNotOptimize(masks);
+  }
+  state.bytes = masks.size();
+}
+
+BENCHMARK(randomSecureKey)
+{
+  std::array<u8, 16> key;
+  for (usize i = 0; i < state.iterations; ++i) {
+    secureRandomBytes(key.data(), key.size());
+    bench::doNotOptimize(key);
+  }
+  state.bytes = key.size();
+}
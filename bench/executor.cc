@@ -0,0 +1,68 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "bench.h"
+#include "corpus.h"
+#include "gateway/dispatcher.h"
+#include "gateway/shard.h"
+#include "json/writer.h"
+#include "utils/executor.h"
+
+using namespace twilight;
+using namespace twilight::gateway;
+
+namespace
+{
+// about what a handler that looks something up and replies spends on the CPU
+constexpr std::chrono::microseconds WORK{5};
+
+void busy(std::chrono::nanoseconds d) noexcept
+{
+  for (auto end = std::chrono::steady_clock::now() + d; std::chrono::steady_clock::now() < end;) {
+  }
+}
+
+// jobs spread over `keys` keys, submitted and drained
+void submit(bench::State& state, u64 keys)
+{
+  Executor executor;
+  std::atomic<usize> sink{0};
+  for (usize i = 0; i < state.iterations; ++i)
+    executor.submit(i % keys, [&sink, i] { sink.fetch_add(i, std::memory_order_relaxed); });
+  executor.drain();
+  state.counter("threads", executor.threads());
+}
+
+// MESSAGE_CREATEs through a dispatcher whose handler takes WORK. socket ns/msg is what the shard's socket thread
+// spends per message, which is everything when handlers run inline
+void dispatch(bench::State& state, bool offload)
+{
+  std::string msg = bench::corpus::messageCreate<json::Writer>(1);
+  Shard shard({.encoding = Encoding::JSON});
+  Executor executor;
+  Dispatcher dispatcher;
+  if (offload)
+    dispatcher.setExecutor(&executor);
+  usize handled = 0;
+  dispatcher.on<MessageCreate>([&](const MessageCreate& e) {
+    busy(WORK);
+    handled += e.d.find("content").has_value();
+  });
+  dispatcher.attach(shard);
+
+  auto start = std::chrono::steady_clock::now();
+  for (usize i = 0; i < state.iterations; ++i) shard.handle(*shard.decode(msg));
+  auto socket = std::chrono::steady_clock::now() - start;
+  executor.drain();
+  bench::doNotOptimize(handled);
+  state.bytes = msg.size();
+  state.counter("socket ns/msg", std::chrono::duration<f64, std::nano>(socket).count() / state.iterations);
+}
+}  // namespace
+
+BENCHMARK(executorSubmitOneKey) { submit(state, 1); }
+BENCHMARK(executorSubmitManyKeys) { submit(state, 1000); }
+
+BENCHMARK(executorDispatchInline) { dispatch(state, false); }
+BENCHMARK(executorDispatchOffloaded) { dispatch(state, true); }
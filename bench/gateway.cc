@@ -0,0 +1,124 @@
+#include <zlib.h>
+
+#include "bench.h"
+#include "corpus.h"
+#include "etf/writer.h"
+#include "gateway/shard.h"
+#include "json/writer.h"
+
+using namespace twilight;
+using namespace twilight::gateway;
+
+namespace
+{
+// touches every scalar so lazily decoded values are fully paid for
+usize walk(const Data& v)
+{
+  switch (v.type()) {
+  case Type::Object: {
+    usize n = 0;
+    for (auto [k, x] : v.fields()) n += k.size() + walk(x);
+    return n;
+  }
+  case Type::Array: {
+    usize n = 0;
+    for (Data x : v.items()) n += walk(x);
+    return n;
+  }
+  case Type::String:
+    return v.asStringView().value_or("").size();
+  case Type::Number:
+    return static_cast<usize>(v.asDouble().value_or(0));
+  case Type::Bool:
+    return v.asBool().value_or(false);
+  default:
+    return 0;
+  }
+}
+
+usize deflated(const std::string& msg)
+{
+  z_stream zs{};
+  deflateInit(&zs, Z_DEFAULT_COMPRESSION);
+  std::string out(deflateBound(&zs, msg.size()) + 16, '\0');
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(msg.data()));
+  zs.avail_in = msg.size();
+  zs.next_out = reinterpret_cast<Bytef*>(out.data());
+  zs.avail_out = out.size();
+  deflate(&zs, Z_SYNC_FLUSH);
+  usize n = out.size() - zs.avail_out;
+  deflateEnd(&zs);
+  return n;
+}
+
+void decodeFull(bench::State& state, Encoding encoding, const std::string& msg)
+{
+  Shard shard({.encoding = encoding});
+  usize sink = 0;
+  for (usize i = 0; i < state.iterations; ++i) {
+    auto payload = shard.decode(msg);
+    sink += walk(payload->d);
+  }
+  bench::doNotOptimize(sink);
+  state.bytes = msg.size();
+  state.counter("wire", msg.size());
+  state.counter("zlib", deflated(msg));
+}
+
+void decodeEnvelope(bench::State& state, Encoding encoding, const std::string& msg)
+{
+  Shard shard({.encoding = encoding});
+  usize sink = 0;
+  for (usize i = 0; i < state.iterations; ++i) {
+    auto payload = shard.decode(msg);
+    sink += payload->t.size() + payload->s.value_or(0);
+  }
+  bench::doNotOptimize(sink);
+  state.bytes = msg.size();
+}
+
+// a dispatch nobody subscribed to, dropped after its envelope
+void decodeUnsubscribed(bench::State& state, Encoding encoding, const std::string& msg)
+{
+  Shard shard({.encoding = encoding});
+  shard.setEvents(EventSet{"INTERACTION_CREATE"});
+  usize sink = 0;
+  for (usize i = 0; i < state.iterations; ++i) {
+    auto payload = shard.decode(msg);
+    sink += payload->t.size() + payload->s.value_or(0);
+  }
+  bench::doNotOptimize(sink);
+  state.bytes = msg.size();
+}
+}  // namespace
+
+BENCHMARK(gatewayJsonGuildCreate) { decodeFull(state, Encoding::JSON, bench::corpus::guildCreate<json::Writer>(1000)); }
+BENCHMARK(gatewayEtfGuildCreate) { decodeFull(state, Encoding::ETF, bench::corpus::guildCreate<etf::Writer>(1000)); }
+
+BENCHMARK(gatewayJsonGuildCreateEnvelope)
+{
+  decodeEnvelope(state, Encoding::JSON, bench::corpus::guildCreate<json::Writer>(1000));
+}
+BENCHMARK(gatewayEtfGuildCreateEnvelope)
+{
+  decodeEnvelope(state, Encoding::ETF, bench::corpus::guildCreate<etf::Writer>(1000));
+}
+
+BENCHMARK(gatewayJsonGuildCreateUnsubscribed)
+{
+  decodeUnsubscribed(state, Encoding::JSON, bench::corpus::guildCreate<json::Writer>(1000));
+}
+BENCHMARK(gatewayJsonPresenceUpdateUnsubscribed)
+{
+  decodeUnsubscribed(state, Encoding::JSON, bench::corpus::presenceUpdate<json::Writer>(1));
+}
+BENCHMARK(gatewayEtfPresenceUpdateUnsubscribed)
+{
+  decodeUnsubscribed(state, Encoding::ETF, bench::corpus::presenceUpdate<etf::Writer>(1));
+}
+
+BENCHMARK(gatewayJsonPresenceUpdate) { decodeFull(state, Encoding::JSON, bench::corpus::presenceUpdate<json::Writer>(1)); }
+BENCHMARK(gatewayEtfPresenceUpdate) { decodeFull(state, Encoding::ETF, bench::corpus::presenceUpdate<etf::Writer>(1)); }
+
+BENCHMARK(gatewayJsonMessageCreate) { decodeFull(state, Encoding::JSON, bench::corpus::messageCreate<json::Writer>(1)); }
+BENCHMARK(gatewayEtfMessageCreate) { decodeFull(state, Encoding::ETF, bench::corpus::messageCreate<etf::Writer>(1)); }
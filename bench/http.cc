@@ -0,0 +1,150 @@
+#include <brotli/encode.h>
+#include <zlib.h>
+
+#include <string>
+
+#include "bench.h"
+#include "corpus.h"
+#include "http/cache.h"
+#include "http/headers.h"
+#include "http/response.h"
+#include "http/server.h"
+#include "json/writer.h"
+
+using namespace twilight;
+
+namespace
+{
+// a page of GET /channels/{id}/messages, the largest response the bot fetches routinely
+std::string page() { return bench::corpus::channelMessages<json::Writer>(50); }
+
+// at the levels cloudflare serves discord's API with
+std::string compress(std::string_view encoding, std::string_view data)
+{
+  std::string out;
+  if (encoding == "br") {
+    usize n = BrotliEncoderMaxCompressedSize(data.size());
+    out.resize(n);
+    BrotliEncoderCompress(4, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, data.size(),
+      reinterpret_cast<const u8*>(data.data()), &n, reinterpret_cast<u8*>(out.data()));
+    out.resize(n);
+    return out;
+  }
+
+  z_stream zs{};
+  deflateInit2(&zs, 6, Z_DEFLATED, encoding == "gzip" ? 16 + MAX_WBITS : MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+  out.resize(deflateBound(&zs, data.size()));
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  zs.avail_in = data.size();
+  zs.next_out = reinterpret_cast<Bytef*>(out.data());
+  zs.avail_out = out.size();
+  deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return out;
+}
+
+void parse(bench::State& state, const std::string& raw)
+{
+  for (usize i = 0; i < state.iterations; ++i) bench::doNotOptimize(http::Response::parse(raw));
+  state.bytes = raw.size();
+}
+
+void parseEncoded(bench::State& state, std::string_view encoding)
+{
+  std::string body = page();
+  std::string encoded = compress(encoding, body);
+  std::string headers = "Content-Encoding: " + std::string{encoding} + "\r\n";
+  parse(state, bench::corpus::restResponse(encoded, headers));
+  state.counter("ratio", static_cast<f64>(body.size()) / encoded.size());
+}
+
+// throughput is over the decoded body, so the codecs compare directly
+void decompress(bench::State& state, std::string_view encoding)
+{
+  std::string body = page();
+  std::string encoded = compress(encoding, body);
+  for (usize i = 0; i < state.iterations; ++i)
+    bench::doNotOptimize(http::Response::decompress(encoding, encoded, &bufferPool()));
+  state.bytes = body.size();
+  state.counter("ratio", static_cast<f64>(body.size()) / encoded.size());
+}
+
+// GETs of a page from a loopback server over one keep-alive connection, through `cache` if given. the server answers
+// with `cacheControl` and an ETag, and 304s a matching If-None-Match
+void cached(bench::State& state, http::ResponseCache* cache, std::string_view cacheControl)
+{
+  std::string body = page();
+  http::Server server({.host = "127.0.0.1", .port = 0, .workers = 1}, [&](const http::Request& req) {
+    http::Response res{.statusCode = 200, .statusMessage = {}, .headers = {}, .body = {}};
+    res.headers.add("Cache-Control", cacheControl);
+    res.headers.add("ETag", "\"v1\"");
+    if (req.headers.get("if-none-match") == std::optional<std::string_view>{"\"v1\""})
+      res.statusCode = 304;
+    else
+      res.body = body;
+    return res;
+  });
+  server.listen();
+
+  http::Client client{"http://127.0.0.1:" + std::to_string(server.port())};
+  for (usize i = 0; i < state.iterations; ++i)
+    bench::doNotOptimize(client.request("/channels/1/messages", {.cache = cache}).body.size());
+  state.bytes = body.size();
+  server.close();
+}
+}  // namespace
+
+BENCHMARK(headersParse)
+{
+  std::string raw = bench::corpus::restResponse({});
+  // the header block without the status line and the blank line, as Response::parse hands it over
+  std::string_view block = raw;
+  block = block.substr(block.find("\r\n") + 2);
+  block = block.substr(0, block.find("\r\n\r\n"));
+  for (usize i = 0; i < state.iterations; ++i) bench::doNotOptimize(http::Headers::parse(block));
+  state.bytes = block.size();
+}
+
+BENCHMARK(headersFind)
+{
+  std::string raw = bench::corpus::restResponse({});
+  for (usize i = 0; i < state.iterations; ++i) bench::doNotOptimize(http::Headers::find(raw, "Content-Length"));
+  state.bytes = raw.size();
+}
+
+BENCHMARK(responseParse) { parse(state, bench::corpus::restResponse(page())); }
+
+BENCHMARK(responseParseChunked)
+{
+  parse(state, bench::corpus::restResponse(bench::corpus::chunked(page(), 4096), "Transfer-Encoding: chunked\r\n"));
+}
+
+BENCHMARK(responseParseGzip) { parseEncoded(state, "gzip"); }
+BENCHMARK(responseParseDeflate) { parseEncoded(state, "deflate"); }
+BENCHMARK(responseParseBrotli) { parseEncoded(state, "br"); }
+
+BENCHMARK(decodeChunked)
+{
+  std::string body = page();
+  std::string encoded = bench::corpus::chunked(body, 4096);
+  for (usize i = 0; i < state.iterations; ++i)
+    bench::doNotOptimize(http::Response::decodeChunked(encoded, &bufferPool()));
+  state.bytes = body.size();
+}
+
+BENCHMARK(decompressGzip) { decompress(state, "gzip"); }
+BENCHMARK(decompressDeflate) { decompress(state, "deflate"); }
+BENCHMARK(decompressBrotli) { decompress(state, "br"); }
+
+BENCHMARK(httpCacheNone) { cached(state, nullptr, "max-age=60"); }
+BENCHMARK(httpCacheFresh)
+{
+  http::ResponseCache cache;
+  cached(state, &cache, "max-age=60");
+}
+BENCHMARK(httpCacheRevalidated)
+{
+  http::ResponseCache cache;
+  cached(state, &cache, "no-cache");
+}
@@ -0,0 +1,53 @@
+#include <chrono>
+#include <string>
+
+#include "bench.h"
+#include "http/client.h"
+#include "interactions/endpoint.h"
+#include "utils/histogram.h"
+
+using namespace twilight;
+
+namespace
+{
+constexpr std::string_view TIMESTAMP = "1700000000";
+constexpr std::string_view BODY = R"({"type":2,"id":"1234567890123456789","application_id":"1234567890123456789",)"
+                                  R"("data":{"id":"1234567890123456789","name":"ping","type":1},)"
+                                  R"("channel_id":"1234567890123456789","token":"aW50ZXJhY3Rpb246MTIzNDU2Nzg5MA"})";
+
+std::string hex(const auto& bytes)
+{
+  return crypto::hex({reinterpret_cast<const char*>(bytes.data()), bytes.size()});
+}
+}  // namespace
+
+// signed requests over one keep-alive loopback connection, verification and the handler included
+BENCHMARK(interactionsRoundTrip)
+{
+  auto key = crypto::KeyPair::generate();
+  interactions::Endpoint endpoint(
+    {.publicKey = hex(key.publicKey()), .server = {.host = "127.0.0.1", .port = 0, .workers = 1}},
+    [](const interactions::Interaction&) {
+      return interactions::Endpoint::response(R"({"type":4,"data":{"content":"pong"}})");
+    });
+  endpoint.listen();
+
+  http::Client client(URI{"http://127.0.0.1:" + std::to_string(endpoint.port())});
+  http::RequestInit init{http::Method::POST, std::string{BODY},
+    {{"Content-Type", "application/json"}, {"X-Signature-Ed25519", hex(key.sign(TIMESTAMP, BODY))},
+      {"X-Signature-Timestamp", std::string{TIMESTAMP}}}};
+
+  Histogram latency;
+  for (usize i = 0; i < state.iterations; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    auto res = client.request("/interactions", init);
+    latency.record((std::chrono::steady_clock::now() - start).count());
+    bench::doNotOptimize(res);
+  }
+  endpoint.close();
+
+  state.bytes = BODY.size();
+  state.counter("p50", latency.percentile(0.5));
+  state.counter("p99", latency.percentile(0.99));
+  state.counter("unauthorized", endpoint.stats().unauthorized);
+}
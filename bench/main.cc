@@ -0,0 +1,111 @@
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "bench.h"
+
+using namespace twilight::bench;
+
+// each case is rerun with more iterations until a single run takes at least this long
+static constexpr std::chrono::milliseconds MIN_TIME{100};
+// runs of that length timed per case, the median is reported
+static constexpr usize REPETITIONS = 5;
+
+// counted by the operator new below
+static thread_local usize allocated = 0;
+
+usize twilight::bench::allocations() noexcept { return allocated; }
+
+void* operator new(usize n)
+{
+  ++allocated;
+  if (void* p = std::malloc(n ? n : 1))
+    return p;
+  throw std::bad_alloc{};
+}
+
+void* operator new(usize n, std::align_val_t align)
+{
+  ++allocated;
+  usize a = static_cast<usize>(align);
+  if (void* p = std::aligned_alloc(a, (n + a - 1) & ~(a - 1)))
+    return p;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, usize) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, usize, std::align_val_t) noexcept { std::free(p); }
+
+namespace
+{
+struct Run {
+  std::chrono::nanoseconds elapsed;
+  usize allocations;
+};
+
+Run run(const Case& c, State& state, usize iterations)
+{
+  state = State{.iterations = iterations};
+  usize before = allocations();
+  auto start = std::chrono::steady_clock::now();
+  c.fn(state);
+  return {std::chrono::steady_clock::now() - start, allocations() - before};
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  // optional substring filter on benchmark names
+  const char* filter = argc > 1 ? argv[1] : nullptr;
+
+  // migrations between cores show up as noise, so everything runs where it started
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(sched_getcpu(), &cpus);
+  sched_setaffinity(0, sizeof(cpus), &cpus);
+
+  std::printf("%-40s %12s %12s %7s %12s %10s\n", "benchmark", "iterations", "ns/op", "+-", "MB/s", "allocs/op");
+
+  for (const Case& c : registry()) {
+    if (filter && !std::strstr(c.name, filter))
+      continue;
+
+    State state;
+    usize n = 1;
+    Run last = run(c, state, n), previous{};
+    while (last.elapsed < MIN_TIME) {
+      previous = last;
+      n *= 4;
+      last = run(c, state, n);
+    }
+
+    // setup outside the hot loop allocates the same at any iteration count, so the difference between the last two
+    // runs is what the loop allocated
+    f64 allocs = n == 1 ? static_cast<f64>(last.allocations)
+                        : std::max(0.0, static_cast<f64>(last.allocations) - static_cast<f64>(previous.allocations)) /
+                            static_cast<f64>(n - n / 4);
+
+    f64 times[REPETITIONS];
+    times[0] = static_cast<f64>(last.elapsed.count()) / n;
+    for (usize r = 1; r < REPETITIONS; ++r) times[r] = static_cast<f64>(run(c, state, n).elapsed.count()) / n;
+    std::sort(times, times + REPETITIONS);
+    f64 ns = times[REPETITIONS / 2];
+    f64 spread = (times[REPETITIONS - 1] - times[0]) / ns * 50;
+
+    std::printf("%-40s %12zu %12.1f %6.1f%%", c.name, n, ns, spread);
+    if (state.bytes)
+      std::printf(" %12.1f", state.bytes / ns * 1e3);
+    else
+      std::printf(" %12s", "-");
+    std::printf(" %10.2f", allocs);
+    for (const auto& [name, value] : state.counters) std::printf("  %s=%g", name.c_str(), value);
+    std::printf("\n");
+  }
+}
@@ -0,0 +1,38 @@
+#include "bench.h"
+#include "utils/histogram.h"
+#include "utils/metrics.h"
+
+using namespace twilight;
+
+BENCHMARK(metricsCounter)
+{
+  metrics::Counter& c = metrics::registry().counter("bench_counter_total");
+  for (usize i = 0; i < state.iterations; ++i) c.add();
+  bench::doNotOptimize(c);
+}
+
+// the single-threaded histogram, for comparison
+BENCHMARK(metricsHistogramPlain)
+{
+  Histogram h;
+  for (usize i = 0; i < state.iterations; ++i) h.record(1000 + (i & 0xFFFF));
+  bench::doNotOptimize(h);
+}
+
+BENCHMARK(metricsHistogram)
+{
+  metrics::AtomicHistogram& h = metrics::registry().histogram("bench_histogram_ns");
+  for (usize i = 0; i < state.iterations; ++i) h.record(1000 + (i & 0xFFFF));
+  bench::doNotOptimize(h);
+}
+
+// what timing one span costs: two clock reads and a record
+BENCHMARK(metricsSpan)
+{
+  metrics::AtomicHistogram& h = metrics::registry().histogram("bench_span_ns");
+  for (usize i = 0; i < state.iterations; ++i) {
+    auto start = metrics::now();
+    h.record(metrics::now() - start);
+  }
+  bench::doNotOptimize(h);
+}
@@ -0,0 +1,50 @@
+#include <string>
+
+#include "bench.h"
+#include "corpus.h"
+#include "http/response.h"
+#include "json/writer.h"
+#include "utils/pool.h"
+
+using namespace twilight;
+
+namespace
+{
+// what recvFrame sees on a busy gateway: mostly small dispatches with the odd large one
+constexpr usize SIZES[] = {180, 420, 900, 2400, 180, 640, 16000, 300, 1500, 190000};
+constexpr usize MIX = std::size(SIZES);
+
+void parse(bench::State& state, std::pmr::memory_resource* resource)
+{
+  std::string raw = bench::corpus::restResponse(bench::corpus::createdMessage<json::Writer>(0));
+  for (usize i = 0; i < state.iterations; ++i) bench::doNotOptimize(http::Response::parse(raw, resource));
+  state.bytes = raw.size();
+}
+}  // namespace
+
+// a frame payload copied out of the receive buffer and dropped once handled, as before the arena
+BENCHMARK(frameHeap)
+{
+  std::string rbuf(SIZES[MIX - 1], 'p');
+  for (usize i = 0; i < state.iterations; ++i) {
+    std::string payload(rbuf, 0, SIZES[i % MIX]);
+    bench::doNotOptimize(payload);
+  }
+}
+
+BENCHMARK(frameArena)
+{
+  std::string rbuf(SIZES[MIX - 1], 'p');
+  MessageArena arena;
+  for (usize i = 0; i < state.iterations; ++i) {
+    {
+      std::pmr::string payload{&arena};
+      payload.assign(rbuf.data(), SIZES[i % MIX]);
+      bench::doNotOptimize(payload);
+    }
+    arena.reset();
+  }
+}
+
+BENCHMARK(responseParseHeap) { parse(state, std::pmr::new_delete_resource()); }
+BENCHMARK(responseParsePooled) { parse(state, &bufferPool()); }
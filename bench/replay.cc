@@ -0,0 +1,86 @@
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "bench.h"
+#include "cache/cache.h"
+#include "corpus.h"
+#include "etf/writer.h"
+#include "gateway/capture.h"
+#include "gateway/dispatcher.h"
+#include "gateway/shard.h"
+#include "json/writer.h"
+
+using namespace twilight;
+using namespace twilight::gateway;
+
+namespace
+{
+const Intent INTENTS = Intent::GUILDS | Intent::GUILD_MEMBERS | Intent::GUILD_PRESENCES | Intent::GUILD_MESSAGES;
+
+// a guild coming online followed by steady presence and message traffic, written through a Recorder like a live
+// session would be
+template <typename W>
+std::string synthesize(Encoding encoding)
+{
+  char path[] = "/tmp/twilight-capture-XXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+
+  Recorder recorder(path, encoding, Compression::None);
+  auto opcode = encoding == Encoding::ETF ? ws::Opcode::Binary : ws::Opcode::Text;
+  recorder.record({.opcode = opcode, .payload = std::pmr::string{bench::corpus::guildCreate<W>(1000)}});
+  for (u64 i = 0; i < 4000; ++i) {
+    if (i % 4 == 3)
+      recorder.record({.opcode = opcode, .payload = std::pmr::string{bench::corpus::messageCreate<W>(i)}});
+    else
+      recorder.record({.opcode = opcode, .payload = std::pmr::string{bench::corpus::presenceUpdate<W>(i % 1000)}});
+  }
+  return path;
+}
+
+// the whole pipeline: decode, cache, dispatch to a message handler
+void replayCapture(bench::State& state, const std::string& path, bool temporary)
+{
+  auto capture = Capture::open(path);
+  if (temporary)
+    unlink(path.c_str());
+  if (!capture.has_value())
+    return;
+
+  ReplayStats total;
+  for (usize i = 0; i < state.iterations; ++i) {
+    Shard shard({.encoding = capture->encoding(), .compression = capture->compression()});
+    cache::Cache cache(INTENTS);
+    Dispatcher dispatcher(&cache);
+    usize messages = 0;
+    dispatcher.on<MessageCreate>([&](const MessageCreate& e) { messages += e.d.find("content").has_value(); });
+    dispatcher.attach(shard);
+
+    ReplayStats stats = replay(*capture, shard);
+    bench::doNotOptimize(messages);
+    total.messages += stats.messages;
+    total.errors += stats.errors;
+    total.elapsed += stats.elapsed;
+    total.latency.merge(stats.latency);
+  }
+
+  state.bytes = capture->size();
+  state.counter("msgs/s", total.messagesPerSecond());
+  state.counter("p50", total.latency.percentile(0.5));
+  state.counter("p99", total.latency.percentile(0.99));
+  state.counter("max", total.latency.max());
+  state.counter("errors", total.errors);
+}
+}  // namespace
+
+// TWILIGHT_CAPTURE replaces the synthetic session with a real capture, recorded with Shard::Options::recorder
+BENCHMARK(replayJsonSession)
+{
+  if (const char* path = std::getenv("TWILIGHT_CAPTURE"))
+    replayCapture(state, path, false);
+  else
+    replayCapture(state, synthesize<json::Writer>(Encoding::JSON), true);
+}
+BENCHMARK(replayEtfSession) { replayCapture(state, synthesize<etf::Writer>(Encoding::ETF), true); }
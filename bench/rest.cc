@@ -0,0 +1,35 @@
+#include <format>
+#include <string>
+
+#include "bench.h"
+#include "rest/route.h"
+#include "uri.h"
+
+using namespace twilight;
+
+namespace
+{
+constexpr u64 CHANNEL = 381870553235193857ull;
+constexpr u64 MESSAGE = 1234567890123456789ull;
+}  // namespace
+
+// formatting the path and working the bucket key out of it at runtime
+BENCHMARK(routeFromPath)
+{
+  for (usize i = 0; i < state.iterations; ++i) {
+    std::string path = std::format("/channels/{}/messages/{}", CHANNEL, MESSAGE + i);
+    bench::doNotOptimize(rest::Route{http::Method::PATCH, std::move(path)});
+  }
+}
+
+BENCHMARK(routeFromTemplate)
+{
+  for (usize i = 0; i < state.iterations; ++i) bench::doNotOptimize(rest::EditMessage::route(CHANNEL, MESSAGE + i));
+}
+
+BENCHMARK(uriViewParse)
+{
+  constexpr std::string_view url = "wss://gateway.discord.gg/?v=10&encoding=json&compress=zlib-stream";
+  for (usize i = 0; i < state.iterations; ++i) bench::doNotOptimize(URIView::parse(url));
+  state.bytes = url.size();
+}
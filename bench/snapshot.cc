@@ -0,0 +1,58 @@
+#include <filesystem>
+#include <string>
+
+#include "bench.h"
+#include "cache/snapshot.h"
+#include "corpus.h"
+#include "json/writer.h"
+
+using namespace twilight;
+using namespace twilight::gateway;
+
+// a guild of 1000 members written to a snapshot and restored from it, next to cacheJsonGuildCreate which builds
+// the same guild from its GUILD_CREATE
+namespace
+{
+const Intent INTENTS = Intent::GUILDS | Intent::GUILD_MEMBERS | Intent::GUILD_PRESENCES;
+
+std::string path()
+{
+  return (std::filesystem::temp_directory_path() / "twilight-bench.snap").string();
+}
+
+void fill(cache::Cache& cache)
+{
+  Shard shard({.encoding = Encoding::JSON});
+  cache.ingest(*shard.decode(bench::corpus::guildCreate<json::Writer>(1000)));
+}
+}  // namespace
+
+BENCHMARK(snapshotWrite)
+{
+  cache::Cache cache(INTENTS);
+  fill(cache);
+  std::vector<cache::ShardSession> sessions{{0, 1, {"session", "wss://gateway.discord.gg", 1}}};
+  for (usize i = 0; i < state.iterations; ++i) cache::Snapshot::write(path(), cache, sessions);
+  state.bytes = std::filesystem::file_size(path());
+  std::filesystem::remove(path());
+}
+
+// open, restore and the lookup that materializes the guild: what a restarted bot pays before serving it
+BENCHMARK(snapshotRestore)
+{
+  {
+    cache::Cache cache(INTENTS);
+    fill(cache);
+    cache::Snapshot::write(path(), cache, {});
+  }
+  usize members = 0;
+  for (usize i = 0; i < state.iterations; ++i) {
+    cache::Cache cache(INTENTS);
+    cache.restore(*cache::Snapshot::open(path()));
+    cache::Epoch::Guard guard;
+    members = cache.guild(bench::corpus::GUILD_ID)->cachedMembers();
+  }
+  state.bytes = std::filesystem::file_size(path());
+  state.counter("members", members);
+  std::filesystem::remove(path());
+}
@@ -0,0 +1,303 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <ctime>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "bench.h"
+#include "http/tls.h"
+#include "utils/uring.h"
+
+using namespace twilight;
+
+// TLS over a TCP loopback connection the way http::Client did it, with OpenSSL reading and writing the socket itself,
+// and through http::Tls with the ciphertext moved by recv/send or a UringSocket. syscalls/msg and cpu ns/msg are the
+// client's, the server runs OpenSSL on its own thread
+namespace
+{
+// a gateway dispatch or a small REST response, each in a record of its own
+constexpr usize MESSAGE = 256;
+// a large request body, four full records
+constexpr usize BODY = 65536;
+
+struct Pair {
+  int local = -1;
+  int remote = -1;
+
+  Pair()
+  {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{.sin_family = AF_INET, .sin_port = 0, .sin_addr = {htonl(INADDR_LOOPBACK)}, .sin_zero = {}};
+    socklen_t len = sizeof(addr);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), len) != 0 || ::listen(listener, 1) != 0 ||
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) != 0)
+      throw std::runtime_error("loopback listen failed");
+    local = socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(local, reinterpret_cast<sockaddr*>(&addr), len) != 0)
+      throw std::runtime_error("loopback connect failed");
+    remote = accept(listener, nullptr, nullptr);
+    ::close(listener);
+    int one = 1;
+    setsockopt(local, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(remote, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  ~Pair()
+  {
+    ::close(local);
+    ::close(remote);
+  }
+};
+
+inline i64 cpuNanos() noexcept
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+}
+
+// a server context with a throwaway EC key and a certificate signed with it
+SSL_CTX* serverContext()
+{
+  static SSL_CTX* ctx = [] {
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 60 * 60);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const u8*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    if (!X509_sign(cert, key, EVP_sha256()) || SSL_CTX_use_certificate(ctx, cert) != 1 ||
+        SSL_CTX_use_PrivateKey(ctx, key) != 1)
+      throw std::runtime_error("self-signed certificate failed");
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ctx;
+  }();
+  return ctx;
+}
+
+SSL_CTX* clientContext()
+{
+  static SSL_CTX* ctx = [] {
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+    return ctx;
+  }();
+  return ctx;
+}
+
+// accepts on `fd`, then `messages` records of MESSAGE bytes or, without any, reads until the connection closes
+std::jthread server(int fd, usize messages)
+{
+  return std::jthread{[fd, messages] {
+    SSL* ssl = SSL_new(serverContext());
+    SSL_set_fd(ssl, fd);
+    if (SSL_accept(ssl) == 1) {
+      std::string buf(BODY, 'm');
+      for (usize i = 0; i < messages; ++i)
+        if (SSL_write(ssl, buf.data(), MESSAGE) <= 0)
+          break;
+      if (!messages)
+        while (SSL_read(ssl, buf.data(), buf.size()) > 0) {
+        }
+    }
+    SSL_free(ssl);
+  }};
+}
+
+// OpenSSL on the socket, every recv and send it makes counted
+struct SocketBio {
+  SSL* ssl;
+  u64 syscalls = 0;
+
+  explicit SocketBio(int fd) : ssl(SSL_new(clientContext()))
+  {
+    SSL_set_fd(ssl, fd);
+    BIO_set_callback_ex(SSL_get_rbio(ssl), count);
+    BIO_set_callback_arg(SSL_get_rbio(ssl), reinterpret_cast<char*>(&syscalls));
+    if (SSL_connect(ssl) != 1)
+      throw std::runtime_error("handshake failed");
+    syscalls = 0;
+  }
+  ~SocketBio() { SSL_free(ssl); }
+
+  static long count(BIO* bio, int op, const char*, usize, int, long, int ret, usize*)
+  {
+    if (op == BIO_CB_READ || op == BIO_CB_WRITE)
+      ++*reinterpret_cast<u64*>(BIO_get_callback_arg(bio));
+    // after the call it passes the result on
+    return op & BIO_CB_RETURN ? ret : 1;
+  }
+};
+
+// http::Tls with its ciphertext moved by `recv` and `send`, the way http::Client drives it
+template <typename Recv, typename Send>
+struct MemoryBio {
+  http::Tls tls{clientContext(), "localhost"};
+  Recv recv;
+  Send send;
+  std::string incoming = std::string(65536, '\0');
+  std::string sealed;
+
+  MemoryBio(Recv recv, Send send) : recv(std::move(recv)), send(std::move(send))
+  {
+    http::Tls::Status status;
+    while ((status = tls.handshake()) != http::Tls::Status::Done) {
+      if (status == http::Tls::Status::Failed || !flush() || !fill())
+        throw std::runtime_error("handshake failed");
+    }
+    flush();
+  }
+
+  bool flush()
+  {
+    sealed.clear();
+    return !tls.take(sealed) || send(sealed.data(), sealed.size());
+  }
+  bool fill()
+  {
+    isize n = recv(incoming.data(), incoming.size());
+    if (n > 0)
+      tls.feed(incoming.data(), n);
+    return n > 0;
+  }
+  isize read(char* buf, usize len)
+  {
+    isize n;
+    while ((n = tls.read(buf, len)) == http::Tls::MORE)
+      if (!fill())
+        return -1;
+    return n;
+  }
+  bool write(const char* buf, usize len) { return tls.write(buf, len) && flush(); }
+};
+
+// a MemoryBio on plain recv/send, counting them
+auto plain(int fd, u64& syscalls)
+{
+  return MemoryBio{[fd, &syscalls](char* buf, usize len) {
+                     ++syscalls;
+                     return ::recv(fd, buf, len, 0);
+                   },
+                   [fd, &syscalls](const char* buf, usize len) {
+                     ++syscalls;
+                     return ::send(fd, buf, len, MSG_NOSIGNAL) == static_cast<isize>(len);
+                   }};
+}
+
+auto uring(UringSocket& ring)
+{
+  return MemoryBio{[&ring](char* buf, usize len) { return ring.recv(buf, len); },
+                   [&ring](const char* buf, usize len) { return ring.send(buf, len) >= 0; }};
+}
+
+// reads until `total` bytes arrived
+template <typename Read>
+void drain(usize total, Read&& read)
+{
+  char buf[16384];
+  for (usize got = 0; got < total;) {
+    isize n = read(buf, sizeof(buf));
+    if (n <= 0)
+      throw std::runtime_error("loopback read failed");
+    got += n;
+  }
+}
+
+void report(bench::State& state, usize bytes, u64 syscalls, i64 cpu)
+{
+  state.bytes = bytes;
+  state.counter("syscalls/msg", static_cast<f64>(syscalls) / state.iterations);
+  state.counter("cpu ns/msg", static_cast<f64>(cpu) / state.iterations);
+}
+}  // namespace
+
+BENCHMARK(tlsStreamSocketBio)
+{
+  Pair pair;
+  auto peer = server(pair.remote, state.iterations);
+  SocketBio client{pair.local};
+  i64 cpu = cpuNanos();
+  drain(state.iterations * MESSAGE, [&](char* buf, usize len) { return SSL_read(client.ssl, buf, len); });
+  report(state, MESSAGE, client.syscalls, cpuNanos() - cpu);
+}
+
+BENCHMARK(tlsStreamMemoryBio)
+{
+  Pair pair;
+  auto peer = server(pair.remote, state.iterations);
+  u64 syscalls = 0;
+  auto client = plain(pair.local, syscalls);
+  syscalls = 0;
+  i64 cpu = cpuNanos();
+  drain(state.iterations * MESSAGE, [&](char* buf, usize len) { return client.read(buf, len); });
+  report(state, MESSAGE, syscalls, cpuNanos() - cpu);
+}
+
+BENCHMARK(tlsStreamRing)
+{
+  if (!UringSocket::supported())
+    return;
+  Pair pair;
+  auto peer = server(pair.remote, state.iterations);
+  UringSocket ring{pair.local};
+  auto client = uring(ring);
+  u64 enters = ring.enters();
+  i64 cpu = cpuNanos();
+  drain(state.iterations * MESSAGE, [&](char* buf, usize len) { return client.read(buf, len); });
+  report(state, MESSAGE, ring.enters() - enters, cpuNanos() - cpu);
+}
+
+// large messages sent, which OpenSSL writes a record per send
+BENCHMARK(tlsSendSocketBio)
+{
+  Pair pair;
+  auto peer = server(pair.remote, 0);
+  std::string body(BODY, 'b');
+  i64 cpu;
+  u64 syscalls;
+  {
+    SocketBio client{pair.local};
+    BIO_set_callback_ex(SSL_get_wbio(client.ssl), SocketBio::count);
+    BIO_set_callback_arg(SSL_get_wbio(client.ssl), reinterpret_cast<char*>(&client.syscalls));
+    cpu = cpuNanos();
+    for (usize i = 0; i < state.iterations; ++i)
+      if (SSL_write(client.ssl, body.data(), body.size()) <= 0)
+        throw std::runtime_error("loopback write failed");
+    cpu = cpuNanos() - cpu;
+    syscalls = client.syscalls;
+  }
+  report(state, BODY, syscalls, cpu);
+  shutdown(pair.local, SHUT_RDWR);
+}
+
+BENCHMARK(tlsSendMemoryBio)
+{
+  Pair pair;
+  auto peer = server(pair.remote, 0);
+  std::string body(BODY, 'b');
+  u64 syscalls = 0;
+  i64 cpu;
+  {
+    auto client = plain(pair.local, syscalls);
+    syscalls = 0;
+    cpu = cpuNanos();
+    for (usize i = 0; i < state.iterations; ++i)
+      if (!client.write(body.data(), body.size()))
+        throw std::runtime_error("loopback write failed");
+    cpu = cpuNanos() - cpu;
+  }
+  report(state, BODY, syscalls, cpu);
+  shutdown(pair.local, SHUT_RDWR);
+}
@@ -0,0 +1,221 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "bench.h"
+#include "utils/uring.h"
+
+using namespace twilight;
+
+// the same messages received through blocking recv, epoll over a nonblocking socket and UringSocket, on a TCP
+// loopback connection. syscalls/msg and cpu ns/msg are the receiving thread's, the peer runs on its own thread. the
+// peer shares the harness's pinned core, so ping-pong times include switching to it and back
+namespace
+{
+// a gateway dispatch or a small REST response
+constexpr usize MESSAGE = 256;
+
+struct Pair {
+  int local = -1;
+  int remote = -1;
+
+  Pair()
+  {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{.sin_family = AF_INET, .sin_port = 0, .sin_addr = {htonl(INADDR_LOOPBACK)}, .sin_zero = {}};
+    socklen_t len = sizeof(addr);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), len) != 0 || ::listen(listener, 1) != 0 ||
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) != 0)
+      throw std::runtime_error("loopback listen failed");
+    local = socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(local, reinterpret_cast<sockaddr*>(&addr), len) != 0)
+      throw std::runtime_error("loopback connect failed");
+    remote = accept(listener, nullptr, nullptr);
+    ::close(listener);
+    int one = 1;
+    setsockopt(local, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(remote, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  ~Pair()
+  {
+    ::close(local);
+    ::close(remote);
+  }
+};
+
+inline i64 cpuNanos() noexcept
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+}
+
+// `messages` of MESSAGE bytes written back to back, as a busy gateway connection delivers them
+std::jthread stream(int fd, usize messages)
+{
+  return std::jthread{[fd, messages] {
+    std::string message(MESSAGE, 'm');
+    for (usize i = 0; i < messages; ++i)
+      if (::send(fd, message.data(), message.size(), MSG_NOSIGNAL) <= 0)
+        return;
+  }};
+}
+
+// sends back whatever arrives until the connection closes, a server answering every request
+std::jthread echo(int fd)
+{
+  return std::jthread{[fd] {
+    char buf[MESSAGE];
+    for (isize n; (n = ::recv(fd, buf, sizeof(buf), 0)) > 0;)
+      if (::send(fd, buf, n, MSG_NOSIGNAL) <= 0)
+        return;
+  }};
+}
+
+void report(bench::State& state, u64 syscalls, i64 cpu)
+{
+  state.bytes = MESSAGE;
+  state.counter("syscalls/msg", static_cast<f64>(syscalls) / state.iterations);
+  state.counter("cpu ns/msg", static_cast<f64>(cpu) / state.iterations);
+}
+
+// reads until `total` bytes arrived with `read(buf, len)`
+template <typename Read>
+void drain(usize total, Read&& read)
+{
+  char buf[65536];
+  for (usize got = 0; got < total;) {
+    isize n = read(buf, sizeof(buf));
+    if (n <= 0)
+      throw std::runtime_error("loopback read failed");
+    got += n;
+  }
+}
+
+// one socket readable through epoll, every wait and recv counted
+struct Poller {
+  int epoll;
+  int fd;
+  u64 syscalls = 0;
+
+  explicit Poller(int fd) : epoll(epoll_create1(0)), fd(fd)
+  {
+    epoll_event ev{.events = EPOLLIN, .data = {.fd = fd}};
+    epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev);
+  }
+  ~Poller() { ::close(epoll); }
+
+  isize read(char* buf, usize len) noexcept
+  {
+    while (true) {
+      ++syscalls;
+      isize n = ::recv(fd, buf, len, MSG_DONTWAIT);
+      if (n >= 0 || errno != EAGAIN)
+        return n;
+      epoll_event ev;
+      ++syscalls;
+      epoll_wait(epoll, &ev, 1, -1);
+    }
+  }
+};
+}  // namespace
+
+BENCHMARK(uringStreamBlocking)
+{
+  Pair pair;
+  auto sender = stream(pair.remote, state.iterations);
+  u64 syscalls = 0;
+  i64 cpu = cpuNanos();
+  drain(state.iterations * MESSAGE, [&](char* buf, usize len) {
+    ++syscalls;
+    return ::recv(pair.local, buf, len, 0);
+  });
+  report(state, syscalls, cpuNanos() - cpu);
+}
+
+BENCHMARK(uringStreamEpoll)
+{
+  Pair pair;
+  Poller poller{pair.local};
+  auto sender = stream(pair.remote, state.iterations);
+  i64 cpu = cpuNanos();
+  drain(state.iterations * MESSAGE, [&](char* buf, usize len) { return poller.read(buf, len); });
+  report(state, poller.syscalls, cpuNanos() - cpu);
+}
+
+BENCHMARK(uringStreamRing)
+{
+  Pair pair;
+  UringSocket ring{pair.local};
+  auto sender = stream(pair.remote, state.iterations);
+  i64 cpu = cpuNanos();
+  drain(state.iterations * MESSAGE, [&](char* buf, usize len) { return ring.recv(buf, len); });
+  report(state, ring.enters(), cpuNanos() - cpu);
+}
+
+// a request and its response at a time, like a REST client on a keep-alive connection
+BENCHMARK(uringPingPongBlocking)
+{
+  Pair pair;
+  auto server = echo(pair.remote);
+  std::string message(MESSAGE, 'r');
+  u64 syscalls = 0;
+  i64 cpu = cpuNanos();
+  for (usize i = 0; i < state.iterations; ++i) {
+    ++syscalls;
+    ::send(pair.local, message.data(), message.size(), MSG_NOSIGNAL);
+    drain(MESSAGE, [&](char* buf, usize) {
+      ++syscalls;
+      return ::recv(pair.local, buf, MESSAGE, 0);
+    });
+  }
+  report(state, syscalls, cpuNanos() - cpu);
+  shutdown(pair.local, SHUT_RDWR);
+}
+
+BENCHMARK(uringPingPongEpoll)
+{
+  Pair pair;
+  Poller poller{pair.local};
+  auto server = echo(pair.remote);
+  std::string message(MESSAGE, 'r');
+  i64 cpu = cpuNanos();
+  for (usize i = 0; i < state.iterations; ++i) {
+    ++poller.syscalls;
+    ::send(pair.local, message.data(), message.size(), MSG_NOSIGNAL);
+    drain(MESSAGE, [&](char* buf, usize) { return poller.read(buf, MESSAGE); });
+  }
+  report(state, poller.syscalls, cpuNanos() - cpu);
+  shutdown(pair.local, SHUT_RDWR);
+}
+
+// the request goes out with the wait for its response, as http::Client sends them
+BENCHMARK(uringPingPongRing)
+{
+  Pair pair;
+  auto server = echo(pair.remote);
+  std::string message(MESSAGE, 'r');
+  i64 cpu;
+  u64 syscalls;
+  {
+    UringSocket ring{pair.local};
+    cpu = cpuNanos();
+    for (usize i = 0; i < state.iterations; ++i) {
+      ring.send(message.data(), message.size(), true);
+      drain(MESSAGE, [&](char* buf, usize) { return ring.recv(buf, MESSAGE); });
+    }
+    cpu = cpuNanos() - cpu;
+    syscalls = ring.enters();
+  }
+  report(state, syscalls, cpu);
+  shutdown(pair.local, SHUT_RDWR);
+}
@@ -0,0 +1,104 @@
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "voice/jitter.h"
+#include "voice/rtp.h"
+#include "voice/transport.h"
+
+using namespace twilight;
+using namespace twilight::voice;
+
+namespace
+{
+// about what opus makes of 20 ms of speech at 64 kb/s
+constexpr usize FRAME_SIZE = 160;
+
+Cipher::Key key()
+{
+  Cipher::Key k;
+  for (usize i = 0; i < k.size(); ++i) k[i] = static_cast<u8>(i * 7);
+  return k;
+}
+
+// a UDP socket on loopback nothing reads from, and its port
+std::pair<int, u16> sink()
+{
+  int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr{.sin_family = AF_INET, .sin_port = 0, .sin_addr = {htonl(INADDR_LOOPBACK)}, .sin_zero = {}};
+  ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  socklen_t len = sizeof(addr);
+  ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+  return {fd, ntohs(addr.sin_port)};
+}
+
+// frames sent `batch` to a send(), one as a connection's tick does or a full sendmmsg as one catching up does, to a
+// socket nothing reads from. sent/pkt drops below 1 once its buffer is full
+void sends(bench::State& state, usize batch)
+{
+  auto [fd, port] = sink();
+  Transport transport("127.0.0.1", port, 1, 3);
+  transport.setKey(key());
+  std::vector<u8> frame(FRAME_SIZE, 0x55);
+  std::vector<std::span<const u8>> frames(batch, frame);
+  usize sent = 0;
+  for (usize i = 0; i < state.iterations; i += batch) sent += transport.send(frames);
+  bench::doNotOptimize(sent);
+  ::close(fd);
+  state.bytes = FRAME_SIZE;
+  state.counter("sent/pkt", static_cast<f64>(sent) / state.iterations);
+}
+}  // namespace
+
+BENCHMARK(voiceSeal)
+{
+  Cipher cipher(key());
+  std::vector<u8> frame(FRAME_SIZE, 0x55);
+  std::array<u8, MAX_PACKET> out;
+  usize size = 0;
+  for (usize i = 0; i < state.iterations; ++i)
+    size += cipher.seal({.sequence = static_cast<u16>(i), .timestamp = static_cast<u32>(i * 960), .ssrc = 1}, frame,
+                        out.data());
+  bench::doNotOptimize(size);
+  state.bytes = FRAME_SIZE;
+}
+
+BENCHMARK(voiceOpen)
+{
+  Cipher cipher(key());
+  std::vector<u8> frame(FRAME_SIZE, 0x55);
+  std::array<u8, MAX_PACKET> sealed, packet;
+  usize size = cipher.seal({.sequence = 1, .timestamp = 960, .ssrc = 1}, frame, sealed.data());
+  usize opened = 0;
+  for (usize i = 0; i < state.iterations; ++i) {
+    // opened in place, so every run starts from a fresh copy
+    std::copy_n(sealed.begin(), size, packet.begin());
+    opened += cipher.open({packet.data(), size}).has_value();
+  }
+  bench::doNotOptimize(opened);
+  state.bytes = size;
+}
+
+// a stream arriving with every 8th pair of packets swapped, played out a frame at a time
+BENCHMARK(voiceJitter)
+{
+  JitterBuffer jitter(3);
+  std::string frame(FRAME_SIZE, 'x'), out;
+  usize played = 0;
+  for (usize i = 0; i < state.iterations; ++i) {
+    u16 seq = static_cast<u16>(i % 8 == 6 ? i + 1 : i % 8 == 7 ? i - 1 : i);
+    jitter.push(seq, {reinterpret_cast<const u8*>(frame.data()), frame.size()});
+    played += jitter.pop(out) == JitterBuffer::Pop::Frame;
+  }
+  bench::doNotOptimize(played);
+  state.bytes = FRAME_SIZE;
+  state.counter("late", jitter.stats().late);
+}
+
+BENCHMARK(voiceSendSingle) { sends(state, 1); }
+BENCHMARK(voiceSendBatched) { sends(state, Transport::BATCH); }
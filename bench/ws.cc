@@ -0,0 +1,77 @@
+#include <array>
+#include <string>
+
+#include "bench.h"
+#include "corpus.h"
+#include "json/writer.h"
+#include "utils/pool.h"
+#include "ws/frame.h"
+
+using namespace twilight;
+
+namespace
+{
+// fixed instead of random, so runs are comparable
+constexpr std::array<u8, 4> MASK = {0x37, 0xfa, 0x21, 0x3d};
+
+void encode(bench::State& state, std::string_view payload)
+{
+  std::string out;
+  for (usize i = 0; i < state.iterations; ++i) {
+    out.clear();
+    ws::encodeFrame(out, 0b10000001, payload, MASK);
+    bench::doNotOptimize(out);
+  }
+  state.bytes = payload.size();
+}
+
+// every frame in `buf`, each dropped with its arena as recvFrame's caller does once the message is handled
+void decode(bench::State& state, std::string_view buf)
+{
+  MessageArena arena;
+  for (usize i = 0; i < state.iterations; ++i) {
+    for (std::string_view rest = buf; !rest.empty(); arena.reset()) {
+      ws::Frame frame{.opcode = ws::Opcode::Continuation, .payload = std::pmr::string{&arena}};
+      rest.remove_prefix(ws::decodeFrame(rest, frame));
+      bench::doNotOptimize(frame);
+    }
+  }
+  state.bytes = buf.size();
+}
+}  // namespace
+
+BENCHMARK(wsEncodeHeartbeat) { encode(state, R"({"op":1,"d":251})"); }
+
+BENCHMARK(wsEncodePresence)
+{
+  encode(state,
+    R"({"op":3,"d":{"since":null,"activities":[{"name":"twilight","type":0}],"status":"online","afk":false}})");
+}
+
+// masking throughput
+BENCHMARK(wsEncode64K) { encode(state, std::string(65536, 'x')); }
+
+// a burst of dispatches as one receive buffer: mostly messages and presences, and a guild create
+BENCHMARK(wsDecode)
+{
+  std::string buf;
+  for (u64 i = 0; i < 64; ++i) {
+    if (i % 2)
+      ws::encodeFrame(buf, 0b10000001, bench::corpus::messageCreate<json::Writer>(i));
+    else
+      ws::encodeFrame(buf, 0b10000001, bench::corpus::presenceUpdate<json::Writer>(i));
+  }
+  ws::encodeFrame(buf, 0b10000001, bench::corpus::guildCreate<json::Writer>(250));
+
+  decode(state, buf);
+}
+
+// the masked frames a server reads back, unmasked on decode
+BENCHMARK(wsDecodeMasked)
+{
+  std::string payload = bench::corpus::messageCreate<json::Writer>(1);
+  std::string buf;
+  for (usize i = 0; i < 16; ++i) ws::encodeFrame(buf, 0b10000001, payload, MASK);
+
+  decode(state, buf);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "epoch.h"
+#include "utils/types.h"
+
+namespace twilight::cache
+{
+// 32-bit handle into an Arena, 0 means "none". refs are half the size of a pointer, which adds up at hundreds of
+// thousands of members per guild
+using Ref = u32;
+
+// append-only bump allocator made of chunks that double from FIRST up to CHUNK bytes. nothing is freed
+// individually: the owner drops the whole arena at once, and memory replaced by an update is only accounted for as
+// wasted. since written bytes never change, readers can follow a ref they got from a consistent record while the
+// (single) writer keeps appending
+class Arena
+{
+ public:
+  static constexpr usize CHUNK_BITS = 16;
+  static constexpr usize CHUNK = usize(1) << CHUNK_BITS;
+  static constexpr usize FIRST = 512;
+
+  Arena() = default;
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // `n + align` must not exceed CHUNK
+  Ref allocate(usize n, usize align = 1);
+
+  inline char* data(Ref ref) noexcept
+  {
+    return chunks[ref >> CHUNK_BITS] + (ref & (CHUNK - 1));
+  }
+  inline const char* data(Ref ref) const noexcept
+  {
+    return chunks[ref >> CHUNK_BITS] + (ref & (CHUNK - 1));
+  }
+
+  // strings are stored with a u16 length prefix and truncated to fit in a chunk
+  Ref store(std::string_view s);
+  std::string_view string(Ref ref) const noexcept;
+
+  // arrays are stored with a u16 element count prefix, padded to the element alignment
+  template <typename T>
+  Ref storeArray(std::span<const T> items)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (items.empty())
+      return 0;
+    Ref ref = allocate(header<T>() + items.size_bytes(), header<T>());
+    u16 n = items.size();
+    std::memcpy(data(ref), &n, sizeof(n));
+    std::memcpy(data(ref) + header<T>(), items.data(), items.size_bytes());
+    return ref;
+  }
+  template <typename T>
+  std::span<const T> array(Ref ref) const noexcept
+  {
+    if (!ref)
+      return {};
+    u16 n;
+    std::memcpy(&n, data(ref), sizeof(n));
+    return {reinterpret_cast<const T*>(data(ref) + header<T>()), n};
+  }
+  template <typename T>
+  static constexpr usize arrayBytes(usize n) noexcept
+  {
+    return n ? header<T>() + n * sizeof(T) : 0;
+  }
+
+  // replace the contents behind `ref` with a fresh copy, unless they're equal. the old bytes are retired
+  void replace(Ref& ref, std::string_view s);
+  template <typename T>
+  void replace(Ref& ref, std::span<const T> items)
+  {
+    auto old = array<T>(ref);
+    if (std::ranges::equal(old, items))
+      return;
+    retire(arrayBytes<T>(old.size()));
+    ref = storeArray(items);
+  }
+
+  // marks the bytes behind `ref` as replaced, for accounting only
+  inline void retire(usize bytes) noexcept { add(wastedBytes, bytes); }
+
+  // calls `f` with the written bytes of every chunk in order. an arena rebuilt by append()ing them resolves every
+  // ref of this one, which is how snapshots copy arenas. writer only
+  template <typename F>
+  void forEachChunk(F&& f) const
+  {
+    for (usize i = 0; i < chunks.size(); ++i)
+      f(std::string_view{chunks[i], i + 1 < chunks.size() ? filled[i] : offset});
+  }
+  // adds a chunk holding `bytes` (at most CHUNK), later allocations continue after them
+  void append(std::string_view bytes);
+
+  inline usize used() const noexcept { return usedBytes.load(std::memory_order_relaxed); }
+  inline usize wasted() const noexcept { return wastedBytes.load(std::memory_order_relaxed); }
+  inline usize capacity() const noexcept { return reserved.load(std::memory_order_relaxed); }
+
+ private:
+  Directory<char> chunks;
+  usize offset = 0;  // position in the last chunk
+  usize size = 0;    // size of the last chunk
+  // bytes written to each chunk before the last
+  std::vector<u32> filled;
+  // only written by the writer, atomic so stats can be read alongside
+  std::atomic<usize> reserved{0};
+  std::atomic<usize> usedBytes{0};
+  std::atomic<usize> wastedBytes{0};
+
+  static inline void add(std::atomic<usize>& counter, usize n) noexcept
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  template <typename T>
+  static constexpr usize header() noexcept
+  {
+    return alignof(T) > sizeof(u16) ? alignof(T) : sizeof(u16);
+  }
+};
+}  // namespace twilight::cache
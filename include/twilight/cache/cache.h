@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "discord.h"
+#include "entities.h"
+#include "epoch.h"
+#include "gateway/events.h"
+#include "gateway/payload.h"
+#include "guild.h"
+#include "interner.h"
+#include "snowflake_map.h"
+
+namespace twilight::cache
+{
+class Snapshot;
+
+// what the cache stores
+enum class CacheFlags : u8 {
+  None = 0,
+  Guilds = 1 << 0,
+  Channels = 1 << 1,
+  Roles = 1 << 2,
+  Members = 1 << 3,
+  Users = 1 << 4,
+  Presences = 1 << 5,
+  All = 0x3F,
+};
+
+// the data each intent subscribes to, so nothing is cached that wasn't asked for
+CacheFlags policy(Intent intents) noexcept;
+
+// guild, channel, role, member and user state built from dispatches.
+//
+// writes are owned per guild: ingest() may be called from every shard thread at once, as long as all events of a
+// given guild arrive on one thread (which is how shards split guilds anyway). only the shared tables (the guild
+// directory, user stripes and the interner) serialize their writers. reads never lock and never block ingestion:
+// they must hold an Epoch::Guard, get records by value, and the views they get (names, role lists, guild pointers)
+// stay valid until the guard is released
+class Cache
+{
+ public:
+  struct Stats {
+    usize guilds = 0;
+    usize channels = 0;
+    usize roles = 0;
+    usize members = 0;
+    usize users = 0;
+    usize interned = 0;
+    // bytes held, including arena space wasted by updates
+    usize bytes = 0;
+    usize wasted = 0;
+  };
+
+  // a copy of a user record with its strings resolved
+  struct UserEntry {
+    User user;
+    std::string_view username;
+    std::string_view globalName;
+  };
+
+  static constexpr usize USER_STRIPES = 16;
+
+  explicit Cache(Intent intents) : Cache(policy(intents)) {}
+  explicit Cache(CacheFlags flags);
+  // there must be no readers left
+  ~Cache();
+
+  Cache(const Cache&) = delete;
+  Cache& operator=(const Cache&) = delete;
+
+  // applies a dispatch, returns whether it was one the cache handles
+  bool ingest(const gateway::Payload& payload);
+
+  inline CacheFlags flags() const noexcept { return cacheFlags; }
+  // the dispatches ingest() reads with these flags, shards may drop the rest unparsed
+  gateway::EventSet events() const;
+
+  const Guild* guild(u64 id) const noexcept;
+  std::optional<UserEntry> user(u64 id) const noexcept;
+
+  // the avatar hash as discord sends it, empty without an avatar
+  static std::string avatar(const User& u);
+  inline std::string_view activity(const Member& m) const noexcept { return interner.get(m.activity); }
+
+  // restores whatever the snapshot still holds first
+  template <typename F>
+  void forEachGuild(F&& f) const
+  {
+    if (pendingGuilds.load(std::memory_order_acquire))
+      restoreAll();
+    guilds.forEach([&](u64 id, const Guild* g) {
+      if (g->id() == id)
+        f(*g);
+    });
+  }
+
+  // takes the interner's lock
+  Stats stats() const noexcept;
+
+  // users aren't reference counted so that dropping a guild stays cheap. this drops the users no cached guild has
+  // as a member anymore and compacts their strings, returns how many were dropped. a user added to a guild while
+  // the sweep runs may be dropped too, it comes back with the next event that carries it
+  usize sweepUsers();
+
+  // serves what `snapshot` holds until events replace it: its users right away, and each of its guilds once it's
+  // first looked up (or all of them, by whatever iterates guilds). a GUILD_CREATE drops the snapshot's copy unread.
+  // only an empty cache with the flags the snapshot was taken with can be restored, false otherwise
+  bool restore(std::shared_ptr<const Snapshot> snapshot);
+  // guilds of the snapshot not restored or replaced yet
+  inline usize pending() const noexcept { return pendingGuilds.load(std::memory_order_relaxed); }
+
+ private:
+  friend class Snapshot;
+
+  struct Users {
+    SeqLock seq;
+    Arena arena;
+    SnowflakeMap<u32> index;
+    Slab<User> records;
+  };
+
+  // what became of each guild of the snapshot
+  enum Restore : u8 { Pending, Restoring, Done };
+
+  CacheFlags cacheFlags;
+  // owned, retired through Epoch when replaced or deleted. guilds are restored from the snapshot by readers too
+  mutable SnowflakeMap<Guild*> guilds;
+  mutable std::mutex guildsMutex;
+
+  // kept for as long as the cache, guilds are copied out of it on demand
+  std::shared_ptr<const Snapshot> snapshot;
+  std::unique_ptr<std::atomic<u8>[]> restored;
+  mutable std::atomic<usize> pendingGuilds{0};
+
+  // users are shared between guilds, so they're split in stripes that are locked by writers to spread contention
+  std::array<std::atomic<Users*>, USER_STRIPES> users{};
+  std::array<std::mutex, USER_STRIPES> usersMutex;
+  Interner interner;
+
+  inline bool has(CacheFlags f) const noexcept { return !!(cacheFlags & f); }
+  // a different multiplier than SnowflakeMap's: with the same hash, a stripe's keys would all share their top bits
+  // and crowd into a sixteenth of the stripe's table
+  static usize stripe(u64 id) noexcept { return (id * 0xD6E8FEB86659FD93ull) >> 60; }
+
+  Guild* target(const gateway::Data& d);
+  // the directory's entry for `id`, restored from the snapshot if that's where it still is
+  Guild* find(u64 id) const noexcept;
+  Guild* restoreGuild(u64 id) const noexcept;
+  void restoreAll() const;
+  // the guild was sent in full, the snapshot's copy is never restored
+  void supersede(u64 id);
+
+  void guildCreate(const gateway::Data& d);
+  void guildDelete(const gateway::Data& d);
+  void guildUpdate(Guild& g, const gateway::Data& d);
+  // returns whether `key` was one of the guild's own fields
+  bool guildField(Guild& g, Guild::Info& info, std::string_view key, const gateway::Data& v);
+  void upsertRole(Guild& g, const gateway::Data& d);
+  void upsertChannel(Guild& g, const gateway::Data& d);
+  // `withUser` is false when the member's user was already written
+  void upsertMember(Guild& g, const gateway::Data& d, bool withUser = true);
+  // a list of members, as in GUILD_CREATE and GUILD_MEMBERS_CHUNK
+  void upsertMembers(Guild& g, const gateway::Data& members);
+  void updatePresence(Guild& g, const gateway::Data& d);
+  // returns the user's id
+  std::optional<u64> upsertUser(const gateway::Data& d);
+  // the stripe's lock must be held
+  void writeUser(Users& table, u64 id, const gateway::Data& d);
+};
+}  // namespace twilight::cache
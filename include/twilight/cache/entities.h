@@ -0,0 +1,162 @@
+#pragma once
+
+#include "arena.h"
+#include "utils/bitwise.h"
+#include "utils/types.h"
+
+// compact records kept by the cache. strings and variable-length lists live in the owning guild's arena (or the
+// cache's user arena) and are referred to by Ref, timestamps are unix seconds, and a member's roles are slots in the
+// guild's role table rather than snowflakes
+namespace twilight::cache
+{
+// https://discord.com/developers/docs/topics/permissions#permissions-bitwise-permission-flags
+enum class Permission : u64 {
+  None = 0,
+  CREATE_INSTANT_INVITE = u64(1) << 0,
+  KICK_MEMBERS = u64(1) << 1,
+  BAN_MEMBERS = u64(1) << 2,
+  ADMINISTRATOR = u64(1) << 3,
+  MANAGE_CHANNELS = u64(1) << 4,
+  MANAGE_GUILD = u64(1) << 5,
+  ADD_REACTIONS = u64(1) << 6,
+  VIEW_AUDIT_LOG = u64(1) << 7,
+  PRIORITY_SPEAKER = u64(1) << 8,
+  STREAM = u64(1) << 9,
+  VIEW_CHANNEL = u64(1) << 10,
+  SEND_MESSAGES = u64(1) << 11,
+  SEND_TTS_MESSAGES = u64(1) << 12,
+  MANAGE_MESSAGES = u64(1) << 13,
+  EMBED_LINKS = u64(1) << 14,
+  ATTACH_FILES = u64(1) << 15,
+  READ_MESSAGE_HISTORY = u64(1) << 16,
+  MENTION_EVERYONE = u64(1) << 17,
+  USE_EXTERNAL_EMOJIS = u64(1) << 18,
+  VIEW_GUILD_INSIGHTS = u64(1) << 19,
+  CONNECT = u64(1) << 20,
+  SPEAK = u64(1) << 21,
+  MUTE_MEMBERS = u64(1) << 22,
+  DEAFEN_MEMBERS = u64(1) << 23,
+  MOVE_MEMBERS = u64(1) << 24,
+  USE_VAD = u64(1) << 25,
+  CHANGE_NICKNAME = u64(1) << 26,
+  MANAGE_NICKNAMES = u64(1) << 27,
+  MANAGE_ROLES = u64(1) << 28,
+  MANAGE_WEBHOOKS = u64(1) << 29,
+  MANAGE_GUILD_EXPRESSIONS = u64(1) << 30,
+  USE_APPLICATION_COMMANDS = u64(1) << 31,
+  REQUEST_TO_SPEAK = u64(1) << 32,
+  MANAGE_EVENTS = u64(1) << 33,
+  MANAGE_THREADS = u64(1) << 34,
+  CREATE_PUBLIC_THREADS = u64(1) << 35,
+  CREATE_PRIVATE_THREADS = u64(1) << 36,
+  USE_EXTERNAL_STICKERS = u64(1) << 37,
+  SEND_MESSAGES_IN_THREADS = u64(1) << 38,
+  USE_EMBEDDED_ACTIVITIES = u64(1) << 39,
+  MODERATE_MEMBERS = u64(1) << 40,
+  VIEW_CREATOR_MONETIZATION_ANALYTICS = u64(1) << 41,
+  USE_SOUNDBOARD = u64(1) << 42,
+  CREATE_GUILD_EXPRESSIONS = u64(1) << 43,
+  CREATE_EVENTS = u64(1) << 44,
+  USE_EXTERNAL_SOUNDS = u64(1) << 45,
+  SEND_VOICE_MESSAGES = u64(1) << 46,
+  SEND_POLLS = u64(1) << 49,
+  USE_EXTERNAL_APPS = u64(1) << 50,
+  All = ~u64(0),
+};
+
+enum class Status : u8 {
+  Offline,
+  Online,
+  Idle,
+  DoNotDisturb,
+};
+
+enum class UserFlag : u8 {
+  None = 0,
+  Bot = 1 << 0,
+  System = 1 << 1,
+  HasAvatar = 1 << 2,
+  AnimatedAvatar = 1 << 3,
+};
+
+enum class MemberFlag : u8 {
+  None = 0,
+  Deaf = 1 << 0,
+  Mute = 1 << 1,
+  Pending = 1 << 2,
+};
+
+enum class RoleFlag : u8 {
+  None = 0,
+  Hoist = 1 << 0,
+  Managed = 1 << 1,
+  Mentionable = 1 << 2,
+  Deleted = 1 << 3,
+};
+
+enum class GuildFlag : u8 {
+  None = 0,
+  Unavailable = 1 << 0,
+  Large = 1 << 1,
+};
+
+struct User {
+  u64 id;
+  Ref username;
+  Ref globalName;
+  // avatar hashes are 32 hex digits, kept as the 16 bytes they encode
+  u8 avatar[16];
+  u32 publicFlags;
+  UserFlag flags;
+};
+
+// the per-member record is what the cache's footprint scales with, keep it at 32 bytes
+struct Member {
+  u64 user;
+  Ref nick;
+  // array of u16 role slots
+  Ref roles;
+  u32 joinedAt;
+  u32 timeoutUntil;
+  // interned name of the first activity, 0 without presences
+  Ref activity;
+  // https://discord.com/developers/docs/resources/guild#guild-member-object-guild-member-flags, fits in 16 bits
+  u16 guildFlags;
+  MemberFlag flags;
+  Status status;
+};
+static_assert(sizeof(Member) == 32);
+
+struct Role {
+  u64 id;
+  u64 permissions;
+  Ref name;
+  u32 color;
+  i16 position;
+  RoleFlag flags;
+};
+
+struct Overwrite {
+  enum class Type : u8 { Role, Member };
+
+  u64 id;
+  u64 allow;
+  u64 deny;
+  Type type;
+
+  bool operator==(const Overwrite&) const = default;
+};
+
+struct Channel {
+  u64 id;
+  u64 parentId;
+  Ref name;
+  Ref topic;
+  // array of Overwrite
+  Ref overwrites;
+  i16 position;
+  u8 type;
+  u8 nsfw;
+};
+static_assert(sizeof(Channel) == 32);
+}  // namespace twilight::cache
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <span>
+#include <vector>
+
+#include "utils/types.h"
+
+namespace twilight::cache
+{
+// epoch-based reclamation. readers pin the current epoch for as long as they hold pointers into shared structures,
+// writers retire what they unlink instead of freeing it, and retired memory is freed once every reader that could
+// still see it has unpinned. pinning is two atomic stores, no locks
+class Epoch
+{
+ public:
+  // pins the calling thread for its lifetime, guards nest
+  class Guard
+  {
+   public:
+    Guard() noexcept;
+    ~Guard();
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+  };
+
+  // frees `p` with `deleter` once no reader can still be holding it
+  static void retire(void* p, void (*deleter)(void*));
+  template <typename T>
+  static void retire(T* p)
+  {
+    retire(p, [](void* q) { delete static_cast<T*>(q); });
+  }
+
+  // frees whatever retired memory is no longer reachable, returns how many objects were freed
+  static usize reclaim();
+  // objects retired but not freed yet
+  static usize pending() noexcept;
+};
+
+// an append-only list of pointers that readers can index without locking while a single writer appends. the list
+// doesn't own what it points to
+template <typename T>
+class Directory
+{
+ public:
+  Directory() = default;
+  ~Directory() { delete list.load(std::memory_order_relaxed); }
+
+  Directory(const Directory&) = delete;
+  Directory& operator=(const Directory&) = delete;
+
+  inline T* operator[](usize i) const noexcept { return (*list.load(std::memory_order_acquire))[i]; }
+  inline usize size() const noexcept
+  {
+    auto l = list.load(std::memory_order_acquire);
+    return l ? l->size() : 0;
+  }
+
+  // copies the list, so appends are O(n). directories are short (chunks double in size) and grow rarely
+  void push(T* p)
+  {
+    auto old = list.load(std::memory_order_relaxed);
+    auto next = old ? new std::vector<T*>(*old) : new std::vector<T*>();
+    next->push_back(p);
+    list.store(next, std::memory_order_release);
+    if (old)
+      Epoch::retire(old);
+  }
+  // one copy for many appends
+  void push(std::span<T* const> ps)
+  {
+    auto old = list.load(std::memory_order_relaxed);
+    auto next = old ? new std::vector<T*>(*old) : new std::vector<T*>();
+    next->insert(next->end(), ps.begin(), ps.end());
+    list.store(next, std::memory_order_release);
+    if (old)
+      Epoch::retire(old);
+  }
+
+ private:
+  std::atomic<std::vector<T*>*> list{nullptr};
+};
+}  // namespace twilight::cache
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "arena.h"
+#include "entities.h"
+#include "seqlock.h"
+#include "slab.h"
+#include "snowflake_map.h"
+
+namespace twilight::cache
+{
+class Cache;
+class Snapshot;
+
+// everything cached for one guild. all of it lives in the guild's own arena, slabs and maps, so dropping a guild is
+// a handful of frees no matter how many members it had.
+//
+// a guild has a single writer (the shard its events come from) and lock-free readers. records are returned by
+// value, copied under the guild's seqlock; strings and spans point into the arena and stay valid for as long as the
+// reader holds an Epoch::Guard
+class Guild
+{
+ public:
+  // the guild's own fields, updated as one record
+  struct Info {
+    u64 owner;
+    Ref name;
+    // as reported by discord, not the number of cached members
+    u32 memberCount;
+    GuildFlag flags;
+  };
+
+  explicit Guild(u64 id) noexcept : guildId(id) {}
+
+  Guild(const Guild&) = delete;
+  Guild& operator=(const Guild&) = delete;
+
+  inline u64 id() const noexcept { return guildId; }
+  inline Info info() const noexcept { return seq.load(state); }
+  inline u64 ownerId() const noexcept { return info().owner; }
+  inline std::string_view name() const noexcept { return arena.string(info().name); }
+  inline u32 memberCount() const noexcept { return info().memberCount; }
+  inline GuildFlag flags() const noexcept { return info().flags; }
+  inline bool unavailable() const noexcept { return !!(flags() & GuildFlag::Unavailable); }
+
+  std::optional<Member> member(u64 user) const noexcept;
+  std::optional<Role> role(u64 id) const noexcept;
+  // deleted roles keep their slot, flagged RoleFlag::Deleted
+  inline Role roleAt(u16 slot) const noexcept { return seq.load(roles[slot]); }
+  std::optional<Channel> channel(u64 id) const noexcept;
+
+  inline std::string_view string(Ref ref) const noexcept { return arena.string(ref); }
+  inline std::span<const u16> roleSlots(const Member& m) const noexcept { return arena.array<u16>(m.roles); }
+  inline std::span<const Overwrite> overwrites(const Channel& c) const noexcept
+  {
+    return arena.array<Overwrite>(c.overwrites);
+  }
+
+  // guild-wide permissions of a member
+  Permission permissions(const Member& m) const noexcept;
+  // permissions of a member in a channel, with overwrites applied
+  Permission permissions(const Member& m, const Channel& c) const noexcept;
+
+  template <typename F>
+  void forEachMember(F&& f) const
+  {
+    memberIndex.forEach([&](u64 id, u32 slot) {
+      if (Member m = seq.load(members[slot]); m.user == id)
+        f(m);
+    });
+  }
+  template <typename F>
+  void forEachRole(F&& f) const
+  {
+    roleIndex.forEach([&](u64 id, u16 slot) {
+      if (Role r = seq.load(roles[slot]); r.id == id)
+        f(r);
+    });
+  }
+  template <typename F>
+  void forEachChannel(F&& f) const
+  {
+    channelIndex.forEach([&](u64 id, u32 slot) {
+      if (Channel c = seq.load(channels[slot]); c.id == id)
+        f(c);
+    });
+  }
+
+  inline usize cachedMembers() const noexcept { return members.size(); }
+  inline usize cachedRoles() const noexcept { return roles.size(); }
+  inline usize cachedChannels() const noexcept { return channels.size(); }
+  usize memoryUsage() const noexcept;
+  // bytes of the arena taken by replaced strings and lists
+  inline usize wasted() const noexcept { return arena.wasted(); }
+
+ private:
+  friend class Cache;
+  friend class Snapshot;
+
+  u64 guildId;
+  // one lock for every record of the guild: writes are short and a reader only retries if one overlapped its copy
+  SeqLock seq;
+  Info state{};
+
+  Arena arena;
+  SnowflakeMap<u32> memberIndex;
+  Slab<Member> members;
+  // role slots are never reused, members refer to roles by slot
+  SnowflakeMap<u16> roleIndex;
+  Slab<Role, false> roles;
+  SnowflakeMap<u32> channelIndex;
+  Slab<Channel> channels;
+
+  // writer side. records are read directly (nothing else writes them), modified on a copy and published whole,
+  // so readers never see a half-filled record
+
+  // publishes `value` at `slot`, or at a new slot indexed under `id`
+  template <typename T, bool Reuse, typename S>
+  void put(Slab<T, Reuse>& slab, SnowflakeMap<S>& index, std::optional<S> slot, u64 id, const T& value)
+  {
+    if (slot) {
+      seq.store(slab[*slot], value);
+      return;
+    }
+    S s = slab.add();
+    seq.store(slab[s], value);
+    index.insertOrAssign(id, s);
+  }
+
+  bool removeMember(u64 user);
+  bool removeRole(u64 id);
+  bool removeChannel(u64 id);
+};
+}  // namespace twilight::cache
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include "arena.h"
+
+namespace twilight::cache
+{
+// deduplicates strings that repeat across many entities (activity names, mostly), each distinct string is stored
+// once and referred to by its Ref. entries are never removed. interning from several threads is serialized, looking
+// a ref up is lock-free
+class Interner
+{
+ public:
+  Ref intern(std::string_view s);
+  inline std::string_view get(Ref ref) const noexcept { return arena.string(ref); }
+
+  usize size() const noexcept;
+  usize memoryUsage() const noexcept;
+
+ private:
+  friend class Snapshot;
+
+  mutable std::mutex mutex;
+  Arena arena;
+  // keys point into the arena, which never moves its contents
+  std::unordered_map<std::string_view, Ref> refs;
+};
+}  // namespace twilight::cache
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+#include "utils/types.h"
+
+namespace twilight::cache
+{
+// sequence lock over records owned by a single writer. readers never block the writer: they copy the record and
+// retry if a write overlapped the copy. records are copied word by word with relaxed atomics, so they must be
+// trivially copyable and a whole number of 8-byte words
+class SeqLock
+{
+ public:
+  template <typename T>
+  void store(T& dst, const T& value) noexcept
+  {
+    u32 s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    u64 words[WORDS<T>];
+    std::memcpy(words, &value, sizeof(T));
+    u64* out = reinterpret_cast<u64*>(&dst);
+    for (usize i = 0; i < WORDS<T>; ++i) std::atomic_ref<u64>(out[i]).store(words[i], std::memory_order_relaxed);
+
+    seq.store(s + 2, std::memory_order_release);
+  }
+
+  template <typename T>
+  T load(const T& src) const noexcept
+  {
+    u64 words[WORDS<T>];
+    u64* in = reinterpret_cast<u64*>(const_cast<T*>(&src));
+    for (;;) {
+      u32 before = seq.load(std::memory_order_acquire);
+      if (before & 1) {
+        // the writer may have been preempted mid-write
+        std::this_thread::yield();
+        continue;
+      }
+      for (usize i = 0; i < WORDS<T>; ++i) words[i] = std::atomic_ref<u64>(in[i]).load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq.load(std::memory_order_relaxed) == before)
+        break;
+    }
+
+    T out;
+    std::memcpy(&out, words, sizeof(T));
+    return out;
+  }
+
+  // number of writes so far
+  inline u32 version() const noexcept { return seq.load(std::memory_order_acquire) / 2; }
+
+ private:
+  std::atomic<u32> seq{0};
+
+  template <typename T>
+  static constexpr usize WORDS = [] {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(sizeof(T) % sizeof(u64) == 0 && alignof(T) >= alignof(u64));
+    return sizeof(T) / sizeof(u64);
+  }();
+};
+}  // namespace twilight::cache
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "epoch.h"
+#include "utils/types.h"
+
+namespace twilight::cache
+{
+// chunked storage for fixed-size records addressed by a 32-bit slot. records never move once added, so pointers
+// handed out stay valid until the slab is destroyed. chunks start small and double up to CHUNK records, most guilds
+// are tiny and shouldn't pay for a full chunk.
+//
+// slots are handed out by a single writer, who also writes the records (through a SeqLock); readers may index any
+// slot they got from a map concurrently
+template <typename T, bool Reuse = true>
+class Slab
+{
+  static_assert(std::is_trivially_copyable_v<T>);
+
+ public:
+  static constexpr usize CHUNK_BITS = 10;
+  static constexpr usize CHUNK = usize(1) << CHUNK_BITS;
+  static constexpr usize FIRST_BITS = 4;
+  // chunks before the first full-size one: FIRST, FIRST, 2 * FIRST, ..., CHUNK / 2
+  static constexpr usize SMALL = CHUNK_BITS - FIRST_BITS + 1;
+
+  Slab() = default;
+  ~Slab()
+  {
+    for (usize i = 0; i < chunks.size(); ++i) delete[] chunks[i];
+  }
+
+  Slab(const Slab&) = delete;
+  Slab& operator=(const Slab&) = delete;
+
+  // the record behind the returned slot is uninitialized, or stale if the slot is reused
+  u32 add()
+  {
+    u32 slot;
+    if (Reuse && !freed.empty()) {
+      slot = freed.back();
+      freed.pop_back();
+    } else {
+      if (next == capacity) {
+        usize n = chunkSize(chunks.size());
+        chunks.push(new T[n]);
+        capacity += n;
+      }
+      slot = next++;
+    }
+    live.store(live.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return slot;
+  }
+
+  // makes room for `n` more records, so a batch of adds allocates once
+  void reserve(usize n)
+  {
+    usize free = capacity - next + (Reuse ? freed.size() : 0);
+    if (free >= n)
+      return;
+    std::vector<T*> added;
+    for (usize i = chunks.size(); free < n; ++i) {
+      usize size = chunkSize(i);
+      added.push_back(new T[size]);
+      capacity += size;
+      free += size;
+    }
+    chunks.push(std::span<T* const>{added});
+  }
+
+  // without slot reuse the slot stays reserved forever, so stale indices never alias a newer record
+  void remove(u32 slot)
+  {
+    if constexpr (Reuse)
+      freed.push_back(slot);
+    live.store(live.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+  }
+
+  inline T& operator[](u32 slot) noexcept
+  {
+    auto [chunk, offset] = locate(slot);
+    return chunks[chunk][offset];
+  }
+  inline const T& operator[](u32 slot) const noexcept
+  {
+    auto [chunk, offset] = locate(slot);
+    return chunks[chunk][offset];
+  }
+
+  inline usize size() const noexcept { return live.load(std::memory_order_relaxed); }
+  // slots handed out so far, including removed ones. writer only
+  inline usize slots() const noexcept { return next; }
+  inline usize memoryUsage() const noexcept
+  {
+    usize n = 0;
+    for (usize i = 0; i < chunks.size(); ++i) n += chunkSize(i);
+    return n * sizeof(T);
+  }
+
+ private:
+  Directory<T> chunks;
+  std::vector<u32> freed;
+  u32 next = 0;
+  usize capacity = 0;
+  std::atomic<usize> live{0};
+
+  static constexpr usize chunkSize(usize chunk) noexcept
+  {
+    if (chunk >= SMALL)
+      return CHUNK;
+    return usize(1) << (FIRST_BITS + (chunk ? chunk - 1 : 0));
+  }
+  static constexpr std::pair<usize, usize> locate(u32 slot) noexcept
+  {
+    if (slot >= CHUNK)
+      return {SMALL - 1 + (slot >> CHUNK_BITS), slot & (CHUNK - 1)};
+    usize chunk = std::bit_width(slot >> FIRST_BITS);
+    return {chunk, chunk ? slot - (usize(1) << (FIRST_BITS + chunk - 1)) : slot};
+  }
+};
+}  // namespace twilight::cache
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <expected>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cache.h"
+#include "gateway/shard.h"
+
+namespace twilight::cache
+{
+// a snapshot is what a restarting bot needs to pick up where it stopped: each shard's gateway session, so it can
+// RESUME instead of identifying and being sent every guild again, and the cache, so it has something to serve until
+// then. layout, little endian, every section padded to 8 bytes:
+//
+//   header    SnapshotHeader
+//   sessions  per shard u32 shard, u32 count, u64 seq, u32 id length, u32 url length, id, url
+//   interner  u32 entries, u32 0, arena, Ref[entries]
+//   users     per stripe u32 records, u32 0, arena, User[records]
+//   guilds    per guild SnapshotGuild, arena, Role[roles], Member[members], Channel[channels]
+//   table     SnapshotEntry[guilds], sorted by id
+//
+// where an arena is u32 chunks, u32 0, u32 length[chunks], then every chunk's bytes. arenas are compacted when
+// written and copied back chunk by chunk, so the refs in records are stored as they are and restoring a guild is a
+// few memcpys. records are raw structs, the header's layout must match the build reading them
+struct SnapshotHeader {
+  char magic[8];
+  u32 version;
+  u32 layout;
+  // unix ns
+  u64 created;
+  u64 size;
+  CacheFlags flags;
+  u8 reserved0;
+  u16 reserved1;
+  u32 sessions;
+  u64 guilds;
+  // section offsets
+  u64 interner;
+  u64 users;
+  u64 sections;
+  u64 table;
+  // crc32 of every section but the guilds' (which have their own), then of the header with this field zeroed
+  u32 crc;
+  u32 reserved2;
+};
+
+struct SnapshotGuild {
+  u64 id;
+  Guild::Info info;
+  u32 roles;
+  u32 members;
+  u32 channels;
+  u32 reserved;
+};
+
+struct SnapshotEntry {
+  u64 id;
+  u64 offset;
+  u64 size;
+  u32 crc;
+  u32 reserved;
+};
+
+// a shard's session, resumable by the same shard of the same shard count
+struct ShardSession {
+  u32 shard;
+  u32 count;
+  gateway::Session session;
+};
+
+// a snapshot file mapped read-only. the sessions, users and interned strings are read when it's opened or
+// restored, guilds only once the cache restoring it asks for them (see Cache::restore)
+class Snapshot
+{
+ public:
+  static constexpr u32 FORMAT = 1;
+
+  // writes `cache` and `sessions` to `path`, through a temporary file renamed over it so a crash never leaves half a
+  // snapshot behind. guilds `cache` hasn't restored from its own snapshot yet are copied over as they are. nothing
+  // may be ingested meanwhile: shards are closed first, and their sessions taken after. throws on I/O errors
+  static void write(const std::string& path, const Cache& cache, std::span<const ShardSession> sessions);
+  // maps `path` and checks everything but the guilds, which are checked as they're restored
+  static std::expected<std::shared_ptr<const Snapshot>, std::string> open(const std::string& path) noexcept;
+  ~Snapshot();
+
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+
+  inline CacheFlags flags() const noexcept { return head.flags; }
+  inline std::chrono::system_clock::time_point created() const noexcept
+  {
+    return std::chrono::system_clock::time_point{std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      std::chrono::nanoseconds{head.created})};
+  }
+  inline usize guilds() const noexcept { return head.guilds; }
+  inline std::span<const ShardSession> sessions() const noexcept { return shardSessions; }
+  // the session to set on shard `shard` of `count` before connecting, if there's one. discord forgets sessions a few
+  // minutes after their connection closed, a stale one costs a failed RESUME and falls back to identifying
+  std::optional<gateway::Session> session(u32 shard, u32 count) const;
+
+ private:
+  friend class Cache;
+
+  // a serialized arena, and the records stored after it
+  struct Image {
+    std::vector<std::string_view> chunks;
+    const char* records = nullptr;
+    u32 count = 0;
+  };
+
+  const char* data;
+  usize length;
+  SnapshotHeader head;
+  std::vector<ShardSession> shardSessions;
+  Image internerImage;
+  std::array<Image, Cache::USER_STRIPES> userImages;
+
+  Snapshot(const char* data, usize length, const SnapshotHeader& head) noexcept
+    : data(data), length(length), head(head)
+  {
+  }
+
+  SnapshotEntry entry(usize i) const noexcept;
+  inline u64 id(usize i) const noexcept { return entry(i).id; }
+  // index of the guild in the table
+  std::optional<usize> find(u64 id) const noexcept;
+  // a fresh copy of guild `i`, null if its section is damaged
+  std::unique_ptr<Guild> guild(usize i) const;
+  // fills empty tables
+  void restore(Interner& interner) const;
+  void restore(usize stripe, Cache::Users& users) const;
+};
+}  // namespace twilight::cache
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
+#include "epoch.h"
+#include "utils/types.h"
+
+namespace twilight::cache
+{
+// open-addressing hash map keyed by snowflake. keys and values live in separate arrays so probing only touches
+// keys, and 0 / ~0 (which are never valid snowflakes) mark empty and erased slots, so there is no per-slot metadata.
+//
+// one writer, any number of lock-free readers: slots are published with release stores and a grown table replaces
+// the old one atomically, the old one being retired through Epoch. readers must hold an Epoch::Guard and may see a
+// value for a key that was erased and reused concurrently, so they have to check the record they get back
+template <typename V>
+class SnowflakeMap
+{
+  static_assert(std::is_trivially_copyable_v<V> && sizeof(V) <= sizeof(u64));
+
+ public:
+  static constexpr u64 EMPTY = 0;
+  static constexpr u64 TOMBSTONE = ~u64(0);
+
+  SnowflakeMap() = default;
+  ~SnowflakeMap() { delete table.load(std::memory_order_relaxed); }
+
+  SnowflakeMap(const SnowflakeMap&) = delete;
+  SnowflakeMap& operator=(const SnowflakeMap&) = delete;
+
+  std::optional<V> find(u64 key) const noexcept
+  {
+    const Table* t = table.load(std::memory_order_acquire);
+    if (!t)
+      return std::nullopt;
+    for (usize i = t->slot(key);; i = (i + 1) & t->mask) {
+      u64 k = t->keys[i].load(std::memory_order_acquire);
+      if (k == key)
+        return t->load(i);
+      if (k == EMPTY)
+        return std::nullopt;
+    }
+  }
+
+  // inserts or replaces, returns the previous value
+  std::optional<V> insertOrAssign(u64 key, V value)
+  {
+    Table* t = table.load(std::memory_order_relaxed);
+    if (t) {
+      for (usize i = t->slot(key);; i = (i + 1) & t->mask) {
+        u64 k = t->keys[i].load(std::memory_order_relaxed);
+        if (k == key) {
+          V old = t->load(i);
+          t->store(i, value);
+          return old;
+        }
+        if (k == EMPTY)
+          break;
+      }
+    }
+    insert(key, value);
+    return std::nullopt;
+  }
+
+  bool erase(u64 key) noexcept
+  {
+    Table* t = table.load(std::memory_order_relaxed);
+    if (!t)
+      return false;
+    for (usize i = t->slot(key);; i = (i + 1) & t->mask) {
+      u64 k = t->keys[i].load(std::memory_order_relaxed);
+      if (k == key) {
+        t->keys[i].store(TOMBSTONE, std::memory_order_release);
+        count.store(count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        ++tombstones;
+        return true;
+      }
+      if (k == EMPTY)
+        return false;
+    }
+  }
+
+  // makes room for `n` entries without rehashing
+  void reserve(usize n)
+  {
+    usize want = std::bit_ceil((n * 4 + 2) / 3 + 1);
+    if (want > capacity())
+      rehash(want);
+  }
+
+  template <typename F>
+  void forEach(F&& f) const
+  {
+    const Table* t = table.load(std::memory_order_acquire);
+    for (usize i = 0; t && i <= t->mask; ++i) {
+      u64 k = t->keys[i].load(std::memory_order_acquire);
+      if (k != EMPTY && k != TOMBSTONE)
+        f(k, t->load(i));
+    }
+  }
+
+  inline usize size() const noexcept { return count.load(std::memory_order_relaxed); }
+  inline bool empty() const noexcept { return !size(); }
+  inline usize memoryUsage() const noexcept { return capacity() * (sizeof(u64) + sizeof(V)); }
+
+ private:
+  struct Table {
+    usize mask;
+    usize shift;
+    std::unique_ptr<std::atomic<u64>[]> keys;
+    std::unique_ptr<V[]> values;
+
+    explicit Table(usize capacity)
+      : mask(capacity - 1),
+        shift(64 - std::countr_zero(capacity)),
+        keys(std::make_unique<std::atomic<u64>[]>(capacity)),
+        values(std::make_unique_for_overwrite<V[]>(capacity))
+    {
+    }
+
+    // fibonacci hashing: the high bits of a snowflake are a timestamp and the low ones a counter, multiplying
+    // spreads both over the top bits, which are the ones we keep
+    inline usize slot(u64 key) const noexcept { return (key * 0x9E3779B97F4A7C15ull) >> shift; }
+
+    inline V load(usize i) const noexcept
+    {
+      return std::atomic_ref<V>(const_cast<V&>(values[i])).load(std::memory_order_acquire);
+    }
+    inline void store(usize i, V v) noexcept { std::atomic_ref<V>(values[i]).store(v, std::memory_order_release); }
+  };
+
+  std::atomic<Table*> table{nullptr};
+  std::atomic<usize> count{0};
+  usize tombstones = 0;
+
+  inline usize capacity() const noexcept
+  {
+    const Table* t = table.load(std::memory_order_acquire);
+    return t ? t->mask + 1 : 0;
+  }
+
+  void insert(u64 key, V value)
+  {
+    usize n = size();
+    usize cap = capacity();
+    if ((n + tombstones + 1) * 4 > cap * 3)
+      rehash(n + 1 > cap / 2 ? cap * 2 : cap);
+
+    Table* t = table.load(std::memory_order_relaxed);
+    usize i = t->slot(key);
+    for (;; i = (i + 1) & t->mask) {
+      u64 k = t->keys[i].load(std::memory_order_relaxed);
+      if (k == EMPTY)
+        break;
+      if (k == TOMBSTONE) {
+        --tombstones;
+        break;
+      }
+    }
+
+    // the value has to be in place before readers can find the key
+    t->store(i, value);
+    t->keys[i].store(key, std::memory_order_release);
+    count.store(n + 1, std::memory_order_relaxed);
+  }
+
+  void rehash(usize capacity)
+  {
+    Table* old = table.load(std::memory_order_relaxed);
+    auto t = new Table(std::max<usize>(capacity, 8));
+
+    for (usize j = 0; old && j <= old->mask; ++j) {
+      u64 k = old->keys[j].load(std::memory_order_relaxed);
+      if (k == EMPTY || k == TOMBSTONE)
+        continue;
+      usize i = t->slot(k);
+      while (t->keys[i].load(std::memory_order_relaxed) != EMPTY) i = (i + 1) & t->mask;
+      t->keys[i].store(k, std::memory_order_relaxed);
+      t->values[i] = old->values[j];
+    }
+
+    tombstones = 0;
+    table.store(t, std::memory_order_release);
+    if (old)
+      Epoch::retire(old);
+  }
+};
+}  // namespace twilight::cache
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "utils/types.h"
+
+typedef struct evp_pkey_st EVP_PKEY;
+
+namespace twilight::crypto
+{
+using PublicKey = std::array<u8, 32>;
+using Signature = std::array<u8, 64>;
+
+// lowercase hex of `data`
+std::string hex(std::string_view data) noexcept;
+// decodes exactly `out.size()` bytes, case insensitive
+template <usize N>
+bool fromHex(std::string_view in, std::array<u8, N>& out) noexcept
+{
+  constexpr auto nibble = [](char c) -> int {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    c |= 0x20;
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+  };
+  if (in.size() != N * 2)
+    return false;
+  for (usize i = 0; i < N; ++i) {
+    int hi = nibble(in[i * 2]), lo = nibble(in[i * 2 + 1]);
+    if (hi < 0 || lo < 0)
+      return false;
+    out[i] = static_cast<u8>(hi << 4 | lo);
+  }
+  return true;
+}
+
+// checks ed25519 signatures against one public key. the key is loaded once, verify() is safe to call from any number
+// of threads at once
+class Verifier
+{
+ public:
+  // throws if the key isn't a valid ed25519 public key
+  explicit Verifier(const PublicKey& key);
+  // `key` as hex, the form discord shows it in
+  explicit Verifier(std::string_view key);
+  ~Verifier();
+
+  Verifier(const Verifier&) = delete;
+  Verifier& operator=(const Verifier&) = delete;
+
+  // whether `signature` signs `prefix` followed by `message`, e.g. discord's timestamp and body. ed25519 takes the
+  // message whole, so the two are joined in a per-thread buffer first
+  bool verify(const Signature& signature, std::string_view prefix, std::string_view message) const noexcept;
+  // `signature` as hex
+  bool verify(std::string_view signature, std::string_view prefix, std::string_view message) const noexcept;
+
+ private:
+  EVP_PKEY* key = nullptr;
+};
+
+// a private key, for signing requests to a local endpoint under test
+class KeyPair
+{
+ public:
+  // a fresh random key, throws if openssl can't make one
+  static KeyPair generate();
+  ~KeyPair();
+
+  KeyPair(KeyPair&& other) noexcept;
+  KeyPair& operator=(KeyPair&& other) = delete;
+  KeyPair(const KeyPair&) = delete;
+
+  PublicKey publicKey() const noexcept;
+  Signature sign(std::string_view prefix, std::string_view message) const;
+
+ private:
+  EVP_PKEY* key = nullptr;
+
+  explicit KeyPair(EVP_PKEY* key) noexcept : key(key) {}
+};
+}  // namespace twilight::crypto
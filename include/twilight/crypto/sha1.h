@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+
+#include "utils/types.h"
+
+namespace twilight::crypto
+{
+// incremental sha-1. input is hashed straight from the caller's buffer, only a trailing partial block is copied.
+// blocks go through sha-ni when the cpu has it (checked once at runtime), through a portable implementation otherwise
+class Sha1
+{
+ public:
+  using Digest = std::array<u8, 20>;
+  static constexpr usize BLOCK = 64;
+
+  inline void update(std::string_view data) noexcept { update(reinterpret_cast<const u8*>(data.data()), data.size()); }
+  void update(const u8* data, usize size) noexcept;
+  // the digest of everything so far, the hasher starts over afterwards
+  Digest final() noexcept;
+
+  static Digest hash(std::string_view data) noexcept;
+  // the block function in use, "sha-ni" or "scalar"
+  static std::string_view backend() noexcept;
+
+ private:
+  std::array<u32, 5> state = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  std::array<u8, BLOCK> buffer;
+  usize buffered = 0;
+  u64 length = 0;
+};
+
+inline Sha1::Digest sha1(std::string_view data) noexcept { return Sha1::hash(data); }
+}  // namespace twilight::crypto
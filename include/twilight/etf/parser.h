@@ -0,0 +1,148 @@
+#pragma once
+
+#include <expected>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "json/parser.h"
+#include "utils/types.h"
+
+namespace twilight::etf
+{
+// https://www.erlang.org/doc/apps/erts/erl_ext_dist.html
+constexpr u8 FORMAT_VERSION = 131;
+
+enum class Tag : u8 {
+  NewFloat = 70,
+  SmallInteger = 97,
+  Integer = 98,
+  Float = 99,
+  Atom = 100,
+  SmallTuple = 104,
+  LargeTuple = 105,
+  Nil = 106,
+  String = 107,
+  List = 108,
+  Binary = 109,
+  SmallBig = 110,
+  LargeBig = 111,
+  SmallAtom = 115,
+  Map = 116,
+  AtomUtf8 = 118,
+  SmallAtomUtf8 = 119,
+};
+
+// discord's ETF payloads map onto the JSON data model: atoms nil/true/false are null and booleans, other atoms and
+// binaries are strings, lists and tuples are arrays and maps are objects
+using Type = json::Type;
+
+// a lazy cursor into an encoded term, mirroring json::Value. terms are length-prefixed, so nothing needs to be
+// indexed up front and every accessor is bounds-checked against the end of the buffer instead
+class Value
+{
+ public:
+  class ArrayIterator;
+  class ObjectIterator;
+
+  template <typename It>
+  struct Range {
+    It first, last;
+    It begin() const noexcept { return first; }
+    It end() const noexcept { return last; }
+  };
+
+  Value() = default;
+
+  Type type() const noexcept;
+  inline bool valid() const noexcept { return p; }
+  inline bool isNull() const noexcept { return type() == Type::Null; }
+
+  // map lookup, keys can be atoms or binaries
+  std::optional<Value> find(std::string_view key) const noexcept;
+  std::optional<Value> at(usize index) const noexcept;
+  // O(1), read from the container header
+  usize size() const noexcept;
+
+  std::optional<bool> asBool() const noexcept;
+  std::optional<i64> asInt() const noexcept;
+  std::optional<u64> asUint() const noexcept;
+  std::optional<f64> asDouble() const noexcept;
+  // snowflakes are sent as (big) integers, but accept decimal strings like the JSON path does
+  std::optional<u64> asSnowflake() const noexcept;
+  std::optional<std::string_view> asStringView() const noexcept;
+  std::optional<std::string> asString() const noexcept;
+
+  // encoded bytes of this term, without the version byte
+  std::string_view raw() const noexcept;
+
+  Range<ArrayIterator> items() const noexcept;
+  Range<ObjectIterator> fields() const noexcept;
+
+ private:
+  friend std::expected<Value, std::string> parse(std::string_view data) noexcept;
+
+  const u8* p = nullptr;
+  const u8* end = nullptr;
+
+  Value(const u8* p, const u8* end) noexcept : p(p), end(end) {}
+
+  std::optional<std::string_view> atom() const noexcept;
+  // magnitude and sign of any integer term
+  std::optional<std::pair<u64, bool>> integer() const noexcept;
+};
+
+class Value::ArrayIterator
+{
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Value;
+  using difference_type = std::ptrdiff_t;
+
+  ArrayIterator() = default;
+
+  Value operator*() const noexcept { return Value{p, end}; }
+  ArrayIterator& operator++() noexcept;
+  ArrayIterator operator++(int) noexcept;
+  bool operator==(const ArrayIterator& other) const noexcept { return remaining == other.remaining; }
+
+ private:
+  friend class Value;
+
+  const u8* p = nullptr;
+  const u8* end = nullptr;
+  usize remaining = 0;
+
+  ArrayIterator(const u8* p, const u8* end, usize remaining) noexcept : p(p), end(end), remaining(remaining) {}
+};
+
+class Value::ObjectIterator
+{
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::pair<std::string_view, Value>;
+  using difference_type = std::ptrdiff_t;
+
+  ObjectIterator() = default;
+
+  // keys that aren't atoms or binaries come out empty
+  value_type operator*() const noexcept;
+  ObjectIterator& operator++() noexcept;
+  ObjectIterator operator++(int) noexcept;
+  bool operator==(const ObjectIterator& other) const noexcept { return remaining == other.remaining; }
+
+ private:
+  friend class Value;
+
+  const u8* p = nullptr;  // points at the key
+  const u8* end = nullptr;
+  usize remaining = 0;
+
+  ObjectIterator(const u8* p, const u8* end, usize remaining) noexcept : p(p), end(end), remaining(remaining) {}
+};
+
+// `data` is not copied and must outlive the returned value
+std::expected<Value, std::string> parse(std::string_view data) noexcept;
+}  // namespace twilight::etf
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <concepts>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/types.h"
+
+namespace twilight::etf
+{
+// streaming encoder with the same interface as json::Writer. container sizes are written as placeholders and
+// patched when the container is closed
+class Writer
+{
+ public:
+  Writer() noexcept;
+
+  Writer& beginObject() noexcept;
+  Writer& endObject() noexcept;
+  Writer& beginArray() noexcept;
+  Writer& endArray() noexcept;
+  // keys are encoded as binaries
+  Writer& key(std::string_view key) noexcept;
+
+  Writer& value(std::nullptr_t) noexcept;
+  Writer& value(bool v) noexcept;
+  Writer& value(f64 v) noexcept;
+  Writer& value(std::string_view v) noexcept;
+  inline Writer& value(const char* v) noexcept { return value(std::string_view{v}); }
+  inline Writer& value(const std::string& v) noexcept { return value(std::string_view{v}); }
+
+  template <std::integral T>
+    requires(!std::same_as<T, bool>)
+  inline Writer& value(T v) noexcept
+  {
+    if constexpr (std::is_signed_v<T>)
+      return integer(v < 0 ? -static_cast<u64>(v) : static_cast<u64>(v), v < 0);
+    else
+      return integer(static_cast<u64>(v), false);
+  }
+
+  inline Writer& snowflake(u64 id) noexcept { return integer(id, false); }
+
+  inline const std::string& str() const noexcept { return out; }
+  inline std::string take() noexcept { return std::move(out); }
+  void clear() noexcept;
+
+ private:
+  struct Container {
+    usize offset;  // position of the tag
+    u32 count;
+  };
+
+  std::string out;
+  std::vector<Container> open;
+
+  void element() noexcept;
+  void atom(std::string_view name) noexcept;
+  void be32(u32 v) noexcept;
+  Writer& integer(u64 magnitude, bool negative) noexcept;
+};
+}  // namespace twilight::etf
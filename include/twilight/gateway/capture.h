@@ -0,0 +1,159 @@
+#pragma once
+
+#include <chrono>
+#include <cstring>
+#include <expected>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "payload.h"
+#include "utils/histogram.h"
+#include "ws/frame.h"
+
+namespace twilight::gateway
+{
+class Shard;
+enum class Compression : u8;
+
+// capture files hold gateway traffic exactly as it was received, so it can be replayed offline through the same
+// decode path. layout, little endian:
+//
+//   header  "TWLTCAP1", u8 encoding, u8 compression, u16 0, u32 0, u64 start (unix ns), u64 size of the records
+//   record  u64 time (ns since start), u32 length, u8 ws opcode, u8 flags, u16 0, payload padded to 8 bytes
+//
+// the header's size is only bumped once a record is complete, so a capture cut short by a crash stays readable
+struct CaptureHeader {
+  char magic[8];
+  Encoding encoding;
+  Compression compression;
+  u16 reserved0;
+  u32 reserved1;
+  u64 start;
+  u64 size;
+};
+
+struct CaptureRecord {
+  enum Flag : u8 {
+    // first message of a connection, compression state starts over
+    StreamStart = 1 << 0,
+  };
+
+  u64 time;
+  u32 length;
+  ws::Opcode opcode;
+  u8 flags;
+  u16 reserved;
+};
+
+// appends received messages to a memory-mapped capture file. one recorder can be shared by several shards only if
+// they use no compression, a zlib stream can't be split back apart
+class Recorder
+{
+ public:
+  // truncates `path`, throws if it can't be created
+  Recorder(const std::string& path, Encoding encoding, Compression compression);
+  ~Recorder();
+
+  Recorder(const Recorder&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+
+  void record(const ws::Frame& frame) noexcept;
+  // the next message starts a new connection
+  void restart() noexcept;
+
+  // bytes of records written
+  usize size() const noexcept;
+
+ private:
+  int fd = -1;
+  char* map = nullptr;
+  usize capacity = 0;
+  std::chrono::steady_clock::time_point start;
+  bool streamStart = true;
+  mutable std::mutex mutex;
+
+  CaptureHeader* header() const noexcept { return reinterpret_cast<CaptureHeader*>(map); }
+  bool grow(usize needed) noexcept;
+};
+
+// a capture file mapped read-only
+class Capture
+{
+ public:
+  struct Message {
+    std::chrono::nanoseconds time;
+    ws::Opcode opcode;
+    bool streamStart;
+    std::string_view payload;
+  };
+
+  static std::expected<Capture, std::string> open(const std::string& path) noexcept;
+  ~Capture();
+
+  Capture(Capture&& other) noexcept;
+  Capture& operator=(Capture&& other) = delete;
+
+  inline Encoding encoding() const noexcept { return head.encoding; }
+  inline Compression compression() const noexcept { return head.compression; }
+  inline usize size() const noexcept { return head.size; }
+
+  // calls `f` with every complete message in order, stops early if it returns false
+  template <typename F>
+  void forEach(F&& f) const
+  {
+    usize pos = sizeof(CaptureHeader);
+    usize end = pos + head.size;
+    while (end - pos >= sizeof(CaptureRecord)) {
+      CaptureRecord rec;
+      std::memcpy(&rec, data + pos, sizeof(rec));
+      pos += sizeof(rec);
+      // records are written padded, one that isn't whole was cut short
+      usize padded = (usize{rec.length} + 7) & ~usize{7};
+      if (end - pos < padded)
+        break;
+      Message m{std::chrono::nanoseconds{rec.time}, rec.opcode, !!(rec.flags & CaptureRecord::StreamStart),
+        {data + pos, rec.length}};
+      pos += padded;
+      if (!f(m))
+        break;
+    }
+  }
+
+ private:
+  const char* data = nullptr;
+  usize length = 0;
+  CaptureHeader head{};
+
+  Capture(const char* data, usize length, const CaptureHeader& head) noexcept
+    : data(data), length(length), head(head)
+  {
+  }
+};
+
+struct ReplayOptions {
+  // replay at the recorded pace instead of as fast as possible
+  bool paced = false;
+  // pace multiplier when paced
+  f64 speed = 1;
+  usize loops = 1;
+};
+
+struct ReplayStats {
+  usize messages = 0;
+  usize bytes = 0;
+  usize errors = 0;
+  std::chrono::nanoseconds elapsed{};
+  // decode and handle time per message, in ns
+  Histogram latency;
+
+  inline f64 messagesPerSecond() const noexcept
+  {
+    return elapsed.count() ? messages * 1e9 / static_cast<f64>(elapsed.count()) : 0;
+  }
+};
+
+// feeds a capture through `shard`'s decode and handle, i.e. its signals and whatever is attached to them (cache,
+// dispatcher). the shard must be configured with the capture's encoding and compression and not be connected
+ReplayStats replay(const Capture& capture, Shard& shard, ReplayOptions options = {});
+}  // namespace twilight::gateway
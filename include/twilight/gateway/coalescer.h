@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/metrics.h"
+#include "utils/types.h"
+
+namespace twilight::gateway
+{
+// throttles events that supersede each other. the first event under a key goes through and opens a window, the ones
+// after it under the same key are merged until the window closes: dropped, or with Mode::Latest kept in place of the
+// one kept before. the event kept is delivered as the window closes and opens the next one, and a key whose window
+// closes with nothing kept is forgotten. so a key gets at most two deliveries per window however busy it is.
+//
+// windows are closed by a thread of the coalescer's own, which is where kept events are delivered. thread-safe.
+// merged events, the ones never delivered, are counted in metrics::registry() as gateway_coalesced_total
+class Coalescer
+{
+ public:
+  using Deliver = std::move_only_function<void()>;
+  using Clock = std::chrono::steady_clock;
+
+  enum class Mode : u8 {
+    // the last event of a window is delivered as it closes
+    Latest,
+    // only the first event of a window is delivered
+    First,
+  };
+
+  struct Key {
+    u64 scope;
+    u64 id;
+    Mode mode;
+
+    bool operator==(const Key&) const = default;
+  };
+
+  explicit Coalescer(std::chrono::milliseconds window);
+  // drops what's still kept
+  ~Coalescer();
+
+  Coalescer(const Coalescer&) = delete;
+  Coalescer& operator=(const Coalescer&) = delete;
+
+  // true if the event under `key` is to be delivered now. otherwise it was merged, and with Mode::Latest `later()`
+  // made what delivers it if it's still the last one when the window closes
+  template <typename F>
+    requires std::convertible_to<std::invoke_result_t<F&>, Deliver>
+  bool offer(const Key& key, F&& later)
+  {
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, opened] = windows.try_emplace(key, now);
+    Window& w = it->second;
+    // a window past its end that the thread hasn't got to yet is as good as closed
+    if (!opened && now - w.opened < window) {
+      if (key.mode == Mode::First || w.kept)
+        merge();
+      if (key.mode == Mode::Latest)
+        w.kept = later();
+      return false;
+    }
+    if (w.kept)
+      merge();
+    w.opened = now;
+    w.kept = nullptr;
+    return true;
+  }
+
+  // delivers what's kept now, on the calling thread, and closes every window
+  void flush();
+
+  inline std::chrono::milliseconds length() const noexcept { return window; }
+  // events merged so far
+  inline u64 merged() const noexcept { return mergedCount.load(std::memory_order_relaxed); }
+  // keys with an open window
+  usize open() const noexcept;
+
+ private:
+  struct Window {
+    Clock::time_point opened;
+    Deliver kept{};
+  };
+  struct KeyHash {
+    inline usize operator()(const Key& k) const noexcept
+    {
+      return (k.scope * 0x9E3779B97F4A7C15ull) ^ k.id ^ static_cast<u64>(k.mode);
+    }
+  };
+
+  std::chrono::milliseconds window;
+  mutable std::mutex mutex;
+  std::unordered_map<Key, Window, KeyHash> windows;
+  std::atomic<u64> mergedCount{0};
+  std::condition_variable_any wake;
+  // last, so it's stopped before the rest goes away
+  std::jthread closer;
+
+  void merge() noexcept;
+  // closes the windows opened before `cutoff`, moving what they kept to `out`. the mutex must be held
+  void close(Clock::time_point cutoff, std::vector<Deliver>& out);
+  void run(std::stop_token stop);
+};
+}  // namespace twilight::gateway
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <string>
+
+#include "payload.h"
+
+namespace twilight::gateway
+{
+// outbound gateway commands, paced to stay under discord's limit of 120 per connection per 60 seconds (going over
+// closes the connection). sends are logged over a sliding window rather than refilled like a token bucket, so a full
+// burst of 120 is allowed without ever letting two bursts land in the same window.
+//
+// commands wait in lanes, highest priority first. heartbeats have room reserved for them that nothing else can use,
+// and a queued presence update is replaced by a newer one instead of both being sent. not thread-safe
+class CommandQueue
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr u32 LIMIT = 120;
+  static constexpr std::chrono::seconds WINDOW{60};
+
+  enum class Lane : u8 {
+    Heartbeat,
+    // IDENTIFY and RESUME
+    Session,
+    // presence and voice state updates
+    State,
+    // member and soundboard requests
+    Requests,
+    Other,
+  };
+  static constexpr usize LANES = 5;
+
+  struct Command {
+    Opcode op;
+    std::string message;
+  };
+
+  static Lane lane(Opcode op) noexcept;
+
+  void push(Opcode op, std::string message);
+  // the next command that may be sent at `now`, counted as sent. heartbeats and session commands only need a
+  // connection, everything else waits for the session to be ready
+  std::optional<Command> pop(Clock::time_point now, bool connected, bool ready);
+  // puts back a command that couldn't be sent and gives its slot back
+  void unpop(Command command);
+  // when pop() may return something next, max() if it's waiting on nothing but the connection or the session
+  Clock::time_point next(Clock::time_point now, bool connected, bool ready) noexcept;
+
+  // a new connection: queued heartbeats and session commands belonged to the old one, and the window starts over
+  void reset() noexcept;
+  // sizes the heartbeat reservation
+  void setHeartbeatInterval(std::chrono::milliseconds interval) noexcept;
+
+  usize size() const noexcept;
+  // sends logged in the current window
+  inline u32 used() const noexcept { return count; }
+
+ private:
+  std::array<std::deque<Command>, LANES> lanes;
+  // send times, oldest first, in a ring
+  std::array<Clock::time_point, LIMIT> log{};
+  u32 first = 0;
+  u32 count = 0;
+  // sends kept free for heartbeats in every window
+  u32 reserved = 3;
+
+  void expire(Clock::time_point now) noexcept;
+  inline u32 budget(usize lane) const noexcept { return lane == 0 ? LIMIT : LIMIT - reserved; }
+  inline bool open(usize lane, bool connected, bool ready) const noexcept
+  {
+    return lane <= static_cast<usize>(Lane::Session) ? connected : connected && ready;
+  }
+};
+}  // namespace twilight::gateway
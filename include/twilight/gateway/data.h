@@ -0,0 +1,210 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include "etf/parser.h"
+#include "json/parser.h"
+
+namespace twilight::gateway
+{
+using Type = json::Type;
+
+// encoding-agnostic view of a payload value, so events can be read the same way regardless of the negotiated
+// encoding. it's as lazy as the value it wraps
+class Data
+{
+ public:
+  class ArrayIterator;
+  class ObjectIterator;
+
+  template <typename It>
+  struct Range {
+    It first, last;
+    It begin() const noexcept { return first; }
+    It end() const noexcept { return last; }
+  };
+
+  Data() = default;
+  Data(json::Value v) noexcept : value(v) {}
+  Data(etf::Value v) noexcept : value(v) {}
+
+  inline bool valid() const noexcept
+  {
+    return apply<bool>([](const auto& v) { return v.valid(); });
+  }
+  inline Type type() const noexcept
+  {
+    return apply<Type>([](const auto& v) { return v.type(); });
+  }
+  inline bool isNull() const noexcept { return type() == Type::Null; }
+
+  inline std::optional<Data> find(std::string_view key) const noexcept
+  {
+    return apply<std::optional<Data>>([&](const auto& v) -> std::optional<Data> {
+      if (auto r = v.find(key); r.has_value())
+        return Data{*r};
+      return std::nullopt;
+    });
+  }
+  inline std::optional<Data> at(usize index) const noexcept
+  {
+    return apply<std::optional<Data>>([&](const auto& v) -> std::optional<Data> {
+      if (auto r = v.at(index); r.has_value())
+        return Data{*r};
+      return std::nullopt;
+    });
+  }
+  inline usize size() const noexcept
+  {
+    return apply<usize>([](const auto& v) { return v.size(); });
+  }
+
+  inline std::optional<bool> asBool() const noexcept
+  {
+    return apply<std::optional<bool>>([](const auto& v) { return v.asBool(); });
+  }
+  inline std::optional<i64> asInt() const noexcept
+  {
+    return apply<std::optional<i64>>([](const auto& v) { return v.asInt(); });
+  }
+  inline std::optional<u64> asUint() const noexcept
+  {
+    return apply<std::optional<u64>>([](const auto& v) { return v.asUint(); });
+  }
+  inline std::optional<f64> asDouble() const noexcept
+  {
+    return apply<std::optional<f64>>([](const auto& v) { return v.asDouble(); });
+  }
+  inline std::optional<u64> asSnowflake() const noexcept
+  {
+    return apply<std::optional<u64>>([](const auto& v) { return v.asSnowflake(); });
+  }
+  // escape sequences are left as-is for JSON
+  inline std::optional<std::string_view> asStringView() const noexcept
+  {
+    return apply<std::optional<std::string_view>>([](const auto& v) { return v.asStringView(); });
+  }
+  inline std::optional<std::string> asString() const noexcept
+  {
+    return apply<std::optional<std::string>>([](const auto& v) { return v.asString(); });
+  }
+
+  // the value in its wire encoding
+  inline std::string_view raw() const noexcept
+  {
+    return apply<std::string_view>([](const auto& v) { return v.raw(); });
+  }
+
+  Range<ArrayIterator> items() const noexcept;
+  Range<ObjectIterator> fields() const noexcept;
+
+ private:
+  std::variant<std::monostate, json::Value, etf::Value> value;
+
+  template <typename R, typename F>
+  inline R apply(F&& f) const noexcept
+  {
+    return std::visit(
+      [&]<typename V>(const V& v) -> R {
+        if constexpr (std::is_same_v<V, std::monostate>)
+          return R{};
+        else
+          return f(v);
+      },
+      value);
+  }
+};
+
+class Data::ArrayIterator
+{
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Data;
+  using difference_type = std::ptrdiff_t;
+
+  ArrayIterator() = default;
+  template <typename It>
+  ArrayIterator(It it) noexcept : it(it)
+  {
+  }
+
+  inline Data operator*() const noexcept
+  {
+    return std::visit([](const auto& i) { return Data{*i}; }, it);
+  }
+  inline ArrayIterator& operator++() noexcept
+  {
+    std::visit([](auto& i) { ++i; }, it);
+    return *this;
+  }
+  inline ArrayIterator operator++(int) noexcept
+  {
+    ArrayIterator ret = *this;
+    ++*this;
+    return ret;
+  }
+  inline bool operator==(const ArrayIterator& other) const noexcept { return it == other.it; }
+
+ private:
+  std::variant<json::Value::ArrayIterator, etf::Value::ArrayIterator> it;
+};
+
+class Data::ObjectIterator
+{
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::pair<std::string_view, Data>;
+  using difference_type = std::ptrdiff_t;
+
+  ObjectIterator() = default;
+  template <typename It>
+  ObjectIterator(It it) noexcept : it(it)
+  {
+  }
+
+  inline value_type operator*() const noexcept
+  {
+    return std::visit(
+      [](const auto& i) {
+        auto [k, v] = *i;
+        return value_type{k, Data{v}};
+      },
+      it);
+  }
+  inline ObjectIterator& operator++() noexcept
+  {
+    std::visit([](auto& i) { ++i; }, it);
+    return *this;
+  }
+  inline ObjectIterator operator++(int) noexcept
+  {
+    ObjectIterator ret = *this;
+    ++*this;
+    return ret;
+  }
+  inline bool operator==(const ObjectIterator& other) const noexcept { return it == other.it; }
+
+ private:
+  std::variant<json::Value::ObjectIterator, etf::Value::ObjectIterator> it;
+};
+
+inline Data::Range<Data::ArrayIterator> Data::items() const noexcept
+{
+  return apply<Range<ArrayIterator>>([](const auto& v) -> Range<ArrayIterator> {
+    auto r = v.items();
+    return {r.begin(), r.end()};
+  });
+}
+
+inline Data::Range<Data::ObjectIterator> Data::fields() const noexcept
+{
+  return apply<Range<ObjectIterator>>([](const auto& v) -> Range<ObjectIterator> {
+    auto r = v.fields();
+    return {r.begin(), r.end()};
+  });
+}
+}  // namespace twilight::gateway
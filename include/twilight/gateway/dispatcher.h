@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "coalescer.h"
+#include "events.h"
+#include "payload.h"
+#include "utils/executor.h"
+
+namespace twilight::cache
+{
+class Cache;
+}
+
+namespace twilight::gateway
+{
+class Shard;
+
+// what keeps handlers in order when they run on an Executor
+enum class Ordering : u8 {
+  // a guild's events are handled in order. events without a guild go by channel, the rest share one queue
+  Guild,
+  // a channel's events are handled in order. events without a channel go by guild, the rest share one queue
+  Channel,
+};
+
+// delivers dispatches to handlers registered per event type. once attached, a shard only fully parses the events
+// that have a handler here or that the cache wants, the rest are dropped after their envelope is read.
+//
+// handlers must all be registered before the first attach(). dispatch() may then run on every shard thread at once,
+// and handlers run on it unless an executor is set
+class Dispatcher
+{
+ public:
+  // dispatches are applied to `cache` (if any) before handlers see them
+  explicit Dispatcher(cache::Cache* cache = nullptr);
+
+  Dispatcher(const Dispatcher&) = delete;
+  Dispatcher& operator=(const Dispatcher&) = delete;
+
+  template <EventType E, typename F>
+    requires std::invocable<F&, const E&>
+  void on(F&& f)
+  {
+    handlers[E::HASH].push_back([f = std::forward<F>(f)](Shard& shard, const Payload& payload) mutable {
+      // the hash only picked the bucket
+      if (payload.t == E::NAME)
+        f(E{shard, payload.d});
+    });
+    subscribed.add(E::HASH);
+  }
+
+  // hands handlers to `executor` instead of running them on the shard's socket thread, so a slow one can't hold up the
+  // connection. the cache is still updated on the socket thread, so handlers may see it ahead of their event. must
+  // be set before the first attach(), and the executor drained before shards or the dispatcher go away
+  inline void setExecutor(Executor* e, Ordering o = Ordering::Guild) noexcept
+  {
+    executor = e;
+    ordering = o;
+  }
+
+  // merges bursts of PRESENCE_UPDATE per member and of TYPING_START per user and channel, `window` long, before
+  // handlers see them (see Coalescer): a member's presence reaches them at most twice a window, the latest one last,
+  // and a user typing once. the cache still applies every presence, which costs little when it changes nothing. the
+  // latest presences are delivered from the coalescer's thread, through the executor if there's one. must be set
+  // before the first attach(), and what's still kept when the dispatcher goes away is dropped
+  void setCoalescing(std::chrono::milliseconds window);
+  inline Coalescer* coalescer() const noexcept { return coalescing.get(); }
+
+  // routes the shard's dispatches here and narrows its events down to events()
+  void attach(Shard& shard);
+  void dispatch(Shard& shard, const Payload& payload);
+
+  // handled or cached events
+  EventSet events() const;
+
+  // the executor key that orders `payload` among others
+  static u64 orderKey(const Payload& payload, Ordering ordering) noexcept;
+  // what `payload` is merged under with coalescing, if it's merged at all
+  static std::optional<Coalescer::Key> coalesceKey(const Payload& payload) noexcept;
+
+ private:
+  using Handler = std::function<void(Shard&, const Payload&)>;
+
+  cache::Cache* cache;
+  Executor* executor = nullptr;
+  Ordering ordering = Ordering::Guild;
+  std::unordered_map<u64, std::vector<Handler>> handlers;
+  EventSet subscribed;
+  std::unique_ptr<Coalescer> coalescing;
+
+  // runs `list` on a copy of `payload`, wherever it's called
+  static Executor::Job deferred(Shard& shard, const Payload& payload, const std::vector<Handler>& list);
+};
+}  // namespace twilight::gateway
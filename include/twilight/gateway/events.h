@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
+#include "data.h"
+#include "utils/types.h"
+
+namespace twilight::gateway
+{
+class Shard;
+
+// FNV-1a, so event names can be hashed at compile time and compared as integers at runtime
+constexpr u64 eventHash(std::string_view name) noexcept
+{
+  u64 h = 0xCBF29CE484222325ull;
+  for (char c : name) {
+    h ^= static_cast<u8>(c);
+    h *= 0x100000001B3ull;
+  }
+  return h;
+}
+
+// a set of dispatch names, held as their hashes. a collision can only let an unwanted event through, never drop a
+// wanted one
+class EventSet
+{
+ public:
+  // no events
+  EventSet() = default;
+  EventSet(std::initializer_list<std::string_view> names)
+  {
+    for (auto name : names) add(eventHash(name));
+  }
+
+  static inline EventSet all() noexcept
+  {
+    EventSet set;
+    set.everything = true;
+    return set;
+  }
+
+  inline void add(u64 hash)
+  {
+    auto it = std::lower_bound(hashes.begin(), hashes.end(), hash);
+    if (it == hashes.end() || *it != hash)
+      hashes.insert(it, hash);
+  }
+  inline void add(std::string_view name) { add(eventHash(name)); }
+  inline void add(const EventSet& other)
+  {
+    everything = everything || other.everything;
+    for (u64 h : other.hashes) add(h);
+  }
+
+  inline bool contains(u64 hash) const noexcept
+  {
+    return everything || std::binary_search(hashes.begin(), hashes.end(), hash);
+  }
+  inline bool contains(std::string_view name) const noexcept { return everything || contains(eventHash(name)); }
+  inline bool isAll() const noexcept { return everything; }
+  inline usize size() const noexcept { return hashes.size(); }
+
+ private:
+  bool everything = false;
+  std::vector<u64> hashes;
+};
+
+template <usize N>
+struct EventName {
+  char value[N];
+
+  consteval EventName(const char (&name)[N]) noexcept { std::copy_n(name, N, value); }
+  constexpr std::string_view view() const noexcept { return {value, N - 1}; }
+};
+
+// a dispatch of a given type. `d` is as lazy as the payload it comes from and is only valid during the handler
+template <EventName Name>
+struct Event {
+  static constexpr std::string_view NAME = Name.view();
+  static constexpr u64 HASH = eventHash(NAME);
+
+  Shard& shard;
+  Data d;
+};
+
+template <typename E>
+concept EventType = requires {
+  { E::NAME } -> std::convertible_to<std::string_view>;
+  { E::HASH } -> std::convertible_to<u64>;
+};
+
+// https://discord.com/developers/docs/events/gateway-events#receive-events
+using Ready = Event<"READY">;
+using Resumed = Event<"RESUMED">;
+using ChannelCreate = Event<"CHANNEL_CREATE">;
+using ChannelUpdate = Event<"CHANNEL_UPDATE">;
+using ChannelDelete = Event<"CHANNEL_DELETE">;
+using ThreadCreate = Event<"THREAD_CREATE">;
+using ThreadUpdate = Event<"THREAD_UPDATE">;
+using ThreadDelete = Event<"THREAD_DELETE">;
+using GuildCreate = Event<"GUILD_CREATE">;
+using GuildUpdate = Event<"GUILD_UPDATE">;
+using GuildDelete = Event<"GUILD_DELETE">;
+using GuildBanAdd = Event<"GUILD_BAN_ADD">;
+using GuildBanRemove = Event<"GUILD_BAN_REMOVE">;
+using GuildMemberAdd = Event<"GUILD_MEMBER_ADD">;
+using GuildMemberUpdate = Event<"GUILD_MEMBER_UPDATE">;
+using GuildMemberRemove = Event<"GUILD_MEMBER_REMOVE">;
+using GuildMembersChunk = Event<"GUILD_MEMBERS_CHUNK">;
+using GuildRoleCreate = Event<"GUILD_ROLE_CREATE">;
+using GuildRoleUpdate = Event<"GUILD_ROLE_UPDATE">;
+using GuildRoleDelete = Event<"GUILD_ROLE_DELETE">;
+using InteractionCreate = Event<"INTERACTION_CREATE">;
+using MessageCreate = Event<"MESSAGE_CREATE">;
+using MessageUpdate = Event<"MESSAGE_UPDATE">;
+using MessageDelete = Event<"MESSAGE_DELETE">;
+using MessageDeleteBulk = Event<"MESSAGE_DELETE_BULK">;
+using MessageReactionAdd = Event<"MESSAGE_REACTION_ADD">;
+using MessageReactionRemove = Event<"MESSAGE_REACTION_REMOVE">;
+using PresenceUpdate = Event<"PRESENCE_UPDATE">;
+using TypingStart = Event<"TYPING_START">;
+using UserUpdate = Event<"USER_UPDATE">;
+using VoiceStateUpdate = Event<"VOICE_STATE_UPDATE">;
+using VoiceServerUpdate = Event<"VOICE_SERVER_UPDATE">;
+}  // namespace twilight::gateway
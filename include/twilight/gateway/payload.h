@@ -0,0 +1,46 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+#include "data.h"
+#include "utils/types.h"
+
+namespace twilight::gateway
+{
+// https://discord.com/developers/docs/topics/opcodes-and-status-codes#gateway-gateway-opcodes
+enum class Opcode : u8 {
+  Dispatch = 0,
+  Heartbeat = 1,
+  Identify = 2,
+  PresenceUpdate = 3,
+  VoiceStateUpdate = 4,
+  Resume = 6,
+  Reconnect = 7,
+  RequestGuildMembers = 8,
+  InvalidSession = 9,
+  Hello = 10,
+  HeartbeatAck = 11,
+  RequestSoundboardSounds = 31,
+};
+
+enum class Encoding : u8 {
+  JSON,
+  ETF,
+};
+
+// a decoded gateway message. `t` and `d` borrow the receive buffer and are only valid while the payload is
+// being handled
+struct Payload {
+  Opcode op;
+  std::optional<u64> s;
+  std::string_view t;
+  Data d;
+
+  // reads the envelope in a single pass over the top-level fields, `d` itself isn't touched
+  static std::optional<Payload> from(const Data& root) noexcept;
+  // reads the envelope straight from JSON text without indexing the document, `d` is left empty. fields are usually
+  // sent before `d`, so this stops after a few dozen bytes. nullopt if the envelope can't be read this way
+  static std::optional<Payload> peek(std::string_view json) noexcept;
+};
+}  // namespace twilight::gateway
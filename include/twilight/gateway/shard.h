@@ -0,0 +1,227 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <expected>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "discord.h"
+#include "command_queue.h"
+#include "etf/writer.h"
+#include "events.h"
+#include "json/parser.h"
+#include "json/writer.h"
+#include "payload.h"
+#include "utils/metrics.h"
+#include "utils/signal.h"
+#include "ws/client.h"
+
+namespace twilight::gateway
+{
+class Recorder;
+
+enum class Compression : u8 {
+  None,
+  // https://discord.com/developers/docs/events/gateway#zlibstream
+  ZlibStream,
+};
+
+// what's needed to resume a session after a reconnect
+struct Session {
+  std::string id;
+  std::string resumeUrl;
+  u64 seq = 0;
+};
+
+// https://discord.com/developers/docs/events/gateway-events#request-guild-members
+struct MemberQuery {
+  // username prefix; empty with a limit of 0 requests every member, which needs the GUILD_MEMBERS intent
+  std::string query{};
+  u32 limit = 0;
+  bool presences = false;
+  // specific users instead of a query
+  std::vector<u64> users{};
+};
+
+struct MemberChunks {
+  u64 guild = 0;
+  u32 chunks = 0;
+  u32 members = 0;
+  // requested users that aren't members
+  std::vector<u64> notFound{};
+};
+
+// updated as chunks arrive
+struct MemberProgress {
+  std::atomic<u32> chunks{0};
+  // 0 until the first chunk tells
+  std::atomic<u32> expected{0};
+  std::atomic<u32> members{0};
+};
+
+struct MemberRequest {
+  std::string nonce;
+  std::shared_ptr<const MemberProgress> progress;
+  std::future<MemberChunks> done;
+};
+
+class Shard
+{
+ public:
+  struct Options {
+    std::string token{};
+    Intent intents = Intent::None;
+    u32 id = 0;
+    u32 count = 1;
+    Encoding encoding = Encoding::JSON;
+    Compression compression = Compression::None;
+    std::string url = "wss://gateway.discord.gg";
+    // every received message is appended to it, if set. not owned
+    Recorder* recorder = nullptr;
+    // the socket and control threads are pinned to these cpus if set, e.g. to keep them apart from an Executor's
+    std::vector<u32> cpus{};
+  };
+
+  explicit Shard(Options options);
+  ~Shard();
+
+  Shard(const Shard&) = delete;
+  Shard& operator=(const Shard&) = delete;
+
+  // connects and identifies (or resumes, if a session is set); reconnects happen in the background afterwards
+  void connect();
+  void close() noexcept;
+
+  // every payload, including dispatches
+  Signal<const Payload&> onpayload;
+  // DISPATCH payloads only, after the shard has updated its session state
+  Signal<const Payload&> ondispatch;
+
+  // queues a command, `data` is called with either a json::Writer or an etf::Writer to write the `d` field. commands
+  // are sent by priority as fast as the gateway's rate limit allows (see CommandQueue), the ones other than
+  // heartbeats, IDENTIFY and RESUME once the session is ready. returns false if the shard is closed
+  template <typename F>
+  bool send(Opcode op, F&& data)
+  {
+    if (options.encoding == Encoding::ETF) {
+      etf::Writer w;
+      envelope(w, op, data);
+      return enqueue(op, w.take());
+    }
+    json::Writer w;
+    envelope(w, op, data);
+    return enqueue(op, w.take());
+  }
+
+  // inflates (if needed) and decodes one message. the payload borrows `message` and buffers owned by the shard, so
+  // it's only valid until the next call. exposed so captured traffic can be fed through the same path
+  std::expected<Payload, std::string> decode(std::string_view message);
+  // updates the session state from a decoded payload and emits the signals
+  void handle(const Payload& payload);
+  // starts a new compression stream, as on a new connection
+  void restartStream() noexcept;
+
+  // sent in the request lane, below presence and voice state updates. `done` is set after the last chunk went through
+  // the signals, so whatever caches members has them by then. it holds an exception if the request couldn't be sent,
+  // or the connection it was queued or sent on closed before the last chunk came
+  MemberRequest requestGuildMembers(u64 guild, MemberQuery query = {});
+  // joins, moves to or, without a channel, leaves a guild's voice channel. the gateway answers with the bot's
+  // VOICE_STATE_UPDATE and a VOICE_SERVER_UPDATE, which together carry what a voice::Connection is made from
+  bool updateVoiceState(u64 guild, std::optional<u64> channel, bool mute = false, bool deaf = false);
+
+  inline const Options& config() const noexcept { return options; }
+  // round trip of the last acknowledged heartbeat, zero before the first. every one is also recorded in
+  // metrics::registry() as gateway_heartbeat_rtt_ns
+  inline std::chrono::nanoseconds latency() const noexcept
+  {
+    return std::chrono::nanoseconds{rtt.load(std::memory_order_relaxed)};
+  }
+  // the dispatches anyone listens to, all of them by default. others only advance the sequence: with JSON they're
+  // dropped after reading the envelope, before the document is parsed, and they never reach the signals. must be set
+  // before connecting
+  inline void setEvents(EventSet set) { events = std::move(set); }
+  Session session() const noexcept;
+  void setSession(Session s) noexcept;
+
+ private:
+  struct Inflater;
+
+  Options options;
+  // replaced on every reconnect
+  std::unique_ptr<ws::Client> ws;
+  mutable std::mutex wsMutex;
+  std::unique_ptr<Inflater> inflater;
+  json::Parser parser;
+  EventSet events = EventSet::all();
+
+  mutable std::mutex sessionMutex;
+  Session sess;
+  std::atomic<u64> seq{0};
+
+  // heartbeats and reconnects run on their own thread so a slow handler on the socket thread can't delay them
+  std::jthread control;
+  std::mutex controlMutex;
+  std::condition_variable_any controlCv;
+  std::chrono::milliseconds heartbeatInterval{0};
+  std::chrono::steady_clock::time_point nextHeartbeat;
+  // when the unacknowledged heartbeat went out
+  std::chrono::steady_clock::time_point heartbeatSent{};
+  bool heartbeatAcked = true;
+  std::atomic<i64> rtt{0};
+  bool connected = false;
+  // READY or RESUMED was received on the current connection
+  bool sessionReady = false;
+  CommandQueue commands;
+  // commands' share of the gateway_commands_queued gauge
+  usize reportedQueue = 0;
+  bool reconnectRequested = false;
+  bool wake = false;
+  std::atomic<bool> closing{false};
+
+  struct PendingMembers {
+    std::promise<MemberChunks> promise;
+    std::shared_ptr<MemberProgress> progress;
+    MemberChunks result;
+  };
+  // sent or queued, by nonce
+  std::mutex membersMutex;
+  std::unordered_map<std::string, PendingMembers> memberRequests;
+  std::atomic<u32> membersOutstanding{0};
+  std::atomic<u64> nonces{0};
+
+  template <typename W, typename F>
+  static void envelope(W& w, Opcode op, F& data)
+  {
+    w.beginObject().key("op").value(static_cast<u8>(op)).key("d");
+    data(w);
+    w.endObject();
+  }
+
+  // the session comes from READY and RESUMED, and member requests are tracked through their chunks
+  inline bool wanted(std::string_view t) const noexcept
+  {
+    return t == "READY" || t == "RESUMED" || events.contains(t) ||
+           (t == "GUILD_MEMBERS_CHUNK" && membersOutstanding.load(std::memory_order_relaxed));
+  }
+  bool enqueue(Opcode op, std::string message);
+  bool sendRaw(const std::string& message) const noexcept;
+  void open();
+  void identify();
+  void resume();
+  void heartbeat();
+  void memberChunk(const Data& d);
+  // fails every request still waiting for chunks, which a new connection won't bring
+  void failMemberRequests(const char* why) noexcept;
+  void requestReconnect() noexcept;
+  void reportQueue() noexcept;
+  void run(std::stop_token stop);
+};
+}  // namespace twilight::gateway
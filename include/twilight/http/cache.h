@@ -0,0 +1,111 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "response.h"
+#include "uri.h"
+
+namespace twilight::http
+{
+// a private cache of GET responses, shared by whatever requests pass it in RequestInit::cache. a response is stored
+// when it's a 200 that neither says no-store nor varies on more than the encoding. it's served from memory while
+// fresh (Cache-Control max-age, else Expires, else a tenth of its Last-Modified age as RFC 9111 suggests), and once
+// stale it's revalidated with If-None-Match / If-Modified-Since, a 304 turning back into the stored response. no-cache
+// responses are revalidated every time.
+//
+// bodies are kept decoded in an LRU bounded by `memoryBytes`. with a directory, what falls out of memory goes to one
+// file per response there, mapped back in and promoted on the next hit, and the directory's files are picked up again
+// by the next cache using it. thread-safe. hits, revalidations and misses are counted in metrics::registry() as
+// http_cache_*_total, the bytes held as the http_cache_memory_bytes and http_cache_disk_bytes gauges
+class ResponseCache
+{
+ public:
+  struct Options {
+    usize memoryBytes = 64 << 20;
+    // the disk tier, off if empty. the directory is created if missing and should be left to the cache
+    std::string directory{};
+    usize diskBytes = usize{1} << 30;
+  };
+
+  // a stored response, body decoded and its framing headers (length, transfer and content encoding) dropped
+  struct Entry {
+    u16 status;
+    std::string statusMessage;
+    // raw header block
+    std::string headers;
+    std::string body;
+    // unix seconds the entry is fresh until
+    i64 expires;
+    // Cache-Control: no-cache, never served without revalidating
+    bool revalidate;
+
+    Response response() const noexcept;
+    inline usize size() const noexcept { return sizeof(Entry) + statusMessage.size() + headers.size() + body.size(); }
+  };
+
+  struct Lookup {
+    // fresh, served without a request
+    std::optional<Response> hit;
+    // stale and being revalidated, what a 304 stands for
+    std::shared_ptr<const Entry> stale;
+  };
+
+  ResponseCache();
+  explicit ResponseCache(Options options);
+  ~ResponseCache();
+
+  ResponseCache(const ResponseCache&) = delete;
+  ResponseCache& operator=(const ResponseCache&) = delete;
+
+  // the request for `key` is answered by `hit`, or sent with `headers` carrying the stale entry's validators. requests
+  // with their own validators are left alone, their 304s are the caller's
+  Lookup lookup(const std::string& key, Headers& headers);
+  // what the request for `key` gets given the server's `res`, which is stored if it can be
+  Response store(const std::string& key, Response res, const std::shared_ptr<const Entry>& stale);
+
+  // requests made with another token see other responses, so the Authorization header is part of the key
+  static std::string key(const URI& uri, std::string_view path, const Headers& headers);
+
+  usize memoryUsage() const noexcept;
+  usize diskUsage() const noexcept;
+
+ private:
+  struct Slot {
+    std::string key;
+    std::shared_ptr<const Entry> entry;
+  };
+  struct File {
+    std::string key;
+    std::string path;
+    usize size;
+  };
+
+  Options options;
+  mutable std::mutex mutex;
+  // most recently used first. the indexes' keys point into the lists' nodes
+  std::list<Slot> memory;
+  std::unordered_map<std::string_view, std::list<Slot>::iterator> memoryIndex;
+  usize memoryBytes = 0;
+  std::list<File> disk;
+  std::unordered_map<std::string_view, std::list<File>::iterator> diskIndex;
+  usize diskBytes = 0;
+
+  // the mutex must be held by these
+  std::shared_ptr<const Entry> find(const std::string& key);
+  void insert(const std::string& key, std::shared_ptr<const Entry> entry);
+  void erase(const std::string& key);
+  // moves entries to disk (or drops them) until memory is within bounds
+  void evict();
+  void spill(const Slot& slot);
+  std::shared_ptr<const Entry> load(const File& file) const;
+  void dropFile(std::list<File>::iterator it);
+  // indexes the files a previous cache left in the directory
+  void scan();
+};
+}  // namespace twilight::http
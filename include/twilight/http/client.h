@@ -5,9 +5,15 @@
 #include <unistd.h>
 
 #include <atomic>
+#include <memory>
+#include <mutex>
 
 #include "response.h"
+#include "tls.h"
 #include "uri.h"
+#include "utils/metrics.h"
+#include "utils/signal.h"
+#include "utils/uring.h"
 
 namespace twilight::http
 {
@@ -21,10 +27,14 @@ enum class Method : u8 {
   HEAD,
 };
 
+class ResponseCache;
+
 struct RequestInit {
   Method method = Method::GET;
   std::string body{};
   Headers headers{};
+  // GETs are answered from it when it has a fresh response, and stored in it. not owned
+  ResponseCache* cache = nullptr;
 };
 
 enum class ClientFlags : int {
@@ -33,6 +43,8 @@ enum class ClientFlags : int {
   NoConnect = 1 << 0,
   // don't follow redirects
   NoFollow = 1 << 1,
+  // receive and send through io_uring when the kernel supports it, TLS included
+  Uring = 1 << 2,
 };
 
 class Client
@@ -43,10 +55,17 @@ class Client
   Client(const Client&) = delete;
   Client& operator=(const Client&) = delete;
 
+  // connects first if needed. a hit in `opts.cache` returns without a request, so without timings either
   Response request(const std::string& path, RequestInit opts = {});
 
   void connect();
 
+  // called after every request with where its time went, on the thread that made it. the same timings are recorded
+  // in metrics::registry() as http_*_ns histograms. neither happens when metrics are compiled out
+  Signal<const Timings&> ontimings;
+  // the last request's
+  inline const Timings& timings() const noexcept { return timing; }
+
  protected:
   struct Socket {
     int fd = -1;
@@ -58,21 +77,43 @@ class Client
     ~SSLCtx();
   } sslCtx;
 
-  struct SSLHandle {
-    SSL* ptr = nullptr;
-    ~SSLHandle();
-  } ssl;
+  std::unique_ptr<Tls> tls;
+
+  // set by connect() with ClientFlags::Uring, declared after `sock` so it's torn down while the fd is still open
+  std::unique_ptr<UringSocket> ring;
 
   URI uri;
   ClientFlags flags;
   std::atomic<bool> connected = false;
 
+  // plaintext, decrypted first on a TLS connection. same results as recv on a blocking socket
   isize recv(char* buf, usize len) const noexcept;
-  isize send(const char* buf, usize len) const noexcept;
-
-  bool sendAll(const std::string& msg) const noexcept;
+  // with `defer` and io_uring, the send goes out with the wait for the next recv
+  bool sendAll(const std::string& msg, bool defer = false) const noexcept;
+  // appends one response to `data`, and sets `firstByte` to when its first bytes arrived
   // !!! this method is designed for RFC 7230-compliant responses and won't work for anything else
-  std::string recvAll() const noexcept;
+  void recvAll(std::string& data, metrics::Clock::time_point* firstByte = nullptr) const noexcept;
+
+ private:
+  // the last request and response as sent and received, kept so keep-alive requests reuse its capacity
+  std::string buf;
+  Timings timing;
+  // connect() set the connection phases and no request has reported them yet
+  bool fresh = false;
+
+  // ciphertext read from the socket, only touched by the receiving thread
+  mutable std::string incoming;
+  // taken out of `tls` and sent under `writing`, so records go out in the order they were sealed
+  mutable std::mutex writing;
+  mutable std::string sealed;
+
+  // the socket's own bytes, ciphertext on a TLS connection
+  isize recvRaw(char* buf, usize len) const noexcept;
+  bool sendRaw(const char* buf, usize len, bool defer) const noexcept;
+  // sends what `tls` sealed, with `writing` held
+  bool flush(bool defer) const noexcept;
+  bool handshake() noexcept;
+  void report() noexcept;
 };
 
 Response fetch(const URI& uri, RequestInit opts = {});
@@ -1,31 +1,53 @@
 #pragma once
 
 #include <expected>
+#include <functional>
 #include <map>
+#include <memory_resource>
 #include <optional>
 #include <string>
+#include <string_view>
 
+#include "utils/pool.h"
 #include "utils/types.h"
 
 namespace twilight::http
 {
+// header names are stored lowercased. entries are allocated from the memory resource given on construction, the buffer
+// pool by default, and copies share their source's. lookups don't allocate
 class Headers
 {
  public:
-  Headers() = default;
-  Headers(const std::initializer_list<std::pair<std::string, std::string>>& headers) noexcept;
+  Headers() noexcept : headers(&bufferPool()) {}
+  explicit Headers(std::pmr::memory_resource* resource) noexcept : headers(resource) {}
+  Headers(const std::initializer_list<std::pair<std::string_view, std::string_view>>& headers,
+    std::pmr::memory_resource* resource = &bufferPool()) noexcept;
   Headers(const std::map<std::string, std::string>& headers) noexcept;
+  Headers(const Headers& other) noexcept : headers(other.headers, other.resource()) {}
+  Headers(const Headers& other, std::pmr::memory_resource* resource) noexcept : headers(other.headers, resource) {}
+  Headers(Headers&& other) noexcept = default;
+  Headers& operator=(const Headers& other) = default;
+  Headers& operator=(Headers&& other) = default;
 
-  void add(const std::string& key, const std::string& value) noexcept;
-  void addIfNotExists(const std::string& key, const std::string& value) noexcept;
-  std::optional<std::string> get(const std::string& key) const noexcept;
+  void add(std::string_view key, std::string_view value) noexcept;
+  void addIfNotExists(std::string_view key, std::string_view value) noexcept;
+  void remove(std::string_view key) noexcept;
+  // the view is invalidated by the next add() of the same key
+  std::optional<std::string_view> get(std::string_view key) const noexcept;
 
   // returns headers as a string in RFC 7230 compliant format (without the trailing CRLF)
   std::string toString() const noexcept;
+  // same as toString(), appended to `out`
+  void appendTo(std::string& out) const noexcept;
 
-  static std::expected<Headers, std::string> parse(const std::string& raw) noexcept;
+  inline std::pmr::memory_resource* resource() const noexcept { return headers.get_allocator().resource(); }
+
+  static std::expected<Headers, std::string> parse(std::string_view raw,
+    std::pmr::memory_resource* resource = &bufferPool()) noexcept;
+  // the value of header `key` in the raw header block `raw`, without parsing the block
+  static std::optional<std::string_view> find(std::string_view raw, std::string_view key) noexcept;
 
  protected:
-  std::map<std::string, std::string> headers;
+  std::pmr::map<std::pmr::string, std::pmr::string, std::less<>> headers;
 };
 }  // namespace twilight::http
@@ -1,26 +1,61 @@
 #pragma once
 
+#include <chrono>
 #include <expected>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 
 #include "utils/types.h"
 #include "headers.h"
 
 namespace twilight::http
 {
+// where the time of one request went. the connection phases are only set for the request that opened the connection,
+// everything is zero when metrics are compiled out
+struct Timings {
+  using Duration = std::chrono::nanoseconds;
+
+  Duration dns{};
+  Duration connect{};
+  Duration tls{};
+  // writing the request, then waiting for the first byte of the response, then reading the rest of it
+  Duration write{};
+  Duration firstByte{};
+  Duration transfer{};
+  // decoding the body, in Response::parse
+  Duration dechunk{};
+  Duration decompress{};
+  // on the wire, headers included
+  usize bytesSent = 0;
+  usize bytesReceived = 0;
+  // after decoding
+  usize bodySize = 0;
+  // sent on a connection an earlier request opened
+  bool reused = false;
+
+  inline Duration total() const noexcept
+  {
+    return dns + connect + tls + write + firstByte + transfer + dechunk + decompress;
+  }
+};
+
 struct Response {
   u16 statusCode;
-  std::string statusMessage;
+  std::pmr::string statusMessage;
   Headers headers;
-  std::string body;
+  std::pmr::string body;
 
   inline bool ok() const noexcept { return statusCode >= 200 && statusCode < 300; }
 
-  static std::expected<Response, std::string> parse(const std::string &raw) noexcept;
+  // the status message, headers and body are allocated from `resource`, the buffer pool by default. the time spent
+  // decoding the body and its decoded size go to `timings`, if given
+  static std::expected<Response, std::string> parse(std::string_view raw,
+    std::pmr::memory_resource *resource = &bufferPool(), Timings *timings = nullptr) noexcept;
 
- private:
-  static std::string decodeChunked(const std::string &data) noexcept;
-  static std::expected<std::string, std::string>
-  decompress(const std::string &encoding, const std::string &data) noexcept;
+  // the body decoding steps of parse(), on their own. malformed chunks end the body early
+  static std::pmr::string decodeChunked(std::string_view data, std::pmr::memory_resource *resource) noexcept;
+  static std::expected<std::pmr::string, std::string>
+  decompress(std::string_view encoding, std::string_view data, std::pmr::memory_resource *resource) noexcept;
 };
 }  // namespace twilight::http
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <expected>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "client.h"
+
+namespace twilight::http
+{
+struct Request {
+  Method method = Method::GET;
+  std::string path;
+  Headers headers;
+  std::string body;
+  // when the last byte of the request arrived, handlers measure their latency budget from here
+  std::chrono::steady_clock::time_point received{};
+  bool keepAlive = true;
+
+  // parses the request line and headers, `head` without the blank line that ends it
+  static std::expected<Request, std::string> parse(std::string_view head) noexcept;
+};
+
+// serializes `res` as an HTTP/1.1 response, Content-Length is always set from the body
+std::string serialize(const Response& res, bool keepAlive) noexcept;
+
+// a small HTTP/1.1 server for webhooks such as the interactions endpoint. one thread runs an epoll loop over
+// non-blocking keep-alive connections and only parses, requests go to a pool of handler threads so slow handlers or
+// expensive checks (signature verification) never hold up reading. requests on one connection are answered in order,
+// pipelined ones wait for the response before theirs is handled.
+//
+// plain http only, discord needs https so it's meant to sit behind a tls-terminating proxy
+class Server
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+  // called on a handler thread, possibly on several at once
+  using Handler = std::function<Response(const Request&)>;
+
+  struct Options {
+    std::string host = "0.0.0.0";
+    // 0 picks a free port, see port()
+    u16 port = 8080;
+    // handler threads, 0 for one per core
+    usize workers = 0;
+    usize maxHeaderSize = 16 * 1024;
+    usize maxBodySize = 1024 * 1024;
+    // keep-alive connections without a request for this long are closed
+    std::chrono::seconds idleTimeout{60};
+  };
+
+  Server(Options options, Handler handler);
+  ~Server();
+
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  // binds and starts serving in the background, throws if the address can't be bound
+  void listen();
+  // stops accepting and closes every connection, requests being handled are dropped
+  void close() noexcept;
+
+  // the bound port, once listening
+  inline u16 port() const noexcept { return bound; }
+
+ private:
+  struct Connection {
+    std::string in;
+    std::string out;
+    usize sent = 0;
+    // a request from this connection is being handled
+    bool busy = false;
+    // a 100 Continue went out for the request being read
+    bool continued = false;
+    // EPOLLOUT is on, the last write didn't fit in the socket buffer
+    bool writing = false;
+    // EPOLLIN is off, `in` holds as much as one request may take while the one before is handled
+    bool paused = false;
+    bool closing = false;
+    u64 id = 0;
+    Clock::time_point active{};
+  };
+
+  struct Job {
+    int fd;
+    u64 id;
+    Request request;
+  };
+
+  struct Done {
+    int fd;
+    u64 id;
+    std::string response;
+    bool keepAlive;
+  };
+
+  Options options;
+  Handler handler;
+  int listener = -1;
+  int epoll = -1;
+  // wakes the loop when a response is ready
+  int event = -1;
+  u16 bound = 0;
+  u64 nextId = 0;
+
+  // only touched by the loop thread
+  std::unordered_map<int, Connection> connections;
+
+  std::mutex jobsMutex;
+  std::condition_variable_any jobsCv;
+  std::deque<Job> jobs;
+
+  std::mutex doneMutex;
+  std::vector<Done> done;
+
+  std::jthread loop;
+  std::vector<std::jthread> workers;
+
+  void run(std::stop_token stop);
+  void work(std::stop_token stop);
+
+  void accept() noexcept;
+  // these return false once the connection was dropped
+  bool read(int fd, Connection& c) noexcept;
+  bool write(int fd, Connection& c) noexcept;
+  // parses the next buffered request, if complete, and queues it
+  void next(int fd, Connection& c) noexcept;
+  // answers on the loop thread, for requests that never reach a handler
+  void reject(int fd, Connection& c, u16 status) noexcept;
+  void finish() noexcept;
+  // stops or resumes reading `fd` depending on how much is buffered, if it's still open
+  void throttle(int fd) noexcept;
+  // EPOLL_CTL_MOD to what the connection's state asks for
+  void interest(int fd, const Connection& c) noexcept;
+  void drop(int fd) noexcept;
+  void sweep(Clock::time_point now) noexcept;
+};
+}  // namespace twilight::http
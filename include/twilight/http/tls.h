@@ -0,0 +1,61 @@
+#pragma once
+
+#include <openssl/ssl.h>
+
+#include <mutex>
+#include <string>
+
+#include "utils/types.h"
+
+namespace twilight::http
+{
+// a TLS client session that never touches a socket. ciphertext from the peer is fed in and ciphertext for it taken
+// out through memory BIOs, and whoever owns the connection moves it, with recv/send, io_uring or anything else. that
+// way a syscall carries as many records as fit in its buffer, rather than OpenSSL reading each record's header and
+// body with a recv of their own and writing every record with a send.
+//
+// one thread may read while others write, writers must take the ciphertext out in the order they sealed it
+class Tls
+{
+ public:
+  // read() needs more ciphertext first
+  static constexpr isize MORE = -2;
+
+  enum class Status : u8 {
+    Done,
+    // send what take() has, then feed() what comes back
+    WantRead,
+    Failed,
+  };
+
+  // a session with `ctx`'s settings for `host`, which it sends as SNI. throws if OpenSSL can't make one
+  Tls(SSL_CTX* ctx, const std::string& host);
+  ~Tls();
+
+  Tls(const Tls&) = delete;
+  Tls& operator=(const Tls&) = delete;
+
+  // advances the handshake as far as the ciphertext fed so far allows
+  Status handshake() noexcept;
+
+  // ciphertext received from the peer
+  void feed(const char* data, usize len) noexcept;
+  // decrypts into `buf` from as many of the buffered records as fit. the byte count, 0 once the peer closed, -1 on
+  // failure or MORE
+  isize read(char* buf, usize len) noexcept;
+
+  // seals `len` bytes of plaintext into records of up to 16 KiB, false on failure
+  bool write(const char* buf, usize len) noexcept;
+  // appends the ciphertext waiting to be sent to `buf`, returns how many bytes that was
+  usize take(std::string& buf) noexcept;
+  // ciphertext waiting to be sent, e.g. after read() answered a key update
+  usize pending() const noexcept;
+
+ private:
+  mutable std::mutex mutex;
+  SSL* ssl = nullptr;
+  // owned by `ssl`
+  BIO* in = nullptr;
+  BIO* out = nullptr;
+};
+}  // namespace twilight::http
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include "crypto/ed25519.h"
+#include "http/server.h"
+#include "json/parser.h"
+
+namespace twilight::interactions
+{
+enum class Type : u8 {
+  Ping = 1,
+  ApplicationCommand = 2,
+  MessageComponent = 3,
+  ApplicationCommandAutocomplete = 4,
+  ModalSubmit = 5,
+};
+
+struct Interaction {
+  const http::Request& request;
+  // the parsed body, only valid during the handler call
+  json::Value data;
+  Type type;
+  // when discord stops waiting for the initial response
+  std::chrono::steady_clock::time_point deadline;
+};
+
+// receives interactions over http (the "interactions endpoint url" of an application) instead of the gateway.
+// every request is checked against the application's public key before anything else looks at it, on the server's
+// handler threads so verification scales with the cores rather than serializing behind the epoll loop. PINGs are
+// answered here.
+//
+// discord gives up on a response after 3 seconds, so requests that waited in the queue past `budget` are answered with
+// 503 without running the handler, a late response would be thrown away anyway and only delay the ones behind it
+class Endpoint
+{
+ public:
+  // returns the interaction response, see response()
+  using Handler = std::function<http::Response(const Interaction&)>;
+
+  struct Options {
+    // the application's public key, as hex
+    std::string publicKey{};
+    std::string path = "/interactions";
+    http::Server::Options server{};
+    // how long after arriving a request may still be handed to the handler
+    std::chrono::milliseconds budget{2500};
+  };
+
+  struct Stats {
+    std::atomic<u64> handled = 0;
+    // bad or missing signature
+    std::atomic<u64> unauthorized = 0;
+    // over budget before the handler ran
+    std::atomic<u64> late = 0;
+    // the handler returned after the deadline
+    std::atomic<u64> overran = 0;
+  };
+
+  // throws if the public key is invalid
+  Endpoint(Options options, Handler handler);
+
+  Endpoint(const Endpoint&) = delete;
+  Endpoint& operator=(const Endpoint&) = delete;
+
+  // throws if the address can't be bound
+  inline void listen() { server.listen(); }
+  inline void close() noexcept { server.close(); }
+  inline u16 port() const noexcept { return server.port(); }
+
+  inline const Stats& stats() const noexcept { return counters; }
+
+  // a 200 with `json` as the interaction response
+  static http::Response response(std::string_view json) noexcept;
+
+ private:
+  Options options;
+  Handler handler;
+  crypto::Verifier verifier;
+  Stats counters;
+  // last, so it stops before anything it calls into goes away
+  http::Server server;
+
+  http::Response handle(const http::Request& req);
+};
+}  // namespace twilight::interactions
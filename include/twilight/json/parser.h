@@ -0,0 +1,162 @@
+#pragma once
+
+#include <expected>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "utils/types.h"
+
+namespace twilight::json
+{
+enum class Type : u8 {
+  Invalid,
+  Null,
+  Bool,
+  Number,
+  String,
+  Array,
+  Object,
+};
+
+class Parser;
+
+// a lazy cursor into a parsed document; nothing is decoded until one of the accessors is called.
+// values borrow both the input buffer and the parser, and are invalidated by the next parse()
+class Value
+{
+ public:
+  class ArrayIterator;
+  class ObjectIterator;
+
+  template <typename It>
+  struct Range {
+    It first, last;
+    It begin() const noexcept { return first; }
+    It end() const noexcept { return last; }
+  };
+
+  Value() = default;
+
+  Type type() const noexcept;
+  inline bool valid() const noexcept { return parser; }
+  inline bool isNull() const noexcept { return type() == Type::Null; }
+
+  // object member lookup, compares against the raw (still escaped) key
+  std::optional<Value> find(std::string_view key) const noexcept;
+  // array element lookup, O(n) in the number of preceding elements
+  std::optional<Value> at(usize index) const noexcept;
+  // number of elements/members, 0 for scalars
+  usize size() const noexcept;
+
+  std::optional<bool> asBool() const noexcept;
+  std::optional<i64> asInt() const noexcept;
+  std::optional<u64> asUint() const noexcept;
+  std::optional<f64> asDouble() const noexcept;
+  // discord serializes snowflakes as strings, but accept plain numbers too
+  std::optional<u64> asSnowflake() const noexcept;
+  // string contents with escape sequences left as-is; doesn't allocate
+  std::optional<std::string_view> asStringView() const noexcept;
+  std::optional<std::string> asString() const noexcept;
+
+  // raw JSON text of this value, including nested containers
+  std::string_view raw() const noexcept;
+
+  Range<ArrayIterator> items() const noexcept;
+  Range<ObjectIterator> fields() const noexcept;
+
+ private:
+  friend class Parser;
+
+  const Parser* parser = nullptr;
+  u32 pos = 0;  // index into the structural index
+
+  Value(const Parser* parser, u32 pos) noexcept : parser(parser), pos(pos) {}
+
+  char head() const noexcept;
+  std::string_view scalar() const noexcept;
+  std::string_view stringAt(u32 at) const noexcept;
+};
+
+class Value::ArrayIterator
+{
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Value;
+  using difference_type = std::ptrdiff_t;
+
+  ArrayIterator() = default;
+
+  Value operator*() const noexcept { return Value{parser, pos}; }
+  ArrayIterator& operator++() noexcept;
+  ArrayIterator operator++(int) noexcept;
+  bool operator==(const ArrayIterator& other) const noexcept { return pos == other.pos; }
+
+ private:
+  friend class Value;
+
+  const Parser* parser = nullptr;
+  u32 pos = 0;
+
+  ArrayIterator(const Parser* parser, u32 pos) noexcept : parser(parser), pos(pos) {}
+};
+
+class Value::ObjectIterator
+{
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::pair<std::string_view, Value>;
+  using difference_type = std::ptrdiff_t;
+
+  ObjectIterator() = default;
+
+  // the key is raw, like Value::asStringView()
+  value_type operator*() const noexcept;
+  ObjectIterator& operator++() noexcept;
+  ObjectIterator operator++(int) noexcept;
+  bool operator==(const ObjectIterator& other) const noexcept { return pos == other.pos; }
+
+ private:
+  friend class Value;
+
+  const Parser* parser = nullptr;
+  u32 pos = 0;  // points at the key
+
+  ObjectIterator(const Parser* parser, u32 pos) noexcept : parser(parser), pos(pos) {}
+};
+
+// simdjson-style two stage parser: stage 1 builds an index of structural characters using SIMD,
+// stage 2 happens on demand as values are accessed. the parser keeps its index buffer between calls,
+// so reusing one instance per connection makes steady-state parsing allocation-free
+class Parser
+{
+ public:
+  Parser() = default;
+
+  Parser(const Parser&) = delete;
+  Parser& operator=(const Parser&) = delete;
+
+  // `json` is not copied and must outlive every Value obtained from this call
+  std::expected<Value, std::string> parse(std::string_view json) noexcept;
+
+ private:
+  friend class Value;
+
+  std::string_view json;
+  std::unique_ptr<u32[]> indices;
+  // for every opening bracket, the position of its matching closing bracket, so skipping a container is O(1)
+  std::unique_ptr<u32[]> closers;
+  usize capacity = 0;
+  u32 count = 0;  // number of structurals, excluding the trailing sentinel
+  std::vector<u32> stack;  // positions of open containers, only used while validating
+
+  bool index() noexcept;
+  std::optional<std::string> validate() noexcept;
+  u32 skip(u32 pos) const noexcept;
+  inline char at(u32 pos) const noexcept { return pos < count ? json[indices[pos]] : '\0'; }
+};
+}  // namespace twilight::json
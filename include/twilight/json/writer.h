@@ -0,0 +1,58 @@
+#pragma once
+
+#include <concepts>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/types.h"
+
+namespace twilight::json
+{
+// streaming serializer; etf::Writer exposes the same interface so payloads can be written once for both encodings
+class Writer
+{
+ public:
+  Writer() = default;
+
+  Writer& beginObject() noexcept;
+  Writer& endObject() noexcept;
+  Writer& beginArray() noexcept;
+  Writer& endArray() noexcept;
+  Writer& key(std::string_view key) noexcept;
+
+  Writer& value(std::nullptr_t) noexcept;
+  Writer& value(bool v) noexcept;
+  Writer& value(f64 v) noexcept;
+  Writer& value(std::string_view v) noexcept;
+  inline Writer& value(const char* v) noexcept { return value(std::string_view{v}); }
+  inline Writer& value(const std::string& v) noexcept { return value(std::string_view{v}); }
+
+  template <std::integral T>
+    requires(!std::same_as<T, bool>)
+  inline Writer& value(T v) noexcept
+  {
+    if constexpr (std::is_signed_v<T>)
+      return integer(static_cast<i64>(v), false);
+    else
+      return integer(static_cast<u64>(v), false);
+  }
+
+  // snowflakes are quoted, discord doesn't accept them as numbers
+  inline Writer& snowflake(u64 id) noexcept { return integer(id, true); }
+
+  inline const std::string& str() const noexcept { return out; }
+  inline std::string take() noexcept { return std::move(out); }
+  void clear() noexcept;
+
+ private:
+  std::string out;
+  // one entry per open container, true once it has at least one element
+  std::vector<bool> nonEmpty;
+  bool afterKey = false;
+
+  void separate() noexcept;
+  Writer& integer(i64 v, bool quoted) noexcept;
+  Writer& integer(u64 v, bool quoted) noexcept;
+};
+}  // namespace twilight::json
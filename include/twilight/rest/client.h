@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "http/client.h"
+#include "route.h"
+#include "utils/metrics.h"
+#include "utils/signal.h"
+
+namespace twilight::rest
+{
+// discord REST client. requests are queued per rate-limit bucket and handed to a small pool of keep-alive
+// connections the moment their bucket (and the global limit) allows, so bulk work runs at exactly the rate discord
+// permits. a single scheduler thread waits for the earliest reset, nothing sleeps per request
+class Client
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    std::string token{};
+    std::string url = "https://discord.com";
+    std::string base = "/api/v10";
+    // concurrent connections, i.e. requests in flight across all buckets
+    usize connections = 4;
+    // requests per second across all routes
+    u32 globalLimit = 50;
+    // how many times a request that got a 429 is queued again before the 429 is returned
+    u8 maxRetries = 3;
+  };
+
+  explicit Client(Options options);
+  // pending requests are abandoned, their futures get a broken promise
+  virtual ~Client();
+
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  std::future<http::Response> request(Route route, http::RequestInit init = {});
+  inline std::future<http::Response> request(http::Method method, std::string path, http::RequestInit init = {})
+  {
+    return request(Route{method, std::move(path)}, std::move(init));
+  }
+
+  // requests waiting for their bucket or a connection
+  usize queued() const noexcept;
+
+  // called on a worker thread after every request that reached discord, with the route and where the time went
+  // once it left the queue. how long requests wait in the queue is recorded as rest_queue_wait_ns
+  Signal<const Route&, const http::Timings&> ontimings;
+
+ protected:
+  // performs one request on connection `worker`, overridable so the scheduler can run against a fake server
+  virtual http::Response perform(usize worker, const std::string& path, http::RequestInit init);
+
+  // must be called by derived classes' destructors when perform() is overridden, so no worker calls into a
+  // half-destroyed object
+  void stop() noexcept;
+
+ private:
+  struct Pending {
+    Route route;
+    http::RequestInit init;
+    std::promise<http::Response> promise;
+    std::string bucket;
+    u8 attempts = 0;
+    metrics::Clock::time_point queuedAt{};
+  };
+
+  struct Bucket {
+    std::deque<Pending> queue;
+    // until discord tells us the limit, one request at a time
+    u32 limit = 1;
+    u32 remaining = 1;
+    u32 inflight = 0;
+    Clock::time_point resetAt{};
+    bool active = false;
+  };
+
+  Options options;
+  std::vector<std::unique_ptr<http::Client>> connections;
+
+  mutable std::mutex mutex;
+  // route key -> bucket hash from X-RateLimit-Bucket
+  std::unordered_map<std::string, std::string> hashes;
+  // "hash:major", or the route key while the hash isn't known
+  std::unordered_map<std::string, Bucket> buckets;
+  // buckets with queued requests
+  std::vector<std::string> active;
+  std::deque<Pending> ready;
+
+  u32 globalRemaining = 0;
+  Clock::time_point globalReset{};
+  Clock::time_point globalBlockedUntil{};
+  Clock::time_point lastSweep{};
+
+  std::condition_variable_any schedulerCv;
+  std::condition_variable_any workerCv;
+  bool wake = false;
+  std::jthread scheduler;
+  std::vector<std::jthread> workers;
+
+  std::string bucketKey(const Route& route) const;
+  void enqueue(Pending p, bool front);
+  void complete(Pending p, http::Response res);
+  void fail(Pending p, std::exception_ptr e);
+
+  void schedule(std::stop_token stop);
+  void work(std::stop_token stop, usize worker);
+};
+}  // namespace twilight::rest
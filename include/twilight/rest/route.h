@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "http/client.h"
+
+namespace twilight::rest
+{
+// one '/'-separated piece of a route template, classified by what it contributes to the bucket key
+struct RouteSegment {
+  enum Role : u8 {
+    Literal,
+    // a parameter limits are kept per (channel, guild, webhook or interaction id and token), kept verbatim
+    Major,
+    // any other parameter, ":id" in the key
+    Id,
+    // the emoji of a reaction route, ":emoji" in the key which ends there
+    Emoji,
+  };
+
+  std::string_view text;
+  Role role;
+  u8 param;
+};
+
+// an endpoint call along with the keys discord rate-limits it by.
+// https://discord.com/developers/docs/topics/rate-limits
+struct Route {
+  http::Method method;
+  // relative to the API base, e.g. "/channels/1234/messages/5678"
+  std::string path;
+  // the path's top-level resource (channel, guild, webhook or interaction), limits are kept per major parameter
+  std::string major;
+  // method and path with every non-major id replaced, identifies the route until discord tells us its bucket
+  std::string key;
+
+  // works the keys out from `path`
+  Route(http::Method method, std::string path);
+  Route(http::Method method, std::string path, std::string major, std::string key) noexcept
+    : method(method), path(std::move(path)), major(std::move(major)), key(std::move(key))
+  {
+  }
+
+  // fills `values` into a template's segments, sizing every string up front
+  static Route build(http::Method method, std::span<const RouteSegment> segments,
+    std::span<const std::string_view> values) noexcept;
+};
+
+template <usize N>
+struct RoutePath {
+  char value[N];
+
+  consteval RoutePath(const char (&path)[N]) noexcept { std::copy_n(path, N, value); }
+  constexpr std::string_view view() const noexcept { return {value, N - 1}; }
+};
+
+template <typename T>
+concept RouteParam = std::unsigned_integral<T> || std::convertible_to<const T&, std::string_view>;
+
+// an endpoint with a path template like "/channels/{channel.id}/messages/{message.id}", where every placeholder is a
+// whole segment. the template is split and classified at compile time, so route() neither parses nor searches: the
+// path and its bucket key come out of one pass over precomputed pieces
+template <http::Method M, RoutePath P>
+class Endpoint
+{
+  static constexpr std::string_view TEMPLATE = P.view();
+
+  static consteval usize count(char c) noexcept { return std::count(TEMPLATE.begin(), TEMPLATE.end(), c); }
+
+ public:
+  static constexpr http::Method METHOD = M;
+  static constexpr usize PARAMS = count('{');
+
+  // integers are ids, strings (tokens, emoji) are percent-encoded where needed
+  template <RouteParam... Args>
+    requires(sizeof...(Args) == PARAMS)
+  static Route route(const Args&... args)
+  {
+    std::array<std::string_view, PARAMS> values;
+    [[maybe_unused]] std::array<std::array<char, 20>, PARAMS> digits;
+    [[maybe_unused]] std::array<std::string, PARAMS> escaped;
+    [[maybe_unused]] usize i = 0;
+    (
+      [&](const auto& arg) {
+        if constexpr (std::unsigned_integral<std::remove_cvref_t<decltype(arg)>>) {
+          auto [end, _] = std::to_chars(digits[i].data(), digits[i].data() + digits[i].size(), arg);
+          values[i] = {digits[i].data(), static_cast<usize>(end - digits[i].data())};
+        } else {
+          values[i] = escape(arg, escaped[i]);
+        }
+        ++i;
+      }(args),
+      ...);
+    return Route::build(M, SEGMENTS, values);
+  }
+
+ private:
+  static consteval std::array<RouteSegment, count('/')> split()
+  {
+    if (TEMPLATE.empty() || TEMPLATE[0] != '/')
+      throw "route templates start with '/'";
+
+    std::array<RouteSegment, count('/')> out{};
+    usize majorSegments = 0;
+    u8 param = 0;
+    std::string_view rest = TEMPLATE.substr(1);
+    for (usize s = 0; s < out.size(); ++s) {
+      usize end = rest.find('/');
+      std::string_view part = rest.substr(0, end);
+      rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+
+      if (s == 0) {
+        if (part == "channels" || part == "guilds")
+          majorSegments = 2;
+        else if (part == "webhooks" || part == "interactions")
+          majorSegments = 3;
+      }
+
+      bool placeholder = part.starts_with('{');
+      if (placeholder != part.ends_with('}') || (placeholder && part.find('{', 1) != std::string_view::npos))
+        throw "placeholders must fill a whole segment";
+      if (!placeholder && part.find_first_of("{}") != std::string_view::npos)
+        throw "placeholders must fill a whole segment";
+
+      out[s].text = part;
+      out[s].param = placeholder ? param++ : 0;
+      if (!placeholder)
+        out[s].role = RouteSegment::Literal;
+      else if (s < majorSegments)
+        out[s].role = RouteSegment::Major;
+      else if (s && out[s - 1].text == "reactions")
+        out[s].role = RouteSegment::Emoji;
+      else
+        out[s].role = RouteSegment::Id;
+    }
+    return out;
+  }
+
+  static constexpr auto SEGMENTS = split();
+
+  static std::string_view escape(std::string_view s, std::string& storage)
+  {
+    constexpr auto plain = [](char c) {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '.' ||
+             c == '_' || c == '~' || c == ':' || c == '@';
+    };
+    if (std::all_of(s.begin(), s.end(), plain))
+      return s;
+    storage = percentEncode(s, ":@");
+    return storage;
+  }
+};
+
+using GetGateway = Endpoint<http::Method::GET, "/gateway/bot">;
+using GetCurrentUser = Endpoint<http::Method::GET, "/users/@me">;
+using GetUser = Endpoint<http::Method::GET, "/users/{user.id}">;
+
+using GetChannel = Endpoint<http::Method::GET, "/channels/{channel.id}">;
+using ModifyChannel = Endpoint<http::Method::PATCH, "/channels/{channel.id}">;
+using DeleteChannel = Endpoint<http::Method::DELETE, "/channels/{channel.id}">;
+using GetChannelMessages = Endpoint<http::Method::GET, "/channels/{channel.id}/messages">;
+using GetChannelMessage = Endpoint<http::Method::GET, "/channels/{channel.id}/messages/{message.id}">;
+using CreateMessage = Endpoint<http::Method::POST, "/channels/{channel.id}/messages">;
+using EditMessage = Endpoint<http::Method::PATCH, "/channels/{channel.id}/messages/{message.id}">;
+using DeleteMessage = Endpoint<http::Method::DELETE, "/channels/{channel.id}/messages/{message.id}">;
+using BulkDeleteMessages = Endpoint<http::Method::POST, "/channels/{channel.id}/messages/bulk-delete">;
+using CreateReaction =
+  Endpoint<http::Method::PUT, "/channels/{channel.id}/messages/{message.id}/reactions/{emoji}/@me">;
+using DeleteOwnReaction =
+  Endpoint<http::Method::DELETE, "/channels/{channel.id}/messages/{message.id}/reactions/{emoji}/@me">;
+using TriggerTypingIndicator = Endpoint<http::Method::POST, "/channels/{channel.id}/typing">;
+
+using GetGuild = Endpoint<http::Method::GET, "/guilds/{guild.id}">;
+using GetGuildRoles = Endpoint<http::Method::GET, "/guilds/{guild.id}/roles">;
+using ListGuildMembers = Endpoint<http::Method::GET, "/guilds/{guild.id}/members">;
+using GetGuildMember = Endpoint<http::Method::GET, "/guilds/{guild.id}/members/{user.id}">;
+using AddGuildMemberRole = Endpoint<http::Method::PUT, "/guilds/{guild.id}/members/{user.id}/roles/{role.id}">;
+using RemoveGuildMemberRole = Endpoint<http::Method::DELETE, "/guilds/{guild.id}/members/{user.id}/roles/{role.id}">;
+
+using CreateInteractionResponse =
+  Endpoint<http::Method::POST, "/interactions/{interaction.id}/{interaction.token}/callback">;
+using EditOriginalInteractionResponse =
+  Endpoint<http::Method::PATCH, "/webhooks/{application.id}/{interaction.token}/messages/@original">;
+using CreateFollowupMessage = Endpoint<http::Method::POST, "/webhooks/{application.id}/{interaction.token}">;
+using ExecuteWebhook = Endpoint<http::Method::POST, "/webhooks/{webhook.id}/{webhook.token}">;
+}  // namespace twilight::rest
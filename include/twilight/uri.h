@@ -1,23 +1,67 @@
 #pragma once
 
+#include <expected>
+#include <optional>
 #include <string>
+#include <string_view>
 
 #include "utils/types.h"
 
 namespace twilight
 {
+// an RFC 3986 URI reference split into its components, all of them views into the parsed string (which must outlive
+// it). components are validated but left percent-encoded, decoding depends on what they're used for
+struct URIView {
+  std::string_view scheme;
+  std::string_view userinfo;
+  // without the brackets of an IPv6 literal
+  std::string_view host;
+  std::optional<u16> port;
+  std::string_view path;
+  std::string_view query;
+  std::string_view fragment;
+  bool hasAuthority = false;
+  bool hasQuery = false;
+  bool hasFragment = false;
+  bool ipLiteral = false;
+
+  static std::expected<URIView, std::string> parse(std::string_view uri) noexcept;
+
+  // path and query, what a request line asks for. an empty path is "/", which the string may not have
+  std::string target() const noexcept;
+  // the explicit port, or the scheme's default (0 if it has none)
+  u16 effectivePort() const noexcept;
+};
+
+// an absolute URI with a host, owning its components
 struct URI {
+  // lowercase
   std::string protocol;
+  std::string userinfo;
   std::string host;
   u16 port;
+  // "/" if the URI has none
   std::string path;
+  std::string query;
+  std::string fragment;
 
   URI() = delete;
-  URI(const char* url) noexcept;
-  URI(std::string url) noexcept;
+  // throws if `url` isn't an absolute URI with a host
+  URI(const char* url);
+  URI(std::string_view url);
+  URI(const std::string& url) : URI(std::string_view{url}) {}
+  explicit URI(const URIView& view) noexcept;
+
+  static std::expected<URI, std::string> parse(std::string_view url) noexcept;
 
   bool isSecure() const noexcept;
+  // path and query, what a request line asks for
+  std::string target() const noexcept;
 
   std::string toString() const noexcept;
 };
+
+// %XX-escapes every byte that isn't unreserved (RFC 3986 section 2.3) or in `keep`
+std::string percentEncode(std::string_view in, std::string_view keep = {}) noexcept;
+std::expected<std::string, std::string> percentDecode(std::string_view in) noexcept;
 }  // namespace twilight
@@ -1,54 +1,50 @@
 #pragma once
 
+#include <array>
+#include <expected>
 #include <string>
+#include <string_view>
 
 #include "types.h"
 
 namespace twilight::base64
 {
-static constexpr const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+enum class Alphabet : u8 {
+  // RFC 4648 section 4, padded
+  Standard,
+  // RFC 4648 section 5, '-' and '_' instead of '+' and '/'. encoded without padding, decoded with or without
+  Url,
+};
+
+constexpr usize encodedSize(usize size, Alphabet alphabet = Alphabet::Standard) noexcept
+{
+  return alphabet == Alphabet::Standard ? (size + 2) / 3 * 4 : size / 3 * 4 + (size % 3 ? size % 3 + 1 : 0);
+}
 
-inline std::string encode(const std::string& input) noexcept
+// the decoded size of `in` if it's valid
+constexpr usize decodedSize(std::string_view in) noexcept
 {
-  std::string ret;
-
-  usize sz = input.size();
-  for (usize i = 0; i < sz; i += 3) {
-    u8 char_array_3[3];
-    u8 char_array_4[4];
-
-    char_array_3[0] = input[i];
-    char_array_3[1] = (i + 1 < sz) ? input[i + 1] : 0;
-    char_array_3[2] = (i + 2 < sz) ? input[i + 2] : 0;
-
-    char_array_4[0] = (char_array_3[0] & 0xFC) >> 2;
-    char_array_4[1] = ((char_array_3[0] & 0x03) << 4) | ((char_array_3[1] & 0xF0) >> 4);
-    char_array_4[2] = ((char_array_3[1] & 0x0F) << 2) | ((char_array_3[2] & 0xC0) >> 6);
-    char_array_4[3] = char_array_3[2] & 0x3F;
-
-    ret += chars[char_array_4[0]];
-    ret += chars[char_array_4[1]];
-    ret += chars[char_array_4[2]];
-    ret += chars[char_array_4[3]];
-  }
-
-  if (sz % 3 == 1) {
-    ret[ret.length() - 2] = '=';
-    ret[ret.length() - 1] = '=';
-  } else if (sz % 3 == 2) {
-    ret[ret.length() - 1] = '=';
-  }
-
-  return ret;
+  usize n = in.size();
+  for (int i = 0; i < 2 && n && in[n - 1] == '='; ++i) --n;
+  return n / 4 * 3 + (n % 4 ? n % 4 - 1 : 0);
 }
 
+// writes exactly encodedSize(size, alphabet) characters to `out`
+void encode(const u8* in, usize size, char* out, Alphabet alphabet = Alphabet::Standard) noexcept;
+std::string encode(std::string_view in, Alphabet alphabet = Alphabet::Standard) noexcept;
+
 template <usize N>
-inline std::string encode(const std::array<u8, N>& input) noexcept
+inline std::string encode(const std::array<u8, N>& in, Alphabet alphabet = Alphabet::Standard) noexcept
 {
-  std::string value(N, '\0');
-  for (usize i = 0; i < N; ++i) {
-    value[i] = input[i];
-  }
-  return encode(value);
+  return encode(std::string_view{reinterpret_cast<const char*>(in.data()), N}, alphabet);
 }
+
+// strict: no whitespace, nothing outside the alphabet, padding only where it belongs and unused bits of the last
+// character zero, so every decodable string has exactly one encoding. writes decodedSize(in) bytes to `out` and
+// returns that count
+std::expected<usize, std::string> decode(std::string_view in, u8* out, Alphabet alphabet = Alphabet::Standard) noexcept;
+std::expected<std::string, std::string> decode(std::string_view in, Alphabet alphabet = Alphabet::Standard) noexcept;
+
+// "data:<mime>;base64,<data>", the form discord takes image uploads (avatars, emojis, stickers) in
+std::string dataUri(std::string_view mime, std::string_view data) noexcept;
 }  // namespace twilight::base64
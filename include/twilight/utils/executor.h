@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+#include "types.h"
+
+namespace twilight
+{
+// pins the calling thread to `cpus`, false if it couldn't be or `cpus` is empty
+bool pinThread(std::span<const u32> cpus) noexcept;
+
+// a work-stealing pool that runs jobs submitted under the same key one at a time, in submission order, and jobs
+// under different keys in parallel. keys hash to a fixed set of strands, serial queues that are only ever scheduled
+// on one worker at a time; a worker runs its own strands and steals others' when it runs out. keys that share a
+// strand are serialized together, which keeps ordering and only costs parallelism.
+//
+// once `capacity` jobs are pending, submit() blocks or drops the job depending on `overflow`. both are counted in
+// metrics::registry() as executor_overflows_total and executor_dropped_total, next to the executor_queued_jobs gauge,
+// executor_steals_total and the time jobs waited in executor_wait_ns
+class Executor
+{
+ public:
+  using Job = std::move_only_function<void()>;
+
+  enum class Overflow : u8 {
+    // the submitter waits for room, pushing back on whatever feeds it
+    Block,
+    // the job is dropped and submit() returns false
+    Drop,
+  };
+
+  struct Options {
+    // 0 picks one per core
+    u32 threads = 0;
+    usize capacity = 65536;
+    Overflow overflow = Overflow::Block;
+    // worker i is pinned to cpus[i % size], unpinned if empty
+    std::vector<u32> cpus{};
+  };
+
+  Executor();
+  explicit Executor(Options options);
+  // runs what's queued, then joins the workers
+  ~Executor();
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  bool submit(u64 key, Job job);
+  // waits until every job submitted so far has run. not to be called from a job
+  void drain() noexcept;
+
+  inline usize queued() const noexcept { return pending.load(std::memory_order_relaxed); }
+  inline u32 threads() const noexcept { return static_cast<u32>(workers.size()); }
+
+ private:
+  static constexpr usize STRANDS = 1024;
+  // jobs a worker runs from one strand before moving it to the back of its queue, so a busy key can't starve others
+  static constexpr usize BATCH = 32;
+
+  struct Task {
+    Job job;
+    metrics::Clock::time_point queued;
+  };
+
+  struct Strand {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    // on a worker's queue or running, cleared once it's found empty
+    bool scheduled = false;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Strand*> strands;
+    std::jthread thread;
+  };
+
+  Options options;
+  std::unique_ptr<Strand[]> strands;
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  // queued or running
+  std::atomic<usize> pending{0};
+  std::atomic<bool> stopping{false};
+
+  // idle workers sleep here until a strand is scheduled
+  std::mutex idleMutex;
+  std::condition_variable idleCv;
+  std::atomic<u32> idle{0};
+  // submitters waiting for room and drain() wait here for jobs to finish
+  std::mutex doneMutex;
+  std::condition_variable doneCv;
+  std::atomic<u32> waiting{0};
+
+  void schedule(Strand& strand, usize home);
+  Strand* take(usize self) noexcept;
+  void run(usize self);
+  void runStrand(Strand& strand, usize self);
+};
+}  // namespace twilight
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+
+#include "types.h"
+
+namespace twilight
+{
+namespace metrics
+{
+class AtomicHistogram;
+}
+
+// log-linear histogram of u64 samples (e.g. latencies in ns): every power of two is split in 2^SUB_BITS buckets, so
+// any recorded value is reported within ~3% and recording is a couple of shifts
+class Histogram
+{
+ public:
+  static constexpr u32 SUB_BITS = 5;
+  static constexpr usize BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+  inline void record(u64 v) noexcept
+  {
+    ++buckets[index(v)];
+    ++n;
+    sum += v;
+    lo = std::min(lo, v);
+    hi = std::max(hi, v);
+  }
+
+  inline void merge(const Histogram& other) noexcept
+  {
+    for (usize i = 0; i < BUCKETS; ++i) buckets[i] += other.buckets[i];
+    n += other.n;
+    sum += other.sum;
+    lo = std::min(lo, other.lo);
+    hi = std::max(hi, other.hi);
+  }
+
+  inline void clear() noexcept { *this = Histogram{}; }
+
+  inline u64 count() const noexcept { return n; }
+  inline u64 min() const noexcept { return n ? lo : 0; }
+  inline u64 max() const noexcept { return hi; }
+  inline u64 total() const noexcept { return sum; }
+  inline f64 mean() const noexcept { return n ? static_cast<f64>(sum) / n : 0; }
+
+  // the value below which `p` (0..1) of the samples fall
+  u64 percentile(f64 p) const noexcept
+  {
+    if (!n)
+      return 0;
+    u64 rank = std::max<u64>(1, static_cast<u64>(p * n + 0.5));
+    u64 seen = 0;
+    for (usize i = 0; i < BUCKETS; ++i) {
+      seen += buckets[i];
+      // a snapshot taken while a first sample is recorded can count it before its extremes are set
+      if (seen >= rank)
+        return lo <= hi ? std::clamp(upper(i), lo, hi) : upper(i);
+    }
+    return hi;
+  }
+
+ private:
+  friend class metrics::AtomicHistogram;
+
+  std::array<u64, BUCKETS> buckets{};
+  u64 n = 0;
+  u64 sum = 0;
+  u64 lo = std::numeric_limits<u64>::max();
+  u64 hi = 0;
+
+  static inline usize index(u64 v) noexcept
+  {
+    if (v < (1ull << SUB_BITS))
+      return v;
+    u32 exp = std::bit_width(v) - 1;
+    u64 sub = (v >> (exp - SUB_BITS)) & ((1ull << SUB_BITS) - 1);
+    return ((exp - SUB_BITS + 1) << SUB_BITS) + sub;
+  }
+
+  // largest value that lands in bucket `i`
+  static inline u64 upper(usize i) noexcept
+  {
+    if (i < (1ull << SUB_BITS))
+      return i;
+    u32 exp = (i >> SUB_BITS) + SUB_BITS - 1;
+    u64 sub = i & ((1ull << SUB_BITS) - 1);
+    u64 base = ((1ull << SUB_BITS) + sub) << (exp - SUB_BITS);
+    return base + ((1ull << (exp - SUB_BITS)) - 1);
+  }
+};
+}  // namespace twilight
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "histogram.h"
+#include "types.h"
+
+// building with TWILIGHT_METRICS=0 turns every recording call into a no-op and skips the clock reads behind them
+#ifndef TWILIGHT_METRICS
+#define TWILIGHT_METRICS 1
+#endif
+
+namespace twilight::metrics
+{
+inline constexpr bool ENABLED = TWILIGHT_METRICS;
+
+using Clock = std::chrono::steady_clock;
+
+// the current time, or the epoch when metrics are compiled out, so spans measured with it cost nothing
+inline Clock::time_point now() noexcept
+{
+  if constexpr (ENABLED)
+    return Clock::now();
+  else
+    return {};
+}
+
+inline u64 nanos(Clock::duration d) noexcept
+{
+  return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
+// all metrics are relaxed atomics: recording never takes a lock, readers see each value on its own but not a
+// consistent view across values
+class Counter
+{
+ public:
+  inline void add(u64 n = 1) noexcept
+  {
+    if constexpr (ENABLED)
+      v.fetch_add(n, std::memory_order_relaxed);
+  }
+  inline u64 value() const noexcept { return v.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<u64> v{0};
+};
+
+class Gauge
+{
+ public:
+  inline void set(i64 n) noexcept
+  {
+    if constexpr (ENABLED)
+      v.store(n, std::memory_order_relaxed);
+  }
+  inline void add(i64 n) noexcept
+  {
+    if constexpr (ENABLED)
+      v.fetch_add(n, std::memory_order_relaxed);
+  }
+  inline i64 value() const noexcept { return v.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<i64> v{0};
+};
+
+// Histogram with atomic buckets, for samples recorded from several threads. snapshot() for percentiles
+class AtomicHistogram
+{
+ public:
+  inline void record(u64 v) noexcept
+  {
+    if constexpr (ENABLED) {
+      buckets[Histogram::index(v)].fetch_add(1, std::memory_order_relaxed);
+      n.fetch_add(1, std::memory_order_relaxed);
+      sum.fetch_add(v, std::memory_order_relaxed);
+      // new extremes are rare, the loads are what usually runs
+      for (u64 cur = lo.load(std::memory_order_relaxed); v < cur;)
+        if (lo.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+          break;
+      for (u64 cur = hi.load(std::memory_order_relaxed); v > cur;)
+        if (hi.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+          break;
+    }
+  }
+  inline void record(Clock::duration d) noexcept { record(nanos(d)); }
+
+  inline u64 count() const noexcept { return n.load(std::memory_order_relaxed); }
+
+  Histogram snapshot() const noexcept;
+
+ private:
+  std::array<std::atomic<u64>, Histogram::BUCKETS> buckets{};
+  std::atomic<u64> n{0};
+  std::atomic<u64> sum{0};
+  std::atomic<u64> lo{std::numeric_limits<u64>::max()};
+  std::atomic<u64> hi{0};
+};
+
+// named metrics, created on first use. lookups take a lock, so callers keep the returned reference (it stays valid
+// for the registry's lifetime) and record through it. names follow prometheus conventions, e.g. http_ttfb_ns, and
+// looking a name up as another kind of metric than it was created as throws
+class Registry
+{
+ public:
+  using Metric = std::variant<const Counter*, const Gauge*, const AtomicHistogram*>;
+
+  Counter& counter(std::string_view name);
+  Gauge& gauge(std::string_view name);
+  AtomicHistogram& histogram(std::string_view name);
+
+  // calls `f(name, metric)` for every metric, sorted by name. for exporting to other telemetry
+  void forEach(const std::function<void(std::string_view, Metric)>& f) const;
+  // prometheus text exposition format, histograms as summaries
+  std::string toString() const;
+
+ private:
+  using Entry = std::variant<std::unique_ptr<Counter>, std::unique_ptr<Gauge>, std::unique_ptr<AtomicHistogram>>;
+
+  mutable std::mutex mutex;
+  std::map<std::string, Entry, std::less<>> metrics;
+
+  template <typename T>
+  T& get(std::string_view name);
+};
+
+// the registry the library records into
+Registry& registry() noexcept;
+
+// a struct of references into registry(), e.g. `Counter& sent = registry().counter("x_sent_total");`. it's built on
+// first use, so only that first call pays for the lookups
+template <typename Set>
+Set& cached()
+{
+  static Set set;
+  return set;
+}
+}  // namespace twilight::metrics
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <memory_resource>
+
+#include "types.h"
+
+namespace twilight
+{
+// power-of-two size classes for I/O buffers (payloads, bodies, header nodes), from 64 B up to 1 MiB. freed blocks go
+// to a free list in the freeing thread's cache and are handed out again from there, so a buffer that's allocated and
+// dropped for every message stops reaching malloc once traffic is steady. each thread caches at most CACHE bytes
+// per class (and at least two blocks), bigger requests and over-aligned ones go straight to the heap.
+//
+// blocks are plain heap blocks of their class size, any thread may free them and all pools are interchangeable
+class BufferPool : public std::pmr::memory_resource
+{
+ public:
+  static constexpr usize MIN_BITS = 6;
+  static constexpr usize MAX_BITS = 20;
+  static constexpr usize CLASSES = MAX_BITS - MIN_BITS + 1;
+  static constexpr usize MAX = usize(1) << MAX_BITS;
+  static constexpr usize CACHE = 512 * 1024;
+
+  // the size of the block a request for `bytes` gets, `bytes` itself above MAX
+  static constexpr usize blockSize(usize bytes) noexcept
+  {
+    return bytes > MAX ? bytes : usize(1) << (sizeClass(bytes) + MIN_BITS);
+  }
+
+  // blocks in the calling thread's cache, for all classes
+  static usize cached() noexcept;
+  // frees the calling thread's cache
+  static void trim() noexcept;
+
+ private:
+  void* do_allocate(usize bytes, usize align) override;
+  void do_deallocate(void* p, usize bytes, usize align) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+  static constexpr usize sizeClass(usize bytes) noexcept
+  {
+    return bytes <= (usize(1) << MIN_BITS) ? 0 : std::bit_width(bytes - 1) - MIN_BITS;
+  }
+};
+
+// the process-wide pool
+BufferPool& bufferPool() noexcept;
+
+// bump allocator for everything built while one message is handled, reset() once it has been. chunks come from
+// `upstream`; a reset rewinds to the first chunk, and if the message needed more than one, they're replaced by a
+// single chunk as big as all of them (up to BufferPool::MAX), so a connection settles on one chunk that fits its
+// usual messages. deallocation does nothing, memory is only reclaimed by reset(). not thread-safe
+class MessageArena : public std::pmr::memory_resource
+{
+ public:
+  explicit MessageArena(std::pmr::memory_resource* upstream = &bufferPool(), usize initial = 4096) noexcept;
+  ~MessageArena();
+
+  MessageArena(const MessageArena&) = delete;
+  MessageArena& operator=(const MessageArena&) = delete;
+
+  // invalidates everything allocated since the last reset
+  void reset() noexcept;
+
+  // bytes handed out since the last reset
+  inline usize used() const noexcept { return usedBytes + (cur - begin); }
+  // bytes held from upstream
+  inline usize capacity() const noexcept { return reserved; }
+
+ private:
+  struct Chunk {
+    Chunk* next;
+    usize size;
+  };
+
+  std::pmr::memory_resource* upstream;
+  Chunk* chunks = nullptr;  // newest first
+  char* begin = nullptr;    // of the newest chunk's usable space
+  char* cur = nullptr;
+  char* end = nullptr;
+  usize usedBytes = 0;  // in chunks before the newest one
+  usize reserved = 0;
+  usize next;  // size of the next chunk
+
+  void* do_allocate(usize bytes, usize align) override;
+  inline void do_deallocate(void*, usize, usize) override {}
+  inline bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+  void* grow(usize bytes, usize align);
+  void release() noexcept;
+};
+}  // namespace twilight
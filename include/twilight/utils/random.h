@@ -1,26 +1,30 @@
 #pragma once
 
 #include <array>
-#include <random>
+#include <cstring>
+#include <type_traits>
 
 #include "types.h"
 
 namespace twilight
 {
+// bytes from a per-thread chacha20 keystream keyed from getrandom(), so any thread can call it without locking.
+// the keystream is generated several blocks at a time and handed out from a buffer, filling many bytes in one call
+// (e.g. the masks for a batch of frames) costs little more than a memcpy
+void randomBytes(u8* out, usize size) noexcept;
+// bytes straight from the kernel, for anything that has to stay unpredictable even if the process state leaks
+void secureRandomBytes(u8* out, usize size) noexcept;
+
 template <typename T, usize N = 1>
 inline std::conditional_t<N == 1, T, std::array<T, N>> rand() noexcept
 {
   static_assert(std::is_integral_v<T>, "T must be an integral type");
 
-  static std::mt19937 rng(std::random_device{}());
-  static std::uniform_int_distribution<T> dist(std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
-
-  if constexpr (N == 1) {
-    return dist(rng);
-  } else {
-    std::array<T, N> arr{};
-    for (T& x : arr) x = dist(rng);
+  std::array<T, N> arr;
+  randomBytes(reinterpret_cast<u8*>(arr.data()), sizeof(arr));
+  if constexpr (N == 1)
+    return arr[0];
+  else
     return arr;
-  }
 }
 }  // namespace twilight
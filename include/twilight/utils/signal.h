@@ -0,0 +1,37 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace twilight
+{
+template <typename... Args>
+class Signal
+{
+ public:
+  using Callback = std::function<void(Args...)>;
+
+  inline void operator()(Args... args) noexcept
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& cb : callbacks) cb(std::forward<Args>(args)...);
+  }
+
+  inline void operator=(const Callback& cb) noexcept
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    callbacks.push_back(std::move(cb));
+  }
+
+  inline bool empty() noexcept
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return callbacks.empty();
+  }
+
+ protected:
+  std::vector<Callback> callbacks;
+  std::mutex mutex;
+};
+}  // namespace twilight
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <linux/io_uring.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "types.h"
+
+namespace twilight
+{
+// a connected socket driven through io_uring instead of recv/send syscalls. one multishot recv fills a ring of
+// kernel-provided buffers for as long as the connection lives, so a busy connection costs one io_uring_enter per batch
+// of completions rather than one recv per chunk. sends are copied, coalesced while one is in flight and never waited
+// for, a failed send shows up on a later call.
+//
+// one thread receives at a time and any thread may send. completions are only processed while receiving, so sends
+// need a receiver to make progress, the way an http or websocket client always has one
+class UringSocket
+{
+ public:
+  // registers `fd`, which the caller keeps owning. throws if the ring can't be set up
+  explicit UringSocket(int fd);
+  ~UringSocket();
+
+  UringSocket(const UringSocket&) = delete;
+  UringSocket& operator=(const UringSocket&) = delete;
+
+  // same results as on a blocking socket: 0 once the peer closed, -1 on errors
+  isize recv(char* buf, usize len) noexcept;
+  // with `defer` the send is only submitted by the next recv, in the same syscall as its wait. for requests whose
+  // response is read right after
+  isize send(const char* buf, usize len, bool defer = false) noexcept;
+
+  // io_uring_enter calls so far, what replaces recv and send
+  inline u64 enters() const noexcept { return entered.load(std::memory_order_relaxed); }
+
+  // whether the kernel has multishot recv and provided buffer rings (Linux 6.0), checked once
+  static bool supported() noexcept;
+
+ private:
+  static constexpr u32 ENTRIES = 64;
+  static constexpr u16 BUFFERS = 16;
+  static constexpr usize BUFFER_SIZE = 16384;
+
+  int ring = -1;
+  // the mmapped submission and completion rings, shared when the kernel allows it
+  void* sqMap = nullptr;
+  usize sqMapSize = 0;
+  void* cqMap = nullptr;
+  usize cqMapSize = 0;
+  io_uring_sqe* sqes = nullptr;
+  u32* sqHead;
+  u32* sqTail;
+  u32* sqMask;
+  u32* sqArray;
+  u32* cqHead;
+  u32* cqTail;
+  u32* cqMask;
+  io_uring_cqe* cqes;
+
+  // provided buffers, handed back to the kernel once read
+  io_uring_buf_ring* bufRing = nullptr;
+  std::unique_ptr<char[]> buffers;
+  u16 bufTail = 0;
+
+  // guards the submission ring and the send state, and the receive state against concurrent receivers
+  std::mutex mutex;
+  // queued but not submitted yet
+  u32 unsubmitted = 0;
+
+  // the buffer being read from, -1 if none
+  i32 current = -1;
+  usize offset = 0;
+  usize length = 0;
+  bool armed = false;
+  bool eof = false;
+  bool failed = false;
+
+  // the send in flight and what's been sent since
+  std::string inflight;
+  usize inflightSent = 0;
+  std::string outbox;
+  bool sending = false;
+
+  std::atomic<u64> entered{0};
+
+  // a zeroed entry at the tail of the submission ring, queued by push() once filled in. null if the ring is full
+  io_uring_sqe* next() noexcept;
+  void push() noexcept;
+  void arm() noexcept;
+  // starts sending the outbox
+  void issueSend() noexcept;
+  // (re)submits what's left of the send in flight
+  void submitSend() noexcept;
+  void recycle(u16 id) noexcept;
+  // processes completions until one brings received data, false if none did
+  bool reap() noexcept;
+  int enter(u32 submit, u32 wait) noexcept;
+  void release() noexcept;
+};
+}  // namespace twilight
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "engine.h"
+#include "json/parser.h"
+#include "json/writer.h"
+#include "transport.h"
+#include "utils/signal.h"
+#include "ws/client.h"
+
+namespace twilight::voice
+{
+// voice gateway opcodes, https://discord.com/developers/docs/topics/opcodes-and-status-codes#voice
+enum class Opcode : u8 {
+  Identify = 0,
+  SelectProtocol = 1,
+  Ready = 2,
+  Heartbeat = 3,
+  SessionDescription = 4,
+  Speaking = 5,
+  HeartbeatAck = 6,
+  Resume = 7,
+  Hello = 8,
+  Resumed = 9,
+  ClientsConnect = 11,
+  ClientDisconnect = 13,
+};
+
+// a connection to a guild's voice server: the voice gateway (version 8) over a ws::Client, and a Transport for the
+// media, paced and read by an Engine shared with any number of other connections.
+//
+// it's made from what the main gateway sends after Shard::updateVoiceState(): the endpoint and token of
+// VOICE_SERVER_UPDATE and the session id of the bot's own VOICE_STATE_UPDATE. frames passed to play() go out one per
+// 20 ms, with speaking turned on before the first and off after the silence that follows the last. what others say
+// comes out of onaudio in order, one frame per speaker per 20 ms, after a jitter buffer.
+//
+// end-to-end encryption (DAVE) isn't negotiated, the connection only works where discord still accepts that. a
+// closed connection isn't resumed, onclose says it's time to make a new one. close() may be called from any signal and
+// connect() from any but onaudio, which would block the timer thread on the handshake. the connection must not be
+// destroyed from them, its destructor waits for them to return
+class Connection
+{
+ public:
+  struct Options {
+    // from VOICE_SERVER_UPDATE, host[:port]. a full url, e.g. ws:// to a local stand-in, is used as it is
+    std::string endpoint;
+    std::string token;
+    // from the bot's own VOICE_STATE_UPDATE
+    std::string sessionId;
+    u64 guild = 0;
+    u64 user = 0;
+    // for the gateway handshake and ip discovery each
+    std::chrono::milliseconds timeout{10000};
+    u16 jitterDepth = 3;
+    // frames play() queues at most, a second's worth
+    usize queue = 50;
+  };
+
+  // `engine` must outlive the connection
+  Connection(Engine& engine, Options options);
+  ~Connection();
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  // identifies, discovers the external address and selects the protocol, returning once packets can flow. throws if
+  // any of it fails or takes too long
+  void connect();
+  void close() noexcept;
+
+  // queues one 20 ms opus frame, false if the queue is full or the frame too large to send
+  bool play(std::span<const u8> frame);
+  usize queued() const noexcept;
+
+  // a speaker's frames on the engine's timer thread, an empty one for a packet that never came so the decoder can
+  // conceal it. the frame is only valid during the call
+  Signal<u32, std::span<const u8>> onaudio;
+  // a user started or stopped speaking, and the ssrc their frames come with
+  Signal<u64, u32, bool> onspeaking;
+  Signal<u64> ondisconnect;
+  // the gateway connection closed without close() being called
+  Signal<> onclose;
+
+  inline u32 ssrc() const noexcept { return own; }
+  // the user behind `ssrc`, once they spoke
+  std::optional<u64> user(u32 ssrc) const;
+  inline const Transport* transport() const noexcept { return udp.get(); }
+  // round trip of the last acknowledged heartbeat, zero before the first
+  inline std::chrono::nanoseconds latency() const noexcept
+  {
+    return std::chrono::nanoseconds{rtt.load(std::memory_order_relaxed)};
+  }
+
+ private:
+  // silence frames sent after the last one
+  static constexpr u32 TRAILING_SILENCE = 5;
+
+  Engine& engine;
+  Options options;
+  std::unique_ptr<ws::Client> ws;
+  // a closed client whose listener is still running the signal that closed it
+  std::unique_ptr<ws::Client> retired;
+  std::unique_ptr<Transport> udp;
+  // only used by the ws listener
+  json::Parser parser;
+  std::atomic<bool> closing{false};
+  // the ws listener's thread, which signals other than onaudio run on
+  std::atomic<std::thread::id> listener{};
+  // the engine's timer thread, which tick() and onaudio run on
+  std::atomic<std::thread::id> ticker{};
+
+  // what the handshake learned, guarded by mutex
+  mutable std::mutex mutex;
+  std::condition_variable cv;
+  std::atomic<u32> own{0};
+  std::string ip;
+  u16 port = 0;
+  std::optional<Cipher::Key> key;
+  std::unordered_map<u32, u64> users;
+  // speakers that left, whose buffers the timer thread drops
+  std::vector<u32> departed;
+  std::atomic<u64> seqAck{0};
+
+  // guarded by mutex
+  Engine::Timer heartbeatTimer = 0;
+  Engine::Timer tickTimer = 0;
+  // the nonce of the heartbeat in flight, 0 once acknowledged
+  std::atomic<u64> heartbeatNonce{0};
+  std::atomic<i64> rtt{0};
+
+  mutable std::mutex queueMutex;
+  std::deque<std::string> frames;
+  // only touched on the timer thread
+  std::vector<std::string> sending;
+  bool speaking = false;
+  u32 silence = 0;
+  // tick() is in the transport's playout, and close() was called from it
+  bool playing = false;
+  bool releasing = false;
+
+  // `data` writes the `d` field
+  template <typename F>
+  bool send(Opcode op, F&& data) const
+  {
+    json::Writer w;
+    w.beginObject().key("op").value(static_cast<u8>(op)).key("d");
+    data(w);
+    w.endObject();
+    return ws && ws->send(ws::Opcode::Text, w.str());
+  }
+  void open();
+  void handle(const ws::Frame& frame);
+  void identify();
+  void heartbeat();
+  void setSpeaking(bool on);
+  // sends and plays out `ticks` frames' worth
+  void tick(u32 ticks);
+};
+}  // namespace twilight::voice
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/metrics.h"
+#include "utils/types.h"
+
+namespace twilight::voice
+{
+// the threads every voice connection of a process shares, so hundreds of them cost two threads rather than hundreds:
+//
+// - a timer thread running a hashed wheel of 1 ms slots. it sleeps until the first timer due in the next occupied
+//   slot (with the thread's timer slack down to 1 us) and runs what's due, which is what paces every stream's 20 ms
+//   frames. how late timers run is recorded in metrics::registry() as voice_timer_lateness_ns
+// - a receive thread waiting on every connection's UDP socket with one epoll, each readable socket then read in a
+//   batch by its callback
+//
+// callbacks run on those threads and should be quick: a slow one delays everything behind it
+class Engine
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Timer = u64;
+  // periods elapsed since the last run, more than 1 when running late
+  using Tick = std::function<void(u32 ticks)>;
+
+  struct Options {
+    // both threads are pinned to these cpus if set
+    std::vector<u32> cpus{};
+  };
+
+  Engine();
+  explicit Engine(Options options);
+  ~Engine();
+
+  Engine(const Engine&) = delete;
+  Engine& operator=(const Engine&) = delete;
+
+  // runs `f` every `period` from `first` on, until cancelled. runs that fall behind are merged into one rather than
+  // made up for, `f` is told how many periods it covers
+  Timer every(Clock::duration period, Tick f, Clock::time_point first = Clock::now());
+  // once it returns `f` isn't running and won't run again. may be called from `f`
+  void cancel(Timer timer) noexcept;
+
+  // calls `f` on the receive thread whenever `fd` is readable, until unwatched. throws if epoll refuses `fd`
+  void watch(int fd, std::function<void()> f);
+  // once it returns `f` isn't running and won't run again. may be called from `f`
+  void unwatch(int fd) noexcept;
+
+  inline usize timers() const noexcept
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+  }
+
+ private:
+  static constexpr Clock::duration TICK = std::chrono::milliseconds{1};
+  static constexpr usize SLOTS = 64;
+
+  struct Entry {
+    Clock::time_point due;
+    Clock::duration period;
+    Tick f;
+    usize slot = 0;
+  };
+
+  Options options;
+
+  // the wheel. slots[i] holds the timers due in ticks where tick % SLOTS == i, this turn of the wheel or a later one
+  mutable std::mutex mutex;
+  std::condition_variable_any wake;
+  std::unordered_map<Timer, Entry> entries;
+  std::array<std::vector<Timer>, SLOTS> slots;
+  Timer nextTimer = 1;
+  Clock::time_point epoch;
+  // the first tick the timer thread hasn't looked at in full
+  u64 cursor = 0;
+  bool changed = false;
+  // held while timers run, so cancel() can wait them out
+  std::mutex running;
+
+  int epoll = -1;
+  // wakes the receive thread to stop
+  int event = -1;
+  std::mutex watchMutex;
+  // shared with the receive thread while it runs them
+  std::unordered_map<int, std::shared_ptr<std::function<void()>>> watches;
+  // held while callbacks run, so unwatch() can wait them out
+  std::mutex receiving;
+
+  std::jthread timerThread;
+  std::jthread receiveThread;
+
+  // the tick `t` falls in
+  inline u64 tickOf(Clock::time_point t) const noexcept
+  {
+    return t <= epoch ? 0 : static_cast<u64>((t - epoch) / TICK);
+  }
+  // the mutex must be held
+  void schedule(Timer timer, Clock::time_point due);
+  void runTimers(std::stop_token stop);
+  void runReceive(std::stop_token stop);
+};
+}  // namespace twilight::voice
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <string>
+
+#include "utils/types.h"
+
+namespace twilight::voice
+{
+// puts one speaker's frames back in order and plays them out at a steady pace, `depth` frames behind the first one
+// of each talk spurt, which absorbs that much jitter. a frame arriving after its turn is dropped, a missing one played
+// out as a loss so the decoder can conceal it. once nothing is left the speaker stopped talking (discord sends
+// nothing during silence), and the next frame starts buffering again. not thread-safe
+class JitterBuffer
+{
+ public:
+  static constexpr usize SLOTS = 64;
+
+  enum class Pop : u8 {
+    // nothing to play, before a talk spurt has `depth` frames or after it ended
+    Buffering,
+    Frame,
+    // the frame in turn never arrived
+    Lost,
+  };
+
+  struct Stats {
+    u64 played = 0;
+    u64 lost = 0;
+    u64 late = 0;
+    u64 duplicates = 0;
+  };
+
+  explicit JitterBuffer(u16 depth = 3) noexcept;
+
+  // false if the frame was dropped, late or a duplicate
+  bool push(u16 sequence, std::span<const u8> frame);
+  // the frame in turn, copied to `out`
+  Pop pop(std::string& out);
+
+  inline usize buffered() const noexcept { return count; }
+  inline const Stats& stats() const noexcept { return counters; }
+
+ private:
+  struct Slot {
+    std::string frame;
+    u16 sequence = 0;
+    bool filled = false;
+  };
+
+  u16 depth;
+  // the next sequence to play, once playing
+  u16 next = 0;
+  bool playing = false;
+  usize count = 0;
+  std::array<Slot, SLOTS> slots;
+  Stats counters;
+
+  void reset() noexcept;
+};
+}  // namespace twilight::voice
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <span>
+#include <string>
+
+#include "utils/types.h"
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+namespace twilight::voice
+{
+// https://discord.com/developers/docs/topics/voice-connections#transport-encryption-and-sending-voice
+// opus at 48 kHz, one 20 ms frame per packet
+inline constexpr std::chrono::milliseconds FRAME{20};
+inline constexpr u32 FRAME_SAMPLES = 960;
+inline constexpr u8 PAYLOAD_TYPE = 0x78;
+inline constexpr usize HEADER_SIZE = 12;
+inline constexpr usize TAG_SIZE = 16;
+// the counter the nonce is made from, sent after the tag
+inline constexpr usize NONCE_SIZE = 4;
+// what sealing adds to a frame
+inline constexpr usize OVERHEAD = HEADER_SIZE + TAG_SIZE + NONCE_SIZE;
+// the largest packet sent or received, well under any path's MTU
+inline constexpr usize MAX_PACKET = 1400;
+inline constexpr usize MAX_FRAME = MAX_PACKET - OVERHEAD;
+// an opus frame of silence. five go out after the last frame of a stream so decoders fade out instead of cutting off
+inline constexpr std::array<u8, 3> SILENCE{0xF8, 0xFF, 0xFE};
+// the only mode sealed here, the one discord prefers among those it still accepts
+inline constexpr const char* MODE = "aead_aes256_gcm_rtpsize";
+
+struct RtpHeader {
+  u16 sequence;
+  u32 timestamp;
+  u32 ssrc;
+};
+
+// an opened packet, `frame` points into the buffer it was opened in
+struct Packet {
+  RtpHeader header;
+  std::span<const u8> frame;
+};
+
+// seals and opens packets in the aead_aes256_gcm_rtpsize mode: the rtp header (with an extension's 4 byte preamble,
+// if any) is authenticated in the clear, the rest encrypted, and the tag follows along with the big-endian counter
+// the nonce is made from. seal() and open() each keep their own context, so they may run on different threads, but
+// each on one at a time
+class Cipher
+{
+ public:
+  using Key = std::array<u8, 32>;
+
+  // throws if openssl can't set the key up
+  explicit Cipher(const Key& key);
+  ~Cipher();
+
+  Cipher(const Cipher&) = delete;
+  Cipher& operator=(const Cipher&) = delete;
+
+  // writes the packet carrying `frame` to `out`, which must hold frame.size() + OVERHEAD bytes, and returns its size.
+  // 0 if openssl failed
+  usize seal(const RtpHeader& header, std::span<const u8> frame, u8* out) noexcept;
+  // decrypts `packet` in place, null if it isn't a voice packet or doesn't authenticate
+  std::optional<Packet> open(std::span<u8> packet) noexcept;
+
+ private:
+  EVP_CIPHER_CTX* sealer = nullptr;
+  EVP_CIPHER_CTX* opener = nullptr;
+  u32 nonce = 0;
+};
+
+// https://discord.com/developers/docs/topics/voice-connections#ip-discovery
+inline constexpr usize DISCOVERY_SIZE = 74;
+
+struct Address {
+  std::string ip;
+  u16 port;
+};
+
+std::array<u8, DISCOVERY_SIZE> discoveryRequest(u32 ssrc) noexcept;
+// the address the voice server sees us at, null unless `packet` is the response for `ssrc`
+std::optional<Address> discoveryResponse(std::span<const u8> packet, u32 ssrc) noexcept;
+}  // namespace twilight::voice
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <expected>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+
+#include "jitter.h"
+#include "rtp.h"
+#include "utils/metrics.h"
+
+namespace twilight::voice
+{
+// a voice connection's UDP socket. once ip discovery told the voice server where to send, frames are sealed and sent
+// as consecutive packets with one sendmmsg, and what arrives is read with recvmmsg, opened and put in a jitter buffer
+// per speaker to be played out from there.
+//
+// send() and skip() run on one thread, receive() on another, playout() and forget() on any. the totals over every
+// transport are in metrics::registry() as voice_*_total
+class Transport
+{
+ public:
+  // packets per sendmmsg or recvmmsg
+  static constexpr usize BATCH = 32;
+
+  struct Stats {
+    metrics::Counter packetsOut;
+    metrics::Counter packetsIn;
+    metrics::Counter bytesOut;
+    metrics::Counter bytesIn;
+    // not voice, or didn't authenticate
+    metrics::Counter rejected;
+  };
+
+  // a socket connected to the voice server at `ip`:`port`, for the stream `ssrc`. throws if it can't be made
+  Transport(const std::string& ip, u16 port, u32 ssrc, u16 jitterDepth = 3);
+  ~Transport();
+
+  Transport(const Transport&) = delete;
+  Transport& operator=(const Transport&) = delete;
+
+  // asks the server where it sees us from, sending again every 250 ms until it answers or `timeout` runs out. blocks,
+  // so it's done before the socket is handed to an Engine
+  std::expected<Address, std::string> discover(std::chrono::milliseconds timeout);
+  // from the session description, before anything is sent or received
+  void setKey(const Cipher::Key& key);
+
+  // seals `frames` as the stream's next packets, 20 ms apart, and sends them in batches. returns how many went out,
+  // frames that didn't are dropped rather than retried
+  usize send(std::span<const std::span<const u8>> frames) noexcept;
+  // moves the stream's timestamp `frames` ahead without sending, for time spent silent
+  inline void skip(u32 frames) noexcept { timestamp += frames * FRAME_SAMPLES; }
+  // reads a batch of whatever is waiting, returns how many packets that was
+  usize receive() noexcept;
+  // calls `f(ssrc, pop, frame)` once for every speaker with a frame or a loss to play, in ssrc order
+  template <typename F>
+  void playout(F&& f)
+  {
+    std::lock_guard<std::mutex> lock(speakersMutex);
+    for (auto& [ssrc, jitter] : speakers) {
+      auto pop = jitter.pop(scratch);
+      if (pop != JitterBuffer::Pop::Buffering)
+        f(ssrc, pop, std::span<const u8>{reinterpret_cast<const u8*>(scratch.data()), scratch.size()});
+    }
+  }
+  // drops a speaker's buffer, e.g. once they left
+  void forget(u32 ssrc);
+
+  inline int fd() const noexcept { return sock; }
+  inline u32 ssrc() const noexcept { return own; }
+  inline const Stats& stats() const noexcept { return counters; }
+
+ private:
+  int sock = -1;
+  u32 own;
+  u16 sequence;
+  u32 timestamp;
+  u16 depth;
+  std::unique_ptr<Cipher> cipher;
+  mutable Stats counters;
+
+  std::mutex speakersMutex;
+  // ordered, so every playout goes round the speakers the same way
+  std::map<u32, JitterBuffer> speakers;
+  std::string scratch;
+};
+}  // namespace twilight::voice
@@ -1,49 +1,44 @@
 #pragma once
 
-#include <functional>
 #include <future>
+#include <mutex>
+#include <optional>
 
 #include "frame.h"
 #include "http/client.h"
 #include "uri.h"
+#include "utils/pool.h"
+#include "utils/signal.h"
 
 namespace twilight::ws
 {
 class Client : protected http::Client
 {
- private:
-  template <typename... Args>
-  class Signal
-  {
-   public:
-    using Callback = std::function<void(Args...)>;
-
-    inline void operator()(Args... args) noexcept
-    {
-      std::lock_guard<std::mutex> lock(mutex);
-      for (const auto& cb : callbacks) cb(std::forward<Args>(args)...);
-    }
-
-    inline void operator=(const Callback& cb) noexcept
-    {
-      std::lock_guard<std::mutex> lock(mutex);
-      callbacks.push_back(std::move(cb));
-    }
-
-   protected:
-    std::vector<Callback> callbacks;
-    std::mutex mutex;
+ public:
+  // this connection's traffic, control frames included. the totals over all connections are in metrics::registry()
+  // as ws_*_total
+  struct Stats {
+    metrics::Counter framesIn;
+    metrics::Counter framesOut;
+    metrics::Counter bytesIn;
+    metrics::Counter bytesOut;
+    // after reassembly
+    metrics::Counter messagesIn;
   };
 
- public:
   explicit Client(const URI& uri, http::ClientFlags flags = http::ClientFlags::None);
+  ~Client();
 
   Client(const Client&) = delete;
   Client& operator=(const Client&) = delete;
 
   bool send(const char* str) const noexcept;
   bool send(const Frame& frame) const noexcept;
+  // a single unfragmented frame, without copying `payload` into a Frame first
+  bool send(Opcode opcode, std::string_view payload) const noexcept;
 
+  // fragmented messages are reassembled before being delivered. the frame lives in the connection's arena, which is
+  // reset once every handler has returned, so handlers must copy whatever they keep
   Signal<const Frame&> onmessage;
   Signal<> onopen;
   Signal<> onclose;
@@ -51,16 +46,40 @@ class Client : protected http::Client
   void connect();
   void close() noexcept;
 
+  // the largest frame or reassembled message accepted, a larger one closes the connection with 1009 (message too big)
+  inline void setMaxMessageSize(usize size) noexcept { maxMessage = size; }
+
+  inline const Stats& stats() const noexcept { return counters; }
+
  protected:
   std::array<u8, 16> key;
 
-  Frame recvFrame() const;
+  // bytes received but not consumed yet; can be non-empty after the handshake if the server
+  // sent its first frame in the same segment as the 101 response
+  std::string rbuf;
+  usize rpos = 0;
+  // received payloads, reset after each message
+  MessageArena arena;
+  std::atomic<usize> maxMessage{64 * 1024 * 1024};
+  // recvFrame() stopped at a frame over maxMessage
+  bool oversized = false;
+
+  std::optional<Frame> recvFrame();
 
  private:
   std::atomic<bool> listening{false};
   std::future<void> listenFuture;
+  mutable std::mutex sendMutex;
+  // the frame being sent, guarded by sendMutex
+  mutable std::string wbuf;
+  mutable Stats counters;
 
   void doHandshake();
   void listen() noexcept;
+  bool fill(usize n) noexcept;
+  // closes with `status` and stops listening
+  void fail(u16 status) noexcept;
+  bool write(u8 header, std::string_view payload) const noexcept;
+  void deliver(const Frame& message) noexcept;
 };
 }  // namespace twilight::ws
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <array>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 
 #include "utils/types.h"
 
@@ -21,8 +24,20 @@ struct Frame {
   bool rsv2 = false;
   bool rsv3 = false;
   Opcode opcode;
-  std::string payload;
+  // received frames are allocated from the connection's message arena and only live until their message is handled
+  std::pmr::string payload;
 
   std::string toString() const;
 };
+
+// the bytes the frame at the start of `data` takes on the wire. while `data` is too short to hold the frame's length,
+// how many it needs to tell instead, so reading until it's no larger than data.size() reads a whole frame. saturates
+// at the largest usize rather than wrapping
+usize frameSize(std::string_view data) noexcept;
+// decodes the whole frame at the start of `data` into `frame`, replacing its payload. returns its size on the wire
+usize decodeFrame(std::string_view data, Frame& frame) noexcept;
+// appends a frame with first byte `header` and `payload` masked with `mask`, as clients send them
+void encodeFrame(std::string& out, u8 header, std::string_view payload, std::array<u8, 4> mask) noexcept;
+// same, unmasked, as servers send them
+void encodeFrame(std::string& out, u8 header, std::string_view payload) noexcept;
 }  // namespace twilight::ws
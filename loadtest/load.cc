@@ -0,0 +1,286 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "http/client.h"
+#include "server.h"
+#include "utils/bitwise.h"
+#include "utils/histogram.h"
+#include "utils/metrics.h"
+#include "voice/connection.h"
+#include "ws/client.h"
+
+using namespace twilight;
+using Clock = std::chrono::steady_clock;
+
+// drives N clients against one URL for a while and reports throughput and latency percentiles. http(s) URLs are
+// requested in a loop on keep-alive connections, POSTing -b bytes if given. ws(s) URLs get a message of -m bytes and
+// wait for the echo before sending the next, or with -m 0 only count what the server sends. with --serve, a loopback
+// server runs in-process and the URL is a target on it, e.g. /bytes?size=65536&encoding=gzip or /ws/echo, and without
+// one it only serves. --uring has the clients do their socket I/O through io_uring. /ws/voice on a loopback server
+// runs a voice connection per client instead, playing -m byte frames the server sends back
+static void usage()
+{
+  std::fprintf(stderr,
+    "usage: twilight_load [-c clients] [-d seconds] [-b body bytes] [-m message bytes] [--serve | --serve-tls] "
+    "[--uring] [--metrics] [url]\n");
+}
+
+namespace
+{
+struct Options {
+  usize clients = 16;
+  std::chrono::seconds duration{10};
+  usize message = 256;
+  // POSTed with every http request when set
+  usize body = 0;
+  std::string url;
+  std::optional<loadtest::LoopbackServer::Options> serve;
+  bool metrics = false;
+  http::ClientFlags flags = http::ClientFlags::None;
+};
+
+// what one client saw, merged into the totals at the end
+struct Result {
+  Histogram latency;
+  u64 operations = 0;
+  u64 bytes = 0;
+  u64 errors = 0;
+};
+
+void requests(const Options& options, Clock::time_point deadline, Result& result)
+{
+  URI uri{options.url};
+  std::string target = uri.target();
+  http::RequestInit init{.method = options.body ? http::Method::POST : http::Method::GET,
+    .body = std::string(options.body, 'x')};
+  std::optional<http::Client> client;
+  while (Clock::now() < deadline) {
+    try {
+      if (!client)
+        client.emplace(uri, options.flags);
+      auto start = Clock::now();
+      http::Response res = client->request(target, init);
+      result.latency.record(metrics::nanos(Clock::now() - start));
+      result.bytes += res.body.size();
+      if (!res.ok())
+        ++result.errors;
+      ++result.operations;
+    } catch (const std::exception&) {
+      // reconnects on the next round
+      ++result.errors;
+      client.reset();
+    }
+  }
+}
+
+void messages(const Options& options, Clock::time_point deadline, Result& result)
+{
+  // bumped for every message and on close, to wake the sender
+  std::atomic<u64> events{0};
+  std::atomic<u64> received{0};
+  std::atomic<u64> bytes{0};
+  std::atomic<bool> closed{false};
+
+  try {
+    ws::Client client{URI{options.url}, options.flags | http::ClientFlags::NoConnect};
+    client.onmessage = [&](const ws::Frame& frame) {
+      bytes.fetch_add(frame.payload.size(), std::memory_order_relaxed);
+      received.fetch_add(1, std::memory_order_relaxed);
+      events.fetch_add(1, std::memory_order_release);
+      events.notify_one();
+    };
+    client.onclose = [&] {
+      closed = true;
+      events.fetch_add(1, std::memory_order_release);
+      events.notify_one();
+    };
+    client.connect();
+
+    if (options.message == 0) {
+      // a firehose with a count closes once it's done
+      while (Clock::now() < deadline && !closed) std::this_thread::sleep_for(std::chrono::milliseconds{10});
+      result.operations = received.load();
+      result.bytes = bytes.load();
+      return;
+    }
+
+    std::string message(options.message, 'x');
+    while (Clock::now() < deadline && !closed) {
+      u64 before = events.load(std::memory_order_acquire);
+      auto start = Clock::now();
+      if (!client.send(ws::Opcode::Text, message))
+        break;
+      events.wait(before, std::memory_order_acquire);
+      if (closed)
+        break;
+      result.latency.record(metrics::nanos(Clock::now() - start));
+      ++result.operations;
+    }
+    if (closed)
+      ++result.errors;
+  } catch (const std::exception&) {
+    ++result.errors;
+  }
+  result.bytes = bytes.load();
+}
+
+// a frame every 20 ms, counted once the echo comes out of onaudio. the first one after the deadline closes the
+// connection right there, as a bot leaving on an audio cue would
+void voices(const Options& options, Clock::time_point deadline, Result& result)
+{
+  // shared by every client, as a bot's connections would share one
+  static voice::Engine engine;
+  std::atomic<bool> done{false};
+  std::atomic<bool> dropped{false};
+  std::atomic<u64> frames{0};
+  std::atomic<u64> bytes{0};
+  std::atomic<u64> lost{0};
+
+  try {
+    voice::Connection c{
+      engine, {.endpoint = options.url, .token = "loadtest", .sessionId = "loadtest", .guild = 1, .user = 1}};
+    c.onaudio = [&](u32, std::span<const u8> frame) {
+      if (frame.empty()) {
+        lost.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        frames.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(frame.size(), std::memory_order_relaxed);
+      }
+      if (Clock::now() >= deadline && !done.exchange(true))
+        c.close();
+    };
+    c.onclose = [&] {
+      dropped = true;
+      done = true;
+    };
+    c.connect();
+
+    std::string frame(std::clamp<usize>(options.message, 1, voice::MAX_FRAME), 'x');
+    std::span<const u8> data{reinterpret_cast<const u8*>(frame.data()), frame.size()};
+    // a few frames ahead keep the stream going without queueing seconds of it
+    while (!done && Clock::now() < deadline + std::chrono::seconds{1}) {
+      while (c.queued() < 3 && c.play(data)) {
+      }
+      std::this_thread::sleep_for(voice::FRAME);
+    }
+    // nothing came back to close it, or the gateway went away
+    if (!done || dropped)
+      ++result.errors;
+  } catch (const std::exception&) {
+    ++result.errors;
+  }
+  result.operations = frames.load();
+  result.bytes = bytes.load();
+  result.errors += lost.load();
+}
+
+std::optional<Options> parse(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    bool value = i + 1 < argc;
+    if (arg == "-c" && value)
+      options.clients = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "-d" && value)
+      options.duration = std::chrono::seconds{std::strtoll(argv[++i], nullptr, 10)};
+    else if (arg == "-m" && value)
+      options.message = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "-b" && value)
+      options.body = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "--serve")
+      options.serve.emplace();
+    else if (arg == "--serve-tls")
+      options.serve.emplace().tls = true;
+    else if (arg == "--uring")
+      options.flags = http::ClientFlags::Uring;
+    else if (arg == "--metrics")
+      options.metrics = true;
+    else if (!arg.starts_with('-') && options.url.empty())
+      options.url = arg;
+    else
+      return std::nullopt;
+  }
+  if ((options.url.empty() && !options.serve) || options.clients == 0)
+    return std::nullopt;
+  return options;
+}
+
+bool voiced(const std::string& url)
+{
+  auto uri = URIView::parse(url);
+  return uri.has_value() && uri->path.starts_with("/ws/voice");
+}
+
+void report(const Options& options, const Result& total, std::chrono::duration<f64> elapsed)
+{
+  f64 seconds = elapsed.count();
+  std::string unit = voiced(options.url) ? "frames" : options.url.starts_with("ws") ? "messages" : "requests";
+  std::printf("%s, %zu clients, %.1fs\n", options.url.c_str(), options.clients, seconds);
+  std::printf("  %-12s %llu (%llu errors)\n", unit.c_str(), static_cast<unsigned long long>(total.operations),
+    static_cast<unsigned long long>(total.errors));
+  std::printf("  %-12s %.1f\n", (unit + "/s").c_str(), total.operations / seconds);
+  std::printf("  %-12s %.1f\n", "MB/s", total.bytes / seconds / 1e6);
+  if (total.latency.count()) {
+    auto us = [](u64 ns) { return ns / 1e3; };
+    std::printf("  latency us   min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+      us(total.latency.min()), us(total.latency.percentile(0.5)), us(total.latency.percentile(0.9)),
+      us(total.latency.percentile(0.99)), us(total.latency.percentile(0.999)), us(total.latency.max()));
+  }
+  if (options.metrics)
+    std::printf("\n%s", metrics::registry().toString().c_str());
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  std::optional<Options> options = parse(argc, argv);
+  if (!options) {
+    usage();
+    return 2;
+  }
+
+  // openssl writes to sockets with plain write(), so a peer that hung up would kill the process
+  std::signal(SIGPIPE, SIG_IGN);
+
+  std::optional<loadtest::LoopbackServer> server;
+  if (options->serve) {
+    server.emplace(*options->serve);
+    server->listen();
+    if (options->url.empty()) {
+      std::printf("serving on %s\n", server->url().c_str());
+      std::fflush(stdout);
+      for (;;) pause();
+    }
+    options->url = server->url(options->url.starts_with("/ws/") ? "ws" : "http") + options->url;
+  }
+
+  auto run = voiced(options->url) ? voices : options->url.starts_with("ws") ? messages : requests;
+  std::vector<Result> results(options->clients);
+  std::vector<std::jthread> threads;
+  auto start = Clock::now();
+  auto deadline = start + options->duration;
+  for (Result& result : results) threads.emplace_back([&] { run(*options, deadline, result); });
+  threads.clear();
+  auto elapsed = Clock::now() - start;
+
+  Result total;
+  for (const Result& r : results) {
+    total.latency.merge(r.latency);
+    total.operations += r.operations;
+    total.bytes += r.bytes;
+    total.errors += r.errors;
+  }
+  report(*options, total, elapsed);
+}
@@ -0,0 +1,613 @@
+#include "server.h"
+
+#include <arpa/inet.h>
+#include <brotli/encode.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/evp.h>
+#include <openssl/x509v3.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+#include "crypto/sha1.h"
+#include "http/server.h"
+#include "json/parser.h"
+#include "json/writer.h"
+#include "uri.h"
+#include "utils/base64.h"
+#include "voice/connection.h"
+#include "voice/rtp.h"
+#include "ws/frame.h"
+
+namespace twilight::loadtest
+{
+namespace
+{
+constexpr usize MAX_HEAD = 16 * 1024;
+constexpr usize MAX_BODY = 64 * 1024 * 1024;
+
+// the value of `key` in a query string like "size=10&chunk=2", empty if it's missing
+std::string_view param(std::string_view query, std::string_view key) noexcept
+{
+  while (!query.empty()) {
+    usize amp = query.find('&');
+    std::string_view pair = query.substr(0, amp);
+    query = amp == std::string_view::npos ? std::string_view{} : query.substr(amp + 1);
+    usize eq = pair.find('=');
+    if (pair.substr(0, eq) == key)
+      return eq == std::string_view::npos ? std::string_view{} : pair.substr(eq + 1);
+  }
+  return {};
+}
+
+usize number(std::string_view s, usize fallback) noexcept
+{
+  usize v = fallback;
+  std::from_chars(s.data(), s.data() + s.size(), v);
+  return v;
+}
+
+std::string_view reason(u16 status) noexcept
+{
+  switch (status) {
+  case 200:
+    return "OK";
+  case 302:
+    return "Found";
+  case 400:
+    return "Bad Request";
+  case 404:
+    return "Not Found";
+  case 413:
+    return "Content Too Large";
+  default:
+    return "";
+  }
+}
+
+// `size` bytes of message objects, which compress about as well as real API responses. cut off at `size`, so not
+// necessarily valid JSON
+std::string payload(usize size)
+{
+  std::string out = "[";
+  for (u64 i = 0; out.size() < size; ++i) {
+    out += R"({"id":")";
+    out += std::to_string(1175928847299117063ull + i * 4194304ull * 977);
+    out += R"(","channel_id":"381870553235193857","author":{"id":"80351110224678912","username":"user)";
+    out += std::to_string(i % 97);
+    out += R"(","avatar":"8342729096ea3675442027381ff50dfe"},"content":"hello world, this is message number )";
+    out += std::to_string(i);
+    out += R"(","timestamp":"2024-01-01T00:00:00.000000+00:00","tts":false,"mentions":[],"embeds":[]},)";
+  }
+  out.resize(size);
+  return out;
+}
+
+std::optional<std::string> compress(std::string_view encoding, std::string_view data)
+{
+  std::string out;
+  if (encoding == "br") {
+    usize n = BrotliEncoderMaxCompressedSize(data.size());
+    out.resize(n);
+    if (!BrotliEncoderCompress(4, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, data.size(),
+          reinterpret_cast<const u8*>(data.data()), &n, reinterpret_cast<u8*>(out.data())))
+      return std::nullopt;
+    out.resize(n);
+    return out;
+  }
+  if (encoding != "gzip" && encoding != "deflate")
+    return std::nullopt;
+
+  z_stream zs{};
+  if (deflateInit2(&zs, 6, Z_DEFLATED, encoding == "gzip" ? 16 + MAX_WBITS : MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return std::nullopt;
+  out.resize(deflateBound(&zs, data.size()));
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  zs.avail_in = data.size();
+  zs.next_out = reinterpret_cast<Bytef*>(out.data());
+  zs.avail_out = out.size();
+  deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return out;
+}
+
+// a response with `headers` (whole lines) and `body`, which is already chunked if they say so
+std::string response(u16 status, std::string_view headers = {}, std::string_view body = {})
+{
+  std::string out = "HTTP/1.1 " + std::to_string(status) + " ";
+  out += reason(status);
+  out += "\r\nServer: twilight-loopback\r\nConnection: keep-alive\r\n";
+  out += headers;
+  if (!headers.contains("Transfer-Encoding"))
+    out += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+  out += "\r\n";
+  out += body;
+  return out;
+}
+
+std::string chunked(std::string_view body, usize size)
+{
+  std::string out;
+  char len[20];
+  for (usize pos = 0; pos < body.size(); pos += size) {
+    std::string_view chunk = body.substr(pos, size);
+    out.append(len, std::snprintf(len, sizeof(len), "%zx\r\n", chunk.size()));
+    out += chunk;
+    out += "\r\n";
+  }
+  out += "0\r\n\r\n";
+  return out;
+}
+
+// an EC key and a certificate for localhost signed with it, valid for a day
+SSL_CTX* selfSigned()
+{
+  SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+  EVP_PKEY* key = EVP_EC_gen("P-256");
+  X509* cert = X509_new();
+  bool ok = ctx && key && cert;
+  if (ok) {
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 60 * 60);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const u8*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+
+    X509V3_CTX v3;
+    X509V3_set_ctx_nodb(&v3);
+    X509V3_set_ctx(&v3, cert, cert, nullptr, nullptr, 0);
+    X509_EXTENSION* san = X509V3_EXT_conf_nid(nullptr, &v3, NID_subject_alt_name, "DNS:localhost,IP:127.0.0.1");
+    ok = san && X509_add_ext(cert, san, -1) && X509_sign(cert, key, EVP_sha256()) &&
+         SSL_CTX_use_certificate(ctx, cert) == 1 && SSL_CTX_use_PrivateKey(ctx, key) == 1;
+    X509_EXTENSION_free(san);
+  }
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  if (!ok) {
+    SSL_CTX_free(ctx);
+    throw std::runtime_error("Failed to create a self-signed certificate");
+  }
+  return ctx;
+}
+}  // namespace
+
+class LoopbackServer::Connection
+{
+ public:
+  int fd;
+  SSL* ssl;
+  // received, from `pos` on not consumed yet
+  std::string in;
+  usize pos = 0;
+
+  Connection(int fd, SSL* ssl) noexcept : fd(fd), ssl(ssl) {}
+  ~Connection()
+  {
+    if (ssl)
+      SSL_free(ssl);
+  }
+
+  // reads until at least `n` unconsumed bytes are buffered
+  bool fill(usize n) noexcept
+  {
+    constexpr usize CHUNK = 16384;
+    if (pos == in.size() || pos >= 65536) {
+      in.erase(0, pos);
+      pos = 0;
+    }
+    while (in.size() - pos < n) {
+      usize used = in.size();
+      in.resize(used + CHUNK);
+      isize r = ssl ? SSL_read(ssl, in.data() + used, CHUNK) : ::recv(fd, in.data() + used, CHUNK, 0);
+      in.resize(used + std::max<isize>(r, 0));
+      if (r <= 0)
+        return false;
+    }
+    return true;
+  }
+
+  bool write(std::string_view data) noexcept
+  {
+    while (!data.empty()) {
+      isize n = ssl ? SSL_write(ssl, data.data(), data.size()) : ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+      if (n <= 0)
+        return false;
+      data.remove_prefix(n);
+    }
+    return true;
+  }
+
+  inline std::string_view buffered() const noexcept { return std::string_view{in}.substr(pos); }
+};
+
+LoopbackServer::LoopbackServer(Options options) : options(std::move(options)) {}
+
+LoopbackServer::~LoopbackServer()
+{
+  close();
+  if (ctx)
+    SSL_CTX_free(ctx);
+}
+
+void LoopbackServer::listen()
+{
+  if (options.tls && !ctx)
+    ctx = selfSigned();
+
+  addrinfo hints{}, *res = nullptr;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  std::string port = std::to_string(options.port);
+  if (getaddrinfo(options.host.c_str(), port.c_str(), &hints, &res) != 0)
+    throw std::runtime_error("Failed to resolve " + options.host);
+
+  listener = ::socket(res->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int one = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  bool ok = listener != -1 && ::bind(listener, res->ai_addr, res->ai_addrlen) == 0 && ::listen(listener, 1024) == 0;
+  freeaddrinfo(res);
+  if (!ok) {
+    if (listener != -1)
+      ::close(listener);
+    listener = -1;
+    throw std::runtime_error("Failed to listen on " + options.host + ":" + port);
+  }
+
+  sockaddr_storage addr{};
+  socklen_t len = sizeof(addr);
+  getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+  bound = ntohs(addr.ss_family == AF_INET6 ? reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port
+                                           : reinterpret_cast<sockaddr_in*>(&addr)->sin_port);
+
+  // the voice server's media go to the same address, on a port of their own
+  udp = ::socket(addr.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (addr.ss_family == AF_INET6)
+    reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port = 0;
+  else
+    reinterpret_cast<sockaddr_in*>(&addr)->sin_port = 0;
+  len = sizeof(addr);
+  if (udp == -1 || ::bind(udp, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      getsockname(udp, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+    if (udp != -1)
+      ::close(udp);
+    udp = -1;
+    ::close(listener);
+    listener = -1;
+    throw std::runtime_error("Failed to bind a UDP socket on " + options.host);
+  }
+  udpPort = ntohs(addr.ss_family == AF_INET6 ? reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port
+                                             : reinterpret_cast<sockaddr_in*>(&addr)->sin_port);
+
+  running = true;
+  acceptor = std::jthread{[this] { accept(); }};
+  echoer = std::jthread{[this] { echo(); }};
+}
+
+void LoopbackServer::close() noexcept
+{
+  if (!running.exchange(false))
+    return;
+  // unblocks accept
+  ::shutdown(listener, SHUT_RDWR);
+  acceptor = {};
+  ::close(listener);
+  listener = -1;
+  // unblocks recvfrom
+  ::shutdown(udp, SHUT_RDWR);
+  echoer = {};
+  ::close(udp);
+  udp = -1;
+
+  std::unordered_map<int, std::jthread> open;
+  {
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    open.swap(connections);
+    finished.clear();
+  }
+  for (auto& [fd, thread] : open) ::shutdown(fd, SHUT_RDWR);
+  for (auto& [fd, thread] : open) {
+    thread.join();
+    ::close(fd);
+  }
+}
+
+std::string LoopbackServer::url(std::string_view scheme) const
+{
+  std::string host = options.host.contains(':') ? "[" + options.host + "]" : options.host;
+  return std::string{scheme} + (options.tls ? "s" : "") + "://" + host + ":" + std::to_string(bound);
+}
+
+void LoopbackServer::accept() noexcept
+{
+  while (running) {
+    int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    // their threads are past the lock, joining can't wait on us. their fds are only closed here, so a new connection
+    // never gets the number of one still in the map
+    for (int done : finished) {
+      connections.erase(done);
+      ::close(done);
+    }
+    finished.clear();
+    connections.emplace(fd, std::jthread{[this, fd] { serve(fd); }});
+  }
+}
+
+void LoopbackServer::serve(int fd) noexcept
+{
+  SSL* ssl = nullptr;
+  if (ctx) {
+    ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if (SSL_accept(ssl) != 1) {
+      SSL_free(ssl);
+      ssl = nullptr;
+      ::shutdown(fd, SHUT_RDWR);
+    }
+  }
+
+  Connection c{fd, ssl};
+  while ((ssl || !ctx) && running) {
+    usize end = c.buffered().find("\r\n\r\n");
+    while (end == std::string_view::npos && c.buffered().size() <= MAX_HEAD && c.fill(c.buffered().size() + 1))
+      end = c.buffered().find("\r\n\r\n");
+    if (end == std::string_view::npos)
+      break;
+
+    auto req = http::Request::parse(c.buffered().substr(0, end));
+    if (!req.has_value()) {
+      c.write(response(400));
+      break;
+    }
+    usize length = number(req->headers.get("Content-Length").value_or("0"), 0);
+    if (length > MAX_BODY) {
+      c.write(response(413));
+      break;
+    }
+    if (!c.fill(end + 4 + length))
+      break;
+    std::string_view body = c.buffered().substr(end + 4, length);
+    c.pos += end + 4 + length;
+
+    if (req->path.starts_with("/ws/")) {
+      if (auto key = req->headers.get("Sec-WebSocket-Key"); key.has_value()) {
+        std::string accept = base64::encode(crypto::sha1(std::string{*key} + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+        if (c.write("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                    "Sec-WebSocket-Accept: " + accept + "\r\n\r\n"))
+          websocket(c, req->path);
+      } else {
+        c.write(response(400));
+      }
+      break;
+    }
+
+    bool sent = req->method == http::Method::POST && req->path == "/echo"
+                  ? c.write(response(200, "Content-Type: application/octet-stream\r\n", body))
+                  : c.write(respond(req->path));
+    if (!sent || !req->keepAlive)
+      break;
+  }
+
+  ::shutdown(fd, SHUT_RDWR);
+  std::lock_guard<std::mutex> lock(connectionsMutex);
+  finished.push_back(fd);
+}
+
+std::string_view LoopbackServer::respond(std::string_view target)
+{
+  {
+    std::shared_lock lock(cacheMutex);
+    if (auto it = cache.find(target); it != cache.end())
+      return it->second;
+  }
+  std::string res = build(target);
+  std::unique_lock lock(cacheMutex);
+  return cache.emplace(target, std::move(res)).first->second;
+}
+
+std::string LoopbackServer::build(std::string_view target) const
+{
+  auto uri = URIView::parse(target);
+  if (!uri.has_value())
+    return response(400);
+  std::string_view path = uri->path, query = uri->query;
+
+  if (path == "/bytes") {
+    std::string body = payload(number(param(query, "size"), 1024));
+    std::string headers = "Content-Type: application/json\r\n";
+    if (std::string_view encoding = param(query, "encoding"); !encoding.empty()) {
+      auto compressed = compress(encoding, body);
+      if (!compressed.has_value())
+        return response(400);
+      body = std::move(*compressed);
+      headers += "Content-Encoding: " + std::string{encoding} + "\r\n";
+    }
+    if (usize chunk = number(param(query, "chunk"), 0))
+      return response(200, headers + "Transfer-Encoding: chunked\r\n", chunked(body, chunk));
+    return response(200, headers, body);
+  }
+
+  if (path.starts_with("/status/"))
+    return response(static_cast<u16>(number(path.substr(8), 400)));
+
+  if (path.starts_with("/redirect/")) {
+    std::string_view rest = path.substr(10);
+    usize slash = rest.find('/');
+    usize n = number(rest.substr(0, slash), 0);
+    std::string location = slash == std::string_view::npos ? "/" : std::string{rest.substr(slash)};
+    if (n > 1)
+      location = "/redirect/" + std::to_string(n - 1) + location;
+    if (uri->hasQuery)
+      location += "?" + std::string{query};
+    return response(302, "Location: " + location + "\r\n");
+  }
+
+  return response(404);
+}
+
+void LoopbackServer::websocket(Connection& c, std::string_view target) noexcept
+{
+  constexpr u8 FIN = 0b10000000;
+  std::string out;
+
+  auto uri = URIView::parse(target);
+  // voice connections ask for the endpoint with "/?v=8" appended
+  if (uri.has_value() && uri->path.starts_with("/ws/voice"))
+    return voice(c);
+  if (uri.has_value() && uri->path == "/ws/firehose") {
+    usize count = number(param(uri->query, "count"), 0);
+    ws::encodeFrame(out, FIN | static_cast<u8>(ws::Opcode::Text), payload(number(param(uri->query, "size"), 1024)));
+    for (usize i = 0; (count == 0 || i < count) && running; ++i)
+      if (!c.write(out))
+        return;
+    out.clear();
+    ws::encodeFrame(out, FIN | static_cast<u8>(ws::Opcode::Close), {});
+    c.write(out);
+    return;
+  }
+
+  ws::Frame frame{.opcode = ws::Opcode::Continuation, .payload = {}};
+  while (running) {
+    for (usize need; (need = ws::frameSize(c.buffered())) > c.buffered().size();)
+      if (!c.fill(need))
+        return;
+    c.pos += ws::decodeFrame(c.buffered(), frame);
+
+    // the first byte as received, fragments are echoed as they come
+    u8 header = frame.fin << 7 | frame.rsv1 << 6 | frame.rsv2 << 5 | frame.rsv3 << 4 | static_cast<u8>(frame.opcode);
+    if (frame.opcode == ws::Opcode::Ping)
+      header = FIN | static_cast<u8>(ws::Opcode::Pong);
+    else if (frame.opcode == ws::Opcode::Pong)
+      continue;
+
+    out.clear();
+    ws::encodeFrame(out, header, frame.payload);
+    if (!c.write(out) || frame.opcode == ws::Opcode::Close)
+      return;
+  }
+}
+
+void LoopbackServer::voice(Connection& c) noexcept
+{
+  constexpr u8 TEXT = 0b10000000 | static_cast<u8>(ws::Opcode::Text);
+  // every connection gets an ssrc of its own, and the same key
+  u32 ssrc = ++ssrcs;
+  json::Parser parser;
+  std::string out;
+
+  auto reply = [&](voice::Opcode op, auto&& data) {
+    json::Writer w;
+    w.beginObject().key("op").value(static_cast<u8>(op)).key("d");
+    data(w);
+    w.endObject();
+    out.clear();
+    ws::encodeFrame(out, TEXT, w.str());
+    return c.write(out);
+  };
+
+  ws::Frame frame{.opcode = ws::Opcode::Continuation, .payload = {}};
+  while (running) {
+    for (usize need; (need = ws::frameSize(c.buffered())) > c.buffered().size();)
+      if (!c.fill(need))
+        return;
+    c.pos += ws::decodeFrame(c.buffered(), frame);
+    if (frame.opcode == ws::Opcode::Close) {
+      out.clear();
+      ws::encodeFrame(out, 0b10000000 | static_cast<u8>(ws::Opcode::Close), frame.payload);
+      c.write(out);
+      return;
+    }
+
+    auto root = parser.parse(frame.payload);
+    if (!root.has_value())
+      continue;
+    auto op = root->find("op").value_or(json::Value{}).asUint();
+    auto d = root->find("d").value_or(json::Value{});
+    bool ok = true;
+    switch (static_cast<voice::Opcode>(op.value_or(0xFF))) {
+    case voice::Opcode::Identify:
+      ok = reply(voice::Opcode::Hello, [](json::Writer& w) {
+        w.beginObject().key("heartbeat_interval").value(41250).endObject();
+      }) && reply(voice::Opcode::Ready, [&](json::Writer& w) {
+        w.beginObject()
+          .key("ssrc")
+          .value(ssrc)
+          .key("ip")
+          .value(options.host)
+          .key("port")
+          .value(udpPort)
+          .key("modes")
+          .beginArray()
+          .value(voice::MODE)
+          .endArray()
+          .endObject();
+      });
+      break;
+    case voice::Opcode::SelectProtocol:
+      ok = reply(voice::Opcode::SessionDescription, [](json::Writer& w) {
+        w.beginObject().key("mode").value(voice::MODE).key("secret_key").beginArray();
+        for (usize i = 0; i < voice::Cipher::Key{}.size(); ++i) w.value(i);
+        w.endArray().endObject();
+      });
+      break;
+    case voice::Opcode::Heartbeat:
+      ok = reply(voice::Opcode::HeartbeatAck, [&](json::Writer& w) {
+        w.beginObject().key("t").value(d.find("t").value_or(json::Value{}).asUint().value_or(0)).endObject();
+      });
+      break;
+    default:
+      break;
+    }
+    if (!ok)
+      return;
+  }
+}
+
+void LoopbackServer::echo() noexcept
+{
+  std::array<u8, voice::MAX_PACKET> buf;
+  while (running) {
+    sockaddr_storage from{};
+    socklen_t len = sizeof(from);
+    isize n = ::recvfrom(udp, buf.data(), buf.size(), 0, reinterpret_cast<sockaddr*>(&from), &len);
+    if (n < 0)
+      continue;
+
+    // an IP discovery request is answered with the address it came from: type 2, the ip as a nul-terminated string
+    // in 64 bytes, then the port
+    if (n == static_cast<isize>(voice::DISCOVERY_SIZE) && buf[0] == 0 && buf[1] == 1) {
+      bool v6 = from.ss_family == AF_INET6;
+      auto* in4 = reinterpret_cast<sockaddr_in*>(&from);
+      auto* in6 = reinterpret_cast<sockaddr_in6*>(&from);
+      buf[1] = 2;
+      std::memset(buf.data() + 8, 0, 64);
+      inet_ntop(from.ss_family, v6 ? static_cast<void*>(&in6->sin6_addr) : static_cast<void*>(&in4->sin_addr),
+        reinterpret_cast<char*>(buf.data() + 8), 64);
+      u16 port = ntohs(v6 ? in6->sin6_port : in4->sin_port);
+      buf[72] = static_cast<u8>(port >> 8);
+      buf[73] = static_cast<u8>(port);
+    }
+    ::sendto(udp, buf.data(), n, 0, reinterpret_cast<sockaddr*>(&from), len);
+  }
+}
+}  // namespace twilight::loadtest
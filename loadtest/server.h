@@ -0,0 +1,89 @@
+#pragma once
+
+#include <openssl/ssl.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/types.h"
+
+namespace twilight::loadtest
+{
+// a local stand-in for discord's HTTP and gateway servers, to drive the clients at full speed without rate limits or
+// network noise. one thread per connection with blocking I/O, simple rather than fast: it only has to outrun the
+// client under test, and every response is built once and cached by target.
+//
+// GET  /bytes?size=N[&chunk=K][&encoding=gzip|deflate|br]   N bytes of JSON, sent in K byte chunks, compressed
+// GET  /status/N                                             an empty response with status N
+// GET  /redirect/N/<target>                                  N redirects, then <target>
+// POST /echo                                                 the request body
+// GET  /ws/echo                                              websocket, every message is sent back
+// GET  /ws/firehose?size=N[&count=M]                         websocket, M messages of N bytes, forever if M is 0
+// GET  /ws/voice                                             a voice gateway, with a UDP socket that answers IP
+//                                                            discovery and sends every other packet back
+class LoopbackServer
+{
+ public:
+  struct Options {
+    std::string host = "127.0.0.1";
+    // 0 picks a free port, see port()
+    u16 port = 0;
+    // https and wss with a freshly generated self-signed certificate for localhost
+    bool tls = false;
+  };
+
+  explicit LoopbackServer(Options options);
+  ~LoopbackServer();
+
+  LoopbackServer(const LoopbackServer&) = delete;
+  LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+  // binds and starts accepting in the background, throws if the address can't be bound
+  void listen();
+  // stops accepting and closes every connection
+  void close() noexcept;
+
+  inline u16 port() const noexcept { return bound; }
+  // e.g. "https://127.0.0.1:41234", `scheme` is "http" or "ws" and gets an s with tls
+  std::string url(std::string_view scheme = "http") const;
+
+ private:
+  class Connection;
+
+  Options options;
+  int listener = -1;
+  u16 bound = 0;
+  SSL_CTX* ctx = nullptr;
+  std::atomic<bool> running{false};
+  // the voice server's UDP socket
+  int udp = -1;
+  u16 udpPort = 0;
+  std::atomic<u32> ssrcs{0};
+
+  std::jthread acceptor;
+  std::jthread echoer;
+  std::mutex connectionsMutex;
+  // by fd, finished ones are joined on the next accept
+  std::unordered_map<int, std::jthread> connections;
+  std::vector<int> finished;
+
+  std::shared_mutex cacheMutex;
+  std::map<std::string, std::string, std::less<>> cache;
+
+  void accept() noexcept;
+  void serve(int fd) noexcept;
+  // the cached response to a GET of `target`
+  std::string_view respond(std::string_view target);
+  std::string build(std::string_view target) const;
+  void websocket(Connection& c, std::string_view target) noexcept;
+  void voice(Connection& c) noexcept;
+  void echo() noexcept;
+};
+}  // namespace twilight::loadtest
@@ -0,0 +1,78 @@
+#include "cache/arena.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace twilight::cache
+{
+Arena::~Arena()
+{
+  for (usize i = 0; i < chunks.size(); ++i) delete[] chunks[i];
+}
+
+Ref Arena::allocate(usize n, usize align)
+{
+  offset = (offset + align - 1) & ~(align - 1);
+  if (!size || offset + n > size) {
+    add(wastedBytes, size - std::min(offset, size));
+    if (size)
+      filled.push_back(std::min(offset, size));
+    // offset 0 of the first chunk is reserved so that a valid ref is never 0
+    usize start = size ? 0 : align;
+    size = std::min(CHUNK, std::max(size ? size * 2 : FIRST, std::bit_ceil(start + n)));
+    chunks.push(new char[size]);
+    add(reserved, size);
+    offset = start;
+  }
+
+  Ref ref = static_cast<Ref>((chunks.size() - 1) << CHUNK_BITS | offset);
+  offset += n;
+  add(usedBytes, n);
+  return ref;
+}
+
+void Arena::append(std::string_view bytes)
+{
+  if (size) {
+    add(wastedBytes, size - std::min(offset, size));
+    filled.push_back(std::min(offset, size));
+  }
+  size = std::min(CHUNK, std::max(FIRST, std::bit_ceil(bytes.size())));
+  chunks.push(new char[size]);
+  std::memcpy(chunks[chunks.size() - 1], bytes.data(), bytes.size());
+  add(reserved, size);
+  add(usedBytes, bytes.size());
+  offset = bytes.size();
+}
+
+Ref Arena::store(std::string_view s)
+{
+  if (s.empty())
+    return 0;
+
+  u16 n = std::min(s.size(), CHUNK - 1 - sizeof(u16) - alignof(u16));
+  Ref ref = allocate(sizeof(n) + n, alignof(u16));
+  std::memcpy(data(ref), &n, sizeof(n));
+  std::memcpy(data(ref) + sizeof(n), s.data(), n);
+  return ref;
+}
+
+std::string_view Arena::string(Ref ref) const noexcept
+{
+  if (!ref)
+    return {};
+  u16 n;
+  std::memcpy(&n, data(ref), sizeof(n));
+  return {data(ref) + sizeof(n), n};
+}
+
+void Arena::replace(Ref& ref, std::string_view s)
+{
+  std::string_view old = string(ref);
+  if (old == s)
+    return;
+  if (ref)
+    retire(sizeof(u16) + old.size());
+  ref = store(s);
+}
+}  // namespace twilight::cache
@@ -0,0 +1,766 @@
+#include "cache/cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+#include "cache/snapshot.h"
+#include "utils/bitwise.h"
+
+namespace twilight::cache
+{
+using gateway::Data;
+
+namespace
+{
+// unescaped strings and translated lists, per thread since shards ingest concurrently
+thread_local std::string scratch;
+thread_local std::vector<u16> slotScratch;
+thread_local std::vector<Overwrite> overwriteScratch;
+thread_local std::vector<std::pair<u64, Data>> userScratch;
+
+inline std::optional<u64> snowflake(const Data& d, std::string_view key) noexcept
+{
+  auto v = d.find(key);
+  return v ? v->asSnowflake() : std::nullopt;
+}
+
+template <typename T>
+inline T integer(const Data& d) noexcept
+{
+  return static_cast<T>(d.asInt().value_or(0));
+}
+
+// "2023-03-05T17:22:01.163000+00:00" to unix seconds, discord timestamps are always UTC
+u32 timestamp(std::string_view s) noexcept
+{
+  if (s.size() < 19)
+    return 0;
+
+  auto digits = [&](usize pos, usize n) -> int {
+    int v = 0;
+    for (usize i = pos; i < pos + n; ++i) {
+      if (s[i] < '0' || s[i] > '9')
+        return -1;
+      v = v * 10 + (s[i] - '0');
+    }
+    return v;
+  };
+
+  int year = digits(0, 4), month = digits(5, 2), day = digits(8, 2);
+  int hour = digits(11, 2), minute = digits(14, 2), second = digits(17, 2);
+  if (year < 1970 || month < 0 || day < 0 || hour < 0 || minute < 0 || second < 0)
+    return 0;
+
+  std::chrono::year_month_day date{std::chrono::year{year}, std::chrono::month(month), std::chrono::day(day)};
+  if (!date.ok())
+    return 0;
+
+  auto t = std::chrono::sys_days{date}.time_since_epoch() + std::chrono::hours{hour} + std::chrono::minutes{minute} +
+           std::chrono::seconds{second};
+  return static_cast<u32>(std::chrono::duration_cast<std::chrono::seconds>(t).count());
+}
+
+inline int hex(char c) noexcept
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+// "a_1269e74af4df7417b13759eae50c83dc" into 16 bytes and the animated flag
+bool avatarHash(std::string_view s, u8 (&out)[16], bool& animated) noexcept
+{
+  animated = s.starts_with("a_");
+  if (animated)
+    s.remove_prefix(2);
+  if (s.size() != 32)
+    return false;
+
+  for (usize i = 0; i < 16; ++i) {
+    int hi = hex(s[2 * i]), lo = hex(s[2 * i + 1]);
+    if (hi < 0 || lo < 0)
+      return false;
+    out[i] = static_cast<u8>(hi << 4 | lo);
+  }
+  return true;
+}
+
+// only valid until the next call on the same thread
+std::string_view text(const Data& d)
+{
+  auto s = d.asStringView();
+  if (!s)
+    return {};
+  // only JSON strings carry escapes, and rarely
+  if (s->find('\\') == std::string_view::npos)
+    return *s;
+  scratch = d.asString().value_or(std::string{});
+  return scratch;
+}
+
+template <typename E>
+inline void setFlag(E& flags, E flag, bool set) noexcept
+{
+  flags = set ? flags | flag : flags & ~flag;
+}
+
+inline Status status(std::string_view s) noexcept
+{
+  if (s == "online")
+    return Status::Online;
+  if (s == "idle")
+    return Status::Idle;
+  if (s == "dnd")
+    return Status::DoNotDisturb;
+  return Status::Offline;
+}
+}  // namespace
+
+CacheFlags policy(Intent intents) noexcept
+{
+  CacheFlags flags = CacheFlags::None;
+  if (!!(intents & Intent::GUILDS))
+    flags |= CacheFlags::Guilds | CacheFlags::Channels | CacheFlags::Roles;
+  if (!!(intents & Intent::GUILD_MEMBERS))
+    flags |= CacheFlags::Members | CacheFlags::Users;
+  if (!!(intents & Intent::GUILD_PRESENCES))
+    flags |= CacheFlags::Presences;
+  return flags;
+}
+
+Cache::Cache(CacheFlags flags) : cacheFlags(flags)
+{
+  // everything hangs off a guild, and presences and users off members. flags missing what they depend on are
+  // dropped rather than implying more
+  if (!has(CacheFlags::Guilds))
+    cacheFlags = CacheFlags::None;
+  if (!has(CacheFlags::Members))
+    cacheFlags &= ~(CacheFlags::Presences | CacheFlags::Users);
+
+  for (auto& u : users) u.store(new Users, std::memory_order_relaxed);
+}
+
+Cache::~Cache()
+{
+  guilds.forEach([](u64, Guild* g) { delete g; });
+  for (auto& u : users) delete u.load(std::memory_order_relaxed);
+  Epoch::reclaim();
+}
+
+bool Cache::ingest(const gateway::Payload& payload)
+{
+  if (payload.op != gateway::Opcode::Dispatch || !has(CacheFlags::Guilds))
+    return false;
+
+  const Data& d = payload.d;
+  std::string_view t = payload.t;
+  // keeps what this thread reads (its own guilds, shared tables) alive while it works
+  Epoch::Guard guard;
+
+  // roughly by how often they arrive
+  if (t == "PRESENCE_UPDATE") {
+    if (Guild* g = has(CacheFlags::Presences) ? target(d) : nullptr)
+      updatePresence(*g, d);
+  } else if (t == "GUILD_MEMBER_UPDATE" || t == "GUILD_MEMBER_ADD") {
+    Guild* g = target(d);
+    if (g && t == "GUILD_MEMBER_ADD") {
+      Guild::Info info = g->state;
+      ++info.memberCount;
+      g->seq.store(g->state, info);
+    }
+    if (g && has(CacheFlags::Members))
+      upsertMember(*g, d);
+  } else if (t == "GUILD_MEMBER_REMOVE") {
+    Guild* g = target(d);
+    auto user = d.find("user");
+    if (g) {
+      Guild::Info info = g->state;
+      --info.memberCount;
+      g->seq.store(g->state, info);
+      if (auto id = user ? snowflake(*user, "id") : std::nullopt)
+        g->removeMember(*id);
+    }
+  } else if (t == "GUILD_MEMBERS_CHUNK") {
+    Guild* g = has(CacheFlags::Members) ? target(d) : nullptr;
+    if (!g)
+      return true;
+    if (auto members = d.find("members"))
+      upsertMembers(*g, *members);
+    if (auto presences = has(CacheFlags::Presences) ? d.find("presences") : std::nullopt)
+      for (Data p : presences->items()) updatePresence(*g, p);
+  } else if (t == "CHANNEL_CREATE" || t == "CHANNEL_UPDATE") {
+    // DM channels have no guild and are skipped
+    if (Guild* g = has(CacheFlags::Channels) ? target(d) : nullptr)
+      upsertChannel(*g, d);
+  } else if (t == "CHANNEL_DELETE") {
+    Guild* g = target(d);
+    if (auto id = snowflake(d, "id"); g && id)
+      g->removeChannel(*id);
+  } else if (t == "GUILD_ROLE_CREATE" || t == "GUILD_ROLE_UPDATE") {
+    Guild* g = has(CacheFlags::Roles) ? target(d) : nullptr;
+    if (auto role = d.find("role"); g && role)
+      upsertRole(*g, *role);
+  } else if (t == "GUILD_ROLE_DELETE") {
+    Guild* g = target(d);
+    if (auto id = snowflake(d, "role_id"); g && id)
+      g->removeRole(*id);
+  } else if (t == "GUILD_CREATE") {
+    guildCreate(d);
+  } else if (t == "GUILD_UPDATE") {
+    if (auto id = snowflake(d, "id"); Guild* g = id ? find(*id) : nullptr)
+      guildUpdate(*g, d);
+  } else if (t == "GUILD_DELETE") {
+    guildDelete(d);
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+gateway::EventSet Cache::events() const
+{
+  if (!has(CacheFlags::Guilds))
+    return {};
+
+  // member counts are kept even without members
+  gateway::EventSet set{"GUILD_CREATE", "GUILD_UPDATE", "GUILD_DELETE", "GUILD_MEMBER_ADD", "GUILD_MEMBER_REMOVE"};
+  if (has(CacheFlags::Members))
+    set.add(gateway::EventSet{"GUILD_MEMBER_UPDATE", "GUILD_MEMBERS_CHUNK"});
+  if (has(CacheFlags::Channels))
+    set.add(gateway::EventSet{"CHANNEL_CREATE", "CHANNEL_UPDATE", "CHANNEL_DELETE"});
+  if (has(CacheFlags::Roles))
+    set.add(gateway::EventSet{"GUILD_ROLE_CREATE", "GUILD_ROLE_UPDATE", "GUILD_ROLE_DELETE"});
+  if (has(CacheFlags::Presences))
+    set.add("PRESENCE_UPDATE");
+  return set;
+}
+
+const Guild* Cache::guild(u64 id) const noexcept
+{
+  // the slot may hold another guild if it was deleted and its slot reused meanwhile
+  Guild* g = find(id);
+  return g && g->id() == id ? g : nullptr;
+}
+
+std::optional<Cache::UserEntry> Cache::user(u64 id) const noexcept
+{
+  const Users* u = users[stripe(id)].load(std::memory_order_acquire);
+  auto slot = u->index.find(id);
+  if (!slot)
+    return std::nullopt;
+
+  User record = u->seq.load(u->records[*slot]);
+  if (record.id != id)
+    return std::nullopt;
+  return UserEntry{record, u->arena.string(record.username), u->arena.string(record.globalName)};
+}
+
+std::string Cache::avatar(const User& u)
+{
+  if (!(u.flags & UserFlag::HasAvatar))
+    return {};
+
+  static constexpr char digits[] = "0123456789abcdef";
+  std::string out = !!(u.flags & UserFlag::AnimatedAvatar) ? "a_" : "";
+  for (u8 b : u.avatar) {
+    out.push_back(digits[b >> 4]);
+    out.push_back(digits[b & 0xF]);
+  }
+  return out;
+}
+
+Cache::Stats Cache::stats() const noexcept
+{
+  Epoch::Guard guard;
+  Stats s;
+  s.interned = interner.size();
+  s.bytes = guilds.memoryUsage() + interner.memoryUsage();
+
+  for (const auto& stripe : users) {
+    const Users* u = stripe.load(std::memory_order_acquire);
+    s.users += u->records.size();
+    s.bytes += u->arena.capacity() + u->index.memoryUsage() + u->records.memoryUsage();
+    s.wasted += u->arena.wasted();
+  }
+
+  forEachGuild([&](const Guild& g) {
+    ++s.guilds;
+    s.channels += g.cachedChannels();
+    s.roles += g.cachedRoles();
+    s.members += g.cachedMembers();
+    s.bytes += g.memoryUsage();
+    s.wasted += g.wasted();
+  });
+  return s;
+}
+
+usize Cache::sweepUsers()
+{
+  Epoch::Guard guard;
+
+  std::vector<u64> live;
+  forEachGuild([&](const Guild& g) { g.forEachMember([&](const Member& m) { live.push_back(m.user); }); });
+  std::sort(live.begin(), live.end());
+
+  usize dropped = 0;
+  for (usize i = 0; i < USER_STRIPES; ++i) {
+    std::lock_guard lock(usersMutex[i]);
+    Users* old = users[i].load(std::memory_order_relaxed);
+    auto fresh = new Users;
+
+    // rebuilt on the side and swapped in whole, so readers never mix a record with the wrong arena
+    old->index.forEach([&](u64 id, u32 slot) {
+      if (!std::binary_search(live.begin(), live.end(), id)) {
+        ++dropped;
+        return;
+      }
+      User u = old->records[slot];
+      u.username = fresh->arena.store(old->arena.string(u.username));
+      u.globalName = fresh->arena.store(old->arena.string(u.globalName));
+      u32 s = fresh->records.add();
+      fresh->seq.store(fresh->records[s], u);
+      fresh->index.insertOrAssign(id, s);
+    });
+
+    users[i].store(fresh, std::memory_order_release);
+    Epoch::retire(old);
+  }
+  return dropped;
+}
+
+bool Cache::restore(std::shared_ptr<const Snapshot> s)
+{
+  if (!s || s->flags() != cacheFlags || snapshot || !guilds.empty())
+    return false;
+
+  s->restore(interner);
+  for (usize i = 0; i < USER_STRIPES; ++i) {
+    std::lock_guard lock(usersMutex[i]);
+    auto fresh = new Users;
+    s->restore(i, *fresh);
+    Epoch::retire(users[i].exchange(fresh, std::memory_order_acq_rel));
+  }
+
+  // zeroed, every guild Pending
+  restored = std::make_unique<std::atomic<u8>[]>(s->guilds());
+  snapshot = std::move(s);
+  pendingGuilds.store(snapshot->guilds(), std::memory_order_release);
+  return true;
+}
+
+Guild* Cache::target(const Data& d)
+{
+  auto id = snowflake(d, "guild_id");
+  return id ? find(*id) : nullptr;
+}
+
+Guild* Cache::find(u64 id) const noexcept
+{
+  if (auto g = guilds.find(id))
+    return *g;
+  return pendingGuilds.load(std::memory_order_acquire) ? restoreGuild(id) : nullptr;
+}
+
+Guild* Cache::restoreGuild(u64 id) const noexcept
+{
+  auto i = snapshot->find(id);
+  if (!i)
+    return nullptr;
+
+  // the first reader to get here restores it, the others wait for it
+  std::atomic<u8>& state = restored[*i];
+  u8 expected = Pending;
+  if (!state.compare_exchange_strong(expected, Restoring)) {
+    if (expected == Restoring)
+      state.wait(Restoring);
+    auto g = guilds.find(id);
+    return g ? *g : nullptr;
+  }
+
+  // null if its section is damaged or there's no memory for it, it's then as if it was never cached
+  Guild* g = nullptr;
+  try {
+    std::unique_ptr<Guild> copy = snapshot->guild(*i);
+    if (copy) {
+      std::lock_guard lock(guildsMutex);
+      guilds.insertOrAssign(id, copy.get());
+      g = copy.release();
+    }
+  } catch (const std::bad_alloc&) {
+  }
+  state.store(Done);
+  state.notify_all();
+  pendingGuilds.fetch_sub(1);
+  return g;
+}
+
+void Cache::restoreAll() const
+{
+  for (usize i = 0; i < snapshot->guilds(); ++i)
+    if (restored[i].load() != Done)
+      restoreGuild(snapshot->id(i));
+}
+
+void Cache::supersede(u64 id)
+{
+  if (!pendingGuilds.load(std::memory_order_acquire))
+    return;
+  auto i = snapshot->find(id);
+  if (!i)
+    return;
+
+  // a restore in progress is let through, the new guild replaces it right after
+  std::atomic<u8>& state = restored[*i];
+  for (u8 expected = Pending; !state.compare_exchange_strong(expected, Done); expected = Pending) {
+    if (expected == Done)
+      return;
+    state.wait(expected);
+  }
+  state.notify_all();
+  pendingGuilds.fetch_sub(1);
+}
+
+void Cache::guildCreate(const Data& d)
+{
+  auto id = snowflake(d, "id");
+  if (!id)
+    return;
+
+  // a guild becoming available again (or being rejoined) is sent in full, start over. it's built on the side and
+  // only published once complete
+  auto g = std::make_unique<Guild>(*id);
+  Guild::Info info{};
+  std::optional<Data> roles, channels, members, presences;
+  for (auto [key, v] : d.fields()) {
+    if (guildField(*g, info, key, v))
+      continue;
+    if (key == "roles")
+      roles = v;
+    else if (key == "channels")
+      channels = v;
+    else if (key == "members")
+      members = v;
+    else if (key == "presences")
+      presences = v;
+  }
+  g->seq.store(g->state, info);
+
+  // roles first, members refer to them by slot
+  if (roles && has(CacheFlags::Roles))
+    for (Data r : roles->items()) upsertRole(*g, r);
+  if (channels && has(CacheFlags::Channels)) {
+    g->channelIndex.reserve(channels->size());
+    for (Data c : channels->items()) upsertChannel(*g, c);
+  }
+  if (members && has(CacheFlags::Members)) {
+    upsertMembers(*g, *members);
+  }
+  if (presences && has(CacheFlags::Presences))
+    for (Data p : presences->items()) updatePresence(*g, p);
+
+  supersede(*id);
+  std::lock_guard lock(guildsMutex);
+  if (auto old = guilds.insertOrAssign(*id, g.release()))
+    Epoch::retire(*old);
+}
+
+void Cache::guildDelete(const Data& d)
+{
+  auto id = snowflake(d, "id");
+  Guild* g = id ? find(*id) : nullptr;
+  if (!g)
+    return;
+
+  // an outage, the guild is still there and will be sent again with GUILD_CREATE
+  if (auto unavailable = d.find("unavailable"); unavailable && unavailable->asBool().value_or(false)) {
+    Guild::Info info = g->state;
+    info.flags |= GuildFlag::Unavailable;
+    g->seq.store(g->state, info);
+    return;
+  }
+
+  std::lock_guard lock(guildsMutex);
+  guilds.erase(*id);
+  Epoch::retire(g);
+}
+
+void Cache::guildUpdate(Guild& g, const Data& d)
+{
+  Guild::Info info = g.state;
+  for (auto [key, v] : d.fields()) guildField(g, info, key, v);
+  g.seq.store(g.state, info);
+}
+
+bool Cache::guildField(Guild& g, Guild::Info& info, std::string_view key, const Data& v)
+{
+  if (key == "name")
+    g.arena.replace(info.name, text(v));
+  else if (key == "owner_id")
+    info.owner = v.asSnowflake().value_or(0);
+  else if (key == "member_count")
+    info.memberCount = integer<u32>(v);
+  else if (key == "unavailable")
+    setFlag(info.flags, GuildFlag::Unavailable, v.asBool().value_or(false));
+  else if (key == "large")
+    setFlag(info.flags, GuildFlag::Large, v.asBool().value_or(false));
+  else
+    return false;
+  return true;
+}
+
+void Cache::upsertRole(Guild& g, const Data& d)
+{
+  auto id = snowflake(d, "id");
+  if (!id)
+    return;
+
+  auto slot = g.roleIndex.find(*id);
+  // slots are u16 and never reused
+  if (!slot && g.roles.slots() > 0xFFFF)
+    return;
+
+  Role r{};
+  r.id = *id;
+  if (slot)
+    r = g.roles[*slot];
+  for (auto [key, v] : d.fields()) {
+    if (key == "name")
+      g.arena.replace(r.name, text(v));
+    else if (key == "permissions")
+      r.permissions = v.asSnowflake().value_or(0);
+    else if (key == "color")
+      r.color = integer<u32>(v);
+    else if (key == "position")
+      r.position = integer<i16>(v);
+    else if (key == "hoist")
+      setFlag(r.flags, RoleFlag::Hoist, v.asBool().value_or(false));
+    else if (key == "managed")
+      setFlag(r.flags, RoleFlag::Managed, v.asBool().value_or(false));
+    else if (key == "mentionable")
+      setFlag(r.flags, RoleFlag::Mentionable, v.asBool().value_or(false));
+  }
+  g.put(g.roles, g.roleIndex, slot, *id, r);
+}
+
+void Cache::upsertChannel(Guild& g, const Data& d)
+{
+  auto id = snowflake(d, "id");
+  if (!id)
+    return;
+
+  auto slot = g.channelIndex.find(*id);
+  Channel c{};
+  c.id = *id;
+  if (slot)
+    c = g.channels[*slot];
+  for (auto [key, v] : d.fields()) {
+    if (key == "name") {
+      g.arena.replace(c.name, text(v));
+    } else if (key == "topic") {
+      g.arena.replace(c.topic, text(v));
+    } else if (key == "parent_id") {
+      c.parentId = v.asSnowflake().value_or(0);
+    } else if (key == "position") {
+      c.position = integer<i16>(v);
+    } else if (key == "type") {
+      c.type = integer<u8>(v);
+    } else if (key == "nsfw") {
+      c.nsfw = v.asBool().value_or(false);
+    } else if (key == "permission_overwrites") {
+      overwriteScratch.clear();
+      for (Data o : v.items()) {
+        Overwrite ow{};
+        ow.id = snowflake(o, "id").value_or(0);
+        ow.allow = snowflake(o, "allow").value_or(0);
+        ow.deny = snowflake(o, "deny").value_or(0);
+        auto type = o.find("type");
+        ow.type = type && type->asInt() == 1 ? Overwrite::Type::Member : Overwrite::Type::Role;
+        overwriteScratch.push_back(ow);
+      }
+      g.arena.replace(c.overwrites, std::span<const Overwrite>{overwriteScratch});
+    }
+  }
+  g.put(g.channels, g.channelIndex, slot, *id, c);
+}
+
+void Cache::upsertMember(Guild& g, const Data& d, bool withUser)
+{
+  // one pass to find the fields, the user id is needed before anything can be written
+  std::optional<u64> id;
+  std::optional<Data> nick, roles, joinedAt, timeoutUntil, flags, deaf, mute, pending;
+  for (auto [key, v] : d.fields()) {
+    if (key == "user")
+      id = withUser ? upsertUser(v) : snowflake(v, "id");
+    else if (key == "nick")
+      nick = v;
+    else if (key == "roles")
+      roles = v;
+    else if (key == "joined_at")
+      joinedAt = v;
+    else if (key == "communication_disabled_until")
+      timeoutUntil = v;
+    else if (key == "flags")
+      flags = v;
+    else if (key == "deaf")
+      deaf = v;
+    else if (key == "mute")
+      mute = v;
+    else if (key == "pending")
+      pending = v;
+  }
+  if (!id)
+    return;
+
+  auto slot = g.memberIndex.find(*id);
+  Member m{};
+  m.user = *id;
+  if (slot)
+    m = g.members[*slot];
+  if (nick)
+    g.arena.replace(m.nick, text(*nick));
+  if (roles) {
+    slotScratch.clear();
+    for (Data r : roles->items())
+      if (auto role = g.roleIndex.find(r.asSnowflake().value_or(0)))
+        slotScratch.push_back(*role);
+    g.arena.replace(m.roles, std::span<const u16>{slotScratch});
+  }
+  if (joinedAt)
+    m.joinedAt = timestamp(text(*joinedAt));
+  if (timeoutUntil)
+    m.timeoutUntil = timestamp(text(*timeoutUntil));
+  if (flags)
+    m.guildFlags = integer<u16>(*flags);
+  if (deaf)
+    setFlag(m.flags, MemberFlag::Deaf, deaf->asBool().value_or(false));
+  if (mute)
+    setFlag(m.flags, MemberFlag::Mute, mute->asBool().value_or(false));
+  if (pending)
+    setFlag(m.flags, MemberFlag::Pending, pending->asBool().value_or(false));
+  g.put(g.members, g.memberIndex, slot, *id, m);
+}
+
+void Cache::upsertMembers(Guild& g, const Data& members)
+{
+  // storage is reserved once per list rather than grown member by member
+  usize n = members.size();
+  g.memberIndex.reserve(g.memberIndex.size() + n);
+  g.members.reserve(n);
+
+  if (has(CacheFlags::Users)) {
+    // users go in stripe by stripe, so each stripe is locked and grown once per list instead of once per member
+    userScratch.clear();
+    for (Data m : members.items())
+      if (auto user = m.find("user"))
+        if (auto id = snowflake(*user, "id"))
+          userScratch.emplace_back(*id, *user);
+    std::sort(userScratch.begin(), userScratch.end(),
+      [](const auto& a, const auto& b) { return stripe(a.first) < stripe(b.first); });
+
+    for (usize i = 0; i < userScratch.size();) {
+      usize s = stripe(userScratch[i].first);
+      usize end = i;
+      while (end < userScratch.size() && stripe(userScratch[end].first) == s) ++end;
+
+      std::lock_guard lock(usersMutex[s]);
+      Users& table = *users[s].load(std::memory_order_relaxed);
+      table.index.reserve(table.index.size() + (end - i));
+      table.records.reserve(end - i);
+      for (; i < end; ++i) writeUser(table, userScratch[i].first, userScratch[i].second);
+    }
+  }
+
+  for (Data m : members.items()) upsertMember(g, m, false);
+}
+
+void Cache::updatePresence(Guild& g, const Data& d)
+{
+  auto user = d.find("user");
+  auto id = user ? snowflake(*user, "id") : std::nullopt;
+  auto slot = id ? g.memberIndex.find(*id) : std::nullopt;
+  // presences are kept on the member record, there's nowhere to put them otherwise
+  if (!slot)
+    return;
+
+  // most presence updates repeat what's stored (another client coming online, an activity's timestamps moving), those
+  // are left at a read: no interning, and no store readers would have to retry on
+  const Member& stored = g.members[*slot];
+  Member m = stored;
+  for (auto [key, v] : d.fields()) {
+    if (key == "status") {
+      m.status = status(text(v));
+    } else if (key == "activities") {
+      auto first = v.at(0);
+      auto name = first ? first->find("name") : std::nullopt;
+      std::string_view s = name ? text(*name) : std::string_view{};
+      if (s != interner.get(m.activity))
+        m.activity = interner.intern(s);
+    }
+  }
+  if (m.status != stored.status || m.activity != stored.activity)
+    g.seq.store(g.members[*slot], m);
+}
+
+std::optional<u64> Cache::upsertUser(const Data& d)
+{
+  auto id = snowflake(d, "id");
+  if (!id || !has(CacheFlags::Users))
+    return id;
+
+  usize s = stripe(*id);
+  std::lock_guard lock(usersMutex[s]);
+  writeUser(*users[s].load(std::memory_order_relaxed), *id, d);
+  return id;
+}
+
+void Cache::writeUser(Users& table, u64 id, const Data& d)
+{
+  std::optional<Data> username, globalName, avatar, publicFlags, bot, system;
+  for (auto [key, v] : d.fields()) {
+    if (key == "username")
+      username = v;
+    else if (key == "global_name")
+      globalName = v;
+    else if (key == "avatar")
+      avatar = v;
+    else if (key == "public_flags")
+      publicFlags = v;
+    else if (key == "bot")
+      bot = v;
+    else if (key == "system")
+      system = v;
+  }
+
+  auto slot = table.index.find(id);
+  User u{};
+  u.id = id;
+  if (slot)
+    u = table.records[*slot];
+  if (username)
+    table.arena.replace(u.username, text(*username));
+  if (globalName)
+    table.arena.replace(u.globalName, text(*globalName));
+  if (publicFlags)
+    u.publicFlags = integer<u32>(*publicFlags);
+  if (bot)
+    setFlag(u.flags, UserFlag::Bot, bot->asBool().value_or(false));
+  if (system)
+    setFlag(u.flags, UserFlag::System, system->asBool().value_or(false));
+  if (avatar) {
+    bool animated = false;
+    setFlag(u.flags, UserFlag::HasAvatar, avatarHash(text(*avatar), u.avatar, animated));
+    setFlag(u.flags, UserFlag::AnimatedAvatar, animated);
+  }
+  if (slot) {
+    table.seq.store(table.records[*slot], u);
+  } else {
+    u32 s = table.records.add();
+    table.seq.store(table.records[s], u);
+    table.index.insertOrAssign(id, s);
+  }
+}
+}  // namespace twilight::cache
@@ -0,0 +1,138 @@
+#include "cache/epoch.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace twilight::cache
+{
+namespace
+{
+// reader slots per block, more blocks are chained on as threads need them
+constexpr usize BLOCK_SLOTS = 256;
+// retiring this many objects triggers a reclaim
+constexpr usize RECLAIM_THRESHOLD = 64;
+
+struct alignas(64) Slot {
+  // epoch the thread pinned, 0 while not pinned
+  std::atomic<u64> epoch{0};
+  std::atomic<bool> taken{false};
+};
+
+struct Retired {
+  void* p;
+  void (*deleter)(void*);
+  u64 epoch;
+};
+
+struct Block {
+  Slot slots[BLOCK_SLOTS];
+  // never freed once linked, a thread may be scanning it
+  std::atomic<Block*> next{nullptr};
+};
+
+std::atomic<u64> global{1};
+Block first;
+
+std::mutex retiredMutex;
+std::vector<Retired> retired;
+
+// claims a slot on the first pin and gives it back when the thread exits
+struct Local {
+  Slot* slot = nullptr;
+  usize depth = 0;
+
+  Slot& get()
+  {
+    if (slot)
+      return *slot;
+    for (Block* b = &first;;) {
+      for (Slot& s : b->slots) {
+        bool expected = false;
+        if (s.taken.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+          return *(slot = &s);
+      }
+      Block* next = b->next.load(std::memory_order_acquire);
+      if (!next) {
+        // every slot is taken, another thread may be adding the same block
+        auto fresh = new Block;
+        if (b->next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel))
+          next = fresh;
+        else
+          delete fresh;
+      }
+      b = next;
+    }
+  }
+
+  ~Local()
+  {
+    if (slot)
+      slot->taken.store(false, std::memory_order_release);
+  }
+};
+
+thread_local Local local;
+}  // namespace
+
+Epoch::Guard::Guard() noexcept
+{
+  if (local.depth++)
+    return;
+  // the pin must be visible before any shared pointer is loaded
+  local.get().epoch.store(global.load(std::memory_order_acquire), std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+Epoch::Guard::~Guard()
+{
+  if (--local.depth)
+    return;
+  local.slot->epoch.store(0, std::memory_order_release);
+}
+
+void Epoch::retire(void* p, void (*deleter)(void*))
+{
+  usize n;
+  {
+    std::lock_guard lock(retiredMutex);
+    // readers pinned after the bump can't have seen `p`, it was already unlinked
+    retired.push_back({p, deleter, global.fetch_add(1, std::memory_order_acq_rel)});
+    n = retired.size();
+  }
+  if (n >= RECLAIM_THRESHOLD)
+    reclaim();
+}
+
+usize Epoch::reclaim()
+{
+  // only what was retired before the scan can be judged by it
+  std::vector<Retired> candidates;
+  {
+    std::lock_guard lock(retiredMutex);
+    candidates.swap(retired);
+  }
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  u64 oldest = global.load(std::memory_order_acquire);
+  for (const Block* b = &first; b; b = b->next.load(std::memory_order_acquire))
+    for (const Slot& s : b->slots)
+      if (u64 e = s.epoch.load(std::memory_order_acquire))
+        oldest = std::min(oldest, e);
+
+  auto it = std::partition(candidates.begin(), candidates.end(), [&](const Retired& r) { return r.epoch >= oldest; });
+  if (it != candidates.begin()) {
+    std::lock_guard lock(retiredMutex);
+    retired.insert(retired.end(), candidates.begin(), it);
+  }
+
+  // deleters may retire more, so they run outside the lock
+  for (auto r = it; r != candidates.end(); ++r) r->deleter(r->p);
+  return candidates.end() - it;
+}
+
+usize Epoch::pending() noexcept
+{
+  std::lock_guard lock(retiredMutex);
+  return retired.size();
+}
+}  // namespace twilight::cache
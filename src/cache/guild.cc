@@ -0,0 +1,144 @@
+#include "cache/guild.h"
+
+namespace twilight::cache
+{
+Permission Guild::permissions(const Member& m) const noexcept
+{
+  // https://discord.com/developers/docs/topics/permissions#permission-overwrites
+  if (m.user == ownerId())
+    return Permission::All;
+
+  // @everyone shares the guild's id
+  auto everyone = role(guildId);
+  u64 p = everyone ? everyone->permissions : 0;
+  for (u16 slot : roleSlots(m)) {
+    Role r = roleAt(slot);
+    if (!(r.flags & RoleFlag::Deleted))
+      p |= r.permissions;
+  }
+
+  if (p & static_cast<u64>(Permission::ADMINISTRATOR))
+    return Permission::All;
+  return static_cast<Permission>(p);
+}
+
+Permission Guild::permissions(const Member& m, const Channel& c) const noexcept
+{
+  Permission base = permissions(m);
+  if (base == Permission::All)
+    return base;
+
+  u64 p = static_cast<u64>(base);
+  auto ow = overwrites(c);
+
+  for (const Overwrite& o : ow) {
+    if (o.id == guildId) {
+      p = (p & ~o.deny) | o.allow;
+      break;
+    }
+  }
+
+  u64 allow = 0, deny = 0;
+  for (u16 slot : roleSlots(m)) {
+    Role r = roleAt(slot);
+    if (!!(r.flags & RoleFlag::Deleted))
+      continue;
+    for (const Overwrite& o : ow) {
+      if (o.type == Overwrite::Type::Role && o.id == r.id) {
+        allow |= o.allow;
+        deny |= o.deny;
+      }
+    }
+  }
+  p = (p & ~deny) | allow;
+
+  for (const Overwrite& o : ow) {
+    if (o.type == Overwrite::Type::Member && o.id == m.user) {
+      p = (p & ~o.deny) | o.allow;
+      break;
+    }
+  }
+
+  return static_cast<Permission>(p);
+}
+
+usize Guild::memoryUsage() const noexcept
+{
+  return sizeof(Guild) + arena.capacity() + memberIndex.memoryUsage() + members.memoryUsage() +
+         roleIndex.memoryUsage() + roles.memoryUsage() + channelIndex.memoryUsage() + channels.memoryUsage();
+}
+
+std::optional<Member> Guild::member(u64 user) const noexcept
+{
+  auto slot = memberIndex.find(user);
+  if (!slot)
+    return std::nullopt;
+  // the slot may have been reused between the lookup and the copy
+  Member m = seq.load(members[*slot]);
+  return m.user == user ? std::optional{m} : std::nullopt;
+}
+
+std::optional<Role> Guild::role(u64 id) const noexcept
+{
+  auto slot = roleIndex.find(id);
+  if (!slot)
+    return std::nullopt;
+  Role r = seq.load(roles[*slot]);
+  return r.id == id ? std::optional{r} : std::nullopt;
+}
+
+std::optional<Channel> Guild::channel(u64 id) const noexcept
+{
+  auto slot = channelIndex.find(id);
+  if (!slot)
+    return std::nullopt;
+  Channel c = seq.load(channels[*slot]);
+  return c.id == id ? std::optional{c} : std::nullopt;
+}
+
+bool Guild::removeMember(u64 user)
+{
+  auto slot = memberIndex.find(user);
+  if (!slot)
+    return false;
+
+  // readers that already found the slot see the old record until it's reused, then fail the id check
+  memberIndex.erase(user);
+  // only for the accounting, the record itself is left as is
+  Member m = members[*slot];
+  arena.replace(m.nick, {});
+  arena.replace(m.roles, std::span<const u16>{});
+  members.remove(*slot);
+  return true;
+}
+
+bool Guild::removeRole(u64 id)
+{
+  auto slot = roleIndex.find(id);
+  if (!slot)
+    return false;
+
+  // members may still hold the slot, the record stays behind as a tombstone
+  roleIndex.erase(id);
+  Role r = roles[*slot];
+  r.flags |= RoleFlag::Deleted;
+  seq.store(roles[*slot], r);
+  roles.remove(*slot);
+  return true;
+}
+
+bool Guild::removeChannel(u64 id)
+{
+  auto slot = channelIndex.find(id);
+  if (!slot)
+    return false;
+
+  channelIndex.erase(id);
+  Channel c = channels[*slot];
+  arena.replace(c.name, {});
+  arena.replace(c.topic, {});
+  arena.replace(c.overwrites, std::span<const Overwrite>{});
+  channels.remove(*slot);
+  return true;
+}
+}  // namespace twilight::cache
@@ -0,0 +1,32 @@
+#include "cache/interner.h"
+
+namespace twilight::cache
+{
+Ref Interner::intern(std::string_view s)
+{
+  if (s.empty())
+    return 0;
+
+  std::lock_guard lock(mutex);
+  if (auto it = refs.find(s); it != refs.end())
+    return it->second;
+
+  Ref ref = arena.store(s);
+  refs.emplace(arena.string(ref), ref);
+  return ref;
+}
+
+usize Interner::size() const noexcept
+{
+  std::lock_guard lock(mutex);
+  return refs.size();
+}
+
+usize Interner::memoryUsage() const noexcept
+{
+  std::lock_guard lock(mutex);
+  // rough estimate of the node-based map: one node per entry plus the bucket array
+  return arena.capacity() + refs.size() * (sizeof(std::string_view) + sizeof(Ref) + 2 * sizeof(void*)) +
+         refs.bucket_count() * sizeof(void*);
+}
+}  // namespace twilight::cache
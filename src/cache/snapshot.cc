@@ -0,0 +1,511 @@
+#include "cache/snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace twilight::cache
+{
+namespace
+{
+constexpr char MAGIC[8] = {'T', 'W', 'L', 'S', 'N', 'A', 'P', '1'};
+// Member and Channel are pinned to 32 bytes where they're declared
+constexpr u32 LAYOUT = sizeof(User) << 24 | sizeof(Role) << 16 | sizeof(Overwrite) << 8 | sizeof(Guild::Info);
+constexpr usize BUFFER = 1 << 20;
+
+inline usize padded(usize n) noexcept
+{
+  return (n + 7) & ~usize{7};
+}
+
+// buffered writes to the snapshot file, with a running crc the caller resets per section
+struct Output {
+  int fd;
+  std::string buf{};
+  u64 pos = 0;
+  uLong crc = 0;
+
+  void write(const void* p, usize n)
+  {
+    crc = crc32_z(crc, static_cast<const Bytef*>(p), n);
+    buf.append(static_cast<const char*>(p), n);
+    pos += n;
+    if (buf.size() >= BUFFER)
+      flush();
+  }
+  template <typename T>
+  void put(const T& v)
+  {
+    write(&v, sizeof(v));
+  }
+  template <typename T>
+  void put(std::span<const T> items)
+  {
+    write(items.data(), items.size_bytes());
+  }
+  void pad()
+  {
+    static constexpr char zeros[8]{};
+    write(zeros, padded(pos) - pos);
+  }
+  void flush()
+  {
+    for (usize done = 0; done < buf.size();) {
+      isize n = ::write(fd, buf.data() + done, buf.size() - done);
+      if (n <= 0)
+        throw std::runtime_error("Failed to write snapshot");
+      done += n;
+    }
+    buf.clear();
+  }
+};
+
+// reads that can't run past the end of a section, `ok` is cleared instead
+struct Input {
+  const char* data;
+  usize size;
+  usize pos = 0;
+  bool ok = true;
+
+  const char* take(usize n) noexcept
+  {
+    if (size - pos < n) {
+      ok = false;
+      return nullptr;
+    }
+    const char* p = data + pos;
+    pos += n;
+    return p;
+  }
+  template <typename T>
+  T get() noexcept
+  {
+    T v{};
+    if (const char* p = take(sizeof(T)))
+      std::memcpy(&v, p, sizeof(T));
+    return v;
+  }
+  void align() noexcept { pos = std::min(size, padded(pos)); }
+};
+
+void writeArena(Output& out, const Arena& arena)
+{
+  std::vector<u32> lengths;
+  arena.forEachChunk([&](std::string_view chunk) { lengths.push_back(chunk.size()); });
+  out.put<u32>(lengths.size());
+  out.put<u32>(0);
+  out.put(std::span<const u32>{lengths});
+  out.pad();
+  arena.forEachChunk([&](std::string_view chunk) {
+    out.write(chunk.data(), chunk.size());
+    out.pad();
+  });
+}
+
+// chunks are never empty (the first has its reserved byte) and refs can only address 64k of them
+std::vector<std::string_view> readArena(Input& in)
+{
+  u32 n = in.get<u32>();
+  in.get<u32>();
+  std::vector<std::string_view> chunks;
+  if (n > Arena::CHUNK)
+    in.ok = false;
+  const char* lengths = in.take(n * sizeof(u32));
+  in.align();
+  for (u32 i = 0; in.ok && i < n; ++i) {
+    u32 len;
+    std::memcpy(&len, lengths + i * sizeof(u32), sizeof(len));
+    if (!len || len > Arena::CHUNK) {
+      in.ok = false;
+      break;
+    }
+    chunks.emplace_back(in.take(len), len);
+    in.align();
+  }
+  return chunks;
+}
+
+template <typename T>
+const char* readRecords(Input& in, u32 n)
+{
+  const char* p = in.take(usize{n} * sizeof(T));
+  in.align();
+  return p;
+}
+
+template <typename T>
+inline T record(const char* records, usize i) noexcept
+{
+  T v;
+  std::memcpy(&v, records + i * sizeof(T), sizeof(T));
+  return v;
+}
+
+void fill(Arena& arena, const std::vector<std::string_view>& chunks)
+{
+  for (std::string_view chunk : chunks) arena.append(chunk);
+}
+
+}  // namespace
+
+void Snapshot::write(const std::string& path, const Cache& cache, std::span<const ShardSession> sessions)
+{
+  std::string tmp = path + ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    throw std::runtime_error("Failed to create snapshot file");
+
+  Epoch::Guard guard;
+  SnapshotHeader h{};
+  std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = FORMAT;
+  h.layout = LAYOUT;
+  h.created = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch())
+                .count();
+  h.flags = cache.flags();
+  h.sessions = sessions.size();
+
+  try {
+    Output out{fd};
+    out.put(h);
+    out.crc = 0;
+
+    for (const ShardSession& s : sessions) {
+      out.put(s.shard);
+      out.put(s.count);
+      out.put(s.session.seq);
+      out.put<u32>(s.session.id.size());
+      out.put<u32>(s.session.resumeUrl.size());
+      out.write(s.session.id.data(), s.session.id.size());
+      out.write(s.session.resumeUrl.data(), s.session.resumeUrl.size());
+      out.pad();
+    }
+
+    // append-only and never wasteful, copied as is
+    h.interner = out.pos;
+    {
+      std::lock_guard lock(cache.interner.mutex);
+      std::vector<Ref> refs;
+      refs.reserve(cache.interner.refs.size());
+      for (const auto& [s, ref] : cache.interner.refs) refs.push_back(ref);
+      out.put<u32>(refs.size());
+      out.put<u32>(0);
+      writeArena(out, cache.interner.arena);
+      out.put(std::span<const Ref>{refs});
+      out.pad();
+    }
+
+    h.users = out.pos;
+    for (const auto& stripe : cache.users) {
+      const Cache::Users& u = *stripe.load(std::memory_order_acquire);
+      Arena arena;
+      std::vector<User> records;
+      u.index.forEach([&](u64 id, u32 slot) {
+        User user = u.records[slot];
+        if (user.id != id)
+          return;
+        user.username = arena.store(u.arena.string(user.username));
+        user.globalName = arena.store(u.arena.string(user.globalName));
+        records.push_back(user);
+      });
+      out.put<u32>(records.size());
+      out.put<u32>(0);
+      writeArena(out, arena);
+      out.put(std::span<const User>{records});
+      out.pad();
+    }
+
+    // every guild has its own crc, left out of the file's
+    h.sections = out.pos;
+    uLong crc = out.crc;
+    std::vector<SnapshotEntry> entries;
+    auto section = [&](u64 id, auto&& body) {
+      out.crc = 0;
+      u64 start = out.pos;
+      body();
+      entries.push_back({id, start, out.pos - start, static_cast<u32>(out.crc), 0});
+    };
+
+    std::vector<Role> roles;
+    std::vector<Member> members;
+    std::vector<Channel> channels;
+    // the guild's live records with their strings and lists copied to a fresh arena, deleted roles kept for their
+    // slots
+    cache.guilds.forEach([&](u64 id, const Guild* g) {
+      if (g->id() != id)
+        return;
+      Arena arena;
+      SnapshotGuild header{};
+      header.id = id;
+      header.info = g->state;
+      header.info.name = arena.store(g->arena.string(header.info.name));
+
+      roles.clear();
+      for (u32 slot = 0; slot < g->roles.slots(); ++slot) {
+        Role r = g->roles[slot];
+        r.name = !(r.flags & RoleFlag::Deleted) ? arena.store(g->arena.string(r.name)) : 0;
+        roles.push_back(r);
+      }
+      members.clear();
+      g->memberIndex.forEach([&](u64 user, u32 slot) {
+        Member m = g->members[slot];
+        if (m.user != user)
+          return;
+        m.nick = arena.store(g->arena.string(m.nick));
+        m.roles = arena.storeArray(g->roleSlots(g->members[slot]));
+        members.push_back(m);
+      });
+      channels.clear();
+      g->channelIndex.forEach([&](u64 channel, u32 slot) {
+        Channel c = g->channels[slot];
+        if (c.id != channel)
+          return;
+        c.name = arena.store(g->arena.string(c.name));
+        c.topic = arena.store(g->arena.string(c.topic));
+        c.overwrites = arena.storeArray(g->overwrites(g->channels[slot]));
+        channels.push_back(c);
+      });
+
+      header.roles = roles.size();
+      header.members = members.size();
+      header.channels = channels.size();
+      section(id, [&] {
+        out.put(header);
+        writeArena(out, arena);
+        out.put(std::span<const Role>{roles});
+        out.pad();
+        out.put(std::span<const Member>{members});
+        out.pad();
+        out.put(std::span<const Channel>{channels});
+        out.pad();
+      });
+    });
+
+    // guilds nothing asked for since the last restore, still in the snapshot they came from
+    if (const Snapshot* old = cache.snapshot.get())
+      for (usize i = 0; i < old->guilds(); ++i) {
+        if (cache.restored[i].load() != Cache::Pending)
+          continue;
+        SnapshotEntry e = old->entry(i);
+        section(e.id, [&] { out.write(old->data + e.offset, e.size); });
+      }
+
+    out.crc = crc;
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.id < b.id; });
+    h.table = out.pos;
+    h.guilds = entries.size();
+    out.put(std::span<const SnapshotEntry>{entries});
+    h.size = out.pos;
+    out.flush();
+
+    h.crc = crc32_z(out.crc, reinterpret_cast<const Bytef*>(&h), sizeof(h));
+    if (pwrite(fd, &h, sizeof(h), 0) != sizeof(h) || fsync(fd) != 0)
+      throw std::runtime_error("Failed to write snapshot");
+  } catch (...) {
+    ::close(fd);
+    ::unlink(tmp.c_str());
+    throw;
+  }
+
+  ::close(fd);
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    ::unlink(tmp.c_str());
+    throw std::runtime_error("Failed to replace snapshot file");
+  }
+}
+
+std::expected<std::shared_ptr<const Snapshot>, std::string> Snapshot::open(const std::string& path) noexcept
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return std::unexpected("Failed to open snapshot file");
+
+  struct stat st{};
+  if (fstat(fd, &st) != 0 || static_cast<usize>(st.st_size) < sizeof(SnapshotHeader)) {
+    ::close(fd);
+    return std::unexpected("Truncated snapshot header");
+  }
+
+  usize length = st.st_size;
+  void* m = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (m == MAP_FAILED)
+    return std::unexpected("Failed to map snapshot file");
+  // guilds are read in whatever order they're asked for
+  madvise(m, length, MADV_RANDOM);
+
+  SnapshotHeader h;
+  std::memcpy(&h, m, sizeof(h));
+  // owns the mapping from here on
+  std::shared_ptr<Snapshot> s{new Snapshot(static_cast<const char*>(m), length, h)};
+
+  if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+    return std::unexpected("Not a snapshot file");
+  if (h.version != FORMAT || h.layout != LAYOUT)
+    return std::unexpected("Snapshot written by an incompatible version");
+  if (h.size != length || h.interner < sizeof(h) || h.interner > h.users || h.users > h.sections ||
+      h.sections > h.table || h.table > length || length - h.table != h.guilds * sizeof(SnapshotEntry))
+    return std::unexpected("Truncated snapshot");
+
+  const char* data = s->data;
+  uLong crc = crc32_z(0, reinterpret_cast<const Bytef*>(data + sizeof(h)), h.sections - sizeof(h));
+  crc = crc32_z(crc, reinterpret_cast<const Bytef*>(data + h.table), length - h.table);
+  SnapshotHeader zeroed = h;
+  zeroed.crc = 0;
+  if (crc32_z(crc, reinterpret_cast<const Bytef*>(&zeroed), sizeof(zeroed)) != h.crc)
+    return std::unexpected("Snapshot checksum mismatch");
+
+  // the checksum passed, anything out of bounds from here on is a bug rather than damage
+  Input sessions{data, h.interner, sizeof(h)};
+  for (u32 i = 0; i < h.sessions && sessions.ok; ++i) {
+    ShardSession session{};
+    session.shard = sessions.get<u32>();
+    session.count = sessions.get<u32>();
+    session.session.seq = sessions.get<u64>();
+    u32 id = sessions.get<u32>(), url = sessions.get<u32>();
+    if (const char* p = sessions.take(usize{id} + url)) {
+      session.session.id.assign(p, id);
+      session.session.resumeUrl.assign(p + id, url);
+    }
+    sessions.align();
+    s->shardSessions.push_back(std::move(session));
+  }
+
+  Input interner{data, h.users, h.interner};
+  s->internerImage.count = interner.get<u32>();
+  interner.get<u32>();
+  s->internerImage.chunks = readArena(interner);
+  s->internerImage.records = readRecords<Ref>(interner, s->internerImage.count);
+
+  Input users{data, h.sections, h.users};
+  for (Image& image : s->userImages) {
+    image.count = users.get<u32>();
+    users.get<u32>();
+    image.chunks = readArena(users);
+    image.records = readRecords<User>(users, image.count);
+  }
+
+  for (usize i = 0; i < h.guilds; ++i)
+    if (SnapshotEntry e = s->entry(i); e.offset < h.sections || e.offset > h.table || e.size > h.table - e.offset)
+      return std::unexpected("Snapshot guild table out of bounds");
+  if (!sessions.ok || !interner.ok || !users.ok)
+    return std::unexpected("Malformed snapshot");
+  return s;
+}
+
+Snapshot::~Snapshot()
+{
+  munmap(const_cast<char*>(data), length);
+}
+
+std::optional<gateway::Session> Snapshot::session(u32 shard, u32 count) const
+{
+  for (const ShardSession& s : shardSessions)
+    if (s.shard == shard && s.count == count && !s.session.id.empty())
+      return s.session;
+  return std::nullopt;
+}
+
+SnapshotEntry Snapshot::entry(usize i) const noexcept
+{
+  return record<SnapshotEntry>(data + head.table, i);
+}
+
+std::optional<usize> Snapshot::find(u64 id) const noexcept
+{
+  usize lo = 0, hi = head.guilds;
+  while (lo < hi) {
+    usize mid = lo + (hi - lo) / 2;
+    u64 at = this->id(mid);
+    if (at == id)
+      return mid;
+    if (at < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return std::nullopt;
+}
+
+std::unique_ptr<Guild> Snapshot::guild(usize i) const
+{
+  SnapshotEntry e = entry(i);
+  if (crc32_z(0, reinterpret_cast<const Bytef*>(data + e.offset), e.size) != e.crc)
+    return nullptr;
+
+  Input in{data + e.offset, e.size};
+  auto header = in.get<SnapshotGuild>();
+  auto chunks = readArena(in);
+  const char* roles = readRecords<Role>(in, header.roles);
+  const char* members = readRecords<Member>(in, header.members);
+  const char* channels = readRecords<Channel>(in, header.channels);
+  // role slots are u16
+  if (!in.ok || header.id != e.id || header.roles > UINT16_MAX + 1)
+    return nullptr;
+
+  // not published yet, records are written directly
+  auto g = std::make_unique<Guild>(header.id);
+  fill(g->arena, chunks);
+  g->state = header.info;
+
+  for (u32 r = 0; r < header.roles; ++r) {
+    Role role = record<Role>(roles, r);
+    auto slot = static_cast<u16>(g->roles.add());
+    g->roles[slot] = role;
+    if (!!(role.flags & RoleFlag::Deleted))
+      g->roles.remove(slot);
+    else
+      g->roleIndex.insertOrAssign(role.id, slot);
+  }
+  g->members.reserve(header.members);
+  g->memberIndex.reserve(header.members);
+  for (u32 m = 0; m < header.members; ++m) {
+    Member member = record<Member>(members, m);
+    u32 slot = g->members.add();
+    g->members[slot] = member;
+    g->memberIndex.insertOrAssign(member.user, slot);
+  }
+  g->channels.reserve(header.channels);
+  g->channelIndex.reserve(header.channels);
+  for (u32 c = 0; c < header.channels; ++c) {
+    Channel channel = record<Channel>(channels, c);
+    u32 slot = g->channels.add();
+    g->channels[slot] = channel;
+    g->channelIndex.insertOrAssign(channel.id, slot);
+  }
+  return g;
+}
+
+void Snapshot::restore(Interner& interner) const
+{
+  std::lock_guard lock(interner.mutex);
+  fill(interner.arena, internerImage.chunks);
+  interner.refs.reserve(internerImage.count);
+  for (u32 i = 0; i < internerImage.count; ++i) {
+    Ref ref = record<Ref>(internerImage.records, i);
+    interner.refs.emplace(interner.arena.string(ref), ref);
+  }
+}
+
+void Snapshot::restore(usize stripe, Cache::Users& users) const
+{
+  const Image& image = userImages[stripe];
+  fill(users.arena, image.chunks);
+  users.records.reserve(image.count);
+  users.index.reserve(image.count);
+  for (u32 i = 0; i < image.count; ++i) {
+    User user = record<User>(image.records, i);
+    u32 slot = users.records.add();
+    users.records[slot] = user;
+    users.index.insertOrAssign(user.id, slot);
+  }
+}
+}  // namespace twilight::cache
@@ -0,0 +1,110 @@
+#include "crypto/ed25519.h"
+
+#include <openssl/evp.h>
+
+#include <stdexcept>
+#include <utility>
+
+namespace twilight::crypto
+{
+namespace
+{
+struct MdCtx {
+  EVP_MD_CTX* ptr = EVP_MD_CTX_new();
+  ~MdCtx() { EVP_MD_CTX_free(ptr); }
+};
+
+// ed25519 can't be fed in pieces, so both parts are joined in a per-thread buffer that keeps its capacity
+std::string_view join(std::string_view prefix, std::string_view message) noexcept
+{
+  if (prefix.empty())
+    return message;
+  thread_local std::string scratch;
+  scratch.assign(prefix);
+  scratch.append(message);
+  return scratch;
+}
+}  // namespace
+
+std::string hex(std::string_view data) noexcept
+{
+  constexpr char DIGITS[] = "0123456789abcdef";
+  std::string out(data.size() * 2, '\0');
+  for (usize i = 0; i < data.size(); ++i) {
+    u8 b = static_cast<u8>(data[i]);
+    out[i * 2] = DIGITS[b >> 4];
+    out[i * 2 + 1] = DIGITS[b & 0xf];
+  }
+  return out;
+}
+
+Verifier::Verifier(const PublicKey& key)
+  : key(EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, nullptr, key.data(), key.size()))
+{
+  if (!this->key)
+    throw std::runtime_error("ed25519: invalid public key");
+}
+
+Verifier::Verifier(std::string_view key)
+{
+  PublicKey raw;
+  if (!fromHex(key, raw))
+    throw std::runtime_error("ed25519: public key must be 64 hex digits");
+  this->key = EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, nullptr, raw.data(), raw.size());
+  if (!this->key)
+    throw std::runtime_error("ed25519: invalid public key");
+}
+
+Verifier::~Verifier() { EVP_PKEY_free(key); }
+
+bool Verifier::verify(const Signature& signature, std::string_view prefix, std::string_view message) const noexcept
+{
+  MdCtx ctx;
+  if (!ctx.ptr || EVP_DigestVerifyInit(ctx.ptr, nullptr, nullptr, nullptr, key) != 1)
+    return false;
+  std::string_view msg = join(prefix, message);
+  return EVP_DigestVerify(ctx.ptr, signature.data(), signature.size(), reinterpret_cast<const u8*>(msg.data()),
+           msg.size()) == 1;
+}
+
+bool Verifier::verify(std::string_view signature, std::string_view prefix, std::string_view message) const noexcept
+{
+  Signature raw;
+  return fromHex(signature, raw) && verify(raw, prefix, message);
+}
+
+KeyPair KeyPair::generate()
+{
+  EVP_PKEY* key = nullptr;
+  EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519, nullptr);
+  bool ok = ctx && EVP_PKEY_keygen_init(ctx) == 1 && EVP_PKEY_keygen(ctx, &key) == 1;
+  EVP_PKEY_CTX_free(ctx);
+  if (!ok)
+    throw std::runtime_error("ed25519: key generation failed");
+  return KeyPair{key};
+}
+
+KeyPair::~KeyPair() { EVP_PKEY_free(key); }
+
+KeyPair::KeyPair(KeyPair&& other) noexcept : key(std::exchange(other.key, nullptr)) {}
+
+PublicKey KeyPair::publicKey() const noexcept
+{
+  PublicKey out{};
+  usize len = out.size();
+  EVP_PKEY_get_raw_public_key(key, out.data(), &len);
+  return out;
+}
+
+Signature KeyPair::sign(std::string_view prefix, std::string_view message) const
+{
+  MdCtx ctx;
+  Signature out;
+  usize len = out.size();
+  std::string_view msg = join(prefix, message);
+  if (!ctx.ptr || EVP_DigestSignInit(ctx.ptr, nullptr, nullptr, nullptr, key) != 1 ||
+      EVP_DigestSign(ctx.ptr, out.data(), &len, reinterpret_cast<const u8*>(msg.data()), msg.size()) != 1)
+    throw std::runtime_error("ed25519: signing failed");
+  return out;
+}
+}  // namespace twilight::crypto
@@ -0,0 +1,197 @@
+#include "crypto/sha1.h"
+
+#include <bit>
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define TWILIGHT_SHA_NI 1
+#endif
+
+namespace twilight::crypto
+{
+namespace
+{
+using Compress = void (*)(u32* state, const u8* blocks, usize count) noexcept;
+
+inline u32 load(const u8* p) noexcept
+{
+  u32 v;
+  std::memcpy(&v, p, sizeof(v));
+  return std::endian::native == std::endian::little ? std::byteswap(v) : v;
+}
+
+// the message schedule is kept as a 16 word ring instead of expanding all 80 words up front
+void compressScalar(u32* state, const u8* blocks, usize count) noexcept
+{
+  for (; count; --count, blocks += Sha1::BLOCK) {
+    u32 w[16];
+    for (usize i = 0; i < 16; ++i) w[i] = load(blocks + i * 4);
+
+    u32 a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    auto round = [&](usize i, u32 f, u32 k) {
+      if (i >= 16)
+        w[i & 15] = std::rotl(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+      u32 t = std::rotl(a, 5) + f + e + k + w[i & 15];
+      e = d;
+      d = c;
+      c = std::rotl(b, 30);
+      b = a;
+      a = t;
+    };
+    for (usize i = 0; i < 20; ++i) round(i, d ^ (b & (c ^ d)), 0x5A827999);
+    for (usize i = 20; i < 40; ++i) round(i, b ^ c ^ d, 0x6ED9EBA1);
+    for (usize i = 40; i < 60; ++i) round(i, (b & c) | (d & (b | c)), 0x8F1BBCDC);
+    for (usize i = 60; i < 80; ++i) round(i, b ^ c ^ d, 0xCA62C1D6);
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+  }
+}
+
+#ifdef TWILIGHT_SHA_NI
+#define SHA_NI __attribute__((target("sha,sse4.1")))
+
+// four rounds of group G. the schedule for group G+1..G+3 is advanced on the way: msg1 starts the words three groups
+// ahead, the xor adds the ones two ahead and msg2 finishes the next group's
+template <int G>
+SHA_NI inline void group(__m128i& abcd, __m128i (&e)[2], __m128i (&m)[4], const u8* block, __m128i mask) noexcept
+{
+  if constexpr (G < 4)
+    m[G] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + G * 16)), mask);
+
+  if constexpr (G == 0)
+    e[0] = _mm_add_epi32(e[0], m[0]);
+  else
+    e[G % 2] = _mm_sha1nexte_epu32(e[G % 2], m[G % 4]);
+  e[(G + 1) % 2] = abcd;
+  if constexpr (G >= 3 && G <= 18)
+    m[(G + 1) % 4] = _mm_sha1msg2_epu32(m[(G + 1) % 4], m[G % 4]);
+  abcd = _mm_sha1rnds4_epu32(abcd, e[G % 2], G / 5);
+  if constexpr (G >= 1 && G <= 16)
+    m[(G + 3) % 4] = _mm_sha1msg1_epu32(m[(G + 3) % 4], m[G % 4]);
+  if constexpr (G >= 2 && G <= 17)
+    m[(G + 2) % 4] = _mm_xor_si128(m[(G + 2) % 4], m[G % 4]);
+}
+
+template <int... G>
+SHA_NI inline void rounds(__m128i& abcd, __m128i (&e)[2], __m128i (&m)[4], const u8* block, __m128i mask,
+  std::integer_sequence<int, G...>) noexcept
+{
+  (group<G>(abcd, e, m, block, mask), ...);
+}
+
+SHA_NI void compressShaNi(u32* state, const u8* blocks, usize count) noexcept
+{
+  const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+  __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+  for (; count; --count, blocks += Sha1::BLOCK) {
+    __m128i abcdSave = abcd, eSave = e0;
+    __m128i e[2] = {e0, _mm_setzero_si128()};
+    __m128i m[4];
+    rounds(abcd, e, m, blocks, mask, std::make_integer_sequence<int, 20>{});
+    e0 = _mm_sha1nexte_epu32(e[0], eSave);
+    abcd = _mm_add_epi32(abcd, abcdSave);
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+  state[4] = static_cast<u32>(_mm_extract_epi32(e0, 3));
+}
+
+bool hasShaNi() noexcept
+{
+  u32 a, b, c, d;
+  if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSE4_1))
+    return false;
+  return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_SHA);
+}
+#endif
+
+Compress pick() noexcept
+{
+#ifdef TWILIGHT_SHA_NI
+  if (hasShaNi())
+    return compressShaNi;
+#endif
+  return compressScalar;
+}
+
+// picked on first use, so hashing during another file's static initialization still works
+inline Compress compressor() noexcept
+{
+  static const Compress c = pick();
+  return c;
+}
+}  // namespace
+
+void Sha1::update(const u8* data, usize size) noexcept
+{
+  length += size;
+  if (buffered) {
+    usize n = std::min(size, BLOCK - buffered);
+    std::memcpy(buffer.data() + buffered, data, n);
+    buffered += n;
+    data += n;
+    size -= n;
+    if (buffered < BLOCK)
+      return;
+    compressor()(state.data(), buffer.data(), 1);
+    buffered = 0;
+  }
+
+  if (usize blocks = size / BLOCK) {
+    compressor()(state.data(), data, blocks);
+    data += blocks * BLOCK;
+    size -= blocks * BLOCK;
+  }
+  std::memcpy(buffer.data(), data, size);
+  buffered = size;
+}
+
+Sha1::Digest Sha1::final() noexcept
+{
+  u64 bits = length * 8;
+  buffer[buffered++] = 0x80;
+  if (buffered > BLOCK - 8) {
+    std::memset(buffer.data() + buffered, 0, BLOCK - buffered);
+    compressor()(state.data(), buffer.data(), 1);
+    buffered = 0;
+  }
+  std::memset(buffer.data() + buffered, 0, BLOCK - 8 - buffered);
+  for (usize i = 0; i < 8; ++i) buffer[BLOCK - 1 - i] = static_cast<u8>(bits >> (i * 8));
+  compressor()(state.data(), buffer.data(), 1);
+
+  Digest out;
+  for (usize i = 0; i < 5; ++i) {
+    out[i * 4] = static_cast<u8>(state[i] >> 24);
+    out[i * 4 + 1] = static_cast<u8>(state[i] >> 16);
+    out[i * 4 + 2] = static_cast<u8>(state[i] >> 8);
+    out[i * 4 + 3] = static_cast<u8>(state[i]);
+  }
+  *this = Sha1{};
+  return out;
+}
+
+Sha1::Digest Sha1::hash(std::string_view data) noexcept
+{
+  Sha1 h;
+  h.update(data);
+  return h.final();
+}
+
+std::string_view Sha1::backend() noexcept
+{
+#ifdef TWILIGHT_SHA_NI
+  if (compressor() == compressShaNi)
+    return "sha-ni";
+#endif
+  return "scalar";
+}
+}  // namespace twilight::crypto
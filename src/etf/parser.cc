@@ -0,0 +1,455 @@
+#include "etf/parser.h"
+
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+using twilight::etf::Tag;
+
+inline u16 be16(const u8* p) noexcept { return static_cast<u16>(p[0] << 8 | p[1]); }
+
+inline u32 be32(const u8* p) noexcept
+{
+  return static_cast<u32>(p[0]) << 24 | static_cast<u32>(p[1]) << 16 | static_cast<u32>(p[2]) << 8 | p[3];
+}
+
+inline u64 be64(const u8* p) noexcept { return static_cast<u64>(be32(p)) << 32 | be32(p + 4); }
+
+// returns a pointer past the term at `p`, or nullptr if it's truncated or unknown
+const u8* skip(const u8* p, const u8* end) noexcept
+{
+  // number of terms left to skip; containers add their children instead of recursing
+  u64 pending = 1;
+
+  while (pending--) {
+    if (p >= end)
+      return nullptr;
+
+    usize avail = end - p - 1;
+    usize len = 0;  // bytes following the tag
+
+    switch (static_cast<Tag>(*p)) {
+    case Tag::SmallInteger:
+      len = 1;
+      break;
+    case Tag::Integer:
+      len = 4;
+      break;
+    case Tag::NewFloat:
+      len = 8;
+      break;
+    case Tag::Float:
+      len = 31;
+      break;
+    case Tag::Nil:
+      break;
+    case Tag::SmallAtom:
+    case Tag::SmallAtomUtf8:
+      if (avail < 1)
+        return nullptr;
+      len = 1 + p[1];
+      break;
+    case Tag::Atom:
+    case Tag::AtomUtf8:
+    case Tag::String:
+      if (avail < 2)
+        return nullptr;
+      len = 2 + be16(p + 1);
+      break;
+    case Tag::Binary:
+      if (avail < 4)
+        return nullptr;
+      len = 4 + static_cast<usize>(be32(p + 1));
+      break;
+    case Tag::SmallBig:
+      if (avail < 1)
+        return nullptr;
+      len = 2 + p[1];
+      break;
+    case Tag::LargeBig:
+      if (avail < 4)
+        return nullptr;
+      len = 5 + static_cast<usize>(be32(p + 1));
+      break;
+    case Tag::SmallTuple:
+      if (avail < 1)
+        return nullptr;
+      len = 1;
+      pending += p[1];
+      break;
+    case Tag::LargeTuple:
+      if (avail < 4)
+        return nullptr;
+      len = 4;
+      pending += be32(p + 1);
+      break;
+    case Tag::List:
+      if (avail < 4)
+        return nullptr;
+      len = 4;
+      pending += static_cast<u64>(be32(p + 1)) + 1;  // elements and the tail
+      break;
+    case Tag::Map:
+      if (avail < 4)
+        return nullptr;
+      len = 4;
+      pending += 2 * static_cast<u64>(be32(p + 1));
+      break;
+    default:
+      return nullptr;
+    }
+
+    if (avail < len)
+      return nullptr;
+    p += 1 + len;
+  }
+
+  return p;
+}
+
+inline std::optional<u64> decimal(std::string_view s) noexcept
+{
+  u64 ret = 0;
+  auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), ret);
+  if (s.empty() || ec != std::errc{} || ptr != s.data() + s.size())
+    return std::nullopt;
+  return ret;
+}
+}  // namespace
+
+namespace twilight::etf
+{
+std::expected<Value, std::string> parse(std::string_view data) noexcept
+{
+  if (data.empty() || static_cast<u8>(data[0]) != FORMAT_VERSION)
+    return std::unexpected("Invalid ETF version");
+  if (data.size() < 2)
+    return std::unexpected("Empty ETF term");
+
+  const u8* p = reinterpret_cast<const u8*>(data.data());
+  return Value{p + 1, p + data.size()};
+}
+
+std::optional<std::string_view> Value::atom() const noexcept
+{
+  if (!p || p >= end)
+    return std::nullopt;
+
+  switch (static_cast<Tag>(*p)) {
+  case Tag::SmallAtom:
+  case Tag::SmallAtomUtf8:
+    if (end - p < 2 || end - p - 2 < p[1])
+      return std::nullopt;
+    return std::string_view{reinterpret_cast<const char*>(p + 2), p[1]};
+  case Tag::Atom:
+  case Tag::AtomUtf8:
+    if (end - p < 3 || end - p - 3 < be16(p + 1))
+      return std::nullopt;
+    return std::string_view{reinterpret_cast<const char*>(p + 3), be16(p + 1)};
+  default:
+    return std::nullopt;
+  }
+}
+
+std::optional<std::pair<u64, bool>> Value::integer() const noexcept
+{
+  if (!p || p >= end)
+    return std::nullopt;
+
+  usize avail = end - p - 1;
+  switch (static_cast<Tag>(*p)) {
+  case Tag::SmallInteger:
+    if (avail < 1)
+      return std::nullopt;
+    return std::pair<u64, bool>{p[1], false};
+  case Tag::Integer: {
+    if (avail < 4)
+      return std::nullopt;
+    i32 v = static_cast<i32>(be32(p + 1));
+    return std::pair<u64, bool>{v < 0 ? -static_cast<u64>(v) : static_cast<u64>(v), v < 0};
+  }
+  case Tag::SmallBig:
+  case Tag::LargeBig: {
+    bool small = static_cast<Tag>(*p) == Tag::SmallBig;
+    usize hdr = small ? 2 : 5;
+    if (avail < hdr)
+      return std::nullopt;
+    usize n = small ? p[1] : be32(p + 1);
+    if (avail - hdr < n)
+      return std::nullopt;
+
+    const u8* digits = p + 1 + hdr;
+    // drop leading zero digits (little-endian, so trailing in memory)
+    while (n && !digits[n - 1]) --n;
+    if (n > 8)
+      return std::nullopt;
+
+    u64 v = 0;
+    for (usize i = n; i-- > 0;) v = v << 8 | digits[i];
+    return std::pair<u64, bool>{v, p[hdr] != 0};
+  }
+  default:
+    return std::nullopt;
+  }
+}
+
+Type Value::type() const noexcept
+{
+  if (!p || p >= end)
+    return Type::Invalid;
+
+  switch (static_cast<Tag>(*p)) {
+  case Tag::SmallInteger:
+  case Tag::Integer:
+  case Tag::SmallBig:
+  case Tag::LargeBig:
+  case Tag::NewFloat:
+  case Tag::Float:
+    return Type::Number;
+  case Tag::Binary:
+  case Tag::String:
+    return Type::String;
+  case Tag::Nil:
+  case Tag::List:
+  case Tag::SmallTuple:
+  case Tag::LargeTuple:
+    return Type::Array;
+  case Tag::Map:
+    return Type::Object;
+  case Tag::SmallAtom:
+  case Tag::SmallAtomUtf8:
+  case Tag::Atom:
+  case Tag::AtomUtf8: {
+    auto a = atom();
+    if (!a.has_value())
+      return Type::Invalid;
+    if (*a == "nil" || *a == "null")
+      return Type::Null;
+    if (*a == "true" || *a == "false")
+      return Type::Bool;
+    return Type::String;
+  }
+  default:
+    return Type::Invalid;
+  }
+}
+
+std::optional<Value> Value::find(std::string_view key) const noexcept
+{
+  for (auto [k, v] : fields()) {
+    if (k == key)
+      return v;
+  }
+  return std::nullopt;
+}
+
+std::optional<Value> Value::at(usize index) const noexcept
+{
+  for (Value v : items()) {
+    if (!index--)
+      return v;
+  }
+  return std::nullopt;
+}
+
+usize Value::size() const noexcept
+{
+  if (!p || p >= end)
+    return 0;
+
+  usize avail = end - p - 1;
+  switch (static_cast<Tag>(*p)) {
+  case Tag::SmallTuple:
+    return avail >= 1 ? p[1] : 0;
+  case Tag::LargeTuple:
+  case Tag::List:
+  case Tag::Map:
+    return avail >= 4 ? be32(p + 1) : 0;
+  default:
+    return 0;
+  }
+}
+
+std::optional<bool> Value::asBool() const noexcept
+{
+  auto a = atom();
+  if (a == "true")
+    return true;
+  if (a == "false")
+    return false;
+  return std::nullopt;
+}
+
+std::optional<i64> Value::asInt() const noexcept
+{
+  auto v = integer();
+  if (!v.has_value())
+    return std::nullopt;
+
+  auto [mag, neg] = *v;
+  if (neg) {
+    if (mag > static_cast<u64>(std::numeric_limits<i64>::max()) + 1)
+      return std::nullopt;
+    return static_cast<i64>(-mag);
+  }
+  if (mag > static_cast<u64>(std::numeric_limits<i64>::max()))
+    return std::nullopt;
+  return static_cast<i64>(mag);
+}
+
+std::optional<u64> Value::asUint() const noexcept
+{
+  auto v = integer();
+  if (!v.has_value() || (v->second && v->first))
+    return std::nullopt;
+  return v->first;
+}
+
+std::optional<f64> Value::asDouble() const noexcept
+{
+  if (!p || p >= end)
+    return std::nullopt;
+
+  usize avail = end - p - 1;
+  switch (static_cast<Tag>(*p)) {
+  case Tag::NewFloat:
+    if (avail < 8)
+      return std::nullopt;
+    return std::bit_cast<f64>(be64(p + 1));
+  case Tag::Float: {
+    if (avail < 31)
+      return std::nullopt;
+    // a NUL-padded "%.20e" string
+    const char* s = reinterpret_cast<const char*>(p + 1);
+    f64 ret = 0;
+    auto [ptr, ec] = std::from_chars(s, s + strnlen(s, 31), ret);
+    if (ec != std::errc{})
+      return std::nullopt;
+    return ret;
+  }
+  default: {
+    auto v = integer();
+    if (!v.has_value())
+      return std::nullopt;
+    return v->second ? -static_cast<f64>(v->first) : static_cast<f64>(v->first);
+  }
+  }
+}
+
+std::optional<u64> Value::asSnowflake() const noexcept
+{
+  if (auto v = asUint(); v.has_value())
+    return v;
+  if (auto s = asStringView(); s.has_value())
+    return decimal(*s);
+  return std::nullopt;
+}
+
+std::optional<std::string_view> Value::asStringView() const noexcept
+{
+  if (!p || p >= end)
+    return std::nullopt;
+
+  usize avail = end - p - 1;
+  switch (static_cast<Tag>(*p)) {
+  case Tag::Binary:
+    if (avail < 4 || avail - 4 < be32(p + 1))
+      return std::nullopt;
+    return std::string_view{reinterpret_cast<const char*>(p + 5), be32(p + 1)};
+  case Tag::String:
+    if (avail < 2 || avail - 2 < be16(p + 1))
+      return std::nullopt;
+    return std::string_view{reinterpret_cast<const char*>(p + 3), be16(p + 1)};
+  default:
+    if (type() != Type::String)
+      return std::nullopt;
+    return atom();
+  }
+}
+
+std::optional<std::string> Value::asString() const noexcept
+{
+  auto s = asStringView();
+  if (!s.has_value())
+    return std::nullopt;
+  return std::string{*s};
+}
+
+std::string_view Value::raw() const noexcept
+{
+  const u8* next = p ? skip(p, end) : nullptr;
+  if (!next)
+    return {};
+  return {reinterpret_cast<const char*>(p), static_cast<usize>(next - p)};
+}
+
+Value::Range<Value::ArrayIterator> Value::items() const noexcept
+{
+  if (!p || p >= end)
+    return {};
+
+  switch (static_cast<Tag>(*p)) {
+  case Tag::SmallTuple:
+  case Tag::LargeTuple:
+  case Tag::List: {
+    usize n = size();
+    usize hdr = static_cast<Tag>(*p) == Tag::SmallTuple ? 2 : 5;
+    if (static_cast<usize>(end - p) < hdr)
+      return {};
+    return {ArrayIterator{p + hdr, end, n}, ArrayIterator{nullptr, end, 0}};
+  }
+  default:
+    return {};
+  }
+}
+
+Value::Range<Value::ObjectIterator> Value::fields() const noexcept
+{
+  if (!p || p >= end || static_cast<Tag>(*p) != Tag::Map || end - p < 5)
+    return {};
+  return {ObjectIterator{p + 5, end, size()}, ObjectIterator{nullptr, end, 0}};
+}
+
+Value::ArrayIterator& Value::ArrayIterator::operator++() noexcept
+{
+  p = skip(p, end);
+  // a malformed element ends the iteration
+  remaining = p ? remaining - 1 : 0;
+  return *this;
+}
+
+Value::ArrayIterator Value::ArrayIterator::operator++(int) noexcept
+{
+  ArrayIterator ret = *this;
+  ++*this;
+  return ret;
+}
+
+Value::ObjectIterator::value_type Value::ObjectIterator::operator*() const noexcept
+{
+  Value key{p, end};
+  auto name = key.atom();
+  if (!name.has_value())
+    name = key.asStringView();
+  const u8* value = skip(p, end);
+  return {name.value_or(std::string_view{}), Value{value, value ? end : nullptr}};
+}
+
+Value::ObjectIterator& Value::ObjectIterator::operator++() noexcept
+{
+  const u8* value = skip(p, end);
+  p = value ? skip(value, end) : nullptr;
+  remaining = p ? remaining - 1 : 0;
+  return *this;
+}
+
+Value::ObjectIterator Value::ObjectIterator::operator++(int) noexcept
+{
+  ObjectIterator ret = *this;
+  ++*this;
+  return ret;
+}
+}  // namespace twilight::etf
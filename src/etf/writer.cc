@@ -0,0 +1,138 @@
+#include "etf/writer.h"
+
+#include <bit>
+
+#include "etf/parser.h"
+
+namespace twilight::etf
+{
+Writer::Writer() noexcept { out.push_back(static_cast<char>(FORMAT_VERSION)); }
+
+void Writer::element() noexcept
+{
+  if (!open.empty())
+    ++open.back().count;
+}
+
+void Writer::be32(u32 v) noexcept
+{
+  out.push_back(static_cast<char>(v >> 24));
+  out.push_back(static_cast<char>(v >> 16));
+  out.push_back(static_cast<char>(v >> 8));
+  out.push_back(static_cast<char>(v));
+}
+
+void Writer::atom(std::string_view name) noexcept
+{
+  element();
+  out.push_back(static_cast<char>(Tag::SmallAtomUtf8));
+  out.push_back(static_cast<char>(name.size()));
+  out.append(name);
+}
+
+Writer& Writer::beginObject() noexcept
+{
+  element();
+  open.push_back({out.size(), 0});
+  out.push_back(static_cast<char>(Tag::Map));
+  be32(0);
+  return *this;
+}
+
+Writer& Writer::endObject() noexcept
+{
+  Container c = open.back();
+  open.pop_back();
+
+  // keys and values were both counted
+  u32 arity = c.count / 2;
+  for (usize i = 0; i < 4; ++i) out[c.offset + 1 + i] = static_cast<char>(arity >> (24 - 8 * i));
+  return *this;
+}
+
+Writer& Writer::beginArray() noexcept
+{
+  element();
+  open.push_back({out.size(), 0});
+  out.push_back(static_cast<char>(Tag::List));
+  be32(0);
+  return *this;
+}
+
+Writer& Writer::endArray() noexcept
+{
+  Container c = open.back();
+  open.pop_back();
+
+  if (!c.count) {
+    // an empty list is just NIL
+    out.resize(c.offset);
+    out.push_back(static_cast<char>(Tag::Nil));
+    return *this;
+  }
+
+  for (usize i = 0; i < 4; ++i) out[c.offset + 1 + i] = static_cast<char>(c.count >> (24 - 8 * i));
+  out.push_back(static_cast<char>(Tag::Nil));  // proper list tail
+  return *this;
+}
+
+Writer& Writer::key(std::string_view key) noexcept { return value(key); }
+
+Writer& Writer::value(std::nullptr_t) noexcept
+{
+  atom("nil");
+  return *this;
+}
+
+Writer& Writer::value(bool v) noexcept
+{
+  atom(v ? "true" : "false");
+  return *this;
+}
+
+Writer& Writer::value(f64 v) noexcept
+{
+  element();
+  out.push_back(static_cast<char>(Tag::NewFloat));
+  u64 bits = std::bit_cast<u64>(v);
+  for (usize i = 0; i < 8; ++i) out.push_back(static_cast<char>(bits >> (56 - 8 * i)));
+  return *this;
+}
+
+Writer& Writer::value(std::string_view v) noexcept
+{
+  element();
+  out.push_back(static_cast<char>(Tag::Binary));
+  be32(v.size());
+  out.append(v);
+  return *this;
+}
+
+Writer& Writer::integer(u64 magnitude, bool negative) noexcept
+{
+  element();
+
+  if (!negative && magnitude <= 0xFF) {
+    out.push_back(static_cast<char>(Tag::SmallInteger));
+    out.push_back(static_cast<char>(magnitude));
+  } else if (magnitude <= (negative ? u64(1) << 31 : (u64(1) << 31) - 1)) {
+    out.push_back(static_cast<char>(Tag::Integer));
+    be32(negative ? static_cast<u32>(-magnitude) : static_cast<u32>(magnitude));
+  } else {
+    // little-endian magnitude with a separate sign byte
+    u8 n = (std::bit_width(magnitude) + 7) / 8;
+    out.push_back(static_cast<char>(Tag::SmallBig));
+    out.push_back(static_cast<char>(n));
+    out.push_back(negative);
+    for (u8 i = 0; i < n; ++i) out.push_back(static_cast<char>(magnitude >> (8 * i)));
+  }
+
+  return *this;
+}
+
+void Writer::clear() noexcept
+{
+  out.assign(1, static_cast<char>(FORMAT_VERSION));
+  open.clear();
+}
+}  // namespace twilight::etf
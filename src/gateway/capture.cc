@@ -0,0 +1,181 @@
+#include "gateway/capture.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "gateway/shard.h"
+
+namespace twilight::gateway
+{
+namespace
+{
+constexpr char MAGIC[8] = {'T', 'W', 'L', 'T', 'C', 'A', 'P', '1'};
+// the file grows by doubling up to this, then linearly
+constexpr usize MAX_GROWTH = 64ull << 20;
+}  // namespace
+
+Recorder::Recorder(const std::string& path, Encoding encoding, Compression compression)
+  : start(std::chrono::steady_clock::now())
+{
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    throw std::runtime_error("Failed to create capture file");
+  if (!grow(1 << 20)) {
+    ::close(fd);
+    throw std::runtime_error("Failed to map capture file");
+  }
+
+  CaptureHeader h{};
+  std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.encoding = encoding;
+  h.compression = compression;
+  h.start = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+              .count();
+  std::memcpy(map, &h, sizeof(h));
+}
+
+Recorder::~Recorder()
+{
+  usize used = sizeof(CaptureHeader) + header()->size;
+  munmap(map, capacity);
+  // drop the unused tail
+  [[maybe_unused]] int r = ftruncate(fd, used);
+  ::close(fd);
+}
+
+bool Recorder::grow(usize needed) noexcept
+{
+  if (needed <= capacity)
+    return true;
+
+  usize next = std::max(capacity, usize{1} << 20);
+  while (next < needed) next += std::min(next, MAX_GROWTH);
+  if (ftruncate(fd, next) != 0)
+    return false;
+
+  void* m = map ? mremap(map, capacity, next, MREMAP_MAYMOVE)
+                : mmap(nullptr, next, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (m == MAP_FAILED)
+    return false;
+  map = static_cast<char*>(m);
+  capacity = next;
+  return true;
+}
+
+void Recorder::record(const ws::Frame& frame) noexcept
+{
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard lock(mutex);
+
+  usize used = sizeof(CaptureHeader) + header()->size;
+  usize padded = (frame.payload.size() + 7) & ~usize{7};
+  // a failed write loses the message but keeps everything before it readable
+  if (frame.payload.size() > UINT32_MAX || !grow(used + sizeof(CaptureRecord) + padded))
+    return;
+
+  CaptureRecord rec{};
+  rec.time = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+  rec.length = frame.payload.size();
+  rec.opcode = frame.opcode;
+  rec.flags = streamStart ? CaptureRecord::StreamStart : 0;
+  std::memcpy(map + used, &rec, sizeof(rec));
+  std::memcpy(map + used + sizeof(rec), frame.payload.data(), frame.payload.size());
+  std::memset(map + used + sizeof(rec) + frame.payload.size(), 0, padded - frame.payload.size());
+
+  streamStart = false;
+  header()->size += sizeof(rec) + padded;
+}
+
+void Recorder::restart() noexcept
+{
+  std::lock_guard lock(mutex);
+  streamStart = true;
+}
+
+usize Recorder::size() const noexcept
+{
+  std::lock_guard lock(mutex);
+  return header()->size;
+}
+
+std::expected<Capture, std::string> Capture::open(const std::string& path) noexcept
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return std::unexpected("Failed to open capture file");
+
+  struct stat st{};
+  if (fstat(fd, &st) != 0 || static_cast<usize>(st.st_size) < sizeof(CaptureHeader)) {
+    ::close(fd);
+    return std::unexpected("Truncated capture header");
+  }
+
+  usize length = st.st_size;
+  void* m = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (m == MAP_FAILED)
+    return std::unexpected("Failed to map capture file");
+
+  CaptureHeader head;
+  std::memcpy(&head, m, sizeof(head));
+  if (std::memcmp(head.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    munmap(m, length);
+    return std::unexpected("Not a capture file");
+  }
+  // records past the end of the file were never flushed
+  head.size = std::min<u64>(head.size, length - sizeof(CaptureHeader));
+  madvise(m, length, MADV_SEQUENTIAL);
+
+  return Capture{static_cast<const char*>(m), length, head};
+}
+
+Capture::Capture(Capture&& other) noexcept
+  : data(std::exchange(other.data, nullptr)), length(std::exchange(other.length, 0)), head(other.head)
+{
+}
+
+Capture::~Capture()
+{
+  if (data)
+    munmap(const_cast<char*>(data), length);
+}
+
+ReplayStats replay(const Capture& capture, Shard& shard, ReplayOptions options)
+{
+  using Clock = std::chrono::steady_clock;
+
+  ReplayStats stats;
+  auto begin = Clock::now();
+
+  for (usize loop = 0; loop < options.loops; ++loop) {
+    auto base = Clock::now();
+    capture.forEach([&](const Capture::Message& m) {
+      if (options.paced)
+        std::this_thread::sleep_until(
+          base + std::chrono::duration_cast<Clock::duration>(m.time / std::max(options.speed, 1e-9)));
+      if (m.streamStart)
+        shard.restartStream();
+
+      auto t0 = Clock::now();
+      if (auto payload = shard.decode(m.payload); payload.has_value())
+        shard.handle(*payload);
+      else
+        ++stats.errors;
+      stats.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count());
+
+      ++stats.messages;
+      stats.bytes += m.payload.size();
+      return true;
+    });
+  }
+
+  stats.elapsed = Clock::now() - begin;
+  return stats;
+}
+}  // namespace twilight::gateway
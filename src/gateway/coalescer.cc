@@ -0,0 +1,89 @@
+#include "gateway/coalescer.h"
+
+#include <algorithm>
+
+namespace twilight::gateway
+{
+namespace
+{
+metrics::Counter& coalescedTotal()
+{
+  static metrics::Counter& c = metrics::registry().counter("gateway_coalesced_total");
+  return c;
+}
+}  // namespace
+
+Coalescer::Coalescer(std::chrono::milliseconds window)
+  : window(std::max(window, std::chrono::milliseconds{1})),
+    closer([this](std::stop_token stop) { run(std::move(stop)); })
+{
+}
+
+Coalescer::~Coalescer()
+{
+  closer.request_stop();
+  closer.join();
+}
+
+void Coalescer::flush()
+{
+  std::vector<Deliver> due;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& [key, w] : windows)
+      if (w.kept)
+        due.push_back(std::move(w.kept));
+    windows.clear();
+  }
+  for (auto& deliver : due) deliver();
+}
+
+usize Coalescer::open() const noexcept
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return windows.size();
+}
+
+void Coalescer::merge() noexcept
+{
+  mergedCount.fetch_add(1, std::memory_order_relaxed);
+  coalescedTotal().add();
+}
+
+void Coalescer::close(Clock::time_point cutoff, std::vector<Deliver>& out)
+{
+  auto now = cutoff + window;
+  for (auto it = windows.begin(); it != windows.end();) {
+    Window& w = it->second;
+    if (w.opened > cutoff) {
+      ++it;
+    } else if (w.kept) {
+      // delivering opens the next window, so a key stays throttled for as long as it's busy
+      out.push_back(std::move(w.kept));
+      w.kept = nullptr;
+      w.opened = now;
+      ++it;
+    } else {
+      it = windows.erase(it);
+    }
+  }
+}
+
+void Coalescer::run(std::stop_token stop)
+{
+  // windows close at most a tick late
+  auto tick = std::max(window / 4, std::chrono::milliseconds{1});
+  std::vector<Deliver> due;
+  while (!stop.stop_requested()) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait_for(lock, stop, tick, [] { return false; });
+      if (stop.stop_requested())
+        return;
+      close(Clock::now() - window, due);
+    }
+    for (auto& deliver : due) deliver();
+    due.clear();
+  }
+}
+}  // namespace twilight::gateway
@@ -0,0 +1,110 @@
+#include "gateway/command_queue.h"
+
+namespace twilight::gateway
+{
+CommandQueue::Lane CommandQueue::lane(Opcode op) noexcept
+{
+  switch (op) {
+  case Opcode::Heartbeat:
+    return Lane::Heartbeat;
+  case Opcode::Identify:
+  case Opcode::Resume:
+    return Lane::Session;
+  case Opcode::PresenceUpdate:
+  case Opcode::VoiceStateUpdate:
+    return Lane::State;
+  case Opcode::RequestGuildMembers:
+  case Opcode::RequestSoundboardSounds:
+    return Lane::Requests;
+  default:
+    return Lane::Other;
+  }
+}
+
+void CommandQueue::push(Opcode op, std::string message)
+{
+  auto& queue = lanes[static_cast<usize>(lane(op))];
+  // only the latest presence matters
+  if (op == Opcode::PresenceUpdate) {
+    for (Command& c : queue) {
+      if (c.op == op) {
+        c.message = std::move(message);
+        return;
+      }
+    }
+  }
+  queue.push_back({op, std::move(message)});
+}
+
+std::optional<CommandQueue::Command> CommandQueue::pop(Clock::time_point now, bool connected, bool ready)
+{
+  expire(now);
+  for (usize i = 0; i < LANES; ++i) {
+    if (lanes[i].empty() || !open(i, connected, ready))
+      continue;
+    // lanes below have a smaller budget, so none of them can go either
+    if (count >= budget(i))
+      return std::nullopt;
+
+    Command c = std::move(lanes[i].front());
+    lanes[i].pop_front();
+    log[(first + count) % LIMIT] = now;
+    ++count;
+    return c;
+  }
+  return std::nullopt;
+}
+
+void CommandQueue::unpop(Command command)
+{
+  if (count)
+    --count;
+  lanes[static_cast<usize>(lane(command.op))].push_front(std::move(command));
+}
+
+CommandQueue::Clock::time_point CommandQueue::next(Clock::time_point now, bool connected, bool ready) noexcept
+{
+  expire(now);
+  for (usize i = 0; i < LANES; ++i) {
+    if (lanes[i].empty() || !open(i, connected, ready))
+      continue;
+    if (count < budget(i))
+      return now;
+    // the oldest sends expire first, enough of them have to go to get under this lane's budget
+    u32 excess = count - budget(i);
+    return log[(first + excess) % LIMIT] + WINDOW;
+  }
+  return Clock::time_point::max();
+}
+
+void CommandQueue::reset() noexcept
+{
+  lanes[static_cast<usize>(Lane::Heartbeat)].clear();
+  lanes[static_cast<usize>(Lane::Session)].clear();
+  first = 0;
+  count = 0;
+}
+
+void CommandQueue::setHeartbeatInterval(std::chrono::milliseconds interval) noexcept
+{
+  if (interval.count() <= 0)
+    return;
+  // every heartbeat due in a window, one requested by discord on top
+  reserved = static_cast<u32>((WINDOW + interval - std::chrono::milliseconds{1}) / interval) + 1;
+}
+
+usize CommandQueue::size() const noexcept
+{
+  usize n = 0;
+  for (const auto& lane : lanes) n += lane.size();
+  return n;
+}
+
+void CommandQueue::expire(Clock::time_point now) noexcept
+{
+  while (count && log[first] + WINDOW <= now) {
+    first = (first + 1) % LIMIT;
+    --count;
+  }
+}
+}  // namespace twilight::gateway
@@ -0,0 +1,122 @@
+#include "gateway/dispatcher.h"
+
+#include "cache/cache.h"
+#include "gateway/shard.h"
+#include "json/parser.h"
+
+namespace twilight::gateway
+{
+Dispatcher::Dispatcher(cache::Cache* cache) : cache(cache) {}
+
+void Dispatcher::attach(Shard& shard)
+{
+  shard.setEvents(events());
+  shard.ondispatch = [this, &shard](const Payload& payload) { dispatch(shard, payload); };
+}
+
+void Dispatcher::setCoalescing(std::chrono::milliseconds window)
+{
+  coalescing = std::make_unique<Coalescer>(window);
+}
+
+void Dispatcher::dispatch(Shard& shard, const Payload& payload)
+{
+  if (cache)
+    cache->ingest(payload);
+
+  auto it = handlers.find(eventHash(payload.t));
+  if (it == handlers.end())
+    return;
+  auto& list = it->second;
+  if (coalescing) {
+    auto key = coalesceKey(payload);
+    bool now = !key || coalescing->offer(*key, [&]() -> Coalescer::Deliver {
+      return [this, order = orderKey(payload, ordering), job = deferred(shard, payload, list)]() mutable {
+        if (executor)
+          executor->submit(order, std::move(job));
+        else
+          job();
+      };
+    });
+    if (!now)
+      return;
+  }
+  if (!executor) {
+    for (auto& handler : list) handler(shard, payload);
+    return;
+  }
+  executor->submit(orderKey(payload, ordering), deferred(shard, payload, list));
+}
+
+Executor::Job Dispatcher::deferred(Shard& shard, const Payload& payload, const std::vector<Handler>& list)
+{
+  // the payload borrows the shard's buffers, so the job gets a copy of `d` followed by `t` and parses `d` again
+  Encoding encoding = shard.config().encoding;
+  std::string_view raw = payload.d.raw();
+  std::string copy;
+  copy.reserve(1 + raw.size() + payload.t.size());
+  if (encoding == Encoding::ETF)
+    copy += static_cast<char>(etf::FORMAT_VERSION);
+  copy += raw;
+  copy += payload.t;
+
+  return [&shard, &list, copy = std::move(copy), t = payload.t.size(), s = payload.s, encoding] {
+    std::string_view data{copy.data(), copy.size() - t};
+    Data d;
+    if (encoding == Encoding::ETF) {
+      if (auto root = etf::parse(data); root.has_value())
+        d = *root;
+    } else {
+      // one per thread, so its index is reused like the shard's
+      thread_local json::Parser parser;
+      if (auto root = parser.parse(data); root.has_value())
+        d = *root;
+    }
+    Payload p{.op = Opcode::Dispatch, .s = s, .t = {copy.data() + data.size(), t}, .d = d};
+    for (auto& handler : list) handler(shard, p);
+  };
+}
+
+u64 Dispatcher::orderKey(const Payload& payload, Ordering ordering) noexcept
+{
+  auto id = [&](std::string_view key) -> u64 {
+    auto v = payload.d.find(key);
+    return v ? v->asSnowflake().value_or(0) : 0;
+  };
+  // guilds and channels carry their own id in the events about them
+  auto own = [&](std::string_view kind) {
+    std::string_view t = payload.t;
+    return t.starts_with(kind) && (t.ends_with("_CREATE") || t.ends_with("_UPDATE") || t.ends_with("_DELETE")) &&
+           t.size() == kind.size() + 7;
+  };
+  u64 guild = own("GUILD") ? id("id") : id("guild_id");
+  u64 channel = own("CHANNEL") || own("THREAD") ? id("id") : id("channel_id");
+  if (ordering == Ordering::Channel)
+    return channel ? channel : guild;
+  return guild ? guild : channel;
+}
+
+std::optional<Coalescer::Key> Dispatcher::coalesceKey(const Payload& payload) noexcept
+{
+  auto id = [](const std::optional<Data>& v, std::string_view key) -> u64 {
+    auto field = v ? v->find(key) : std::nullopt;
+    return field ? field->asSnowflake().value_or(0) : 0;
+  };
+  // a presence replaces the member's last one, a typing start repeats while they keep typing
+  if (payload.t == "PRESENCE_UPDATE")
+    return Coalescer::Key{
+      .scope = id(payload.d, "guild_id"), .id = id(payload.d.find("user"), "id"), .mode = Coalescer::Mode::Latest};
+  if (payload.t == "TYPING_START")
+    return Coalescer::Key{
+      .scope = id(payload.d, "channel_id"), .id = id(payload.d, "user_id"), .mode = Coalescer::Mode::First};
+  return std::nullopt;
+}
+
+EventSet Dispatcher::events() const
+{
+  EventSet set = subscribed;
+  if (cache)
+    set.add(cache->events());
+  return set;
+}
+}  // namespace twilight::gateway
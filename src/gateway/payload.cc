@@ -0,0 +1,161 @@
+#include "gateway/payload.h"
+
+#include <charconv>
+
+namespace twilight::gateway
+{
+namespace
+{
+struct Cursor {
+  const char* p;
+  const char* end;
+
+  inline void ws() noexcept
+  {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+  }
+
+  // past the closing quote of the string starting at p, nullptr if unterminated
+  inline const char* string(const char* s) const noexcept
+  {
+    for (++s; s < end; ++s) {
+      if (*s == '\\')
+        ++s;
+      else if (*s == '"')
+        return s + 1;
+    }
+    return nullptr;
+  }
+
+  // skips one value without validating it
+  bool skip() noexcept
+  {
+    usize depth = 0;
+    while (p < end) {
+      char c = *p;
+      if (c == '"') {
+        if (!(p = string(p)))
+          return false;
+        if (!depth)
+          return true;
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        ++depth;
+      } else if (c == '}' || c == ']') {
+        if (!depth)
+          return true;
+        if (!--depth) {
+          ++p;
+          return true;
+        }
+      } else if (!depth && (c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r')) {
+        return true;
+      }
+      ++p;
+    }
+    return !depth;
+  }
+
+  std::optional<u64> number() noexcept
+  {
+    u64 v;
+    auto [next, ec] = std::from_chars(p, end, v);
+    if (ec != std::errc{})
+      return std::nullopt;
+    p = next;
+    return v;
+  }
+
+  inline bool literal(std::string_view s) noexcept
+  {
+    if (static_cast<usize>(end - p) < s.size() || std::string_view{p, s.size()} != s)
+      return false;
+    p += s.size();
+    return true;
+  }
+};
+}  // namespace
+
+std::optional<Payload> Payload::from(const Data& root) noexcept
+{
+  std::optional<u64> op;
+  Payload payload{};
+
+  for (auto [key, value] : root.fields()) {
+    if (key == "op")
+      op = value.asUint();
+    else if (key == "s")
+      payload.s = value.asUint();
+    else if (key == "t")
+      payload.t = value.asStringView().value_or(std::string_view{});
+    else if (key == "d")
+      payload.d = value;
+  }
+
+  if (!op.has_value())
+    return std::nullopt;
+
+  payload.op = static_cast<Opcode>(*op);
+  return payload;
+}
+
+std::optional<Payload> Payload::peek(std::string_view json) noexcept
+{
+  Cursor c{json.data(), json.data() + json.size()};
+  std::optional<u64> op;
+  Payload payload{};
+  bool s = false, t = false;
+
+  c.ws();
+  if (c.p == c.end || *c.p++ != '{')
+    return std::nullopt;
+
+  while (!(op && s && t)) {
+    c.ws();
+    if (c.p == c.end || *c.p != '"')
+      break;
+    const char* keyEnd = c.string(c.p);
+    if (!keyEnd)
+      return std::nullopt;
+    std::string_view key{c.p + 1, keyEnd - 1};
+    c.p = keyEnd;
+    c.ws();
+    if (c.p == c.end || *c.p++ != ':')
+      return std::nullopt;
+    c.ws();
+
+    if (key == "op") {
+      if (!(op = c.number()))
+        return std::nullopt;
+    } else if (key == "s") {
+      s = true;
+      if (!c.literal("null") && !(payload.s = c.number()))
+        return std::nullopt;
+    } else if (key == "t") {
+      t = true;
+      if (!c.literal("null")) {
+        const char* valueEnd = c.p < c.end && *c.p == '"' ? c.string(c.p) : nullptr;
+        if (!valueEnd)
+          return std::nullopt;
+        payload.t = {c.p + 1, valueEnd - 1};
+        // event names never have escapes, anything else goes through the real parser
+        if (payload.t.find('\\') != std::string_view::npos)
+          return std::nullopt;
+        c.p = valueEnd;
+      }
+    } else if (!c.skip()) {
+      return std::nullopt;
+    }
+
+    c.ws();
+    if (c.p < c.end && *c.p == ',')
+      ++c.p;
+  }
+
+  if (!op)
+    return std::nullopt;
+  payload.op = static_cast<Opcode>(*op);
+  return payload;
+}
+}  // namespace twilight::gateway
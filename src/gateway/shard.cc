@@ -0,0 +1,570 @@
+#include "gateway/shard.h"
+
+#include <zlib.h>
+
+#include <stdexcept>
+#include <type_traits>
+
+#include "etf/parser.h"
+#include "gateway/capture.h"
+#include "utils/executor.h"
+#include "utils/random.h"
+
+namespace twilight::gateway
+{
+using namespace std::chrono_literals;
+
+namespace
+{
+struct GatewayMetrics {
+  metrics::AtomicHistogram& heartbeatRtt = metrics::registry().histogram("gateway_heartbeat_rtt_ns");
+  metrics::Gauge& queued = metrics::registry().gauge("gateway_commands_queued");
+  metrics::Counter& sent = metrics::registry().counter("gateway_commands_sent_total");
+  metrics::Counter& reconnects = metrics::registry().counter("gateway_connections_total");
+};
+}  // namespace
+
+struct Shard::Inflater {
+  z_stream zs{};
+  // a message that arrived without the flush suffix, waiting for the rest
+  std::string pending;
+  std::string out;
+
+  Inflater() noexcept { inflateInit(&zs); }
+  ~Inflater() { inflateEnd(&zs); }
+
+  void reset() noexcept
+  {
+    inflateReset(&zs);
+    pending.clear();
+  }
+
+  std::expected<std::string_view, std::string> feed(std::string_view in) noexcept
+  {
+    static constexpr std::string_view SUFFIX{"\x00\x00\xff\xff", 4};
+
+    std::string_view data = in;
+    if (!pending.empty()) {
+      pending.append(in);
+      data = pending;
+    }
+
+    if (!data.ends_with(SUFFIX)) {
+      if (pending.empty())
+        pending.assign(in);
+      return std::unexpected("Incomplete zlib-stream message");
+    }
+
+    out.clear();
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = data.size();
+
+    do {
+      usize used = out.size();
+      out.resize(used + std::max<usize>(4096, data.size() * 4));
+      zs.next_out = reinterpret_cast<Bytef*>(out.data() + used);
+      zs.avail_out = out.size() - used;
+
+      int ret = inflate(&zs, Z_SYNC_FLUSH);
+      out.resize(out.size() - zs.avail_out);
+      if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        pending.clear();
+        return std::unexpected("Invalid compression");
+      }
+    } while (zs.avail_in > 0 || zs.avail_out == 0);
+
+    pending.clear();
+    return out;
+  }
+};
+
+Shard::Shard(Options options) : options(std::move(options)), inflater(std::make_unique<Inflater>()) {}
+
+Shard::~Shard()
+{
+  close();
+  // what's still queued is dropped with the shard
+  metrics::cached<GatewayMetrics>().queued.add(-static_cast<i64>(reportedQueue));
+}
+
+void Shard::connect()
+{
+  closing = false;
+  open();
+  if (!control.joinable())
+    control = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+void Shard::close() noexcept
+{
+  closing = true;
+
+  if (control.joinable()) {
+    control.request_stop();
+    control.join();
+  }
+
+  std::unique_ptr<ws::Client> old;
+  {
+    std::lock_guard<std::mutex> lock(wsMutex);
+    old = std::move(ws);
+  }
+  if (old)
+    old->close();
+  failMemberRequests("Shard closed before the members arrived");
+}
+
+Session Shard::session() const noexcept
+{
+  std::lock_guard<std::mutex> lock(sessionMutex);
+  Session ret = sess;
+  ret.seq = seq;
+  return ret;
+}
+
+void Shard::setSession(Session s) noexcept
+{
+  std::lock_guard<std::mutex> lock(sessionMutex);
+  seq = s.seq;
+  sess = std::move(s);
+}
+
+std::expected<Payload, std::string> Shard::decode(std::string_view message)
+{
+  std::string_view data = message;
+  if (options.compression == Compression::ZlibStream) {
+    auto inflated = inflater->feed(message);
+    if (!inflated.has_value())
+      return std::unexpected(inflated.error());
+    data = *inflated;
+  }
+
+  if (options.encoding == Encoding::JSON && !events.isAll()) {
+    if (auto head = Payload::peek(data); head && head->op == Opcode::Dispatch && !wanted(head->t))
+      return *head;
+  }
+
+  std::optional<Payload> payload;
+  if (options.encoding == Encoding::ETF) {
+    auto root = etf::parse(data);
+    if (!root.has_value())
+      return std::unexpected(root.error());
+    payload = Payload::from(*root);
+  } else {
+    auto root = parser.parse(data);
+    if (!root.has_value())
+      return std::unexpected(root.error());
+    payload = Payload::from(*root);
+  }
+
+  if (!payload.has_value())
+    return std::unexpected("Payload has no opcode");
+  return *payload;
+}
+
+void Shard::restartStream() noexcept { inflater->reset(); }
+
+void Shard::handle(const Payload& payload)
+{
+  if (payload.op == Opcode::Dispatch && !wanted(payload.t)) {
+    if (payload.s.has_value())
+      seq = *payload.s;
+    return;
+  }
+
+  onpayload(payload);
+
+  switch (payload.op) {
+  case Opcode::Dispatch:
+    if (payload.s.has_value())
+      seq = *payload.s;
+    if (payload.t == "READY") {
+      std::lock_guard<std::mutex> lock(sessionMutex);
+      if (auto id = payload.d.find("session_id"); id.has_value())
+        sess.id = id->asString().value_or("");
+      if (auto url = payload.d.find("resume_gateway_url"); url.has_value())
+        sess.resumeUrl = url->asString().value_or("");
+    }
+    if (payload.t == "READY" || payload.t == "RESUMED") {
+      {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        sessionReady = true;
+        wake = true;
+      }
+      controlCv.notify_all();
+    }
+    ondispatch(payload);
+    if (payload.t == "GUILD_MEMBERS_CHUNK" && membersOutstanding.load(std::memory_order_relaxed))
+      memberChunk(payload.d);
+    break;
+  case Opcode::Heartbeat:
+    heartbeat();
+    break;
+  case Opcode::Reconnect:
+    requestReconnect();
+    break;
+  case Opcode::InvalidSession:
+    if (!payload.d.asBool().value_or(false)) {
+      std::lock_guard<std::mutex> lock(sessionMutex);
+      sess.id.clear();
+      seq = 0;
+    }
+    requestReconnect();
+    break;
+  case Opcode::Hello: {
+    std::chrono::milliseconds interval{payload.d.find("heartbeat_interval").value_or(Data{}).asUint().value_or(41250)};
+    {
+      std::lock_guard<std::mutex> lock(controlMutex);
+      heartbeatInterval = interval;
+      commands.setHeartbeatInterval(interval);
+      // the first heartbeat is jittered, see https://discord.com/developers/docs/events/gateway#sending-heartbeats
+      nextHeartbeat = std::chrono::steady_clock::now() + interval * rand<u16>() / 0xFFFF;
+      heartbeatAcked = true;
+      wake = true;
+    }
+    controlCv.notify_all();
+
+    bool resumable;
+    {
+      std::lock_guard<std::mutex> lock(sessionMutex);
+      resumable = !sess.id.empty();
+    }
+    resumable ? resume() : identify();
+    break;
+  }
+  case Opcode::HeartbeatAck: {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    heartbeatAcked = true;
+    if (heartbeatSent != std::chrono::steady_clock::time_point{}) {
+      auto elapsed = std::chrono::steady_clock::now() - heartbeatSent;
+      rtt.store(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), std::memory_order_relaxed);
+      metrics::cached<GatewayMetrics>().heartbeatRtt.record(elapsed);
+      heartbeatSent = {};
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+bool Shard::enqueue(Opcode op, std::string message)
+{
+  if (closing)
+    return false;
+  {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    commands.push(op, std::move(message));
+    reportQueue();
+    wake = true;
+  }
+  controlCv.notify_all();
+  return true;
+}
+
+bool Shard::sendRaw(const std::string& message) const noexcept
+{
+  std::lock_guard<std::mutex> lock(wsMutex);
+  if (!ws)
+    return false;
+  return ws->send(options.encoding == Encoding::ETF ? ws::Opcode::Binary : ws::Opcode::Text, message);
+}
+
+void Shard::open()
+{
+  std::string url;
+  {
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    url = !sess.id.empty() && !sess.resumeUrl.empty() ? sess.resumeUrl : options.url;
+  }
+  url += options.encoding == Encoding::ETF ? "/?v=10&encoding=etf" : "/?v=10&encoding=json";
+  if (options.compression == Compression::ZlibStream)
+    url += "&compress=zlib-stream";
+
+  // the old listener may still be decoding and handling, so it's gone before the state it uses is reset
+  std::unique_ptr<ws::Client> old;
+  {
+    std::lock_guard<std::mutex> lock(wsMutex);
+    old = std::move(ws);
+  }
+  old.reset();
+
+  {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    heartbeatInterval = 0ms;
+    heartbeatAcked = true;
+    connected = false;
+    sessionReady = false;
+    heartbeatSent = {};
+    commands.reset();
+    reportQueue();
+  }
+  // their commands were dropped with the queue or sent on the old connection, whose chunks won't come
+  failMemberRequests("Gateway connection closed before the members arrived");
+  inflater->reset();
+  metrics::cached<GatewayMetrics>().reconnects.add();
+
+  auto next = std::make_unique<ws::Client>(URI{url}, http::ClientFlags::NoConnect);
+  if (Recorder* recorder = options.recorder) {
+    recorder->restart();
+    // registered first, so messages are on disk before they're handled
+    next->onmessage = [recorder](const ws::Frame& frame) { recorder->record(frame); };
+  }
+  // the listener thread pins itself on its first message
+  next->onmessage = [this, pinned = options.cpus.empty()](const ws::Frame& frame) mutable {
+    if (!pinned) {
+      pinThread(options.cpus);
+      pinned = true;
+    }
+    auto payload = decode(frame.payload);
+    if (payload.has_value())
+      handle(*payload);
+  };
+  next->onclose = [this] {
+    if (!closing)
+      requestReconnect();
+  };
+
+  ws::Client* client = next.get();
+  {
+    std::lock_guard<std::mutex> lock(wsMutex);
+    ws = std::move(next);
+  }
+
+  client->connect();
+  {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    connected = true;
+    wake = true;
+  }
+  controlCv.notify_all();
+}
+
+void Shard::identify()
+{
+  using I = std::underlying_type_t<Intent>;
+
+  send(Opcode::Identify, [&](auto& w) {
+    w.beginObject()
+      .key("token")
+      .value(options.token)
+      .key("intents")
+      .value(static_cast<I>(options.intents))
+      .key("properties")
+      .beginObject()
+      .key("os")
+      .value("linux")
+      .key("browser")
+      .value("twilight")
+      .key("device")
+      .value("twilight")
+      .endObject()
+      .key("shard")
+      .beginArray()
+      .value(options.id)
+      .value(options.count)
+      .endArray()
+      .endObject();
+  });
+}
+
+void Shard::resume()
+{
+  Session s = session();
+  send(Opcode::Resume, [&](auto& w) {
+    w.beginObject().key("token").value(options.token).key("session_id").value(s.id).key("seq").value(s.seq).endObject();
+  });
+}
+
+void Shard::reportQueue() noexcept
+{
+  usize n = commands.size();
+  metrics::cached<GatewayMetrics>().queued.add(static_cast<i64>(n) - static_cast<i64>(reportedQueue));
+  reportedQueue = n;
+}
+
+void Shard::heartbeat()
+{
+  u64 s = seq;
+  send(Opcode::Heartbeat, [&](auto& w) {
+    if (s)
+      w.value(s);
+    else
+      w.value(nullptr);
+  });
+}
+
+MemberRequest Shard::requestGuildMembers(u64 guild, MemberQuery query)
+{
+  // nonces are at most 32 characters
+  std::string nonce = std::to_string(options.id) + "." + std::to_string(nonces.fetch_add(1) + 1);
+  auto progress = std::make_shared<MemberProgress>();
+  std::future<MemberChunks> done;
+  {
+    std::lock_guard<std::mutex> lock(membersMutex);
+    PendingMembers& p = memberRequests[nonce];
+    p.progress = progress;
+    p.result.guild = guild;
+    done = p.promise.get_future();
+    membersOutstanding.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  bool queued = send(Opcode::RequestGuildMembers, [&](auto& w) {
+    w.beginObject().key("guild_id").snowflake(guild);
+    if (!query.users.empty()) {
+      w.key("user_ids").beginArray();
+      for (u64 id : query.users) w.snowflake(id);
+      w.endArray();
+    } else {
+      w.key("query").value(query.query).key("limit").value(query.limit);
+    }
+    if (query.presences)
+      w.key("presences").value(true);
+    w.key("nonce").value(nonce).endObject();
+  });
+  if (!queued) {
+    std::lock_guard<std::mutex> lock(membersMutex);
+    // unless a reconnect failed it already
+    if (auto it = memberRequests.find(nonce); it != memberRequests.end()) {
+      it->second.promise.set_exception(std::make_exception_ptr(std::runtime_error("Shard is closed")));
+      memberRequests.erase(it);
+      membersOutstanding.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+  return {std::move(nonce), std::move(progress), std::move(done)};
+}
+
+void Shard::failMemberRequests(const char* why) noexcept
+{
+  std::lock_guard<std::mutex> lock(membersMutex);
+  for (auto& [nonce, p] : memberRequests) p.promise.set_exception(std::make_exception_ptr(std::runtime_error(why)));
+  memberRequests.clear();
+  membersOutstanding.store(0, std::memory_order_relaxed);
+}
+
+bool Shard::updateVoiceState(u64 guild, std::optional<u64> channel, bool mute, bool deaf)
+{
+  return send(Opcode::VoiceStateUpdate, [&](auto& w) {
+    w.beginObject().key("guild_id").snowflake(guild).key("channel_id");
+    if (channel)
+      w.snowflake(*channel);
+    else
+      w.value(nullptr);
+    w.key("self_mute").value(mute).key("self_deaf").value(deaf).endObject();
+  });
+}
+
+void Shard::memberChunk(const Data& d)
+{
+  auto nonce = d.find("nonce");
+  auto key = nonce ? nonce->asStringView() : std::nullopt;
+  if (!key)
+    return;
+
+  std::lock_guard<std::mutex> lock(membersMutex);
+  auto it = memberRequests.find(std::string{*key});
+  if (it == memberRequests.end())
+    return;
+
+  PendingMembers& p = it->second;
+  u32 count = d.find("chunk_count").value_or(Data{}).asUint().value_or(1);
+  u32 members = d.find("members").value_or(Data{}).size();
+  if (auto notFound = d.find("not_found"))
+    for (Data id : notFound->items())
+      if (auto v = id.asSnowflake())
+        p.result.notFound.push_back(*v);
+
+  ++p.result.chunks;
+  p.result.members += members;
+  p.progress->expected.store(count, std::memory_order_relaxed);
+  p.progress->members.fetch_add(members, std::memory_order_relaxed);
+  p.progress->chunks.fetch_add(1, std::memory_order_release);
+
+  if (p.result.chunks >= count) {
+    p.promise.set_value(std::move(p.result));
+    memberRequests.erase(it);
+    membersOutstanding.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+void Shard::requestReconnect() noexcept
+{
+  {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    reconnectRequested = true;
+    wake = true;
+  }
+  controlCv.notify_all();
+}
+
+void Shard::run(std::stop_token stop)
+{
+  pinThread(options.cpus);
+  std::unique_lock<std::mutex> lock(controlMutex);
+
+  while (!stop.stop_requested()) {
+    if (reconnectRequested) {
+      reconnectRequested = false;
+      lock.unlock();
+      bool ok = true;
+      try {
+        open();
+      } catch (const std::exception&) {
+        ok = false;
+      }
+      lock.lock();
+      if (!ok) {
+        // back off before trying again
+        reconnectRequested = true;
+        controlCv.wait_for(lock, stop, 5s, [] { return false; });
+      }
+      continue;
+    }
+
+    if (heartbeatInterval != 0ms && std::chrono::steady_clock::now() >= nextHeartbeat) {
+      if (!heartbeatAcked) {
+        // no ACK since the last heartbeat, the connection is a zombie
+        reconnectRequested = true;
+        continue;
+      }
+      heartbeatAcked = false;
+      nextHeartbeat = std::chrono::steady_clock::now() + heartbeatInterval;
+      lock.unlock();
+      heartbeat();
+      lock.lock();
+      continue;
+    }
+
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (heartbeatInterval != 0ms)
+      deadline = nextHeartbeat;
+
+    auto now = std::chrono::steady_clock::now();
+    if (auto command = commands.pop(now, connected, sessionReady)) {
+      lock.unlock();
+      bool sent = sendRaw(command->message);
+      lock.lock();
+      if (!sent) {
+        // the connection is going away. commands for the session are made again on the next one, the rest wait
+        connected = false;
+        sessionReady = false;
+        if (CommandQueue::lane(command->op) > CommandQueue::Lane::Session)
+          commands.unpop(std::move(*command));
+      } else {
+        metrics::cached<GatewayMetrics>().sent.add();
+        if (command->op == Opcode::Heartbeat)
+          heartbeatSent = std::chrono::steady_clock::now();
+      }
+      reportQueue();
+      continue;
+    }
+    deadline = std::min(deadline, commands.next(now, connected, sessionReady));
+
+    if (deadline != std::chrono::steady_clock::time_point::max())
+      controlCv.wait_until(lock, stop, deadline, [&] { return wake; });
+    else
+      controlCv.wait(lock, stop, [&] { return wake; });
+    wake = false;
+  }
+}
+}  // namespace twilight::gateway
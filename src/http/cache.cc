@@ -0,0 +1,497 @@
+#include "http/cache.h"
+
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "utils/metrics.h"
+
+namespace twilight::http
+{
+namespace
+{
+constexpr char MAGIC[8] = {'T', 'W', 'L', 'H', 'T', 'T', 'P', '1'};
+// past this, heuristic freshness from Last-Modified is capped
+constexpr i64 MAX_HEURISTIC = 24 * 60 * 60;
+
+// a disk tier file is this, then the key, status message, header block and body
+struct FileHeader {
+  char magic[8];
+  u16 status;
+  u8 revalidate;
+  u8 reserved;
+  u32 key;
+  u32 message;
+  u32 headers;
+  u64 body;
+  i64 expires;
+};
+
+struct CacheMetrics {
+  metrics::Counter& hits = metrics::registry().counter("http_cache_hits_total");
+  metrics::Counter& revalidated = metrics::registry().counter("http_cache_revalidated_total");
+  metrics::Counter& misses = metrics::registry().counter("http_cache_misses_total");
+  metrics::Gauge& memory = metrics::registry().gauge("http_cache_memory_bytes");
+  metrics::Gauge& disk = metrics::registry().gauge("http_cache_disk_bytes");
+};
+
+inline i64 now() noexcept
+{
+  return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+inline char toLower(char c) noexcept
+{
+  return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) noexcept
+{
+  return std::ranges::equal(a, b, [](char x, char y) { return toLower(x) == toLower(y); });
+}
+
+std::string_view trim(std::string_view s) noexcept
+{
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+  return s;
+}
+
+// calls `f` with every trimmed element of a comma separated list
+template <typename F>
+void forEachToken(std::string_view list, F&& f)
+{
+  while (!list.empty()) {
+    usize comma = list.find(',');
+    if (auto token = trim(list.substr(0, comma)); !token.empty())
+      f(token);
+    list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+  }
+}
+
+std::optional<i64> integer(std::string_view s) noexcept
+{
+  i64 v;
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+  if (ec != std::errc{} || end != s.data() + s.size())
+    return std::nullopt;
+  return v;
+}
+
+// "Sun, 06 Nov 1994 08:49:37 GMT" to unix seconds, the only date format servers still send
+std::optional<i64> httpDate(std::optional<std::string_view> value) noexcept
+{
+  static constexpr std::string_view MONTHS[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+  if (!value)
+    return std::nullopt;
+  std::string_view s = *value;
+  usize comma = s.find(", ");
+  if (comma == std::string_view::npos || s.size() < comma + 22)
+    return std::nullopt;
+  s.remove_prefix(comma + 2);
+
+  auto day = integer(s.substr(0, 2)), year = integer(s.substr(7, 4));
+  auto hour = integer(s.substr(12, 2)), minute = integer(s.substr(15, 2)), second = integer(s.substr(18, 2));
+  auto month = std::ranges::find(MONTHS, s.substr(3, 3));
+  if (!day || !year || !hour || !minute || !second || month == std::end(MONTHS))
+    return std::nullopt;
+
+  std::chrono::year_month_day date{std::chrono::year(*year), std::chrono::month(month - MONTHS + 1),
+    std::chrono::day(*day)};
+  if (!date.ok())
+    return std::nullopt;
+  return std::chrono::sys_days{date}.time_since_epoch() / std::chrono::seconds{1} + *hour * 3600 + *minute * 60 +
+         *second;
+}
+
+// what a response's headers allow, https://www.rfc-editor.org/rfc/rfc9111#section-4.2
+struct Policy {
+  bool store = true;
+  bool revalidate = false;
+  i64 expires = 0;
+};
+
+Policy policy(const Headers& headers, i64 received) noexcept
+{
+  Policy p;
+  std::optional<i64> maxAge;
+  if (auto cc = headers.get("cache-control"))
+    forEachToken(*cc, [&](std::string_view d) {
+      if (equalsIgnoreCase(d, "no-store"))
+        p.store = false;
+      else if (equalsIgnoreCase(d, "no-cache"))
+        p.revalidate = true;
+      else if (d.size() > 8 && equalsIgnoreCase(d.substr(0, 8), "max-age="))
+        maxAge = integer(d.substr(8));
+    });
+  // bodies are stored decoded, so only the encoding may vary
+  if (auto vary = headers.get("vary"))
+    forEachToken(*vary, [&](std::string_view field) { p.store &= equalsIgnoreCase(field, "accept-encoding"); });
+
+  i64 date = httpDate(headers.get("date")).value_or(received);
+  i64 lifetime = 0;
+  if (maxAge) {
+    lifetime = *maxAge;
+  } else if (auto expires = headers.get("expires")) {
+    // an invalid date means already expired
+    lifetime = httpDate(expires).value_or(date) - date;
+  } else if (auto modified = httpDate(headers.get("last-modified"))) {
+    lifetime = std::min(MAX_HEURISTIC, std::max<i64>(0, date - *modified) / 10);
+  }
+  i64 age = std::max<i64>(0, integer(headers.get("age").value_or("")).value_or(0));
+  p.expires = received + lifetime - age;
+
+  // never fresh and nothing to revalidate with
+  if (p.expires <= received && !headers.get("etag") && !headers.get("last-modified"))
+    p.store = false;
+  return p;
+}
+
+std::string hex(const unsigned char* bytes, usize n)
+{
+  static constexpr char digits[] = "0123456789abcdef";
+  std::string out;
+  for (usize i = 0; i < n; ++i) {
+    out.push_back(digits[bytes[i] >> 4]);
+    out.push_back(digits[bytes[i] & 0xF]);
+  }
+  return out;
+}
+
+std::string sha256(std::string_view s)
+{
+  unsigned char md[EVP_MAX_MD_SIZE];
+  unsigned int n = 0;
+  EVP_Digest(s.data(), s.size(), md, &n, EVP_sha256(), nullptr);
+  return hex(md, n);
+}
+
+// a file of the disk tier mapped read-only, empty if it isn't one
+struct Mapped {
+  const char* data = nullptr;
+  usize size = 0;
+  FileHeader header{};
+
+  explicit Mapped(const std::string& path) noexcept
+  {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return;
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && static_cast<usize>(st.st_size) >= sizeof(FileHeader)) {
+      void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m != MAP_FAILED) {
+        data = static_cast<const char*>(m);
+        size = st.st_size;
+      }
+    }
+    ::close(fd);
+    if (!data)
+      return;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        size - sizeof(header) != u64{header.key} + header.message + header.headers + header.body) {
+      munmap(const_cast<char*>(data), size);
+      data = nullptr;
+    }
+  }
+  ~Mapped()
+  {
+    if (data)
+      munmap(const_cast<char*>(data), size);
+  }
+
+  inline std::string_view key() const noexcept { return {data + sizeof(header), header.key}; }
+};
+}  // namespace
+
+Response ResponseCache::Entry::response() const noexcept
+{
+  auto parsed = Headers::parse(headers);
+  return Response{.statusCode = status,
+    .statusMessage = std::pmr::string{statusMessage, &bufferPool()},
+    .headers = parsed ? std::move(*parsed) : Headers{},
+    .body = std::pmr::string{body, &bufferPool()}};
+}
+
+ResponseCache::ResponseCache() : ResponseCache(Options{}) {}
+
+ResponseCache::ResponseCache(Options opts) : options(std::move(opts))
+{
+  if (!options.directory.empty())
+    scan();
+}
+
+ResponseCache::~ResponseCache()
+{
+  // the files stay for the next cache using the directory
+  metrics::cached<CacheMetrics>().memory.add(-static_cast<i64>(memoryBytes));
+  metrics::cached<CacheMetrics>().disk.add(-static_cast<i64>(diskBytes));
+}
+
+ResponseCache::Lookup ResponseCache::lookup(const std::string& key, Headers& headers)
+{
+  if (headers.get("if-none-match") || headers.get("if-modified-since"))
+    return {};
+
+  std::shared_ptr<const Entry> entry;
+  {
+    std::lock_guard lock(mutex);
+    entry = find(key);
+  }
+  CacheMetrics& m = metrics::cached<CacheMetrics>();
+  if (entry && !entry->revalidate && now() < entry->expires) {
+    m.hits.add();
+    return {entry->response(), nullptr};
+  }
+
+  auto etag = entry ? Headers::find(entry->headers, "etag") : std::nullopt;
+  auto modified = entry ? Headers::find(entry->headers, "last-modified") : std::nullopt;
+  if (!etag && !modified) {
+    m.misses.add();
+    return {};
+  }
+  if (etag)
+    headers.add("If-None-Match", *etag);
+  if (modified)
+    headers.add("If-Modified-Since", *modified);
+  return {std::nullopt, std::move(entry)};
+}
+
+Response ResponseCache::store(const std::string& key, Response res, const std::shared_ptr<const Entry>& stale)
+{
+  i64 received = now();
+  if (res.statusCode == 304 && stale) {
+    metrics::cached<CacheMetrics>().revalidated.add();
+    // the 304 brings the stored response's new freshness and validators
+    Headers headers = Headers::parse(stale->headers).value_or(Headers{});
+    for (std::string_view field : {"cache-control", "date", "expires", "age", "etag", "last-modified", "vary"})
+      if (auto v = res.headers.get(field))
+        headers.add(field, *v);
+    Policy p = policy(headers, received);
+    auto entry = std::make_shared<Entry>(*stale);
+    entry->headers = headers.toString();
+    entry->expires = p.expires;
+    entry->revalidate = p.revalidate;
+
+    std::lock_guard lock(mutex);
+    if (p.store)
+      insert(key, entry);
+    else
+      erase(key);
+    return entry->response();
+  }
+  if (res.statusCode != 200)
+    return res;
+
+  Policy p = policy(res.headers, received);
+  if (!p.store) {
+    std::lock_guard lock(mutex);
+    erase(key);
+    return res;
+  }
+
+  Headers headers = res.headers;
+  for (std::string_view framing : {"content-length", "transfer-encoding", "content-encoding"}) headers.remove(framing);
+  auto entry = std::make_shared<Entry>(Entry{
+    res.statusCode, std::string{res.statusMessage}, headers.toString(), std::string{res.body}, p.expires, p.revalidate});
+  std::lock_guard lock(mutex);
+  insert(key, std::move(entry));
+  return res;
+}
+
+std::string ResponseCache::key(const URI& uri, std::string_view path, const Headers& headers)
+{
+  std::string k = uri.protocol + "://" + uri.host + ":" + std::to_string(uri.port);
+  k += path;
+  // hashed, keys end up in the disk tier's files
+  if (auto auth = headers.get("authorization")) {
+    k += '\n';
+    k += sha256(*auth);
+  }
+  return k;
+}
+
+usize ResponseCache::memoryUsage() const noexcept
+{
+  std::lock_guard lock(mutex);
+  return memoryBytes;
+}
+
+usize ResponseCache::diskUsage() const noexcept
+{
+  std::lock_guard lock(mutex);
+  return diskBytes;
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::find(const std::string& key)
+{
+  if (auto it = memoryIndex.find(key); it != memoryIndex.end()) {
+    memory.splice(memory.begin(), memory, it->second);
+    return it->second->entry;
+  }
+  auto it = diskIndex.find(key);
+  if (it == diskIndex.end())
+    return nullptr;
+
+  // back to memory, where it may push others out to disk
+  auto entry = load(*it->second);
+  dropFile(it->second);
+  if (entry)
+    insert(key, entry);
+  return entry;
+}
+
+void ResponseCache::insert(const std::string& key, std::shared_ptr<const Entry> entry)
+{
+  erase(key);
+  usize size = entry->size();
+  memory.push_front({key, std::move(entry)});
+  memoryIndex.emplace(memory.front().key, memory.begin());
+  memoryBytes += size;
+  metrics::cached<CacheMetrics>().memory.add(size);
+  evict();
+}
+
+void ResponseCache::erase(const std::string& key)
+{
+  if (auto it = memoryIndex.find(key); it != memoryIndex.end()) {
+    auto slot = it->second;
+    memoryBytes -= slot->entry->size();
+    metrics::cached<CacheMetrics>().memory.add(-static_cast<i64>(slot->entry->size()));
+    memoryIndex.erase(it);
+    memory.erase(slot);
+  }
+  if (auto it = diskIndex.find(key); it != diskIndex.end())
+    dropFile(it->second);
+}
+
+void ResponseCache::evict()
+{
+  while (memoryBytes > options.memoryBytes && !memory.empty()) {
+    const Slot& last = memory.back();
+    if (!options.directory.empty())
+      spill(last);
+    memoryBytes -= last.entry->size();
+    metrics::cached<CacheMetrics>().memory.add(-static_cast<i64>(last.entry->size()));
+    memoryIndex.erase(last.key);
+    memory.pop_back();
+  }
+  while (diskBytes > options.diskBytes && !disk.empty()) dropFile(std::prev(disk.end()));
+}
+
+void ResponseCache::spill(const Slot& slot)
+{
+  const Entry& e = *slot.entry;
+  // the key's hash names the file, the key inside tells collisions apart
+  std::string path = options.directory + "/" + sha256(slot.key).substr(0, 32);
+  FileHeader h{};
+  std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.status = e.status;
+  h.revalidate = e.revalidate;
+  h.key = slot.key.size();
+  h.message = e.statusMessage.size();
+  h.headers = e.headers.size();
+  h.body = e.body.size();
+  h.expires = e.expires;
+
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return;
+  bool ok = true;
+  for (std::string_view part : {std::string_view{reinterpret_cast<const char*>(&h), sizeof(h)},
+         std::string_view{slot.key}, std::string_view{e.statusMessage}, std::string_view{e.headers},
+         std::string_view{e.body}})
+    for (usize done = 0; ok && done < part.size();) {
+      isize n = ::write(fd, part.data() + done, part.size() - done);
+      ok = n > 0;
+      done += ok ? n : 0;
+    }
+  ::close(fd);
+  // a failed write drops the entry instead
+  if (!ok) {
+    ::unlink(path.c_str());
+    return;
+  }
+
+  usize size = sizeof(h) + slot.key.size() + e.statusMessage.size() + e.headers.size() + e.body.size();
+  disk.push_front({slot.key, std::move(path), size});
+  diskIndex.emplace(disk.front().key, disk.begin());
+  diskBytes += size;
+  metrics::cached<CacheMetrics>().disk.add(size);
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::load(const File& file) const
+{
+  Mapped m{file.path};
+  if (!m.data || m.key() != file.key)
+    return nullptr;
+
+  const char* p = m.data + sizeof(FileHeader) + m.header.key;
+  auto entry = std::make_shared<Entry>();
+  entry->status = m.header.status;
+  entry->revalidate = m.header.revalidate;
+  entry->expires = m.header.expires;
+  entry->statusMessage.assign(p, m.header.message);
+  p += m.header.message;
+  entry->headers.assign(p, m.header.headers);
+  p += m.header.headers;
+  entry->body.assign(p, m.header.body);
+  return entry;
+}
+
+void ResponseCache::dropFile(std::list<File>::iterator it)
+{
+  ::unlink(it->path.c_str());
+  diskBytes -= it->size;
+  metrics::cached<CacheMetrics>().disk.add(-static_cast<i64>(it->size));
+  diskIndex.erase(it->key);
+  disk.erase(it);
+}
+
+void ResponseCache::scan()
+{
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  fs::create_directories(options.directory, ec);
+
+  struct Found {
+    fs::file_time_type modified;
+    std::string key;
+    std::string path;
+    usize size;
+  };
+  std::vector<Found> found;
+  for (const auto& file : fs::directory_iterator(options.directory, ec)) {
+    if (!file.is_regular_file(ec))
+      continue;
+    // anything else in the directory isn't ours to touch
+    Mapped m{file.path().string()};
+    if (m.data)
+      found.push_back({file.last_write_time(ec), std::string{m.key()}, file.path().string(), m.size});
+  }
+
+  // most recently written first, as if they'd just been spilled in that order
+  std::ranges::sort(found, [](const Found& a, const Found& b) { return a.modified > b.modified; });
+  for (Found& f : found) {
+    if (diskIndex.contains(f.key))
+      continue;
+    disk.push_back({std::move(f.key), std::move(f.path), f.size});
+    diskIndex.emplace(disk.back().key, std::prev(disk.end()));
+    diskBytes += f.size;
+    metrics::cached<CacheMetrics>().disk.add(f.size);
+  }
+  while (diskBytes > options.diskBytes && !disk.empty()) dropFile(std::prev(disk.end()));
+}
+}  // namespace twilight::http
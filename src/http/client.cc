@@ -4,11 +4,13 @@
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
-#include <format>
+#include <algorithm>
+#include <charconv>
 #include <memory>
 #include <mutex>
 #include <type_traits>
 
+#include "http/cache.h"
 #include "http/headers.h"
 #include "utils/bitwise.h"
 
@@ -16,9 +18,30 @@ static constexpr const char* HTTP_VER = "HTTP/1.1";
 static constexpr const char* USER_AGENT = "twilight/" VERSION;
 
 static constexpr u8 MAX_REDIRECTS = 16;
+// ciphertext read per syscall, four full TLS records
+static constexpr usize CIPHERTEXT_CHUNK = 65536;
 
 namespace twilight::http
 {
+namespace
+{
+struct HttpMetrics {
+  metrics::AtomicHistogram& dns = metrics::registry().histogram("http_dns_ns");
+  metrics::AtomicHistogram& connect = metrics::registry().histogram("http_connect_ns");
+  metrics::AtomicHistogram& tls = metrics::registry().histogram("http_tls_ns");
+  metrics::AtomicHistogram& write = metrics::registry().histogram("http_write_ns");
+  metrics::AtomicHistogram& firstByte = metrics::registry().histogram("http_ttfb_ns");
+  metrics::AtomicHistogram& transfer = metrics::registry().histogram("http_transfer_ns");
+  metrics::AtomicHistogram& dechunk = metrics::registry().histogram("http_dechunk_ns");
+  metrics::AtomicHistogram& decompress = metrics::registry().histogram("http_decompress_ns");
+  metrics::AtomicHistogram& total = metrics::registry().histogram("http_request_ns");
+  metrics::Counter& requests = metrics::registry().counter("http_requests_total");
+  metrics::Counter& connections = metrics::registry().counter("http_connections_total");
+  metrics::Counter& sent = metrics::registry().counter("http_sent_bytes_total");
+  metrics::Counter& received = metrics::registry().counter("http_received_bytes_total");
+};
+}  // namespace
+
 Client::Client(const URI& uri, ClientFlags flags) : uri(uri), flags(flags)
 {
   static std::once_flag sslInit;
@@ -37,12 +60,14 @@ void Client::connect()
   hints.ai_socktype = SOCK_STREAM;
   hints.ai_family = AF_UNSPEC;
 
+  auto start = metrics::now();
   addrinfo* res = nullptr;
   int err = getaddrinfo(uri.host.c_str(), std::to_string(uri.port).c_str(), &hints, &res);
   if (err)
     throw std::runtime_error("getaddrinfo: " + std::string(gai_strerror(err)));
 
   auto resGuard = std::unique_ptr<addrinfo, decltype(&freeaddrinfo)>(res, &freeaddrinfo);
+  auto resolved = metrics::now();
 
   // Connect
   for (addrinfo* p = res; p; p = p->ai_next) {
@@ -56,112 +81,173 @@ void Client::connect()
   }
   if (sock.fd < 0)
     throw std::runtime_error("Unable to connect to " + uri.host);
+  if (!!(flags & ClientFlags::Uring) && UringSocket::supported())
+    ring = std::make_unique<UringSocket>(sock.fd);
+  auto opened = metrics::now();
 
-  // TLS
+  // TLS, over whichever of the two carries the bytes
   if (uri.isSecure()) {
     sslCtx.ptr = SSL_CTX_new(TLS_client_method());
     if (!sslCtx.ptr)
       throw std::runtime_error("SSL_CTX_new failed");
     SSL_CTX_set_verify(sslCtx.ptr, SSL_VERIFY_NONE, nullptr);
 
-    ssl.ptr = SSL_new(sslCtx.ptr);
-    SSL_set_fd(ssl.ptr, sock.fd);
-    SSL_set_tlsext_host_name(ssl.ptr, uri.host.c_str());
-    if (SSL_connect(ssl.ptr) != 1) {
+    tls = std::make_unique<Tls>(sslCtx.ptr, uri.host);
+    incoming.resize(CIPHERTEXT_CHUNK);
+    if (!handshake()) {
       ERR_print_errors_fp(stderr);
       throw std::runtime_error("SSL_connect failed");
     }
   }
 
+  timing = {.dns = resolved - start, .connect = opened - resolved};
+  if (tls)
+    timing.tls = metrics::now() - opened;
+  fresh = true;
   connected = true;
 }
 
-isize Client::recv(char* buf, usize len) const noexcept
+bool Client::handshake() noexcept
 {
-  return ssl.ptr ? SSL_read(ssl.ptr, buf, len) : ::recv(sock.fd, buf, len, 0);
+  while (true) {
+    Tls::Status status = tls->handshake();
+    {
+      // through io_uring each flight goes out with the wait for the server's answer
+      std::lock_guard<std::mutex> lock(writing);
+      if (!flush(status == Tls::Status::WantRead))
+        return false;
+    }
+    if (status != Tls::Status::WantRead)
+      return status == Tls::Status::Done;
+    isize n = recvRaw(incoming.data(), incoming.size());
+    if (n <= 0)
+      return false;
+    tls->feed(incoming.data(), n);
+  }
 }
 
-isize Client::send(const char* buf, usize len) const noexcept
+isize Client::recvRaw(char* buf, usize len) const noexcept
 {
-  return ssl.ptr ? SSL_write(ssl.ptr, buf, len) : ::send(sock.fd, buf, len, 0);
+  return ring ? ring->recv(buf, len) : ::recv(sock.fd, buf, len, 0);
 }
 
-bool Client::sendAll(const std::string& msg) const noexcept
-{
-  usize off = 0, len = msg.size();
-  while (off < len) {
-    isize n = send(msg.data() + off, len - off);
-    if (n <= 0) {
-      if (ssl.ptr) {
-        int e = SSL_get_error(ssl.ptr, n);
-        if (e == SSL_ERROR_WANT_READ || e == SSL_ERROR_WANT_WRITE)
-          continue;
-      }
+bool Client::sendRaw(const char* buf, usize len, bool defer) const noexcept
+{
+  if (ring)
+    return ring->send(buf, len, defer) >= 0;
+  for (usize off = 0; off < len;) {
+    isize n = ::send(sock.fd, buf + off, len - off, 0);
+    if (n <= 0)
       return false;
-    }
     off += n;
   }
   return true;
 }
 
-std::string Client::recvAll() const noexcept
+bool Client::flush(bool defer) const noexcept
 {
-  constexpr isize CHUNK = 4096;
-  std::string data;
+  sealed.clear();
+  return !tls->take(sealed) || sendRaw(sealed.data(), sealed.size(), defer);
+}
 
+isize Client::recv(char* buf, usize len) const noexcept
+{
+  if (!tls)
+    return recvRaw(buf, len);
+  // records already read are decrypted before the socket is asked for more
   while (true) {
-    char buf[CHUNK];
-    isize n = recv(buf, CHUNK);
-    if (n <= 0)
-      break;
-    data.append(buf, n);
-    if (data.find("\r\n\r\n") != std::string::npos)
+    isize n = tls->read(buf, len);
+    if (n != Tls::MORE)
+      return n;
+    // reading may have left something to answer, e.g. a key update
+    if (tls->pending()) {
+      std::lock_guard<std::mutex> lock(writing);
+      if (!flush(false))
+        return -1;
+    }
+    isize r = recvRaw(incoming.data(), incoming.size());
+    if (r <= 0)
+      return r;
+    tls->feed(incoming.data(), r);
+  }
+}
+
+bool Client::sendAll(const std::string& msg, bool defer) const noexcept
+{
+  if (!tls)
+    return sendRaw(msg.data(), msg.size(), defer);
+  // the whole message is sealed at once, into full records, and goes out with one send
+  std::lock_guard<std::mutex> lock(writing);
+  return tls->write(msg.data(), msg.size()) && flush(defer);
+}
+
+void Client::recvAll(std::string& data, metrics::Clock::time_point* firstByte) const noexcept
+{
+  constexpr usize CHUNK = 16384;
+  usize start = data.size();
+
+  // reads straight into `data`, false once the connection has nothing more
+  auto more = [&] {
+    usize used = data.size();
+    data.resize(used + CHUNK);
+    isize n = recv(data.data() + used, CHUNK);
+    data.resize(used + std::max<isize>(n, 0));
+    return n > 0;
+  };
+
+  usize hdrEnd = std::string::npos;
+  while (hdrEnd == std::string::npos) {
+    usize scanned = std::max(data.size(), start + 3) - 3;
+    if (!more())
       break;
+    if (firstByte && scanned == start)
+      *firstByte = metrics::now();
+    hdrEnd = data.find("\r\n\r\n", scanned);
   }
 
   // If we never saw headers, return what we have
-  usize hdrEnd = data.find("\r\n\r\n");
   if (hdrEnd == std::string::npos)
-    return data;
-
-  // Parse headers
-  std::string headerBlk = data.substr(0, hdrEnd);
-  auto hdrsExp = Headers::parse(headerBlk);
-  if (!hdrsExp.has_value())
-    return data;  // let Response::parse fail on malformed headers
+    return;
 
-  Headers& hdrs = *hdrsExp;
+  std::string_view headerBlk = std::string_view{data}.substr(start, hdrEnd - start);
   usize bodySoFar = data.size() - (hdrEnd + 4);
 
   // Content-Length?
-  if (auto cl = hdrs.get("Content-Length"); cl.has_value()) {
-    usize want = std::stoul(*cl);
+  if (auto cl = Headers::find(headerBlk, "Content-Length"); cl.has_value()) {
+    usize want = 0;
+    std::from_chars(cl->data(), cl->data() + cl->size(), want);
     while (bodySoFar < want) {
-      char buf[CHUNK];
-      isize n = recv(buf, CHUNK);
-      if (n <= 0)
+      usize before = data.size();
+      if (!more())
         break;
-      data.append(buf, n);
-      bodySoFar += n;
+      bodySoFar += data.size() - before;
     }
   }  // chunked?
-  else if (hdrs.get("Transfer-Encoding").value_or("") == "chunked") {
-    // read until the zero‐length chunk terminator
-    while (data.find("\r\n0\r\n\r\n", hdrEnd + 4) == std::string::npos) {
-      char buf[CHUNK];
-      isize n = recv(buf, CHUNK);
-      if (n <= 0)
+  else if (Headers::find(headerBlk, "Transfer-Encoding").value_or("") == "chunked") {
+    // read until the zero-length chunk terminator, the CRLF before it may be the one ending the headers
+    usize scanned = hdrEnd + 2;
+    while (data.find("\r\n0\r\n\r\n", scanned) == std::string::npos) {
+      scanned = std::max(data.size(), scanned + 6) - 6;
+      if (!more())
         break;
-      data.append(buf, n);
     }
   }
-
-  return data;
 }
 
 Response Client::request(const std::string& path, RequestInit opts)
 {
-  std::string hostHdr = uri.host;
+  std::string cacheKey;
+  ResponseCache::Lookup cached;
+  if (opts.cache && opts.method == Method::GET) {
+    cacheKey = ResponseCache::key(uri, path, opts.headers);
+    cached = opts.cache->lookup(cacheKey, opts.headers);
+    if (cached.hit)
+      return std::move(*cached.hit);
+  }
+  connect();
+
+  // ipv6 literals keep their brackets in the Host header
+  std::string hostHdr = uri.host.find(':') == std::string::npos ? uri.host : "[" + uri.host + "]";
   if ((uri.port != 80 && uri.port != 443))
     hostHdr += ":" + std::to_string(uri.port);
   opts.headers.addIfNotExists("Host", hostHdr);
@@ -172,33 +258,95 @@ Response Client::request(const std::string& path, RequestInit opts)
   if (!opts.body.empty())
     opts.headers.addIfNotExists("Content-Length", std::to_string(opts.body.size()));
 
-  static const std::array<std::string, 7> M = {"GET", "POST", "PUT", "DELETE", "PATCH", "OPTIONS", "HEAD"};
-  std::string mstr = M[usize(opts.method)];
-
-  std::string msg = std::format("{} {} {}\r\n{}\r\n{}", mstr, path, HTTP_VER, opts.headers.toString(), opts.body);
-
-  if (!sendAll(msg))
+  static constexpr std::array<std::string_view, 7> M = {"GET", "POST", "PUT", "DELETE", "PATCH", "OPTIONS", "HEAD"};
+
+  // a request after the one that opened the connection only has its own phases
+  if (!fresh)
+    timing = {.reused = true};
+  fresh = false;
+
+  buf.clear();
+  buf += M[usize(opts.method)];
+  buf += ' ';
+  buf += path;
+  buf += ' ';
+  buf += HTTP_VER;
+  buf += "\r\n";
+  opts.headers.appendTo(buf);
+  buf += "\r\n";
+  buf += opts.body;
+
+  auto start = metrics::now();
+  // through io_uring the request goes out with the wait for its response, in one syscall
+  if (!sendAll(buf, true))
     throw std::runtime_error("Failed to send request");
-
-  std::string raw = recvAll();
-  auto res = Response::parse(raw);
+  auto sent = metrics::now();
+  timing.write = sent - start;
+  timing.bytesSent = buf.size();
+
+  buf.clear();
+  auto firstByte = sent;
+  recvAll(buf, &firstByte);
+  timing.firstByte = firstByte - sent;
+  timing.transfer = metrics::now() - firstByte;
+  timing.bytesReceived = buf.size();
+
+  auto res = Response::parse(buf, &bufferPool(), &timing);
   if (!res.has_value())
     throw std::runtime_error("Failed to parse response: " + res.error());
+  report();
+
+  if (!cacheKey.empty()) {
+    res = opts.cache->store(cacheKey, std::move(*res), cached.stale);
+    // the validators were for this resource, not wherever it redirects to
+    if (cached.stale) {
+      opts.headers.remove("If-None-Match");
+      opts.headers.remove("If-Modified-Since");
+    }
+  }
 
   if (static_cast<std::underlying_type_t<ClientFlags>>(flags & ClientFlags::NoFollow) || res->statusCode < 300 ||
       res->statusCode >= 400)
-    return *res;
+    return std::move(*res);
 
   std::remove_const_t<decltype(MAX_REDIRECTS)> redirects = 0;
   while (res->statusCode >= 300 && res->statusCode < 400) {
-    std::string loc = res->headers.get("Location").value_or("");
+    std::string loc{res->headers.get("Location").value_or("")};
     if (loc.empty())
       break;
     if (++redirects > MAX_REDIRECTS)
       throw std::runtime_error("Too many redirects");
     res = request(loc, std::move(opts));
   }
-  return *res;
+  return std::move(*res);
+}
+
+void Client::report() noexcept
+{
+  if constexpr (!metrics::ENABLED)
+    return;
+
+  HttpMetrics& m = metrics::cached<HttpMetrics>();
+  if (!timing.reused) {
+    m.connections.add();
+    m.dns.record(timing.dns);
+    m.connect.record(timing.connect);
+    if (tls)
+      m.tls.record(timing.tls);
+  }
+  m.write.record(timing.write);
+  m.firstByte.record(timing.firstByte);
+  m.transfer.record(timing.transfer);
+  if (timing.dechunk.count())
+    m.dechunk.record(timing.dechunk);
+  if (timing.decompress.count())
+    m.decompress.record(timing.decompress);
+  m.total.record(timing.total());
+  m.requests.add();
+  m.sent.add(timing.bytesSent);
+  m.received.add(timing.bytesReceived);
+
+  ontimings(timing);
 }
 
 Client::Socket::~Socket()
@@ -215,15 +363,10 @@ Client::SSLCtx::~SSLCtx()
     SSL_CTX_free(ptr);
 }
 
-Client::SSLHandle::~SSLHandle()
-{
-  if (ptr)
-    SSL_free(ptr);
-}
-
 Response fetch(const URI& uri, RequestInit opts)
 {
-  Client client{uri};
-  return client.request(uri.path, std::move(opts));
+  // connected by request(), which a cache hit never gets to
+  Client client{uri, ClientFlags::NoConnect};
+  return client.request(uri.target(), std::move(opts));
 }
 }  // namespace twilight::http
@@ -1,38 +1,94 @@
 #include "http/headers.h"
 
-#include <algorithm>
-#include <sstream>
-
 #include "utils/types.h"
 
-static std::string toLower(const std::string& s)
-{
-  std::string lower = s;
-  std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
-  return lower;
-}
+static inline char toLower(char c) { return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c; }
 
-static std::string trim(const std::string& s)
+static std::string_view trim(std::string_view s)
 {
   auto b = s.find_first_not_of(" \t");
-  if (b == std::string::npos)
-    return "";
+  if (b == std::string_view::npos)
+    return {};
   auto e = s.find_last_not_of(" \t");
   return s.substr(b, e - b + 1);
 }
 
+static bool equalsIgnoreCase(std::string_view a, std::string_view b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (usize i = 0; i < a.size(); ++i)
+    if (toLower(a[i]) != toLower(b[i]))
+      return false;
+  return true;
+}
+
+// calls `f(name, value)` for every header line until the first empty one, lines without a colon are skipped
+template <typename F>
+static void forEachLine(std::string_view raw, F&& f)
+{
+  while (!raw.empty()) {
+    usize eol = raw.find('\n');
+    std::string_view line = raw.substr(0, eol);
+    raw = eol == std::string_view::npos ? std::string_view{} : raw.substr(eol + 1);
+    if (line.ends_with('\r'))
+      line.remove_suffix(1);
+    if (line.empty())
+      break;
+
+    usize colonPos = line.find(':');
+    if (colonPos == std::string_view::npos)
+      continue;
+    if (!f(trim(line.substr(0, colonPos)), trim(line.substr(colonPos + 1))))
+      break;
+  }
+}
+
+namespace
+{
+// header names are short, so they're lowercased on the stack
+struct LowerKey {
+  char buf[64];
+  std::string spill;
+  std::string_view view;
+
+  explicit LowerKey(std::string_view key) noexcept
+  {
+    char* out = buf;
+    if (key.size() > sizeof(buf)) {
+      spill.resize(key.size());
+      out = spill.data();
+    }
+    for (usize i = 0; i < key.size(); ++i) out[i] = toLower(key[i]);
+    view = {out, key.size()};
+  }
+};
+}  // namespace
+
 namespace twilight::http
 {
-Headers::Headers(const std::initializer_list<std::pair<std::string, std::string>>& headers) noexcept
+Headers::Headers(const std::initializer_list<std::pair<std::string_view, std::string_view>>& headers,
+  std::pmr::memory_resource* resource) noexcept
+  : headers(resource)
 {
-  for (const auto& [key, value] : headers) add(toLower(key), value);
+  for (const auto& [key, value] : headers) add(key, value);
 }
 
-Headers::Headers(const std::map<std::string, std::string>& headers) noexcept : headers(headers) {}
+Headers::Headers(const std::map<std::string, std::string>& headers) noexcept : Headers()
+{
+  for (const auto& [key, value] : headers) add(key, value);
+}
 
-void Headers::add(const std::string& key, const std::string& value) noexcept { headers[toLower(key)] = value; }
+void Headers::add(std::string_view key, std::string_view value) noexcept
+{
+  LowerKey lower{key};
+  if (auto it = headers.find(lower.view); it != headers.end())
+    it->second.assign(value);
+  else
+    headers.emplace(lower.view, value);
+}
 
-void Headers::addIfNotExists(const std::string& key, const std::string& value) noexcept
+void Headers::addIfNotExists(std::string_view key, std::string_view value) noexcept
 {
   if (get(key).has_value())
     return;
@@ -40,43 +96,58 @@ void Headers::addIfNotExists(const std::string& key, const std::string& value) n
   add(key, value);
 }
 
-std::optional<std::string> Headers::get(const std::string& key) const noexcept
+void Headers::remove(std::string_view key) noexcept
 {
-  std::string lowerKey = toLower(key);
-  if (headers.find(lowerKey) == headers.end())
+  LowerKey lower{key};
+  if (auto it = headers.find(lower.view); it != headers.end())
+    headers.erase(it);
+}
+
+std::optional<std::string_view> Headers::get(std::string_view key) const noexcept
+{
+  LowerKey lower{key};
+  auto it = headers.find(lower.view);
+  if (it == headers.end())
     return std::nullopt;
 
-  return headers.at(lowerKey);
+  return it->second;
 }
 
 std::string Headers::toString() const noexcept
 {
-  std::stringstream ss;
-  for (const auto& [key, value] : headers) ss << key << ": " << value << "\r\n";
-  return ss.str();
+  std::string out;
+  appendTo(out);
+  return out;
 }
 
-std::expected<Headers, std::string> Headers::parse(const std::string& raw) noexcept
+void Headers::appendTo(std::string& out) const noexcept
 {
-  Headers hdrs;
-
-  std::istringstream ss(raw);
-  std::string line;
-
-  while (std::getline(ss, line) && !line.empty()) {
-    if (line.back() == '\r')
-      line.pop_back();
-
-    usize colonPos = line.find(':');
-    if (colonPos == std::string::npos)
-      continue;
-
-    std::string name = trim(line.substr(0, colonPos));
-    std::string value = trim(line.substr(colonPos + 1));
-
-    hdrs.add(name, value);
+  for (const auto& [key, value] : headers) {
+    out += key;
+    out += ": ";
+    out += value;
+    out += "\r\n";
   }
+}
 
+std::expected<Headers, std::string> Headers::parse(std::string_view raw, std::pmr::memory_resource* resource) noexcept
+{
+  Headers hdrs{resource};
+  forEachLine(raw, [&](std::string_view name, std::string_view value) {
+    hdrs.add(name, value);
+    return true;
+  });
   return hdrs;
 }
+
+std::optional<std::string_view> Headers::find(std::string_view raw, std::string_view key) noexcept
+{
+  std::optional<std::string_view> found;
+  forEachLine(raw, [&](std::string_view name, std::string_view value) {
+    if (equalsIgnoreCase(name, key))
+      found = value;
+    return !found;
+  });
+  return found;
+}
 }  // namespace twilight::http
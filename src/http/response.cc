@@ -3,72 +3,91 @@
 #include <brotli/decode.h>
 #include <zlib.h>
 
+#include <algorithm>
+#include <charconv>
 #include <expected>
-#include <vector>
 
 #include "http/headers.h"
+#include "utils/metrics.h"
 
 namespace twilight::http
 {
-std::expected<Response, std::string> Response::parse(const std::string &raw) noexcept
+std::expected<Response, std::string>
+Response::parse(std::string_view raw, std::pmr::memory_resource *resource, Timings *timings) noexcept
 {
   usize headerEnd = raw.find("\r\n\r\n");
-  if (headerEnd == std::string::npos)
+  if (headerEnd == std::string_view::npos)
     return std::unexpected("No CRLF separator found in response");
 
-  std::string headerBlk = raw.substr(0, headerEnd);
-  std::string body = raw.substr(headerEnd + 4);
+  std::string_view headerBlk = raw.substr(0, headerEnd);
+  std::string_view body = raw.substr(headerEnd + 4);
 
   usize statusLineEnd = headerBlk.find("\r\n");
-  if (statusLineEnd == std::string::npos)
+  if (statusLineEnd == std::string_view::npos)
     return std::unexpected("Invalid header line");
 
-  std::string statusLine = headerBlk.substr(0, statusLineEnd);
+  std::string_view statusLine = headerBlk.substr(0, statusLineEnd);
   usize sp1 = statusLine.find(' ');
   usize sp2 = statusLine.find(' ', sp1 + 1);
-  if (sp1 == std::string::npos || sp2 == std::string::npos)
+  if (sp1 == std::string_view::npos || sp2 == std::string_view::npos)
     return std::unexpected("Invalid status line");
 
-  u16 statusCode = std::stoul(statusLine.substr(sp1 + 1, sp2 - sp1 - 1));
-  std::string statusMessage = statusLine.substr(sp2 + 1);
+  u16 statusCode = 0;
+  if (std::from_chars(statusLine.data() + sp1 + 1, statusLine.data() + sp2, statusCode).ec != std::errc{})
+    return std::unexpected("Invalid status code");
 
-  auto headers = Headers::parse(headerBlk.substr(statusLineEnd + 2));
+  auto headers = Headers::parse(headerBlk.substr(statusLineEnd + 2), resource);
   if (!headers.has_value())
     return std::unexpected("Invalid header format");
 
+  Response res{.statusCode = statusCode,
+    .statusMessage = std::pmr::string{statusLine.substr(sp2 + 1), resource},
+    .headers = std::move(*headers),
+    .body = std::pmr::string{resource}};
+
   if (body.size()) {
-    if (auto te = headers->get("transfer-encoding"); te.value_or("") == "chunked") {
-      body = decodeChunked(body);
+    std::pmr::string chunked{resource};
+    if (auto te = res.headers.get("transfer-encoding"); te.value_or("") == "chunked") {
+      auto start = metrics::now();
+      chunked = decodeChunked(body, resource);
+      body = chunked;
+      if (timings)
+        timings->dechunk = metrics::now() - start;
     }
 
-    if (auto ce = headers->get("content-encoding"); ce.has_value()) {
-      auto decompressed = decompress(ce.value(), body);
+    if (auto ce = res.headers.get("content-encoding"); ce.has_value()) {
+      auto start = metrics::now();
+      auto decompressed = decompress(*ce, body, resource);
       if (!decompressed.has_value())
         return std::unexpected(decompressed.error());
-      body = decompressed.value();
+      res.body = std::move(*decompressed);
+      if (timings)
+        timings->decompress = metrics::now() - start;
+    } else if (body.data() == chunked.data()) {
+      res.body = std::move(chunked);
+    } else {
+      res.body.assign(body);
     }
   }
 
-  return Response{.statusCode = statusCode, .statusMessage = statusMessage, .headers = headers.value(), .body = body};
+  if (timings)
+    timings->bodySize = res.body.size();
+  return res;
 }
 
-std::string Response::decodeChunked(const std::string &data) noexcept
+std::pmr::string Response::decodeChunked(std::string_view data, std::pmr::memory_resource *resource) noexcept
 {
-  std::string out;
+  std::pmr::string out{resource};
   size_t pos = 0;
   while (pos < data.size()) {
     // Find the next CRLF
     size_t crlf = data.find("\r\n", pos);
-    if (crlf == std::string::npos)
+    if (crlf == std::string_view::npos)
       break;
-    // Parse chunk size
-    std::string szstr = data.substr(pos, crlf - pos);
+    // Parse chunk size, extensions after ';' are ignored
     size_t chunk_size = 0;
-    try {
-      chunk_size = std::stoul(szstr, nullptr, 16);
-    } catch (...) {
+    if (std::from_chars(data.data() + pos, data.data() + crlf, chunk_size, 16).ec != std::errc{})
       break;
-    }
     if (chunk_size == 0)
       break;
     pos = crlf + 2;
@@ -83,8 +102,8 @@ std::string Response::decodeChunked(const std::string &data) noexcept
   return out;
 }
 
-std::expected<std::string, std::string>
-Response::decompress(const std::string &encoding, const std::string &data) noexcept
+std::expected<std::pmr::string, std::string>
+Response::decompress(std::string_view encoding, std::string_view data, std::pmr::memory_resource *resource) noexcept
 {
   if (encoding == "gzip" || encoding == "deflate") {
     // zlib/gzip/deflate
@@ -93,18 +112,20 @@ Response::decompress(const std::string &encoding, const std::string &data) noexc
     zs.avail_in = data.size();
     if (inflateInit2(&zs, encoding == "gzip" ? 16 + MAX_WBITS : MAX_WBITS) != Z_OK)
       return std::unexpected("Failed to initialize zlib stream");
-    std::string out;
-    char buf[4096];
+    // inflated straight into the result, grown as needed
+    std::pmr::string out{resource};
     int ret;
     do {
-      zs.next_out = reinterpret_cast<Bytef *>(buf);
-      zs.avail_out = sizeof(buf);
+      usize used = out.size();
+      out.resize(used + std::max<usize>(4096, data.size() * 3));
+      zs.next_out = reinterpret_cast<Bytef *>(out.data() + used);
+      zs.avail_out = out.size() - used;
       ret = inflate(&zs, Z_NO_FLUSH);
+      out.resize(out.size() - zs.avail_out);
       if (ret != Z_OK && ret != Z_STREAM_END) {
         inflateEnd(&zs);
         return std::unexpected("Invalid compression");
       }
-      out.append(buf, sizeof(buf) - zs.avail_out);
     } while (ret != Z_STREAM_END);
     inflateEnd(&zs);
     return out;
@@ -115,9 +136,9 @@ Response::decompress(const std::string &encoding, const std::string &data) noexc
       return std::unexpected("Failed to initialize brotli stream");
     const uint8_t *next_in = reinterpret_cast<const uint8_t *>(data.data());
     size_t available_in = data.size();
-    size_t out_len = data.size() * 3 + 1024;  // guess
-    std::vector<uint8_t> out(out_len);
-    uint8_t *next_out = out.data();
+    std::pmr::string out{resource};
+    out.resize(data.size() * 3 + 1024);  // guess
+    uint8_t *next_out = reinterpret_cast<uint8_t *>(out.data());
     size_t available_out = out.size();
     size_t total_out = 0;
     BrotliDecoderResult res;
@@ -130,16 +151,15 @@ Response::decompress(const std::string &encoding, const std::string &data) noexc
       if (res == BROTLI_DECODER_RESULT_SUCCESS)
         break;
       if (available_out == 0) {
-        size_t used = next_out - out.data();
-        out_len *= 2;
-        out.resize(out_len);
-        next_out = out.data() + used;
-        available_out = out_len - used;
+        size_t used = next_out - reinterpret_cast<uint8_t *>(out.data());
+        out.resize(out.size() * 2);
+        next_out = reinterpret_cast<uint8_t *>(out.data()) + used;
+        available_out = out.size() - used;
       }
     }
-    size_t used = next_out - out.data();
+    out.resize(next_out - reinterpret_cast<uint8_t *>(out.data()));
     BrotliDecoderDestroyInstance(s);
-    return std::string(reinterpret_cast<char *>(out.data()), used);
+    return out;
   } else {
     return std::unexpected("Unsupported encoding");
   }
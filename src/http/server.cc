@@ -0,0 +1,448 @@
+#include "http/server.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+namespace twilight::http
+{
+namespace
+{
+constexpr std::array<std::string_view, 7> METHODS = {"GET", "POST", "PUT", "DELETE", "PATCH", "OPTIONS", "HEAD"};
+
+std::string_view reason(u16 status) noexcept
+{
+  switch (status) {
+  case 100:
+    return "Continue";
+  case 200:
+    return "OK";
+  case 204:
+    return "No Content";
+  case 400:
+    return "Bad Request";
+  case 401:
+    return "Unauthorized";
+  case 404:
+    return "Not Found";
+  case 405:
+    return "Method Not Allowed";
+  case 413:
+    return "Content Too Large";
+  case 431:
+    return "Request Header Fields Too Large";
+  case 500:
+    return "Internal Server Error";
+  case 501:
+    return "Not Implemented";
+  case 503:
+    return "Service Unavailable";
+  default:
+    return "";
+  }
+}
+
+bool hasToken(std::string_view value, std::string_view token) noexcept
+{
+  auto it = std::ranges::search(value, token, {}, [](unsigned char c) { return std::tolower(c); }).begin();
+  return it != value.end();
+}
+
+inline void poll(int epoll, int op, int fd, u32 events) noexcept
+{
+  epoll_event ev{};
+  ev.events = events;
+  ev.data.fd = fd;
+  epoll_ctl(epoll, op, fd, &ev);
+}
+}  // namespace
+
+std::expected<Request, std::string> Request::parse(std::string_view head) noexcept
+{
+  usize lineEnd = head.find("\r\n");
+  std::string_view line = head.substr(0, lineEnd);
+  usize sp1 = line.find(' ');
+  usize sp2 = line.find(' ', sp1 + 1);
+  if (sp1 == std::string_view::npos || sp2 == std::string_view::npos)
+    return std::unexpected("Invalid request line");
+
+  Request req;
+  auto m = std::find(METHODS.begin(), METHODS.end(), line.substr(0, sp1));
+  if (m == METHODS.end())
+    return std::unexpected("Unknown method");
+  req.method = static_cast<Method>(m - METHODS.begin());
+  req.path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+  if (req.path.empty() || req.path[0] != '/')
+    return std::unexpected("Invalid request target");
+
+  std::string_view version = line.substr(sp2 + 1);
+  if (version != "HTTP/1.1" && version != "HTTP/1.0")
+    return std::unexpected("Unsupported HTTP version");
+
+  if (lineEnd != std::string_view::npos) {
+    auto headers = Headers::parse(head.substr(lineEnd + 2));
+    if (!headers.has_value())
+      return std::unexpected("Invalid header format");
+    req.headers = std::move(*headers);
+  }
+
+  auto conn = req.headers.get("Connection");
+  req.keepAlive = version == "HTTP/1.1" ? !(conn && hasToken(*conn, "close")) : conn && hasToken(*conn, "keep-alive");
+  return req;
+}
+
+std::string serialize(const Response& res, bool keepAlive) noexcept
+{
+  Headers headers = res.headers;
+  headers.add("Content-Length", std::to_string(res.body.size()));
+  headers.add("Connection", keepAlive ? "keep-alive" : "close");
+  std::string_view message = res.statusMessage.empty() ? reason(res.statusCode) : res.statusMessage;
+  return std::format("HTTP/1.1 {} {}\r\n{}\r\n{}", res.statusCode, message, headers.toString(), res.body);
+}
+
+Server::Server(Options options, Handler handler) : options(std::move(options)), handler(std::move(handler)) {}
+
+Server::~Server() { close(); }
+
+void Server::listen()
+{
+  addrinfo hints{}, *res = nullptr;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  std::string port = std::to_string(options.port);
+  if (int err = getaddrinfo(options.host.c_str(), port.c_str(), &hints, &res); err != 0)
+    throw std::runtime_error(std::string("getaddrinfo: ") + gai_strerror(err));
+
+  for (addrinfo* p = res; p; p = p->ai_next) {
+    listener = ::socket(p->ai_family, p->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, p->ai_protocol);
+    if (listener < 0)
+      continue;
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(listener, p->ai_addr, p->ai_addrlen) == 0 && ::listen(listener, SOMAXCONN) == 0)
+      break;
+    ::close(listener);
+    listener = -1;
+  }
+  freeaddrinfo(res);
+  if (listener < 0)
+    throw std::runtime_error("Failed to bind " + options.host + ":" + port + ": " + std::strerror(errno));
+
+  sockaddr_storage addr{};
+  socklen_t len = sizeof(addr);
+  getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+  bound = ntohs(addr.ss_family == AF_INET6 ? reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port
+                                           : reinterpret_cast<sockaddr_in*>(&addr)->sin_port);
+
+  epoll = epoll_create1(EPOLL_CLOEXEC);
+  event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epoll < 0 || event < 0)
+    throw std::runtime_error(std::string("epoll: ") + std::strerror(errno));
+  poll(epoll, EPOLL_CTL_ADD, listener, EPOLLIN);
+  poll(epoll, EPOLL_CTL_ADD, event, EPOLLIN);
+
+  usize n = options.workers ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+  for (usize i = 0; i < n; ++i) workers.emplace_back([this](std::stop_token stop) { work(stop); });
+  loop = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+void Server::close() noexcept
+{
+  loop.request_stop();
+  for (auto& w : workers) w.request_stop();
+  if (event >= 0) {
+    u64 one = 1;
+    [[maybe_unused]] auto _ = ::write(event, &one, sizeof(one));
+  }
+  if (loop.joinable())
+    loop.join();
+  for (auto& w : workers)
+    if (w.joinable())
+      w.join();
+  workers.clear();
+
+  for (auto& [fd, _] : connections) ::close(fd);
+  connections.clear();
+  for (int* fd : {&listener, &epoll, &event}) {
+    if (*fd >= 0)
+      ::close(*fd);
+    *fd = -1;
+  }
+}
+
+void Server::run(std::stop_token stop)
+{
+  constexpr int MAX_EVENTS = 64;
+  std::array<epoll_event, MAX_EVENTS> events;
+  auto swept = Clock::now();
+
+  while (!stop.stop_requested()) {
+    int n = epoll_wait(epoll, events.data(), MAX_EVENTS, 1000);
+    for (int i = 0; i < n; ++i) {
+      int fd = events[i].data.fd;
+      u32 ev = events[i].events;
+      if (fd == listener) {
+        accept();
+        continue;
+      }
+      if (fd == event) {
+        u64 count;
+        [[maybe_unused]] auto _ = ::read(event, &count, sizeof(count));
+        finish();
+        continue;
+      }
+
+      auto it = connections.find(fd);
+      if (it == connections.end())
+        continue;
+      Connection& c = it->second;
+      if ((ev & EPOLLOUT) && !write(fd, c))
+        continue;
+      // a paused connection's hangup would be reported until it's read again, and nobody's left to answer
+      if (c.paused && (ev & (EPOLLERR | EPOLLHUP)))
+        drop(fd);
+      else if (ev & (EPOLLIN | EPOLLERR | EPOLLHUP))
+        read(fd, c);
+    }
+
+    if (auto now = Clock::now(); now - swept >= std::chrono::seconds{1}) {
+      sweep(now);
+      swept = now;
+    }
+  }
+}
+
+void Server::work(std::stop_token stop)
+{
+  while (true) {
+    Job job;
+    {
+      std::unique_lock lock(jobsMutex);
+      if (!jobsCv.wait(lock, stop, [&] { return !jobs.empty(); }))
+        return;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+
+    Response res;
+    try {
+      res = handler(job.request);
+    } catch (const std::exception&) {
+      res = Response{.statusCode = 500, .statusMessage = {}, .headers = {}, .body = {}};
+    }
+
+    {
+      std::lock_guard lock(doneMutex);
+      done.push_back({job.fd, job.id, serialize(res, job.request.keepAlive), job.request.keepAlive});
+    }
+    u64 one = 1;
+    [[maybe_unused]] auto _ = ::write(event, &one, sizeof(one));
+  }
+}
+
+void Server::accept() noexcept
+{
+  while (true) {
+    int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    Connection& c = connections[fd];
+    c.id = nextId++;
+    c.active = Clock::now();
+    poll(epoll, EPOLL_CTL_ADD, fd, EPOLLIN | EPOLLRDHUP);
+  }
+}
+
+bool Server::read(int fd, Connection& c) noexcept
+{
+  constexpr usize CHUNK = 16 * 1024;
+  // pipelined requests wait in `in`, as much as a single request may take and no more
+  while (c.in.size() < options.maxHeaderSize + options.maxBodySize) {
+    usize size = c.in.size();
+    c.in.resize(size + CHUNK);
+    isize n = ::recv(fd, c.in.data() + size, CHUNK, 0);
+    c.in.resize(size + std::max<isize>(n, 0));
+    if (n > 0)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    // closed by the peer, or broken
+    drop(fd);
+    return false;
+  }
+  c.active = Clock::now();
+  next(fd, c);
+  throttle(fd);
+  return true;
+}
+
+bool Server::write(int fd, Connection& c) noexcept
+{
+  while (c.sent < c.out.size()) {
+    isize n = ::send(fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      c.sent += n;
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (!c.writing) {
+        c.writing = true;
+        interest(fd, c);
+      }
+      return true;
+    }
+    drop(fd);
+    return false;
+  }
+
+  c.out.clear();
+  c.sent = 0;
+  if (c.writing) {
+    c.writing = false;
+    interest(fd, c);
+  }
+  if (c.closing && !c.busy) {
+    drop(fd);
+    return false;
+  }
+  return true;
+}
+
+void Server::next(int fd, Connection& c) noexcept
+{
+  if (c.busy || c.closing)
+    return;
+
+  usize headEnd = c.in.find("\r\n\r\n");
+  if (headEnd == std::string::npos) {
+    if (c.in.size() > options.maxHeaderSize)
+      reject(fd, c, 431);
+    return;
+  }
+
+  auto req = Request::parse(std::string_view{c.in}.substr(0, headEnd));
+  if (!req.has_value())
+    return reject(fd, c, 400);
+  // discord always sends a Content-Length, chunked request bodies aren't worth supporting here
+  if (req->headers.get("Transfer-Encoding").has_value())
+    return reject(fd, c, 501);
+
+  usize length = 0;
+  if (auto cl = req->headers.get("Content-Length"); cl.has_value()) {
+    auto [end, ec] = std::from_chars(cl->data(), cl->data() + cl->size(), length);
+    if (ec != std::errc{} || end != cl->data() + cl->size())
+      return reject(fd, c, 400);
+  }
+  if (length > options.maxBodySize)
+    return reject(fd, c, 413);
+
+  usize bodyStart = headEnd + 4;
+  if (c.in.size() - bodyStart < length) {
+    if (!c.continued && hasToken(req->headers.get("Expect").value_or(""), "100-continue")) {
+      c.continued = true;
+      c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+      write(fd, c);
+    }
+    return;
+  }
+
+  req->body = c.in.substr(bodyStart, length);
+  req->received = Clock::now();
+  c.in.erase(0, bodyStart + length);
+  c.continued = false;
+  c.busy = true;
+  {
+    std::lock_guard lock(jobsMutex);
+    jobs.push_back({fd, c.id, std::move(*req)});
+  }
+  jobsCv.notify_one();
+}
+
+void Server::reject(int fd, Connection& c, u16 status) noexcept
+{
+  // whatever follows a bad request can't be framed, so the connection goes after this
+  c.closing = true;
+  c.in.clear();
+  c.out += serialize(Response{.statusCode = status, .statusMessage = {}, .headers = {}, .body = {}}, false);
+  write(fd, c);
+}
+
+void Server::finish() noexcept
+{
+  std::vector<Done> ready;
+  {
+    std::lock_guard lock(doneMutex);
+    ready.swap(done);
+  }
+
+  for (Done& d : ready) {
+    auto it = connections.find(d.fd);
+    // dropped while its request was handled, the fd may belong to a newer connection by now
+    if (it == connections.end() || it->second.id != d.id)
+      continue;
+    Connection& c = it->second;
+    c.busy = false;
+    c.closing = c.closing || !d.keepAlive;
+    c.active = Clock::now();
+    c.out += d.response;
+    if (write(d.fd, c)) {
+      next(d.fd, c);
+      throttle(d.fd);
+    }
+  }
+}
+
+void Server::throttle(int fd) noexcept
+{
+  // next() may have dropped it
+  auto it = connections.find(fd);
+  if (it == connections.end())
+    return;
+  Connection& c = it->second;
+  // only a request being handled keeps the buffer full, without one next() took or rejected what was there
+  bool full = c.busy && c.in.size() >= options.maxHeaderSize + options.maxBodySize;
+  if (full != c.paused) {
+    c.paused = full;
+    interest(fd, c);
+  }
+}
+
+void Server::interest(int fd, const Connection& c) noexcept
+{
+  u32 events = EPOLLRDHUP;
+  if (!c.paused)
+    events |= EPOLLIN;
+  if (c.writing)
+    events |= EPOLLOUT;
+  poll(epoll, EPOLL_CTL_MOD, fd, events);
+}
+
+void Server::drop(int fd) noexcept
+{
+  epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+  ::close(fd);
+  connections.erase(fd);
+}
+
+void Server::sweep(Clock::time_point now) noexcept
+{
+  std::vector<int> idle;
+  for (const auto& [fd, c] : connections)
+    if (!c.busy && c.out.empty() && now - c.active >= options.idleTimeout)
+      idle.push_back(fd);
+  for (int fd : idle) drop(fd);
+}
+}  // namespace twilight::http
@@ -0,0 +1,99 @@
+#include "http/tls.h"
+
+#include <openssl/err.h>
+
+#include <stdexcept>
+
+namespace twilight::http
+{
+Tls::Tls(SSL_CTX* ctx, const std::string& host)
+{
+  ssl = SSL_new(ctx);
+  in = BIO_new(BIO_s_mem());
+  out = BIO_new(BIO_s_mem());
+  if (!ssl || !in || !out) {
+    BIO_free(in);
+    BIO_free(out);
+    SSL_free(ssl);
+    throw std::runtime_error("SSL_new failed");
+  }
+  // an empty BIO means "wait for more", not the end of the connection
+  BIO_set_mem_eof_return(in, -1);
+  SSL_set_bio(ssl, in, out);
+  // whole buffered records are pulled at once rather than a header and then its body
+  SSL_set_read_ahead(ssl, 1);
+  SSL_set_tlsext_host_name(ssl, host.c_str());
+  SSL_set_connect_state(ssl);
+}
+
+Tls::~Tls() { SSL_free(ssl); }
+
+Tls::Status Tls::handshake() noexcept
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  ERR_clear_error();
+  int r = SSL_do_handshake(ssl);
+  if (r == 1)
+    return Status::Done;
+  return SSL_get_error(ssl, r) == SSL_ERROR_WANT_READ ? Status::WantRead : Status::Failed;
+}
+
+void Tls::feed(const char* data, usize len) noexcept
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  BIO_write(in, data, static_cast<int>(len));
+}
+
+isize Tls::read(char* buf, usize len) noexcept
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  usize total = 0;
+  while (total < len) {
+    ERR_clear_error();
+    usize n = 0;
+    if (SSL_read_ex(ssl, buf + total, len - total, &n) == 1) {
+      total += n;
+      continue;
+    }
+    // what was read comes first, the next call runs into the same condition again
+    if (total)
+      break;
+    switch (SSL_get_error(ssl, 0)) {
+    case SSL_ERROR_WANT_READ:
+      return MORE;
+    case SSL_ERROR_ZERO_RETURN:
+      return 0;
+    default:
+      return -1;
+    }
+  }
+  return static_cast<isize>(total);
+}
+
+bool Tls::write(const char* buf, usize len) noexcept
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  ERR_clear_error();
+  usize n = 0;
+  // the memory BIO takes everything, so this never stops partway
+  return len == 0 || (SSL_write_ex(ssl, buf, len, &n) == 1 && n == len);
+}
+
+usize Tls::take(std::string& buf) noexcept
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  usize n = BIO_ctrl_pending(out);
+  if (!n)
+    return 0;
+  usize used = buf.size();
+  buf.resize(used + n);
+  BIO_read(out, buf.data() + used, static_cast<int>(n));
+  return n;
+}
+
+usize Tls::pending() const noexcept
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return BIO_ctrl_pending(out);
+}
+}  // namespace twilight::http
@@ -0,0 +1,69 @@
+#include "interactions/endpoint.h"
+
+namespace twilight::interactions
+{
+namespace
+{
+inline http::Response status(u16 code) noexcept
+{
+  return http::Response{.statusCode = code, .statusMessage = {}, .headers = {}, .body = {}};
+}
+}  // namespace
+
+Endpoint::Endpoint(Options options, Handler handler)
+  : options(std::move(options)),
+    handler(std::move(handler)),
+    verifier(std::string_view{this->options.publicKey}),
+    server(this->options.server, [this](const http::Request& req) { return handle(req); })
+{
+}
+
+http::Response Endpoint::response(std::string_view json) noexcept
+{
+  return http::Response{.statusCode = 200,
+    .statusMessage = {},
+    .headers = {{"Content-Type", "application/json"}},
+    .body = std::pmr::string{json, &bufferPool()}};
+}
+
+http::Response Endpoint::handle(const http::Request& req)
+{
+  std::string_view path = std::string_view{req.path}.substr(0, req.path.find('?'));
+  if (path != options.path)
+    return status(404);
+  if (req.method != http::Method::POST)
+    return status(405);
+
+  auto signature = req.headers.get("X-Signature-Ed25519");
+  auto timestamp = req.headers.get("X-Signature-Timestamp");
+  if (!signature || !timestamp || !verifier.verify(std::string_view{*signature}, *timestamp, req.body)) {
+    ++counters.unauthorized;
+    return status(401);
+  }
+
+  // one parser per handler thread keeps its index buffers between requests
+  thread_local json::Parser parser;
+  auto body = parser.parse(req.body);
+  if (!body.has_value())
+    return status(400);
+  auto type = body->find("type");
+  if (!type || !type->asUint())
+    return status(400);
+
+  Interaction interaction{req, *body, static_cast<Type>(*type->asUint()), req.received + std::chrono::seconds{3}};
+  if (interaction.type == Type::Ping)
+    return response(R"({"type":1})");
+
+  if (std::chrono::steady_clock::now() - req.received > options.budget) {
+    ++counters.late;
+    return status(503);
+  }
+
+  http::Response res = handler(interaction);
+  ++counters.handled;
+  if (std::chrono::steady_clock::now() > interaction.deadline)
+    ++counters.overran;
+  res.headers.addIfNotExists("Content-Type", "application/json");
+  return res;
+}
+}  // namespace twilight::interactions
@@ -0,0 +1,602 @@
+#include "json/parser.h"
+
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+constexpr usize BLOCK = 64;
+
+// per-block bitmasks, bit i corresponds to byte i of the block
+struct Block {
+  u64 quote;
+  u64 backslash;
+  u64 op;  // { } [ ] : ,
+  u64 ws;
+};
+
+#if defined(__AVX2__)
+inline u64 eq(__m256i lo, __m256i hi, char c) noexcept
+{
+  __m256i v = _mm256_set1_epi8(c);
+  u32 a = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v));
+  u32 b = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v));
+  return static_cast<u64>(a) | (static_cast<u64>(b) << 32);
+}
+
+inline Block classify(const char* p) noexcept
+{
+  __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+  // '[' | 0x20 == '{' and ']' | 0x20 == '}', so brackets and braces share one compare each
+  __m256i bit = _mm256_set1_epi8(0x20);
+  __m256i loLower = _mm256_or_si256(lo, bit), hiLower = _mm256_or_si256(hi, bit);
+
+  return {
+    .quote = eq(lo, hi, '"'),
+    .backslash = eq(lo, hi, '\\'),
+    .op = eq(loLower, hiLower, '{') | eq(loLower, hiLower, '}') | eq(lo, hi, ':') | eq(lo, hi, ','),
+    .ws = eq(lo, hi, ' ') | eq(lo, hi, '\t') | eq(lo, hi, '\n') | eq(lo, hi, '\r'),
+  };
+}
+#elif defined(__SSE2__)
+inline u64 eq(const __m128i (&v)[4], char c) noexcept
+{
+  __m128i s = _mm_set1_epi8(c);
+  u64 ret = 0;
+  for (usize i = 0; i < 4; ++i) {
+    u16 bits = _mm_movemask_epi8(_mm_cmpeq_epi8(v[i], s));
+    ret |= static_cast<u64>(bits) << (16 * i);
+  }
+  return ret;
+}
+
+inline Block classify(const char* p) noexcept
+{
+  __m128i v[4], lower[4];
+  for (usize i = 0; i < 4; ++i) {
+    v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+    lower[i] = _mm_or_si128(v[i], _mm_set1_epi8(0x20));
+  }
+
+  return {
+    .quote = eq(v, '"'),
+    .backslash = eq(v, '\\'),
+    .op = eq(lower, '{') | eq(lower, '}') | eq(v, ':') | eq(v, ','),
+    .ws = eq(v, ' ') | eq(v, '\t') | eq(v, '\n') | eq(v, '\r'),
+  };
+}
+#else
+inline Block classify(const char* p) noexcept
+{
+  Block b{};
+  for (usize i = 0; i < BLOCK; ++i) {
+    u64 bit = u64(1) << i;
+    switch (p[i]) {
+    case '"':
+      b.quote |= bit;
+      break;
+    case '\\':
+      b.backslash |= bit;
+      break;
+    case '{':
+    case '}':
+    case '[':
+    case ']':
+    case ':':
+    case ',':
+      b.op |= bit;
+      break;
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+      b.ws |= bit;
+      break;
+    }
+  }
+  return b;
+}
+#endif
+
+// bit i of the result is the xor of bits 0..i of x
+inline u64 prefixXor(u64 x) noexcept
+{
+#if defined(__PCLMUL__)
+  return _mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_set_epi64x(0, x), _mm_set1_epi8(static_cast<char>(0xFF)), 0));
+#else
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+#endif
+}
+
+// tracks state that carries over from one block to the next
+struct Scanner {
+  u64 nextIsEscaped = 0;
+  u64 inString = 0;  // all ones when the previous block ended inside a string
+  u64 prevScalar = 0;
+
+  // returns the mask of characters escaped by a backslash, see simdjson's json_escape_scanner
+  inline u64 escaped(u64 backslash) noexcept
+  {
+    constexpr u64 ODD = 0xAAAAAAAAAAAAAAAA;
+    if (!backslash) {
+      u64 ret = nextIsEscaped;
+      nextIsEscaped = 0;
+      return ret;
+    }
+    u64 potential = backslash & ~nextIsEscaped;
+    u64 code = (((potential << 1) | ODD) - potential) ^ ODD;
+    u64 ret = code ^ (backslash | nextIsEscaped);
+    nextIsEscaped = (code & backslash) >> 63;
+    return ret;
+  }
+
+  // returns the structural mask of a block: operators outside strings, opening quotes and the first byte of
+  // every other scalar
+  inline u64 next(const Block& b) noexcept
+  {
+    u64 quotes = b.quote & ~escaped(b.backslash);
+    // includes the opening quote and excludes the closing one
+    u64 str = prefixXor(quotes) ^ inString;
+    inString = static_cast<u64>(static_cast<i64>(str) >> 63);
+
+    u64 scalar = ~(b.op | b.ws | quotes | str);
+    u64 scalarStart = scalar & ~((scalar << 1) | prevScalar);
+    prevScalar = scalar >> 63;
+
+    return (b.op & ~str) | (quotes & str) | scalarStart;
+  }
+};
+
+inline bool isWs(char c) noexcept { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+inline void appendUtf8(std::string& out, u32 cp) noexcept
+{
+  if (cp < 0x80) {
+    out.push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+
+inline std::optional<u32> hex4(std::string_view s) noexcept
+{
+  if (s.size() < 4)
+    return std::nullopt;
+  u32 ret = 0;
+  auto [ptr, ec] = std::from_chars(s.data(), s.data() + 4, ret, 16);
+  if (ec != std::errc{} || ptr != s.data() + 4)
+    return std::nullopt;
+  return ret;
+}
+
+template <typename T>
+inline std::optional<T> number(std::string_view s) noexcept
+{
+  if (s.empty() || (s[0] != '-' && (s[0] < '0' || s[0] > '9')))
+    return std::nullopt;
+  T ret{};
+  auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), ret);
+  if (ec != std::errc{} || ptr != s.data() + s.size())
+    return std::nullopt;
+  return ret;
+}
+}  // namespace
+
+namespace twilight::json
+{
+std::expected<Value, std::string> Parser::parse(std::string_view json) noexcept
+{
+  if (json.size() >= UINT32_MAX)
+    return std::unexpected("Document too large");
+
+  this->json = json;
+  if (!index())
+    return std::unexpected("Unterminated string");
+
+  if (auto err = validate(); err.has_value())
+    return std::unexpected(*err);
+
+  return Value{this, 0};
+}
+
+bool Parser::index() noexcept
+{
+  // worst case every byte is structural, plus the sentinel
+  if (capacity < json.size() + 1) {
+    capacity = std::bit_ceil(json.size() + 1);
+    indices = std::make_unique_for_overwrite<u32[]>(capacity);
+    closers = std::make_unique_for_overwrite<u32[]>(capacity);
+  }
+
+  Scanner scanner;
+  u32* out = indices.get();
+  const char* p = json.data();
+  usize n = json.size();
+
+  auto flush = [&](u64 mask, u32 base) {
+    while (mask) {
+      *out++ = base + std::countr_zero(mask);
+      mask &= mask - 1;
+    }
+  };
+
+  usize i = 0;
+  for (; i + BLOCK <= n; i += BLOCK) flush(scanner.next(classify(p + i)), i);
+
+  if (i < n) {
+    // pad the tail with whitespace, which is never structural
+    char tail[BLOCK];
+    std::memset(tail, ' ', BLOCK);
+    std::memcpy(tail, p + i, n - i);
+    flush(scanner.next(classify(tail)), i);
+  }
+
+  count = out - indices.get();
+  // the sentinel lets accessors look at the next structural without bounds checks
+  *out = n;
+
+  return !scanner.inString;
+}
+
+std::optional<std::string> Parser::validate() noexcept
+{
+  enum class State : u8 { Value, ArrayStart, ObjectStart, Key, Colon, After };
+
+  stack.clear();
+  State state = State::Value;
+
+  for (u32 i = 0; i < count; ++i) {
+    char c = json[indices[i]];
+
+    switch (state) {
+    case State::ObjectStart:
+      if (c == '}') {
+        closers[stack.back()] = i;
+        stack.pop_back();
+        state = State::After;
+        continue;
+      }
+      [[fallthrough]];
+    case State::Key:
+      if (c != '"')
+        return "Expected object key at offset " + std::to_string(indices[i]);
+      state = State::Colon;
+      continue;
+    case State::Colon:
+      if (c != ':')
+        return "Expected ':' at offset " + std::to_string(indices[i]);
+      state = State::Value;
+      continue;
+    case State::ArrayStart:
+      if (c == ']') {
+        closers[stack.back()] = i;
+        stack.pop_back();
+        state = State::After;
+        continue;
+      }
+      [[fallthrough]];
+    case State::Value:
+      if (c == '{' || c == '[') {
+        stack.push_back(i);
+        state = c == '{' ? State::ObjectStart : State::ArrayStart;
+      } else if (c == '}' || c == ']' || c == ':' || c == ',') {
+        return "Expected value at offset " + std::to_string(indices[i]);
+      } else {
+        state = State::After;
+      }
+      continue;
+    case State::After: {
+      if (stack.empty())
+        return "Trailing data at offset " + std::to_string(indices[i]);
+      char open = json[indices[stack.back()]];
+      if (c == ',') {
+        state = open == '{' ? State::Key : State::Value;
+      } else if ((c == '}' && open == '{') || (c == ']' && open == '[')) {
+        closers[stack.back()] = i;
+        stack.pop_back();
+      } else {
+        return "Unexpected character at offset " + std::to_string(indices[i]);
+      }
+      continue;
+    }
+    }
+  }
+
+  if (state != State::After || !stack.empty())
+    return "Unexpected end of document";
+
+  return std::nullopt;
+}
+
+u32 Parser::skip(u32 pos) const noexcept
+{
+  char c = at(pos);
+  if (c != '{' && c != '[')
+    return pos + 1;
+  return closers[pos] + 1;
+}
+
+char Value::head() const noexcept { return parser ? parser->at(pos) : '\0'; }
+
+std::string_view Value::scalar() const noexcept
+{
+  usize begin = parser->indices[pos], end = parser->indices[pos + 1];
+  while (end > begin && isWs(parser->json[end - 1])) --end;
+  return parser->json.substr(begin, end - begin);
+}
+
+std::string_view Value::stringAt(u32 at) const noexcept
+{
+  // the closing quote isn't indexed, but it's the last non-whitespace byte before the next structural
+  usize begin = parser->indices[at] + 1, end = parser->indices[at + 1];
+  while (end > begin && parser->json[end - 1] != '"') --end;
+  return parser->json.substr(begin, end - begin - 1);
+}
+
+Type Value::type() const noexcept
+{
+  switch (head()) {
+  case '{':
+    return Type::Object;
+  case '[':
+    return Type::Array;
+  case '"':
+    return Type::String;
+  case 't':
+  case 'f':
+    return Type::Bool;
+  case 'n':
+    return Type::Null;
+  case '-':
+    return Type::Number;
+  default:
+    return head() >= '0' && head() <= '9' ? Type::Number : Type::Invalid;
+  }
+}
+
+std::optional<Value> Value::find(std::string_view key) const noexcept
+{
+  if (head() != '{')
+    return std::nullopt;
+
+  for (auto [k, v] : fields()) {
+    if (k == key)
+      return v;
+  }
+  return std::nullopt;
+}
+
+std::optional<Value> Value::at(usize index) const noexcept
+{
+  if (head() != '[')
+    return std::nullopt;
+
+  for (Value v : items()) {
+    if (!index--)
+      return v;
+  }
+  return std::nullopt;
+}
+
+usize Value::size() const noexcept
+{
+  char c = head();
+  if (c == '[')
+    return std::distance(items().begin(), items().end());
+  if (c == '{')
+    return std::distance(fields().begin(), fields().end());
+  return 0;
+}
+
+std::optional<bool> Value::asBool() const noexcept
+{
+  if (type() != Type::Bool)
+    return std::nullopt;
+
+  std::string_view s = scalar();
+  if (s == "true")
+    return true;
+  if (s == "false")
+    return false;
+  return std::nullopt;
+}
+
+std::optional<i64> Value::asInt() const noexcept
+{
+  if (type() != Type::Number)
+    return std::nullopt;
+  return number<i64>(scalar());
+}
+
+std::optional<u64> Value::asUint() const noexcept
+{
+  if (type() != Type::Number || head() == '-')
+    return std::nullopt;
+  return number<u64>(scalar());
+}
+
+std::optional<f64> Value::asDouble() const noexcept
+{
+  if (type() != Type::Number)
+    return std::nullopt;
+  return number<f64>(scalar());
+}
+
+std::optional<u64> Value::asSnowflake() const noexcept
+{
+  if (head() == '"')
+    return number<u64>(stringAt(pos));
+  return asUint();
+}
+
+std::optional<std::string_view> Value::asStringView() const noexcept
+{
+  if (head() != '"')
+    return std::nullopt;
+  return stringAt(pos);
+}
+
+std::optional<std::string> Value::asString() const noexcept
+{
+  if (head() != '"')
+    return std::nullopt;
+
+  std::string_view s = stringAt(pos);
+  std::string out;
+  out.reserve(s.size());
+
+  for (usize i = 0; i < s.size(); ++i) {
+    usize esc = s.find('\\', i);
+    if (esc == std::string_view::npos) {
+      out.append(s.substr(i));
+      break;
+    }
+    out.append(s.substr(i, esc - i));
+    i = esc + 1;
+    if (i >= s.size())
+      return std::nullopt;
+
+    switch (s[i]) {
+    case '"':
+    case '\\':
+    case '/':
+      out.push_back(s[i]);
+      break;
+    case 'b':
+      out.push_back('\b');
+      break;
+    case 'f':
+      out.push_back('\f');
+      break;
+    case 'n':
+      out.push_back('\n');
+      break;
+    case 'r':
+      out.push_back('\r');
+      break;
+    case 't':
+      out.push_back('\t');
+      break;
+    case 'u': {
+      auto cp = hex4(s.substr(i + 1));
+      if (!cp.has_value())
+        return std::nullopt;
+      i += 4;
+      if (*cp >= 0xD800 && *cp <= 0xDBFF) {
+        // surrogate pair
+        if (s.substr(i + 1, 2) != "\\u")
+          return std::nullopt;
+        auto lo = hex4(s.substr(i + 3));
+        if (!lo.has_value() || *lo < 0xDC00 || *lo > 0xDFFF)
+          return std::nullopt;
+        i += 6;
+        *cp = 0x10000 + ((*cp - 0xD800) << 10) + (*lo - 0xDC00);
+      } else if (*cp >= 0xDC00 && *cp <= 0xDFFF) {
+        return std::nullopt;
+      }
+      appendUtf8(out, *cp);
+      break;
+    }
+    default:
+      return std::nullopt;
+    }
+  }
+
+  return out;
+}
+
+std::string_view Value::raw() const noexcept
+{
+  if (!parser)
+    return {};
+
+  switch (head()) {
+  case '{':
+  case '[': {
+    usize begin = parser->indices[pos];
+    usize end = parser->indices[parser->skip(pos) - 1] + 1;
+    return parser->json.substr(begin, end - begin);
+  }
+  case '"': {
+    std::string_view s = stringAt(pos);
+    return {s.data() - 1, s.size() + 2};
+  }
+  default:
+    return scalar();
+  }
+}
+
+Value::Range<Value::ArrayIterator> Value::items() const noexcept
+{
+  if (head() != '[')
+    return {};
+
+  u32 end = parser->skip(pos) - 1;
+  return {ArrayIterator{parser, pos + 1}, ArrayIterator{parser, end}};
+}
+
+Value::Range<Value::ObjectIterator> Value::fields() const noexcept
+{
+  if (head() != '{')
+    return {};
+
+  u32 end = parser->skip(pos) - 1;
+  return {ObjectIterator{parser, pos + 1}, ObjectIterator{parser, end}};
+}
+
+Value::ArrayIterator& Value::ArrayIterator::operator++() noexcept
+{
+  u32 next = parser->skip(pos);
+  pos = parser->at(next) == ',' ? next + 1 : next;
+  return *this;
+}
+
+Value::ArrayIterator Value::ArrayIterator::operator++(int) noexcept
+{
+  ArrayIterator ret = *this;
+  ++*this;
+  return ret;
+}
+
+Value::ObjectIterator::value_type Value::ObjectIterator::operator*() const noexcept
+{
+  Value key{parser, pos};
+  return {key.stringAt(pos), Value{parser, pos + 2}};
+}
+
+Value::ObjectIterator& Value::ObjectIterator::operator++() noexcept
+{
+  u32 next = parser->skip(pos + 2);
+  pos = parser->at(next) == ',' ? next + 1 : next;
+  return *this;
+}
+
+Value::ObjectIterator Value::ObjectIterator::operator++(int) noexcept
+{
+  ObjectIterator ret = *this;
+  ++*this;
+  return ret;
+}
+}  // namespace twilight::json
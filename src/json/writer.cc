@@ -0,0 +1,164 @@
+#include "json/writer.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace twilight::json
+{
+void Writer::separate() noexcept
+{
+  if (afterKey) {
+    afterKey = false;
+    return;
+  }
+  if (nonEmpty.empty())
+    return;
+  if (nonEmpty.back())
+    out.push_back(',');
+  nonEmpty.back() = true;
+}
+
+Writer& Writer::beginObject() noexcept
+{
+  separate();
+  out.push_back('{');
+  nonEmpty.push_back(false);
+  return *this;
+}
+
+Writer& Writer::endObject() noexcept
+{
+  out.push_back('}');
+  nonEmpty.pop_back();
+  return *this;
+}
+
+Writer& Writer::beginArray() noexcept
+{
+  separate();
+  out.push_back('[');
+  nonEmpty.push_back(false);
+  return *this;
+}
+
+Writer& Writer::endArray() noexcept
+{
+  out.push_back(']');
+  nonEmpty.pop_back();
+  return *this;
+}
+
+Writer& Writer::key(std::string_view key) noexcept
+{
+  value(key);
+  out.push_back(':');
+  afterKey = true;
+  return *this;
+}
+
+Writer& Writer::value(std::nullptr_t) noexcept
+{
+  separate();
+  out.append("null");
+  return *this;
+}
+
+Writer& Writer::value(bool v) noexcept
+{
+  separate();
+  out.append(v ? "true" : "false");
+  return *this;
+}
+
+Writer& Writer::value(f64 v) noexcept
+{
+  // json has no nan or infinity
+  if (!std::isfinite(v))
+    return value(nullptr);
+  separate();
+  char buf[32];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+  out.append(buf, ptr);
+  return *this;
+}
+
+Writer& Writer::value(std::string_view v) noexcept
+{
+  static constexpr const char* HEX = "0123456789abcdef";
+
+  separate();
+  out.reserve(out.size() + v.size() + 2);
+  out.push_back('"');
+
+  // copy runs of characters that don't need escaping in one go
+  usize run = 0;
+  for (usize i = 0; i < v.size(); ++i) {
+    u8 c = v[i];
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    out.append(v.substr(run, i - run));
+    run = i + 1;
+
+    switch (c) {
+    case '"':
+      out.append("\\\"");
+      break;
+    case '\\':
+      out.append("\\\\");
+      break;
+    case '\n':
+      out.append("\\n");
+      break;
+    case '\r':
+      out.append("\\r");
+      break;
+    case '\t':
+      out.append("\\t");
+      break;
+    default:
+      out.append("\\u00");
+      out.push_back(HEX[c >> 4]);
+      out.push_back(HEX[c & 0xF]);
+      break;
+    }
+  }
+  out.append(v.substr(run));
+
+  out.push_back('"');
+  return *this;
+}
+
+Writer& Writer::integer(i64 v, bool quoted) noexcept
+{
+  separate();
+  char buf[24];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+  if (quoted)
+    out.push_back('"');
+  out.append(buf, ptr);
+  if (quoted)
+    out.push_back('"');
+  return *this;
+}
+
+Writer& Writer::integer(u64 v, bool quoted) noexcept
+{
+  separate();
+  char buf[24];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+  if (quoted)
+    out.push_back('"');
+  out.append(buf, ptr);
+  if (quoted)
+    out.push_back('"');
+  return *this;
+}
+
+void Writer::clear() noexcept
+{
+  out.clear();
+  nonEmpty.clear();
+  afterKey = false;
+}
+}  // namespace twilight::json
@@ -0,0 +1,313 @@
+#include "rest/client.h"
+
+#include <algorithm>
+#include <charconv>
+
+#include "json/parser.h"
+
+using namespace std::chrono_literals;
+
+namespace twilight::rest
+{
+namespace
+{
+// idle buckets are forgotten after this long, per-channel buckets would pile up otherwise
+constexpr auto BUCKET_TTL = 5min;
+
+std::optional<f64> seconds(const http::Headers& headers, const std::string& key) noexcept
+{
+  auto v = headers.get(key);
+  if (!v)
+    return std::nullopt;
+  f64 out;
+  auto [_, ec] = std::from_chars(v->data(), v->data() + v->size(), out);
+  return ec == std::errc{} ? std::optional{out} : std::nullopt;
+}
+
+metrics::AtomicHistogram& queueWait()
+{
+  static metrics::AtomicHistogram& h = metrics::registry().histogram("rest_queue_wait_ns");
+  return h;
+}
+
+inline Client::Clock::duration duration(f64 seconds) noexcept
+{
+  return std::chrono::duration_cast<Client::Clock::duration>(std::chrono::duration<f64>(seconds));
+}
+}  // namespace
+
+Client::Client(Options options) : options(std::move(options))
+{
+  connections.resize(std::max<usize>(this->options.connections, 1));
+  scheduler = std::jthread([this](std::stop_token stop) { schedule(stop); });
+  for (usize i = 0; i < connections.size(); ++i)
+    workers.emplace_back([this, i](std::stop_token stop) { work(stop, i); });
+}
+
+Client::~Client() { stop(); }
+
+void Client::stop() noexcept
+{
+  scheduler.request_stop();
+  for (auto& w : workers) w.request_stop();
+  if (scheduler.joinable())
+    scheduler.join();
+  for (auto& w : workers)
+    if (w.joinable())
+      w.join();
+}
+
+std::future<http::Response> Client::request(Route route, http::RequestInit init)
+{
+  init.headers.addIfNotExists("Authorization", "Bot " + options.token);
+  init.headers.addIfNotExists("User-Agent", "DiscordBot (https://github.com/averithefox/twilight, " VERSION ")");
+  if (!init.body.empty())
+    init.headers.addIfNotExists("Content-Type", "application/json");
+
+  Pending p{std::move(route), std::move(init), {}, {}, 0, metrics::now()};
+  auto future = p.promise.get_future();
+
+  std::lock_guard lock(mutex);
+  p.bucket = bucketKey(p.route);
+  enqueue(std::move(p), false);
+  return future;
+}
+
+usize Client::queued() const noexcept
+{
+  std::lock_guard lock(mutex);
+  usize n = ready.size();
+  for (const auto& key : active)
+    if (auto it = buckets.find(key); it != buckets.end())
+      n += it->second.queue.size();
+  return n;
+}
+
+http::Response Client::perform(usize worker, const std::string& path, http::RequestInit init)
+{
+  auto& conn = connections[worker];
+  // an idle keep-alive connection may have been closed by the server, reconnect once. only when nothing came back on
+  // a reused connection, anything else may have reached the server and retrying could run it twice
+  for (bool retried = false;; retried = true) {
+    try {
+      if (!conn)
+        conn = std::make_unique<http::Client>(URI{options.url});
+      return conn->request(options.base + path, init);
+    } catch (const std::runtime_error&) {
+      bool unanswered = conn && conn->timings().reused && conn->timings().bytesReceived == 0;
+      conn.reset();
+      if (retried || !unanswered)
+        throw;
+    }
+  }
+}
+
+std::string Client::bucketKey(const Route& route) const
+{
+  if (auto it = hashes.find(route.key); it != hashes.end())
+    return it->second + ":" + route.major;
+  return route.key;
+}
+
+void Client::enqueue(Pending p, bool front)
+{
+  std::string key = p.bucket;
+  Bucket& b = buckets[key];
+  if (front)
+    b.queue.push_front(std::move(p));
+  else
+    b.queue.push_back(std::move(p));
+
+  if (!b.active) {
+    b.active = true;
+    active.push_back(std::move(key));
+  }
+  wake = true;
+  schedulerCv.notify_one();
+}
+
+void Client::complete(Pending p, http::Response res)
+{
+  auto now = Clock::now();
+  std::unique_lock lock(mutex);
+
+  if (auto it = buckets.find(p.bucket); it != buckets.end() && it->second.inflight)
+    --it->second.inflight;
+
+  // the route's real bucket, which may be shared with other routes
+  std::string key = p.bucket;
+  if (auto hash = res.headers.get("X-RateLimit-Bucket")) {
+    hashes[p.route.key] = *hash;
+    key = std::string{*hash} + ":" + p.route.major;
+    if (key != p.bucket) {
+      // requests queued under the provisional key move over
+      Bucket& old = buckets[p.bucket];
+      Bucket& real = buckets[key];
+      while (!old.queue.empty()) {
+        old.queue.front().bucket = key;
+        real.queue.push_back(std::move(old.queue.front()));
+        old.queue.pop_front();
+      }
+      if (!real.queue.empty() && !real.active) {
+        real.active = true;
+        active.push_back(key);
+      }
+    }
+  }
+
+  Bucket& b = buckets[key];
+  auto limit = seconds(res.headers, "X-RateLimit-Limit");
+  auto remaining = seconds(res.headers, "X-RateLimit-Remaining");
+  auto resetAfter = seconds(res.headers, "X-RateLimit-Reset-After");
+  if (limit && remaining && resetAfter) {
+    b.limit = std::max<u32>(*limit, 1);
+    // discord hasn't counted what's still in flight
+    b.remaining = *remaining > b.inflight ? static_cast<u32>(*remaining) - b.inflight : 0;
+    b.resetAt = now + duration(*resetAfter);
+  } else if (res.statusCode != 429) {
+    // not rate limited at all
+    b.limit = b.remaining = UINT32_MAX;
+  }
+
+  if (res.statusCode == 429) {
+    f64 retryAfter = seconds(res.headers, "Retry-After").value_or(1);
+    bool global = res.headers.get("X-RateLimit-Global").has_value() ||
+                  res.headers.get("X-RateLimit-Scope").value_or("") == "global";
+
+    // the body is more precise than the header
+    json::Parser parser;
+    if (auto body = parser.parse(res.body); body.has_value()) {
+      if (auto v = body->find("retry_after"); v && v->asDouble())
+        retryAfter = *v->asDouble();
+      if (auto v = body->find("global"); v && v->asBool())
+        global = global || *v->asBool();
+    }
+
+    if (global) {
+      globalBlockedUntil = now + duration(retryAfter);
+    } else {
+      b.remaining = 0;
+      b.resetAt = now + duration(retryAfter);
+    }
+
+    if (p.attempts++ < options.maxRetries) {
+      p.bucket = key;
+      enqueue(std::move(p), true);
+      return;
+    }
+  }
+
+  wake = true;
+  schedulerCv.notify_one();
+  lock.unlock();
+  p.promise.set_value(std::move(res));
+}
+
+void Client::fail(Pending p, std::exception_ptr e)
+{
+  {
+    std::lock_guard lock(mutex);
+    if (auto it = buckets.find(p.bucket); it != buckets.end()) {
+      if (it->second.inflight)
+        --it->second.inflight;
+      // the request may or may not have counted, give the slot back rather than stall the bucket
+      if (it->second.remaining < it->second.limit)
+        ++it->second.remaining;
+    }
+    wake = true;
+    schedulerCv.notify_one();
+  }
+  p.promise.set_exception(e);
+}
+
+void Client::schedule(std::stop_token stop)
+{
+  std::unique_lock lock(mutex);
+  while (!stop.stop_requested()) {
+    auto now = Clock::now();
+    auto next = Clock::time_point::max();
+
+    if (now >= globalReset) {
+      globalRemaining = options.globalLimit;
+      globalReset = now + 1s;
+    }
+
+    bool dispatched = false;
+    for (usize i = 0; i < active.size();) {
+      auto it = buckets.find(active[i]);
+      Bucket* b = it != buckets.end() ? &it->second : nullptr;
+
+      if (b && now >= b->resetAt && b->remaining < b->limit)
+        b->remaining = b->limit > b->inflight ? b->limit - b->inflight : 0;
+
+      while (b && !b->queue.empty() && b->remaining && globalRemaining && now >= globalBlockedUntil) {
+        ready.push_back(std::move(b->queue.front()));
+        b->queue.pop_front();
+        --b->remaining;
+        ++b->inflight;
+        --globalRemaining;
+        dispatched = true;
+      }
+
+      if (!b || b->queue.empty()) {
+        if (b)
+          b->active = false;
+        active[i] = std::move(active.back());
+        active.pop_back();
+        continue;
+      }
+
+      // still blocked: wait for whichever limit lifts first. a bucket blocked on in-flight requests only is woken
+      // by their completion
+      if (now < globalBlockedUntil)
+        next = std::min(next, globalBlockedUntil);
+      else if (!globalRemaining)
+        next = std::min(next, globalReset);
+      else if (!b->remaining && b->resetAt > now)
+        next = std::min(next, b->resetAt);
+      ++i;
+    }
+
+    if (dispatched)
+      workerCv.notify_all();
+
+    if (now - lastSweep >= BUCKET_TTL) {
+      lastSweep = now;
+      std::erase_if(buckets, [&](const auto& entry) {
+        const Bucket& b = entry.second;
+        return !b.active && !b.inflight && b.queue.empty() && now - b.resetAt >= BUCKET_TTL;
+      });
+    }
+
+    wake = false;
+    if (next == Clock::time_point::max())
+      schedulerCv.wait(lock, stop, [&] { return wake; });
+    else
+      schedulerCv.wait_until(lock, stop, next, [&] { return wake; });
+  }
+}
+
+void Client::work(std::stop_token stop, usize worker)
+{
+  while (true) {
+    std::unique_lock lock(mutex);
+    if (!workerCv.wait(lock, stop, [&] { return !ready.empty(); }))
+      return;
+    Pending p = std::move(ready.front());
+    ready.pop_front();
+    lock.unlock();
+
+    if constexpr (metrics::ENABLED)
+      queueWait().record(metrics::now() - p.queuedAt);
+
+    try {
+      http::Response res = perform(worker, p.route.path, p.init);
+      if (auto& conn = connections[worker])
+        ontimings(p.route, conn->timings());
+      complete(std::move(p), std::move(res));
+    } catch (...) {
+      fail(std::move(p), std::current_exception());
+    }
+  }
+}
+}  // namespace twilight::rest
@@ -0,0 +1,111 @@
+#include "rest/route.h"
+
+namespace twilight::rest
+{
+namespace
+{
+inline bool isId(std::string_view s) noexcept
+{
+  if (s.empty())
+    return false;
+  for (char c : s)
+    if (c < '0' || c > '9')
+      return false;
+  return true;
+}
+}  // namespace
+
+Route::Route(http::Method method, std::string p) : method(method), path(std::move(p))
+{
+  std::string_view rest = path;
+  if (auto q = rest.find('?'); q != std::string_view::npos)
+    rest = rest.substr(0, q);
+
+  key = std::to_string(static_cast<u8>(method));
+
+  // resources whose id (and token) is the major parameter
+  usize majorSegments = 0;
+  std::string_view previous;
+  for (usize segment = 0; !rest.empty(); ++segment) {
+    if (rest.front() == '/')
+      rest.remove_prefix(1);
+    usize end = rest.find('/');
+    std::string_view part = rest.substr(0, end);
+    rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end);
+
+    if (segment == 0) {
+      if (part == "channels" || part == "guilds")
+        majorSegments = 2;
+      else if (part == "webhooks" || part == "interactions")
+        majorSegments = 3;
+    }
+
+    key += '/';
+    if (segment < majorSegments) {
+      key += part;
+      if (segment) {
+        major += '/';
+        major += part;
+      }
+    } else if (previous == "reactions") {
+      // every emoji shares a bucket, and so does everything below it
+      key += ":emoji";
+      break;
+    } else if (isId(part)) {
+      key += ":id";
+    } else {
+      key += part;
+    }
+    previous = part;
+  }
+}
+
+Route Route::build(http::Method method, std::span<const RouteSegment> segments,
+  std::span<const std::string_view> values) noexcept
+{
+  auto text = [&](const RouteSegment& s) { return s.role == RouteSegment::Literal ? s.text : values[s.param]; };
+
+  usize pathSize = 0, majorSize = 0, keySize = 1;
+  for (const RouteSegment& s : segments) {
+    pathSize += 1 + text(s).size();
+    if (s.role == RouteSegment::Major)
+      majorSize += 1 + text(s).size();
+  }
+  keySize += pathSize;
+
+  Route route{method, {}, {}, {}};
+  route.path.reserve(pathSize);
+  route.major.reserve(majorSize);
+  route.key.reserve(keySize);
+  route.key += static_cast<char>('0' + static_cast<u8>(method));
+
+  bool keyDone = false;
+  for (const RouteSegment& s : segments) {
+    std::string_view part = text(s);
+    route.path += '/';
+    route.path += part;
+    if (keyDone)
+      continue;
+
+    route.key += '/';
+    switch (s.role) {
+    case RouteSegment::Literal:
+      route.key += part;
+      break;
+    case RouteSegment::Major:
+      route.key += part;
+      route.major += '/';
+      route.major += part;
+      break;
+    case RouteSegment::Id:
+      route.key += ":id";
+      break;
+    case RouteSegment::Emoji:
+      route.key += ":emoji";
+      keyDone = true;
+      break;
+    }
+  }
+  return route;
+}
+}  // namespace twilight::rest
@@ -1,67 +1,312 @@
 #include "uri.h"
 
-#include <cctype>
+#include <algorithm>
+#include <charconv>
 #include <format>
+#include <stdexcept>
 #include <string>
 
 namespace twilight
 {
-URI::URI(const char* url) noexcept : URI(std::string(url)) {};
+namespace
+{
+enum Class : u8 {
+  ALPHA = 1 << 0,
+  DIGIT = 1 << 1,
+  // - . _ ~
+  UNRESERVED = 1 << 2,
+  // ! $ & ' ( ) * + , ; =
+  SUB_DELIM = 1 << 3,
+  HEX = 1 << 4,
+};
+
+constexpr auto CLASSES = [] {
+  std::array<u8, 256> t{};
+  for (int c = 'a'; c <= 'z'; ++c) t[c] |= ALPHA;
+  for (int c = 'A'; c <= 'Z'; ++c) t[c] |= ALPHA;
+  for (int c = '0'; c <= '9'; ++c) t[c] |= DIGIT | HEX;
+  for (int c = 'a'; c <= 'f'; ++c) t[c] |= HEX;
+  for (int c = 'A'; c <= 'F'; ++c) t[c] |= HEX;
+  for (char c : std::string_view{"-._~"}) t[static_cast<u8>(c)] |= UNRESERVED;
+  for (char c : std::string_view{"!$&'()*+,;="}) t[static_cast<u8>(c)] |= SUB_DELIM;
+  return t;
+}();
+
+inline bool is(char c, u8 classes) noexcept { return CLASSES[static_cast<u8>(c)] & classes; }
+inline bool unreserved(char c) noexcept { return is(c, ALPHA | DIGIT | UNRESERVED); }
+inline bool hex(std::string_view s) noexcept
+{
+  return std::all_of(s.begin(), s.end(), [](char c) { return is(c, HEX); });
+}
 
-URI::URI(std::string url) noexcept
+// whether `s` is made of unreserved characters, sub-delims, pct-encoded octets and `extra`
+bool valid(std::string_view s, std::string_view extra) noexcept
 {
-#define SET_STR(var, val) \
-  if (var.empty())        \
-    var = val;
-
-  usize protocolPos = url.find("://");
-  if (protocolPos != std::string::npos) {
-    protocol = url.substr(0, protocolPos);
-    url = url.substr(protocolPos + 3);
-  } else {
-    protocol = "http";
+  for (usize i = 0; i < s.size(); ++i) {
+    char c = s[i];
+    if (c == '%') {
+      if (i + 2 >= s.size() || !is(s[i + 1], HEX) || !is(s[i + 2], HEX))
+        return false;
+      i += 2;
+    } else if (!unreserved(c) && !is(c, SUB_DELIM) && extra.find(c) == std::string_view::npos) {
+      return false;
+    }
   }
+  return true;
+}
 
-  usize portPos = url.find(":");
-  if (portPos != std::string::npos) {
-    host = url.substr(0, portPos);
-    std::string portStr;
-    for (usize i = portPos + 1; i < url.size(); ++i) {
-      if (std::isdigit(url[i])) {
-        portStr += url[i];
-      } else {
-        break;
+// RFC 3986 section 3.2.2, IPv6address or IPvFuture between the brackets
+bool validIpLiteral(std::string_view s) noexcept
+{
+  if (s.empty())
+    return false;
+  if (s[0] == 'v' || s[0] == 'V') {
+    usize dot = s.find('.');
+    if (dot == std::string_view::npos || dot < 2 || dot + 1 == s.size())
+      return false;
+    return hex(s.substr(1, dot - 1)) && valid(s.substr(dot + 1), ":");
+  }
+
+  // hex groups around at most one "::", optionally ending in an ipv4 address
+  usize groups = 0;
+  bool compressed = false;
+  usize i = 0;
+  if (s.starts_with("::")) {
+    compressed = true;
+    i = 2;
+  }
+  while (i < s.size()) {
+    usize end = s.find(':', i);
+    std::string_view group = s.substr(i, end == std::string_view::npos ? std::string_view::npos : end - i);
+    if (group.find('.') != std::string_view::npos) {
+      // the last 32 bits as a dotted quad
+      if (end != std::string_view::npos)
+        return false;
+      u32 parts = 0;
+      for (usize p = 0; p <= group.size();) {
+        usize dot = std::min(group.find('.', p), group.size());
+        u32 v;
+        auto [ptr, ec] = std::from_chars(group.data() + p, group.data() + dot, v);
+        if (ec != std::errc{} || ptr != group.data() + dot || v > 255 || dot - p > 3)
+          return false;
+        ++parts;
+        p = dot + 1;
       }
+      if (parts != 4)
+        return false;
+      groups += 2;
+      break;
+    }
+    if (group.empty() || group.size() > 4 || !hex(group))
+      return false;
+    ++groups;
+    if (end == std::string_view::npos)
+      break;
+    i = end + 1;
+    if (i < s.size() && s[i] == ':') {
+      if (compressed)
+        return false;
+      compressed = true;
+      ++i;
+    } else if (i == s.size()) {
+      return false;
     }
-    port = std::stoi(portStr);
-    url = url.substr(portPos + portStr.size() + 1);
-  } else {
-    port = isSecure() ? 443 : 80;
   }
+  return compressed ? groups < 8 : groups == 8;
+}
+
+constexpr u16 defaultPort(std::string_view scheme) noexcept
+{
+  if (scheme == "http" || scheme == "ws")
+    return 80;
+  if (scheme == "https" || scheme == "wss")
+    return 443;
+  return 0;
+}
+
+std::string lower(std::string_view s) noexcept
+{
+  std::string out{s};
+  std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+  return out;
+}
+}  // namespace
+
+std::expected<URIView, std::string> URIView::parse(std::string_view uri) noexcept
+{
+  URIView v;
+  std::string_view rest = uri;
+
+  // a scheme is only there if a ':' comes before any of "/?#"
+  if (usize colon = rest.find(':'); colon != std::string_view::npos && colon < rest.find_first_of("/?#")) {
+    std::string_view scheme = rest.substr(0, colon);
+    auto schemeChar = [](char c) { return is(c, ALPHA | DIGIT) || c == '+' || c == '-' || c == '.'; };
+    if (scheme.empty() || !is(scheme[0], ALPHA) || !std::all_of(scheme.begin(), scheme.end(), schemeChar))
+      return std::unexpected("Invalid scheme");
+    v.scheme = scheme;
+    rest.remove_prefix(colon + 1);
+  }
+
+  if (usize hash = rest.find('#'); hash != std::string_view::npos) {
+    v.fragment = rest.substr(hash + 1);
+    v.hasFragment = true;
+    rest = rest.substr(0, hash);
+    if (!valid(v.fragment, ":@/?"))
+      return std::unexpected("Invalid fragment");
+  }
+  if (usize question = rest.find('?'); question != std::string_view::npos) {
+    v.query = rest.substr(question + 1);
+    v.hasQuery = true;
+    rest = rest.substr(0, question);
+    if (!valid(v.query, ":@/?"))
+      return std::unexpected("Invalid query");
+  }
+
+  if (rest.starts_with("//")) {
+    v.hasAuthority = true;
+    rest.remove_prefix(2);
+    usize slash = rest.find('/');
+    std::string_view authority = rest.substr(0, slash);
+    rest = slash == std::string_view::npos ? std::string_view{} : rest.substr(slash);
+
+    if (usize at = authority.rfind('@'); at != std::string_view::npos) {
+      v.userinfo = authority.substr(0, at);
+      authority.remove_prefix(at + 1);
+      if (!valid(v.userinfo, ":"))
+        return std::unexpected("Invalid userinfo");
+    }
 
-  usize pathPos = url.find("/");
-  if (pathPos != std::string::npos) {
-    SET_STR(host, url.substr(0, pathPos));
-    path = url.substr(pathPos);
+    std::string_view port;
+    bool hasPort = false;
+    if (authority.starts_with('[')) {
+      usize close = authority.find(']');
+      if (close == std::string_view::npos)
+        return std::unexpected("Unterminated IP literal");
+      v.host = authority.substr(1, close - 1);
+      v.ipLiteral = true;
+      if (!validIpLiteral(v.host))
+        return std::unexpected("Invalid IP literal");
+      authority.remove_prefix(close + 1);
+      if (!authority.empty()) {
+        if (authority[0] != ':')
+          return std::unexpected("Invalid authority");
+        port = authority.substr(1);
+        hasPort = true;
+      }
+    } else {
+      usize colon = authority.rfind(':');
+      v.host = authority.substr(0, colon);
+      if (colon != std::string_view::npos) {
+        port = authority.substr(colon + 1);
+        hasPort = true;
+      }
+      // reg-name, which covers IPv4 addresses too
+      if (!valid(v.host, ""))
+        return std::unexpected("Invalid host");
+    }
+
+    // an empty port means the default
+    if (hasPort && !port.empty()) {
+      u32 n;
+      auto [ptr, ec] = std::from_chars(port.data(), port.data() + port.size(), n);
+      if (ec != std::errc{} || ptr != port.data() + port.size() || n > 65535)
+        return std::unexpected("Invalid port");
+      v.port = static_cast<u16>(n);
+    }
   }
 
-  if (!path.empty() && !host.empty())
-    return;
+  v.path = rest;
+  if (!valid(v.path, ":@/"))
+    return std::unexpected("Invalid path");
+  if (v.hasAuthority && !v.path.empty() && v.path[0] != '/')
+    return std::unexpected("Invalid path");
+  return v;
+}
 
-  usize queryPos = url.find("?");
-  if (queryPos != std::string::npos) {
-    SET_STR(path, url.substr(queryPos));
-    SET_STR(host, url.substr(0, queryPos));
-  } else {
-    SET_STR(path, "/");
-    SET_STR(host, url);
+std::string URIView::target() const noexcept
+{
+  std::string out{path.empty() ? "/" : path};
+  if (hasQuery) {
+    out.push_back('?');
+    out.append(query);
   }
+  return out;
+}
+
+u16 URIView::effectivePort() const noexcept { return port.value_or(defaultPort(lower(scheme))); }
+
+URI::URI(const char* url) : URI(std::string_view{url}) {}
+
+URI::URI(std::string_view url)
+{
+  auto uri = parse(url);
+  if (!uri.has_value())
+    throw std::runtime_error("Invalid URI: " + uri.error());
+  *this = std::move(*uri);
+}
+
+URI::URI(const URIView& view) noexcept
+  : protocol(lower(view.scheme)),
+    userinfo(view.userinfo),
+    host(view.host),
+    port(view.effectivePort()),
+    path(view.path.empty() ? "/" : view.path),
+    query(view.query),
+    fragment(view.fragment)
+{
+}
+
+std::expected<URI, std::string> URI::parse(std::string_view url) noexcept
+{
+  auto view = URIView::parse(url);
+  if (!view.has_value())
+    return std::unexpected(view.error());
+  if (view->scheme.empty() || !view->hasAuthority || view->host.empty())
+    return std::unexpected("Not an absolute URI with a host");
+  return URI{*view};
 }
 
 bool URI::isSecure() const noexcept { return protocol == "wss" || protocol == "https"; }
 
+std::string URI::target() const noexcept { return query.empty() ? path : path + '?' + query; }
+
 std::string URI::toString() const noexcept
 {
-  return std::format("URI{{protocol={}, host={}, port={}, path={}}}", protocol, host, port, path);
+  return std::format("URI{{protocol={}, host={}, port={}, path={}, query={}}}", protocol, host, port, path, query);
+}
+
+std::string percentEncode(std::string_view in, std::string_view keep) noexcept
+{
+  constexpr char DIGITS[] = "0123456789ABCDEF";
+  std::string out;
+  out.reserve(in.size());
+  for (char c : in) {
+    if (unreserved(c) || keep.find(c) != std::string_view::npos) {
+      out += c;
+    } else {
+      out += '%';
+      out += DIGITS[static_cast<u8>(c) >> 4];
+      out += DIGITS[static_cast<u8>(c) & 0xF];
+    }
+  }
+  return out;
+}
+
+std::expected<std::string, std::string> percentDecode(std::string_view in) noexcept
+{
+  constexpr auto nibble = [](char c) { return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10; };
+  std::string out;
+  out.reserve(in.size());
+  for (usize i = 0; i < in.size(); ++i) {
+    if (in[i] != '%') {
+      out += in[i];
+      continue;
+    }
+    if (i + 2 >= in.size() || !is(in[i + 1], HEX) || !is(in[i + 2], HEX))
+      return std::unexpected(std::format("Invalid percent-encoding at {}", i));
+    out += static_cast<char>(nibble(in[i + 1]) << 4 | nibble(in[i + 2]));
+    i += 2;
+  }
+  return out;
 }
 }  // namespace twilight
@@ -0,0 +1,332 @@
+#include "utils/base64.h"
+
+#include <cstring>
+#include <format>
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+namespace twilight::base64
+{
+namespace
+{
+constexpr u8 INVALID = 0xFF;
+
+struct Table {
+  char chars[64];
+  // character to value, INVALID if it's not in the alphabet
+  u8 values[256];
+#if defined(__AVX2__) || defined(__SSSE3__)
+  // simd decoding: a character is valid iff lo[low nibble] & hi[high nibble] is zero, and its value is the character
+  // plus roll[high nibble], or plus roll[8 + high nibble] for `special`, the one that shares a high nibble with
+  // characters of a different run
+  u8 lo[16];
+  u8 hi[16];
+  i8 roll[16];
+  char special;
+  // encoding: value to character offset, by the class the kernel reduces the value to
+  i8 shift[16];
+#endif
+};
+
+constexpr Table table(const char (&chars)[65], [[maybe_unused]] char special) noexcept
+{
+  Table t{};
+  for (usize i = 0; i < 64; ++i) t.chars[i] = chars[i];
+  for (u8& v : t.values) v = INVALID;
+  for (usize i = 0; i < 64; ++i) t.values[static_cast<u8>(chars[i])] = static_cast<u8>(i);
+#if defined(__AVX2__) || defined(__SSSE3__)
+  // rows (high nibbles) with the same set of valid low nibbles share a bit, rows without any share 0x10 which every
+  // low nibble has
+  u16 patterns[8] = {};
+  u8 bits[8] = {};
+  usize distinct = 0;
+  constexpr u8 FREE[] = {0x01, 0x02, 0x04, 0x08, 0x20, 0x40, 0x80};
+  for (u8 h = 0; h < 16; ++h) {
+    u16 valid = 0;
+    for (u8 l = 0; l < 16; ++l)
+      if (t.values[h << 4 | l] != INVALID)
+        valid |= 1 << l;
+    if (!valid) {
+      t.hi[h] = 0x10;
+      continue;
+    }
+    usize p = 0;
+    while (p < distinct && patterns[p] != valid) ++p;
+    if (p == distinct) {
+      patterns[distinct] = valid;
+      bits[distinct] = FREE[distinct];
+      ++distinct;
+    }
+    t.hi[h] = bits[p];
+  }
+  for (u8 l = 0; l < 16; ++l) {
+    t.lo[l] = 0x10;
+    for (usize p = 0; p < distinct; ++p)
+      if (!(patterns[p] & (1 << l)))
+        t.lo[l] |= bits[p];
+  }
+
+  t.special = special;
+  for (u8 h = 0; h < 8; ++h) {
+    for (u8 l = 0; l < 16; ++l) {
+      char c = static_cast<char>(h << 4 | l);
+      if (t.values[static_cast<u8>(c)] != INVALID && c != special) {
+        t.roll[h] = static_cast<i8>(t.values[static_cast<u8>(c)] - c);
+        break;
+      }
+    }
+  }
+  t.roll[8 + (special >> 4)] = static_cast<i8>(t.values[static_cast<u8>(special)] - special);
+
+  // the kernel reduces 0..25 to 13, 26..51 to 0 and 52..63 to 1..12
+  t.shift[13] = static_cast<i8>(chars[0] - 0);
+  t.shift[0] = static_cast<i8>(chars[26] - 26);
+  for (u8 i = 52; i < 64; ++i) t.shift[i - 51] = static_cast<i8>(chars[i] - i);
+#endif
+  return t;
+}
+
+constexpr Table STANDARD = table("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/", '/');
+constexpr Table URL = table("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_", '_');
+
+inline const Table& of(Alphabet alphabet) noexcept { return alphabet == Alphabet::Standard ? STANDARD : URL; }
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+template <typename V>
+V splat(const void* table) noexcept;
+
+template <>
+inline __m128i splat<__m128i>(const void* table) noexcept
+{
+  return _mm_loadu_si128(static_cast<const __m128i*>(table));
+}
+#endif
+
+#if defined(__AVX2__)
+template <>
+inline __m256i splat<__m256i>(const void* table) noexcept
+{
+  return _mm256_broadcastsi128_si256(_mm_loadu_si128(static_cast<const __m128i*>(table)));
+}
+
+// 24 bytes to 32 characters: each 32 bit lane gets one 3 byte group, split into four 6 bit indices with two
+// multiplies, then mapped to characters with one shuffle (Muła & Lemire)
+inline __m256i encodeBlock(__m256i in, __m256i shift) noexcept
+{
+  in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5,
+                                 4, 7, 6, 8, 7, 10, 9, 11, 10));
+  __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+  __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+  __m256i indices = _mm256_or_si256(ac, bd);
+  __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+  reduced = _mm256_or_si256(
+    reduced, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+  return _mm256_add_epi8(indices, _mm256_shuffle_epi8(shift, reduced));
+}
+
+// 32 characters to 24 bytes, false if any of them is invalid
+inline bool decodeBlock(const char* in, u8* out, const Table& t) noexcept
+{
+  __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+  __m256i mask = _mm256_set1_epi8(0x0f);
+  __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask);
+  __m256i loNibbles = _mm256_and_si256(str, mask);
+  // characters >= 0x80 have their high nibble land on a 0x10 row through the sign bit check below
+  __m256i high = _mm256_cmpgt_epi8(_mm256_setzero_si256(), str);
+  __m256i lo = _mm256_shuffle_epi8(splat<__m256i>(t.lo), loNibbles);
+  __m256i hi = _mm256_or_si256(_mm256_shuffle_epi8(splat<__m256i>(t.hi), hiNibbles), high);
+  if (!_mm256_testz_si256(lo, hi))
+    return false;
+
+  __m256i special = _mm256_and_si256(_mm256_cmpeq_epi8(str, _mm256_set1_epi8(t.special)), _mm256_set1_epi8(8));
+  __m256i roll = _mm256_shuffle_epi8(splat<__m256i>(t.roll), _mm256_add_epi8(hiNibbles, special));
+  str = _mm256_add_epi8(str, roll);
+
+  // four 6 bit values per lane into three bytes
+  str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+  str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+  str = _mm256_shuffle_epi8(str, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6,
+                                   5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  str = _mm256_permutevar8x32_epi32(str, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+  // exactly 24 bytes, the output buffer may end right after them
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(str));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 16), _mm256_extracti128_si256(str, 1));
+  return true;
+}
+#elif defined(__SSSE3__)
+inline __m128i encodeBlock(__m128i in, __m128i shift) noexcept
+{
+  in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+  __m128i ac = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+  __m128i bd = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+  __m128i indices = _mm_or_si128(ac, bd);
+  __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  reduced = _mm_or_si128(reduced, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+  return _mm_add_epi8(indices, _mm_shuffle_epi8(shift, reduced));
+}
+
+inline bool decodeBlock(const char* in, u8* out, const Table& t) noexcept
+{
+  __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+  __m128i mask = _mm_set1_epi8(0x0f);
+  __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask);
+  __m128i loNibbles = _mm_and_si128(str, mask);
+  __m128i high = _mm_cmpgt_epi8(_mm_setzero_si128(), str);
+  __m128i lo = _mm_shuffle_epi8(splat<__m128i>(t.lo), loNibbles);
+  __m128i hi = _mm_or_si128(_mm_shuffle_epi8(splat<__m128i>(t.hi), hiNibbles), high);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF)
+    return false;
+
+  __m128i special = _mm_and_si128(_mm_cmpeq_epi8(str, _mm_set1_epi8(t.special)), _mm_set1_epi8(8));
+  __m128i roll = _mm_shuffle_epi8(splat<__m128i>(t.roll), _mm_add_epi8(hiNibbles, special));
+  str = _mm_add_epi8(str, roll);
+
+  str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+  str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+  str = _mm_shuffle_epi8(str, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(out), str);
+  u32 tail = static_cast<u32>(_mm_cvtsi128_si32(_mm_srli_si128(str, 8)));
+  std::memcpy(out + 8, &tail, sizeof(tail));
+  return true;
+}
+#endif
+}  // namespace
+
+void encode(const u8* in, usize size, char* out, Alphabet alphabet) noexcept
+{
+  const Table& t = of(alphabet);
+  const u8* end = in + size;
+#if defined(__AVX2__)
+  __m256i shift = splat<__m256i>(t.shift);
+  // the second half is loaded from in + 12, 16 bytes of it
+  for (; end - in >= 28; in += 24, out += 32) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12));
+    __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), encodeBlock(block, shift));
+  }
+#elif defined(__SSSE3__)
+  __m128i shift = splat<__m128i>(t.shift);
+  for (; end - in >= 16; in += 12, out += 16)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+      encodeBlock(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), shift));
+#endif
+
+  for (; end - in >= 3; in += 3, out += 4) {
+    u32 v = in[0] << 16 | in[1] << 8 | in[2];
+    out[0] = t.chars[v >> 18];
+    out[1] = t.chars[v >> 12 & 63];
+    out[2] = t.chars[v >> 6 & 63];
+    out[3] = t.chars[v & 63];
+  }
+
+  usize rest = end - in;
+  if (!rest)
+    return;
+  u32 v = in[0] << 16 | (rest == 2 ? in[1] << 8 : 0);
+  *out++ = t.chars[v >> 18];
+  *out++ = t.chars[v >> 12 & 63];
+  if (rest == 2)
+    *out++ = t.chars[v >> 6 & 63];
+  if (alphabet == Alphabet::Standard) {
+    if (rest == 1)
+      *out++ = '=';
+    *out++ = '=';
+  }
+}
+
+std::string encode(std::string_view in, Alphabet alphabet) noexcept
+{
+  std::string out(encodedSize(in.size(), alphabet), '\0');
+  encode(reinterpret_cast<const u8*>(in.data()), in.size(), out.data(), alphabet);
+  return out;
+}
+
+std::expected<usize, std::string> decode(std::string_view in, u8* out, Alphabet alphabet) noexcept
+{
+  const Table& t = of(alphabet);
+  usize size = in.size();
+  usize padding = 0;
+  while (padding < 2 && size && in[size - 1] == '=') {
+    --size;
+    ++padding;
+  }
+  if (alphabet == Alphabet::Standard || padding) {
+    if (in.size() % 4)
+      return std::unexpected("Invalid base64 length");
+  }
+  if (size % 4 == 1)
+    return std::unexpected("Invalid base64 length");
+
+  const char* p = in.data();
+  const char* end = p + size;
+  u8* o = out;
+  // the last quantum may be partial, leave it to the scalar tail
+#if defined(__AVX2__)
+  for (; end - p > 32; p += 32, o += 24)
+    if (!decodeBlock(p, o, t))
+      break;
+#elif defined(__SSSE3__)
+  for (; end - p > 16; p += 16, o += 12)
+    if (!decodeBlock(p, o, t))
+      break;
+#endif
+
+  auto invalid = [&](const char* at) {
+    return std::unexpected(std::format("Invalid base64 character at {}", at - in.data()));
+  };
+  for (; end - p >= 4; p += 4, o += 3) {
+    u8 a = t.values[static_cast<u8>(p[0])], b = t.values[static_cast<u8>(p[1])];
+    u8 c = t.values[static_cast<u8>(p[2])], d = t.values[static_cast<u8>(p[3])];
+    // INVALID is the only value with the top bit set
+    if ((a | b | c | d) & 0x80) {
+      for (usize i = 0; i < 4; ++i)
+        if (t.values[static_cast<u8>(p[i])] == INVALID)
+          return invalid(p + i);
+    }
+    u32 v = a << 18 | b << 12 | c << 6 | d;
+    o[0] = static_cast<u8>(v >> 16);
+    o[1] = static_cast<u8>(v >> 8);
+    o[2] = static_cast<u8>(v);
+  }
+
+  usize rest = end - p;
+  if (rest) {
+    for (usize i = 0; i < rest; ++i)
+      if (t.values[static_cast<u8>(p[i])] == INVALID)
+        return invalid(p + i);
+    u32 v = t.values[static_cast<u8>(p[0])] << 18 | t.values[static_cast<u8>(p[1])] << 12 |
+            (rest == 3 ? t.values[static_cast<u8>(p[2])] << 6 : 0);
+    // bits past the last byte must be zero
+    if (v & (rest == 3 ? 0xFF : 0xFFFF))
+      return std::unexpected("Non-canonical base64 padding bits");
+    *o++ = static_cast<u8>(v >> 16);
+    if (rest == 3)
+      *o++ = static_cast<u8>(v >> 8);
+  }
+  return o - out;
+}
+
+std::expected<std::string, std::string> decode(std::string_view in, Alphabet alphabet) noexcept
+{
+  std::string out(decodedSize(in), '\0');
+  auto res = decode(in, reinterpret_cast<u8*>(out.data()), alphabet);
+  if (!res.has_value())
+    return std::unexpected(std::move(res.error()));
+  return out;
+}
+
+std::string dataUri(std::string_view mime, std::string_view data) noexcept
+{
+  constexpr std::string_view PREFIX = "data:", SUFFIX = ";base64,";
+  usize head = PREFIX.size() + mime.size() + SUFFIX.size();
+  std::string out;
+  out.reserve(head + encodedSize(data.size()));
+  out.append(PREFIX).append(mime).append(SUFFIX);
+  out.resize(head + encodedSize(data.size()));
+  encode(reinterpret_cast<const u8*>(data.data()), data.size(), out.data() + head);
+  return out;
+}
+}  // namespace twilight::base64
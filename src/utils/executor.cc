@@ -0,0 +1,199 @@
+#include "utils/executor.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace twilight
+{
+namespace
+{
+struct ExecutorMetrics {
+  metrics::Gauge& queued = metrics::registry().gauge("executor_queued_jobs");
+  metrics::Counter& overflows = metrics::registry().counter("executor_overflows_total");
+  metrics::Counter& dropped = metrics::registry().counter("executor_dropped_total");
+  metrics::Counter& steals = metrics::registry().counter("executor_steals_total");
+  metrics::AtomicHistogram& wait = metrics::registry().histogram("executor_wait_ns");
+};
+}  // namespace
+
+bool pinThread(std::span<const u32> cpus) noexcept
+{
+  if (cpus.empty())
+    return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (u32 cpu : cpus)
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+Executor::Executor() : Executor(Options{}) {}
+
+Executor::Executor(Options opts) : options(std::move(opts)), strands(std::make_unique<Strand[]>(STRANDS))
+{
+  u32 n = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+  // every worker exists before any starts, they steal from each other
+  for (u32 i = 0; i < n; ++i) workers.push_back(std::make_unique<Worker>());
+  for (u32 i = 0; i < n; ++i) workers[i]->thread = std::jthread([this, i] { run(i); });
+}
+
+Executor::~Executor()
+{
+  stopping = true;
+  {
+    std::lock_guard<std::mutex> lock(idleMutex);
+    idleCv.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock(doneMutex);
+    doneCv.notify_all();
+  }
+  for (auto& worker : workers) worker->thread.join();
+}
+
+bool Executor::submit(u64 key, Job job)
+{
+  ExecutorMetrics& m = metrics::cached<ExecutorMetrics>();
+  if (pending.load(std::memory_order_relaxed) >= options.capacity) {
+    m.overflows.add();
+    if (options.overflow == Overflow::Drop) {
+      m.dropped.add();
+      return false;
+    }
+    waiting.fetch_add(1);
+    {
+      std::unique_lock<std::mutex> lock(doneMutex);
+      doneCv.wait(lock, [&] { return pending.load() < options.capacity || stopping; });
+    }
+    waiting.fetch_sub(1);
+  }
+
+  pending.fetch_add(1);
+  m.queued.add(1);
+  // snowflakes vary most in their high bits, which the multiplication spreads over the ones kept
+  usize index = (key * 0x9E3779B97F4A7C15ull) >> (64 - std::countr_zero(STRANDS));
+  Strand& strand = strands[index];
+  bool wasIdle;
+  {
+    std::lock_guard<std::mutex> lock(strand.mutex);
+    strand.tasks.push_back({std::move(job), metrics::now()});
+    wasIdle = !std::exchange(strand.scheduled, true);
+  }
+  if (wasIdle)
+    schedule(strand, index % workers.size());
+  return true;
+}
+
+void Executor::drain() noexcept
+{
+  waiting.fetch_add(1);
+  {
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneCv.wait(lock, [&] { return pending.load() == 0; });
+  }
+  waiting.fetch_sub(1);
+}
+
+void Executor::schedule(Strand& strand, usize home)
+{
+  {
+    std::lock_guard<std::mutex> lock(workers[home]->mutex);
+    workers[home]->strands.push_back(&strand);
+  }
+  // a worker going idle counts itself before it looks at the queues under their locks, so either it sees the strand
+  // or this sees it
+  if (idle.load()) {
+    std::lock_guard<std::mutex> lock(idleMutex);
+    idleCv.notify_one();
+  }
+}
+
+Executor::Strand* Executor::take(usize self) noexcept
+{
+  {
+    Worker& own = *workers[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.strands.empty()) {
+      Strand* strand = own.strands.front();
+      own.strands.pop_front();
+      return strand;
+    }
+  }
+  // steals from the back, the strands their owner would get to last
+  for (usize i = 1; i < workers.size(); ++i) {
+    Worker& other = *workers[(self + i) % workers.size()];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if (!other.strands.empty()) {
+      Strand* strand = other.strands.back();
+      other.strands.pop_back();
+      metrics::cached<ExecutorMetrics>().steals.add();
+      return strand;
+    }
+  }
+  return nullptr;
+}
+
+void Executor::run(usize self)
+{
+  if (!options.cpus.empty())
+    pinThread(std::span{&options.cpus[self % options.cpus.size()], 1});
+
+  auto anything = [this] {
+    return std::ranges::any_of(workers, [](const auto& w) {
+      std::lock_guard<std::mutex> lock(w->mutex);
+      return !w->strands.empty();
+    });
+  };
+
+  while (true) {
+    if (Strand* strand = take(self)) {
+      runStrand(*strand, self);
+      continue;
+    }
+    // nothing left anywhere. strands still running elsewhere are finished by whoever runs them
+    if (stopping)
+      return;
+    idle.fetch_add(1);
+    {
+      std::unique_lock<std::mutex> lock(idleMutex);
+      idleCv.wait(lock, [&] { return stopping || anything(); });
+    }
+    idle.fetch_sub(1);
+  }
+}
+
+void Executor::runStrand(Strand& strand, usize self)
+{
+  ExecutorMetrics& m = metrics::cached<ExecutorMetrics>();
+  for (usize n = 0;; ++n) {
+    Task task;
+    {
+      std::lock_guard<std::mutex> lock(strand.mutex);
+      if (strand.tasks.empty()) {
+        strand.scheduled = false;
+        return;
+      }
+      if (n == BATCH)
+        break;
+      task = std::move(strand.tasks.front());
+      strand.tasks.pop_front();
+    }
+    m.wait.record(metrics::now() - task.queued);
+    task.job();
+
+    pending.fetch_sub(1);
+    m.queued.add(-1);
+    if (waiting.load()) {
+      std::lock_guard<std::mutex> lock(doneMutex);
+      doneCv.notify_all();
+    }
+  }
+  // still scheduled, behind whatever else this worker has
+  schedule(strand, self);
+}
+}  // namespace twilight
@@ -0,0 +1,67 @@
+#include "utils/metrics.h"
+
+#include <format>
+#include <stdexcept>
+
+namespace twilight::metrics
+{
+Histogram AtomicHistogram::snapshot() const noexcept
+{
+  Histogram h;
+  for (usize i = 0; i < Histogram::BUCKETS; ++i) h.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+  h.n = n.load(std::memory_order_relaxed);
+  h.sum = sum.load(std::memory_order_relaxed);
+  h.lo = lo.load(std::memory_order_relaxed);
+  h.hi = hi.load(std::memory_order_relaxed);
+  return h;
+}
+
+template <typename T>
+T& Registry::get(std::string_view name)
+{
+  std::lock_guard lock(mutex);
+  auto it = metrics.find(name);
+  if (it == metrics.end())
+    it = metrics.emplace(std::string{name}, std::make_unique<T>()).first;
+  auto* p = std::get_if<std::unique_ptr<T>>(&it->second);
+  if (!p)
+    throw std::runtime_error("Metric " + std::string{name} + " is registered with another type");
+  return **p;
+}
+
+Counter& Registry::counter(std::string_view name) { return get<Counter>(name); }
+Gauge& Registry::gauge(std::string_view name) { return get<Gauge>(name); }
+AtomicHistogram& Registry::histogram(std::string_view name) { return get<AtomicHistogram>(name); }
+
+void Registry::forEach(const std::function<void(std::string_view, Metric)>& f) const
+{
+  std::lock_guard lock(mutex);
+  for (const auto& [name, entry] : metrics)
+    std::visit([&](const auto& p) { f(name, Metric{p.get()}); }, entry);
+}
+
+std::string Registry::toString() const
+{
+  std::string out;
+  forEach([&](std::string_view name, Metric metric) {
+    if (auto* c = std::get_if<const Counter*>(&metric)) {
+      out += std::format("# TYPE {} counter\n{} {}\n", name, name, (*c)->value());
+    } else if (auto* g = std::get_if<const Gauge*>(&metric)) {
+      out += std::format("# TYPE {} gauge\n{} {}\n", name, name, (*g)->value());
+    } else {
+      Histogram h = std::get<const AtomicHistogram*>(metric)->snapshot();
+      out += std::format("# TYPE {} summary\n", name);
+      for (f64 q : {0.5, 0.9, 0.99, 0.999}) out += std::format("{}{{quantile=\"{}\"}} {}\n", name, q, h.percentile(q));
+      out += std::format("{}_sum {}\n{}_count {}\n", name, h.total(), name, h.count());
+    }
+  });
+  return out;
+}
+
+Registry& registry() noexcept
+{
+  // never destroyed, metrics may be recorded from other statics' destructors
+  static Registry* r = new Registry;
+  return *r;
+}
+}  // namespace twilight::metrics
@@ -0,0 +1,169 @@
+#include "utils/pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <new>
+
+namespace twilight
+{
+namespace
+{
+struct Block {
+  Block* next;
+};
+
+// trivially destructible so the fast paths don't go through a TLS guard, Reaper frees it at thread exit
+struct Cache {
+  std::array<Block*, BufferPool::CLASSES> heads{};
+  std::array<u32, BufferPool::CLASSES> counts{};
+  // the thread is exiting, frees go to the heap
+  bool dead = false;
+};
+
+constinit thread_local Cache cache{};
+
+struct Reaper {
+  bool armed = false;
+  ~Reaper()
+  {
+    BufferPool::trim();
+    cache.dead = true;
+  }
+};
+
+thread_local Reaper reaper;
+
+inline usize limit(usize cls) noexcept { return std::max<usize>(BufferPool::CACHE >> (cls + BufferPool::MIN_BITS), 2); }
+
+inline bool pooled(usize bytes, usize align) noexcept
+{
+  return bytes <= BufferPool::MAX && align <= alignof(std::max_align_t);
+}
+}  // namespace
+
+void* BufferPool::do_allocate(usize bytes, usize align)
+{
+  if (!pooled(bytes, align))
+    return align > alignof(std::max_align_t) ? ::operator new(bytes, std::align_val_t{align}) : ::operator new(bytes);
+
+  usize cls = sizeClass(bytes);
+  if (Block* b = cache.heads[cls]) {
+    cache.heads[cls] = b->next;
+    --cache.counts[cls];
+    return b;
+  }
+  return ::operator new(usize(1) << (cls + MIN_BITS));
+}
+
+void BufferPool::do_deallocate(void* p, usize bytes, usize align)
+{
+  if (!pooled(bytes, align)) {
+    if (align > alignof(std::max_align_t))
+      ::operator delete(p, bytes, std::align_val_t{align});
+    else
+      ::operator delete(p, bytes);
+    return;
+  }
+
+  usize cls = sizeClass(bytes);
+  if (cache.dead || cache.counts[cls] >= limit(cls)) {
+    ::operator delete(p, usize(1) << (cls + MIN_BITS));
+    return;
+  }
+  if (!reaper.armed)
+    reaper.armed = true;
+  Block* b = static_cast<Block*>(p);
+  b->next = cache.heads[cls];
+  cache.heads[cls] = b;
+  ++cache.counts[cls];
+}
+
+bool BufferPool::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+  return dynamic_cast<const BufferPool*>(&other) != nullptr;
+}
+
+usize BufferPool::cached() noexcept
+{
+  usize n = 0;
+  for (u32 c : cache.counts) n += c;
+  return n;
+}
+
+void BufferPool::trim() noexcept
+{
+  for (usize cls = 0; cls < CLASSES; ++cls) {
+    while (Block* b = cache.heads[cls]) {
+      cache.heads[cls] = b->next;
+      ::operator delete(b, usize(1) << (cls + MIN_BITS));
+    }
+    cache.counts[cls] = 0;
+  }
+}
+
+BufferPool& bufferPool() noexcept
+{
+  // never destroyed, buffers may be freed by other statics' destructors
+  static BufferPool* pool = new BufferPool;
+  return *pool;
+}
+
+MessageArena::MessageArena(std::pmr::memory_resource* upstream, usize initial) noexcept
+  : upstream(upstream), next(std::bit_ceil(std::max<usize>(initial, 256)))
+{
+}
+
+MessageArena::~MessageArena() { release(); }
+
+void MessageArena::reset() noexcept
+{
+  // several chunks, or one too big to keep: start over with a single chunk the size of all of them
+  if (chunks && (chunks->next || chunks->size > BufferPool::MAX)) {
+    usize total = std::min(reserved, BufferPool::MAX);
+    release();
+    next = std::bit_ceil(total);
+  }
+  cur = begin;
+  usedBytes = 0;
+}
+
+void* MessageArena::do_allocate(usize bytes, usize align)
+{
+  std::uintptr_t p = (reinterpret_cast<std::uintptr_t>(cur) + align - 1) & ~(align - 1);
+  if (!cur || p + bytes > reinterpret_cast<std::uintptr_t>(end))
+    return grow(bytes, align);
+  cur = reinterpret_cast<char*>(p + bytes);
+  return reinterpret_cast<void*>(p);
+}
+
+void* MessageArena::grow(usize bytes, usize align)
+{
+  usize size = std::max(next, std::bit_ceil(sizeof(Chunk) + bytes + align));
+  auto* c = static_cast<Chunk*>(upstream->allocate(size, alignof(std::max_align_t)));
+  c->next = chunks;
+  c->size = size;
+  chunks = c;
+  reserved += size;
+  next = std::min(size * 2, BufferPool::MAX);
+
+  if (begin)
+    usedBytes += cur - begin;
+  begin = reinterpret_cast<char*>(c + 1);
+  end = reinterpret_cast<char*>(c) + size;
+
+  std::uintptr_t p = (reinterpret_cast<std::uintptr_t>(begin) + align - 1) & ~(align - 1);
+  cur = reinterpret_cast<char*>(p + bytes);
+  return reinterpret_cast<void*>(p);
+}
+
+void MessageArena::release() noexcept
+{
+  while (Chunk* c = chunks) {
+    chunks = c->next;
+    upstream->deallocate(c, c->size, alignof(std::max_align_t));
+  }
+  begin = cur = end = nullptr;
+  reserved = 0;
+}
+}  // namespace twilight
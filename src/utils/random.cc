@@ -0,0 +1,145 @@
+#include "utils/random.h"
+
+#include <pthread.h>
+#include <sys/random.h>
+
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstdlib>
+
+namespace twilight
+{
+namespace
+{
+// blocks generated per refill, written lane by lane so the compiler can run them side by side in vector registers
+constexpr usize LANES = 16;
+constexpr usize BLOCK = 64;
+// the key is replaced after this much keystream, and whenever the process forked
+constexpr u64 RESEED = 1 << 20;
+
+// bumped in the child after fork(), so it doesn't go on to hand out the same bytes as its parent
+std::atomic<u32> forks = 0;
+[[maybe_unused]] const int atfork =
+  pthread_atfork(nullptr, nullptr, [] { forks.fetch_add(1, std::memory_order_relaxed); });
+
+inline void quarter(u32 (&x)[16][LANES], usize a, usize b, usize c, usize d) noexcept
+{
+  for (usize l = 0; l < LANES; ++l) {
+    x[a][l] += x[b][l];
+    x[d][l] = std::rotl(x[d][l] ^ x[a][l], 16);
+    x[c][l] += x[d][l];
+    x[b][l] = std::rotl(x[b][l] ^ x[c][l], 12);
+    x[a][l] += x[b][l];
+    x[d][l] = std::rotl(x[d][l] ^ x[a][l], 8);
+    x[c][l] += x[d][l];
+    x[b][l] = std::rotl(x[b][l] ^ x[c][l], 7);
+  }
+}
+
+struct ChaCha {
+  u32 state[16];
+  u8 buffer[LANES * BLOCK];
+  usize pos = sizeof(buffer);
+  u64 generated = RESEED;
+  u32 forked = 0;
+
+  void seed() noexcept
+  {
+    static constexpr u32 SIGMA[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+    std::memcpy(state, SIGMA, sizeof(SIGMA));
+    // key and nonce, the counter starts at 0
+    secureRandomBytes(reinterpret_cast<u8*>(state + 4), 8 * sizeof(u32));
+    state[12] = state[13] = 0;
+    secureRandomBytes(reinterpret_cast<u8*>(state + 14), 2 * sizeof(u32));
+    generated = 0;
+    forked = forks.load(std::memory_order_relaxed);
+  }
+
+  void refill() noexcept
+  {
+    if (generated >= RESEED)
+      seed();
+
+    u32 x[16][LANES];
+    for (usize i = 0; i < 16; ++i)
+      for (usize l = 0; l < LANES; ++l) x[i][l] = state[i];
+    for (usize l = 0; l < LANES; ++l) {
+      u64 counter = (static_cast<u64>(state[13]) << 32 | state[12]) + l;
+      x[12][l] = static_cast<u32>(counter);
+      x[13][l] = static_cast<u32>(counter >> 32);
+    }
+    u32 in[16][LANES];
+    std::memcpy(in, x, sizeof(x));
+
+    for (usize r = 0; r < 10; ++r) {
+      quarter(x, 0, 4, 8, 12);
+      quarter(x, 1, 5, 9, 13);
+      quarter(x, 2, 6, 10, 14);
+      quarter(x, 3, 7, 11, 15);
+      quarter(x, 0, 5, 10, 15);
+      quarter(x, 1, 6, 11, 12);
+      quarter(x, 2, 7, 8, 13);
+      quarter(x, 3, 4, 9, 14);
+    }
+
+    for (usize l = 0; l < LANES; ++l) {
+      for (usize i = 0; i < 16; ++i) {
+        u32 v = x[i][l] + in[i][l];
+        if constexpr (std::endian::native == std::endian::big)
+          v = std::byteswap(v);
+        std::memcpy(buffer + l * BLOCK + i * 4, &v, 4);
+      }
+    }
+
+    u64 counter = (static_cast<u64>(state[13]) << 32 | state[12]) + LANES;
+    state[12] = static_cast<u32>(counter);
+    state[13] = static_cast<u32>(counter >> 32);
+    generated += sizeof(buffer);
+    pos = 0;
+  }
+};
+
+thread_local ChaCha chacha;
+}  // namespace
+
+void randomBytes(u8* out, usize size) noexcept
+{
+  ChaCha& c = chacha;
+  // whatever is buffered was generated before a fork, the parent hands out the same bytes
+  if (c.forked != forks.load(std::memory_order_relaxed)) [[unlikely]] {
+    c.pos = sizeof(c.buffer);
+    c.generated = RESEED;
+  }
+  if (size <= sizeof(c.buffer) - c.pos) [[likely]] {
+    std::memcpy(out, c.buffer + c.pos, size);
+    c.pos += size;
+    return;
+  }
+
+  while (size) {
+    if (c.pos == sizeof(c.buffer))
+      c.refill();
+    usize n = std::min(size, sizeof(c.buffer) - c.pos);
+    std::memcpy(out, c.buffer + c.pos, n);
+    c.pos += n;
+    out += n;
+    size -= n;
+  }
+}
+
+void secureRandomBytes(u8* out, usize size) noexcept
+{
+  while (size) {
+    isize n = getrandom(out, size, 0);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      // only possible on kernels older than 3.17, nothing sensible to fall back to
+      std::abort();
+    }
+    out += n;
+    size -= n;
+  }
+}
+}  // namespace twilight
@@ -0,0 +1,343 @@
+#include "utils/uring.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace twilight
+{
+namespace
+{
+// user_data of each kind of request
+constexpr u64 RECV = 1;
+constexpr u64 SEND = 2;
+constexpr u64 CANCEL = 3;
+
+template <typename T>
+inline T load(T* p) noexcept
+{
+  return std::atomic_ref<T>{*p}.load(std::memory_order_acquire);
+}
+
+template <typename T>
+inline void store(T* p, T v) noexcept
+{
+  std::atomic_ref<T>{*p}.store(v, std::memory_order_release);
+}
+
+inline int registerRing(int ring, u32 op, const void* arg, u32 n) noexcept
+{
+  return static_cast<int>(syscall(__NR_io_uring_register, ring, op, arg, n));
+}
+
+inline void* map(usize size, int fd, u64 offset) noexcept
+{
+  void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, static_cast<off_t>(offset));
+  return p == MAP_FAILED ? nullptr : p;
+}
+}  // namespace
+
+UringSocket::UringSocket(int fd)
+{
+  io_uring_params p{};
+  ring = static_cast<int>(syscall(__NR_io_uring_setup, ENTRIES, &p));
+  if (ring < 0)
+    throw std::runtime_error("io_uring_setup: " + std::string(std::strerror(errno)));
+
+  sqMapSize = p.sq_off.array + p.sq_entries * sizeof(u32);
+  cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+  if (single)
+    sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+  sqMap = map(sqMapSize, ring, IORING_OFF_SQ_RING);
+  cqMap = single ? sqMap : map(cqMapSize, ring, IORING_OFF_CQ_RING);
+  sqes = static_cast<io_uring_sqe*>(map(p.sq_entries * sizeof(io_uring_sqe), ring, IORING_OFF_SQES));
+
+  // provided buffers are published through a page-aligned ring of their addresses
+  void* br = mmap(nullptr, BUFFERS * sizeof(io_uring_buf), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  bufRing = br == MAP_FAILED ? nullptr : static_cast<io_uring_buf_ring*>(br);
+  buffers = std::make_unique_for_overwrite<char[]>(BUFFERS * BUFFER_SIZE);
+
+  io_uring_buf_reg reg{};
+  reg.ring_addr = reinterpret_cast<std::uintptr_t>(bufRing);
+  reg.ring_entries = BUFFERS;
+  reg.bgid = 0;
+  if (!sqMap || !cqMap || !sqes || !bufRing || registerRing(ring, IORING_REGISTER_PBUF_RING, &reg, 1) < 0 ||
+      registerRing(ring, IORING_REGISTER_FILES, &fd, 1) < 0) {
+    std::string error = std::strerror(errno);
+    release();
+    throw std::runtime_error("io_uring setup failed: " + error);
+  }
+
+  char* sq = static_cast<char*>(sqMap);
+  sqHead = reinterpret_cast<u32*>(sq + p.sq_off.head);
+  sqTail = reinterpret_cast<u32*>(sq + p.sq_off.tail);
+  sqMask = reinterpret_cast<u32*>(sq + p.sq_off.ring_mask);
+  sqArray = reinterpret_cast<u32*>(sq + p.sq_off.array);
+  char* cq = static_cast<char*>(cqMap);
+  cqHead = reinterpret_cast<u32*>(cq + p.cq_off.head);
+  cqTail = reinterpret_cast<u32*>(cq + p.cq_off.tail);
+  cqMask = reinterpret_cast<u32*>(cq + p.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+  for (u16 id = 0; id < BUFFERS; ++id) recycle(id);
+}
+
+UringSocket::~UringSocket()
+{
+  // the kernel writes into the buffers until the recv is gone, so everything is cancelled and waited for first
+  bool drained = true;
+  if (sqes && (armed || sending)) {
+    io_uring_sqe* sqe = next();
+    if (sqe) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+      sqe->user_data = CANCEL;
+      push();
+    }
+    drained = sqe && enter(std::exchange(unsubmitted, 0), 0) >= 0;
+    while (drained && (armed || sending)) {
+      if (enter(0, 1) < 0 && errno != EINTR) {
+        drained = false;
+        break;
+      }
+      u32 head = *cqHead;
+      for (u32 tail = load(cqTail); head != tail; ++head) {
+        const io_uring_cqe& cqe = cqes[head & *cqMask];
+        if (cqe.user_data == SEND)
+          sending = false;
+        else if (cqe.user_data == RECV && !(cqe.flags & IORING_CQE_F_MORE))
+          armed = false;
+      }
+      store(cqHead, head);
+    }
+  }
+  if (!drained) {
+    // what the kernel may still be reading or writing is leaked rather than freed under it
+    (void)buffers.release();
+    bufRing = nullptr;
+    (void)new (std::nothrow) std::string(std::move(inflight));
+  }
+  release();
+}
+
+void UringSocket::release() noexcept
+{
+  if (ring >= 0)
+    ::close(ring);
+  if (sqes)
+    munmap(sqes, ENTRIES * sizeof(io_uring_sqe));
+  if (cqMap && cqMap != sqMap)
+    munmap(cqMap, cqMapSize);
+  if (sqMap)
+    munmap(sqMap, sqMapSize);
+  if (bufRing)
+    munmap(bufRing, BUFFERS * sizeof(io_uring_buf));
+}
+
+isize UringSocket::recv(char* buf, usize len) noexcept
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    if (current >= 0) {
+      usize n = std::min(len, length - offset);
+      std::memcpy(buf, buffers.get() + current * BUFFER_SIZE + offset, n);
+      offset += n;
+      if (offset == length) {
+        recycle(static_cast<u16>(current));
+        current = -1;
+      }
+      // a send reaping queued shouldn't wait for the next call
+      if (unsubmitted)
+        enter(std::exchange(unsubmitted, 0), 0);
+      return static_cast<isize>(n);
+    }
+
+    if (reap())
+      continue;
+    if (failed)
+      return -1;
+    if (eof)
+      return 0;
+    if (!armed)
+      arm();
+
+    // submits whatever is queued and waits, one syscall where a blocking socket needed a send and a recv
+    u32 submit = std::exchange(unsubmitted, 0);
+    lock.unlock();
+    int r = enter(submit, 1);
+    lock.lock();
+    if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+      failed = true;
+  }
+}
+
+isize UringSocket::send(const char* buf, usize len, bool defer) noexcept
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  if (failed)
+    return -1;
+  outbox.append(buf, len);
+  if (!sending)
+    issueSend();
+  if (!defer && unsubmitted)
+    enter(std::exchange(unsubmitted, 0), 0);
+  return static_cast<isize>(len);
+}
+
+bool UringSocket::supported() noexcept
+{
+  static const bool ok = [] {
+    utsname u;
+    if (uname(&u) != 0)
+      return false;
+    int major = 0;
+    std::from_chars(u.release, u.release + std::strlen(u.release), major);
+    if (major < 6)
+      return false;
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+      return false;
+    bool works = true;
+    try {
+      UringSocket probe{fds[0]};
+    } catch (const std::exception&) {
+      works = false;
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return works;
+  }();
+  return ok;
+}
+
+io_uring_sqe* UringSocket::next() noexcept
+{
+  u32 tail = *sqTail;
+  if (tail - load(sqHead) >= ENTRIES)
+    return nullptr;
+  io_uring_sqe* sqe = &sqes[tail & *sqMask];
+  std::memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+void UringSocket::push() noexcept
+{
+  u32 tail = *sqTail;
+  sqArray[tail & *sqMask] = tail & *sqMask;
+  store(sqTail, tail + 1);
+  ++unsubmitted;
+}
+
+void UringSocket::arm() noexcept
+{
+  io_uring_sqe* sqe = next();
+  if (!sqe) {
+    failed = true;
+    return;
+  }
+  sqe->opcode = IORING_OP_RECV;
+  // index 0 of the registered files
+  sqe->fd = 0;
+  sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->buf_group = 0;
+  sqe->user_data = RECV;
+  push();
+  armed = true;
+}
+
+void UringSocket::issueSend() noexcept
+{
+  inflight.swap(outbox);
+  outbox.clear();
+  inflightSent = 0;
+  sending = true;
+  submitSend();
+}
+
+void UringSocket::submitSend() noexcept
+{
+  io_uring_sqe* sqe = next();
+  if (!sqe) {
+    failed = true;
+    return;
+  }
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = 0;
+  sqe->flags = IOSQE_FIXED_FILE;
+  sqe->addr = reinterpret_cast<std::uintptr_t>(inflight.data() + inflightSent);
+  sqe->len = static_cast<u32>(inflight.size() - inflightSent);
+  sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+  sqe->user_data = SEND;
+  push();
+}
+
+void UringSocket::recycle(u16 id) noexcept
+{
+  // the entries start at the ring itself, which `bufs` doesn't in C++: the uapi header's flexible array sits behind an
+  // empty struct there. only these fields are written, the first entry's last one is the ring's tail
+  io_uring_buf& b = reinterpret_cast<io_uring_buf*>(bufRing)[bufTail & (BUFFERS - 1)];
+  b.addr = reinterpret_cast<std::uintptr_t>(buffers.get() + id * BUFFER_SIZE);
+  b.len = BUFFER_SIZE;
+  b.bid = id;
+  store(&bufRing->tail, ++bufTail);
+}
+
+bool UringSocket::reap() noexcept
+{
+  bool got = false;
+  u32 head = *cqHead;
+  for (u32 tail = load(cqTail); head != tail && !got; ++head) {
+    const io_uring_cqe& cqe = cqes[head & *cqMask];
+    if (cqe.user_data == SEND) {
+      if (cqe.res < 0) {
+        failed = true;
+        sending = false;
+        continue;
+      }
+      inflightSent += static_cast<usize>(cqe.res);
+      if (inflightSent < inflight.size())
+        submitSend();
+      else if (!outbox.empty())
+        issueSend();
+      else
+        sending = false;
+    } else if (cqe.user_data == RECV) {
+      if (!(cqe.flags & IORING_CQE_F_MORE))
+        armed = false;
+      if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+        current = static_cast<i32>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        offset = 0;
+        length = static_cast<usize>(cqe.res);
+        got = true;
+      } else if (cqe.res == 0) {
+        eof = true;
+      } else if (cqe.res != -ENOBUFS) {
+        // out of buffers only stops the recv, it's rearmed once some are read
+        failed = true;
+      }
+    }
+  }
+  store(cqHead, head);
+  return got;
+}
+
+int UringSocket::enter(u32 submit, u32 wait) noexcept
+{
+  entered.fetch_add(1, std::memory_order_relaxed);
+  return static_cast<int>(
+    syscall(__NR_io_uring_enter, ring, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0));
+}
+}  // namespace twilight
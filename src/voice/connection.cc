@@ -0,0 +1,327 @@
+#include "voice/connection.h"
+
+#include <stdexcept>
+#include <thread>
+
+namespace twilight::voice
+{
+Connection::Connection(Engine& engine, Options options) : engine(engine), options(std::move(options)) {}
+
+Connection::~Connection() { close(); }
+
+void Connection::connect()
+{
+  try {
+    open();
+  } catch (...) {
+    close();
+    throw;
+  }
+}
+
+void Connection::open()
+{
+  closing = false;
+  std::string url = options.endpoint.find("://") == std::string::npos ? "wss://" + options.endpoint : options.endpoint;
+  ws = std::make_unique<ws::Client>(URI{url + "/?v=8"}, http::ClientFlags::NoConnect);
+  ws->onmessage = [this](const ws::Frame& frame) {
+    listener = std::this_thread::get_id();
+    handle(frame);
+  };
+  ws->onclose = [this] {
+    listener = std::this_thread::get_id();
+    if (!closing)
+      onclose();
+  };
+  ws->connect();
+  identify();
+
+  // Ready brings the server's address and our ssrc
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!cv.wait_for(lock, options.timeout, [&] { return own != 0; }))
+    throw std::runtime_error("Voice gateway didn't send Ready in time");
+  std::string server = ip;
+  u16 serverPort = port;
+  lock.unlock();
+
+  udp = std::make_unique<Transport>(server, serverPort, own, options.jitterDepth);
+  auto address = udp->discover(options.timeout);
+  if (!address.has_value())
+    throw std::runtime_error(address.error());
+  send(Opcode::SelectProtocol, [&](json::Writer& w) {
+    w.beginObject()
+      .key("protocol")
+      .value("udp")
+      .key("data")
+      .beginObject()
+      .key("address")
+      .value(address->ip)
+      .key("port")
+      .value(address->port)
+      .key("mode")
+      .value(MODE)
+      .endObject()
+      .endObject();
+  });
+
+  lock.lock();
+  if (!cv.wait_for(lock, options.timeout, [&] { return key.has_value(); }))
+    throw std::runtime_error("Voice gateway didn't send a session description in time");
+  udp->setKey(*key);
+  lock.unlock();
+
+  engine.watch(udp->fd(), [this] { udp->receive(); });
+  Engine::Timer timer = engine.every(FRAME, [this](u32 ticks) { tick(ticks); });
+  lock.lock();
+  tickTimer = timer;
+}
+
+void Connection::close() noexcept
+{
+  closing = true;
+  bool timerThread = std::this_thread::get_id() == ticker.load();
+  // onaudio runs inside the transport's playout, tick() lets go of it and of its own timer once that has returned
+  bool deferred = timerThread && playing;
+  Engine::Timer heartbeats, ticks = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    heartbeats = std::exchange(heartbeatTimer, 0);
+    if (!deferred)
+      ticks = std::exchange(tickTimer, 0);
+  }
+  if (heartbeats)
+    engine.cancel(heartbeats);
+  if (ticks)
+    engine.cancel(ticks);
+  if (udp && !deferred)
+    engine.unwatch(udp->fd());
+  if (ws) {
+    ws->close();
+    retired = std::move(ws);
+  }
+  // the listener can't wait for itself, nor the timer thread for a listener that may be waiting for a timer. the client
+  // is then kept until close() runs elsewhere, at the latest when the connection is destroyed
+  if (!timerThread && std::this_thread::get_id() != listener.load())
+    // joins the listener
+    retired.reset();
+  if (deferred)
+    releasing = true;
+  else
+    udp.reset();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  own = 0;
+  key.reset();
+  users.clear();
+}
+
+bool Connection::play(std::span<const u8> frame)
+{
+  if (frame.size() > MAX_FRAME)
+    return false;
+  std::lock_guard<std::mutex> lock(queueMutex);
+  if (frames.size() >= options.queue)
+    return false;
+  frames.emplace_back(reinterpret_cast<const char*>(frame.data()), frame.size());
+  return true;
+}
+
+usize Connection::queued() const noexcept
+{
+  std::lock_guard<std::mutex> lock(queueMutex);
+  return frames.size();
+}
+
+std::optional<u64> Connection::user(u32 ssrc) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = users.find(ssrc);
+  return it != users.end() ? std::optional{it->second} : std::nullopt;
+}
+
+void Connection::identify()
+{
+  send(Opcode::Identify, [&](json::Writer& w) {
+    w.beginObject()
+      .key("server_id")
+      .snowflake(options.guild)
+      .key("user_id")
+      .snowflake(options.user)
+      .key("session_id")
+      .value(options.sessionId)
+      .key("token")
+      .value(options.token)
+      .key("max_dave_protocol_version")
+      .value(0)
+      .endObject();
+  });
+}
+
+void Connection::heartbeat()
+{
+  // a heartbeat still unacknowledged when the next is due means the connection is gone
+  u64 nonce = static_cast<u64>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch())
+                                 .count());
+  if (heartbeatNonce.exchange(nonce) != 0) {
+    if (ws)
+      ws->close();
+    return;
+  }
+  send(Opcode::Heartbeat, [&](json::Writer& w) {
+    w.beginObject().key("t").value(nonce).key("seq_ack").value(seqAck.load()).endObject();
+  });
+}
+
+void Connection::handle(const ws::Frame& frame)
+{
+  auto root = parser.parse(frame.payload);
+  if (!root.has_value())
+    return;
+  auto op = root->find("op");
+  auto d = root->find("d");
+  if (!op || !d)
+    return;
+  if (auto seq = root->find("seq"))
+    seqAck = seq->asUint().value_or(seqAck.load());
+
+  auto uint = [&](std::string_view field) { return d->find(field).value_or(json::Value{}).asUint().value_or(0); };
+  switch (static_cast<Opcode>(op->asUint().value_or(0xFF))) {
+  case Opcode::Hello: {
+    std::chrono::milliseconds interval{uint("heartbeat_interval")};
+    if (interval.count() == 0)
+      break;
+    Engine::Timer timer = engine.every(interval, [this](u32) { heartbeat(); }, Engine::Clock::now() + interval);
+    Engine::Timer old;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      // one made after close() took the last is cancelled right away
+      old = closing ? timer : std::exchange(heartbeatTimer, timer);
+    }
+    if (old)
+      engine.cancel(old);
+    break;
+  }
+  case Opcode::Ready: {
+    std::lock_guard<std::mutex> lock(mutex);
+    ip = d->find("ip").value_or(json::Value{}).asString().value_or("");
+    port = static_cast<u16>(uint("port"));
+    own = static_cast<u32>(uint("ssrc"));
+    cv.notify_all();
+    break;
+  }
+  case Opcode::SessionDescription: {
+    auto secret = d->find("secret_key");
+    if (!secret || secret->size() != Cipher::Key{}.size())
+      break;
+    Cipher::Key k;
+    usize i = 0;
+    for (json::Value b : secret->items()) k[i++] = static_cast<u8>(b.asUint().value_or(0));
+    std::lock_guard<std::mutex> lock(mutex);
+    key = k;
+    cv.notify_all();
+    break;
+  }
+  case Opcode::HeartbeatAck: {
+    u64 nonce = uint("t");
+    if (nonce && heartbeatNonce.compare_exchange_strong(nonce, 0)) {
+      auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch());
+      rtt.store(std::chrono::duration_cast<std::chrono::nanoseconds>(now - std::chrono::milliseconds{nonce}).count(),
+                std::memory_order_relaxed);
+    }
+    break;
+  }
+  case Opcode::Speaking: {
+    u64 id = d->find("user_id").value_or(json::Value{}).asSnowflake().value_or(0);
+    u32 ssrc = static_cast<u32>(uint("ssrc"));
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      users[ssrc] = id;
+    }
+    onspeaking(id, ssrc, uint("speaking") != 0);
+    break;
+  }
+  case Opcode::ClientDisconnect: {
+    u64 id = d->find("user_id").value_or(json::Value{}).asSnowflake().value_or(0);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::erase_if(users, [&](const auto& entry) {
+        if (entry.second == id)
+          departed.push_back(entry.first);
+        return entry.second == id;
+      });
+    }
+    ondisconnect(id);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void Connection::setSpeaking(bool on)
+{
+  speaking = on;
+  send(Opcode::Speaking, [&](json::Writer& w) {
+    w.beginObject().key("speaking").value(on ? 1 : 0).key("delay").value(0).key("ssrc").value(own.load()).endObject();
+  });
+}
+
+void Connection::tick(u32 ticks)
+{
+  ticker = std::this_thread::get_id();
+  // up to a frame per tick, more to catch up after running late
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    while (sending.size() < ticks && !frames.empty()) {
+      sending.push_back(std::move(frames.front()));
+      frames.pop_front();
+    }
+  }
+
+  std::array<std::span<const u8>, Transport::BATCH> spans;
+  usize n = 0;
+  if (!sending.empty()) {
+    if (!speaking)
+      setSpeaking(true);
+    silence = TRAILING_SILENCE;
+    for (; n < sending.size() && n < spans.size(); ++n)
+      spans[n] = {reinterpret_cast<const u8*>(sending[n].data()), sending[n].size()};
+  } else if (speaking) {
+    for (; n < ticks && n < spans.size() && silence; ++n, --silence) spans[n] = SILENCE;
+  }
+  udp->send({spans.data(), n});
+  if (n < ticks)
+    udp->skip(ticks - n);
+  sending.clear();
+  if (speaking && !silence)
+    setSpeaking(false);
+
+  std::vector<u32> gone;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    gone.swap(departed);
+  }
+  for (u32 ssrc : gone) udp->forget(ssrc);
+  playing = true;
+  for (u32 i = 0; i < std::min<u32>(ticks, JitterBuffer::SLOTS) && !releasing; ++i)
+    udp->playout([&](u32 ssrc, JitterBuffer::Pop pop, std::span<const u8> frame) {
+      if (!releasing)
+        onaudio(ssrc, pop == JitterBuffer::Pop::Lost ? std::span<const u8>{} : frame);
+    });
+  playing = false;
+  // closed from onaudio
+  if (releasing) {
+    releasing = false;
+    engine.unwatch(udp->fd());
+    udp.reset();
+    Engine::Timer self;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      self = std::exchange(tickTimer, 0);
+    }
+    engine.cancel(self);
+  }
+}
+}  // namespace twilight::voice
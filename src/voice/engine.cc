@@ -0,0 +1,222 @@
+#include "voice/engine.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#include "utils/executor.h"
+
+namespace twilight::voice
+{
+namespace
+{
+metrics::AtomicHistogram& lateness()
+{
+  static metrics::AtomicHistogram& h = metrics::registry().histogram("voice_timer_lateness_ns");
+  return h;
+}
+}  // namespace
+
+Engine::Engine() : Engine(Options{}) {}
+
+Engine::Engine(Options opts) : options(std::move(opts)), epoch(Clock::now())
+{
+  epoll = epoll_create1(EPOLL_CLOEXEC);
+  event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  epoll_event ev{.events = EPOLLIN, .data = {.fd = event}};
+  if (epoll == -1 || event == -1 || epoll_ctl(epoll, EPOLL_CTL_ADD, event, &ev) == -1) {
+    if (epoll != -1)
+      ::close(epoll);
+    if (event != -1)
+      ::close(event);
+    throw std::runtime_error("voice: failed to set up epoll");
+  }
+  timerThread = std::jthread([this](std::stop_token stop) { runTimers(stop); });
+  receiveThread = std::jthread([this](std::stop_token stop) { runReceive(stop); });
+}
+
+Engine::~Engine()
+{
+  timerThread.request_stop();
+  receiveThread.request_stop();
+  u64 one = 1;
+  [[maybe_unused]] auto n = ::write(event, &one, sizeof(one));
+  timerThread.join();
+  receiveThread.join();
+  ::close(epoll);
+  ::close(event);
+}
+
+Engine::Timer Engine::every(Clock::duration period, Tick f, Clock::time_point first)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  Timer timer = nextTimer++;
+  entries.emplace(timer, Entry{.due = first, .period = std::max(period, Clock::duration{TICK}), .f = std::move(f)});
+  schedule(timer, first);
+  changed = true;
+  wake.notify_all();
+  return timer;
+}
+
+void Engine::cancel(Timer timer) noexcept
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(timer);
+    if (it == entries.end())
+      return;
+    // a running timer is in no slot, and gets its function back only if it's still here
+    std::erase(slots[it->second.slot], timer);
+    entries.erase(it);
+  }
+  if (std::this_thread::get_id() != timerThread.get_id())
+    std::lock_guard<std::mutex> wait(running);
+}
+
+void Engine::schedule(Timer timer, Clock::time_point due)
+{
+  // a tick the thread already went past won't be looked at again, so it goes in the one it's at
+  usize slot = std::max(tickOf(due), cursor) % SLOTS;
+  slots[slot].push_back(timer);
+  entries.at(timer).slot = slot;
+}
+
+void Engine::watch(int fd, std::function<void()> f)
+{
+  std::lock_guard<std::mutex> lock(watchMutex);
+  watches[fd] = std::make_shared<std::function<void()>>(std::move(f));
+  epoll_event ev{.events = EPOLLIN, .data = {.fd = fd}};
+  if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    watches.erase(fd);
+    throw std::runtime_error("voice: failed to watch socket");
+  }
+}
+
+void Engine::unwatch(int fd) noexcept
+{
+  {
+    std::lock_guard<std::mutex> lock(watchMutex);
+    if (!watches.erase(fd))
+      return;
+    epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+  }
+  if (std::this_thread::get_id() != receiveThread.get_id())
+    std::lock_guard<std::mutex> wait(receiving);
+}
+
+void Engine::runTimers(std::stop_token stop)
+{
+  // the default 50 us of slack would be most of the precision a 1 ms wheel has
+  prctl(PR_SET_TIMERSLACK, 1000UL);
+  pinThread(options.cpus);
+
+  struct Due {
+    Timer timer;
+    Tick f;
+    u32 ticks;
+  };
+  std::vector<Due> due;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stop.stop_requested()) {
+    auto now = Clock::now();
+    u64 current = static_cast<u64>((now - epoch) / TICK);
+    // every slot from the cursor up to now, at most one turn of the wheel
+    for (u64 t = cursor; t <= current && t < cursor + SLOTS; ++t) {
+      auto& slot = slots[t % SLOTS];
+      for (usize i = 0; i < slot.size();) {
+        Entry& e = entries.at(slot[i]);
+        if (e.due > now) {
+          ++i;
+          continue;
+        }
+        lateness().record(now - e.due);
+        u32 ticks = 1 + static_cast<u32>((now - e.due) / e.period);
+        due.push_back({slot[i], std::move(e.f), ticks});
+        slot[i] = slot.back();
+        slot.pop_back();
+      }
+    }
+    // the current tick may still have timers due later in it
+    cursor = std::max(cursor, current);
+
+    if (!due.empty()) {
+      lock.unlock();
+      {
+        std::lock_guard<std::mutex> hold(running);
+        for (auto& d : due) {
+          // another timer of the batch may have cancelled it
+          {
+            std::lock_guard<std::mutex> check(mutex);
+            if (!entries.contains(d.timer))
+              continue;
+          }
+          d.f(d.ticks);
+        }
+      }
+      lock.lock();
+      // cancelled ones are gone, the rest get their function back and their next run
+      for (auto& d : due) {
+        auto it = entries.find(d.timer);
+        if (it == entries.end())
+          continue;
+        it->second.f = std::move(d.f);
+        it->second.due += it->second.period * d.ticks;
+        schedule(d.timer, it->second.due);
+      }
+      lock.unlock();
+      // destroyed without the lock, they may own anything
+      due.clear();
+      lock.lock();
+      continue;
+    }
+
+    // sleeps until the first timer due this turn of the wheel, to the next turn if there's none, or until a timer is
+    // added
+    changed = false;
+    auto until = Clock::time_point::max();
+    for (u64 t = cursor; t < cursor + SLOTS && until == Clock::time_point::max(); ++t)
+      for (Timer timer : slots[t % SLOTS])
+        if (const Entry& e = entries.at(timer); tickOf(e.due) <= t)
+          until = std::min(until, e.due);
+    if (until == Clock::time_point::max() && !entries.empty())
+      until = epoch + (cursor + SLOTS) * TICK;
+    if (until == Clock::time_point::max())
+      wake.wait(lock, stop, [&] { return changed; });
+    else
+      wake.wait_until(lock, stop, until, [&] { return changed; });
+  }
+}
+
+void Engine::runReceive(std::stop_token stop)
+{
+  pinThread(options.cpus);
+  std::array<epoll_event, 64> events;
+  while (!stop.stop_requested()) {
+    int n = epoll_wait(epoll, events.data(), events.size(), -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    std::lock_guard<std::mutex> hold(receiving);
+    for (int i = 0; i < n; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == event)
+        return;
+      std::shared_ptr<std::function<void()>> f;
+      {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        if (auto it = watches.find(fd); it != watches.end())
+          f = it->second;
+      }
+      if (f)
+        (*f)();
+    }
+  }
+}
+}  // namespace twilight::voice
@@ -0,0 +1,79 @@
+#include "voice/jitter.h"
+
+#include <algorithm>
+
+namespace twilight::voice
+{
+JitterBuffer::JitterBuffer(u16 depth) noexcept : depth(std::clamp<u16>(depth, 1, SLOTS / 2)) {}
+
+void JitterBuffer::reset() noexcept
+{
+  for (Slot& s : slots) s.filled = false;
+  count = 0;
+  playing = false;
+}
+
+bool JitterBuffer::push(u16 sequence, std::span<const u8> frame)
+{
+  auto distance = static_cast<i16>(sequence - next);
+  if (playing) {
+    if (distance < 0) {
+      ++counters.late;
+      return false;
+    }
+    // far ahead of what's playing, the sender started over
+    if (distance >= static_cast<i16>(SLOTS))
+      reset();
+  }
+  if (!playing) {
+    if (!count) {
+      next = sequence;
+    } else if (distance < -static_cast<i16>(SLOTS / 2) || distance >= static_cast<i16>(SLOTS / 2)) {
+      reset();
+      next = sequence;
+    } else if (distance < 0) {
+      // reordered ahead of what was the first
+      next = sequence;
+    }
+  }
+
+  Slot& s = slots[sequence % SLOTS];
+  if (s.filled && s.sequence == sequence) {
+    ++counters.duplicates;
+    return false;
+  }
+  if (!s.filled)
+    ++count;
+  s.frame.assign(reinterpret_cast<const char*>(frame.data()), frame.size());
+  s.sequence = sequence;
+  s.filled = true;
+  if (!playing && count >= depth)
+    playing = true;
+  return true;
+}
+
+JitterBuffer::Pop JitterBuffer::pop(std::string& out)
+{
+  if (!playing)
+    return Pop::Buffering;
+  if (!count) {
+    playing = false;
+    return Pop::Buffering;
+  }
+
+  Slot& s = slots[next % SLOTS];
+  bool found = s.filled && s.sequence == next;
+  if (s.filled) {
+    s.filled = false;
+    --count;
+  }
+  ++next;
+  if (!found) {
+    ++counters.lost;
+    return Pop::Lost;
+  }
+  out.swap(s.frame);
+  ++counters.played;
+  return Pop::Frame;
+}
+}  // namespace twilight::voice
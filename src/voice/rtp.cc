@@ -0,0 +1,142 @@
+#include "voice/rtp.h"
+
+#include <openssl/evp.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace twilight::voice
+{
+namespace
+{
+inline void putBe16(u8* p, u16 v) noexcept
+{
+  p[0] = static_cast<u8>(v >> 8);
+  p[1] = static_cast<u8>(v);
+}
+
+inline void putBe32(u8* p, u32 v) noexcept
+{
+  p[0] = static_cast<u8>(v >> 24);
+  p[1] = static_cast<u8>(v >> 16);
+  p[2] = static_cast<u8>(v >> 8);
+  p[3] = static_cast<u8>(v);
+}
+
+inline u16 be16(const u8* p) noexcept { return static_cast<u16>(p[0] << 8 | p[1]); }
+
+inline u32 be32(const u8* p) noexcept
+{
+  return static_cast<u32>(p[0]) << 24 | static_cast<u32>(p[1]) << 16 | static_cast<u32>(p[2]) << 8 | p[3];
+}
+
+EVP_CIPHER_CTX* context(const Cipher::Key& key, bool encrypt)
+{
+  EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+  if (!ctx || EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key.data(), nullptr, encrypt) != 1) {
+    EVP_CIPHER_CTX_free(ctx);
+    throw std::runtime_error("voice: failed to set up AES-256-GCM");
+  }
+  return ctx;
+}
+
+// the 12 byte nonce is the counter followed by zeros
+std::array<u8, 12> iv(const u8* counter) noexcept
+{
+  std::array<u8, 12> out{};
+  std::memcpy(out.data(), counter, NONCE_SIZE);
+  return out;
+}
+}  // namespace
+
+Cipher::Cipher(const Key& key) : sealer(context(key, true))
+{
+  try {
+    opener = context(key, false);
+  } catch (...) {
+    EVP_CIPHER_CTX_free(sealer);
+    throw;
+  }
+}
+
+Cipher::~Cipher()
+{
+  EVP_CIPHER_CTX_free(sealer);
+  EVP_CIPHER_CTX_free(opener);
+}
+
+usize Cipher::seal(const RtpHeader& header, std::span<const u8> frame, u8* out) noexcept
+{
+  out[0] = 0x80;
+  out[1] = PAYLOAD_TYPE;
+  putBe16(out + 2, header.sequence);
+  putBe32(out + 4, header.timestamp);
+  putBe32(out + 8, header.ssrc);
+
+  u8* counter = out + HEADER_SIZE + frame.size() + TAG_SIZE;
+  putBe32(counter, nonce++);
+  auto nonceBytes = iv(counter);
+
+  int n;
+  if (EVP_EncryptInit_ex(sealer, nullptr, nullptr, nullptr, nonceBytes.data()) != 1 ||
+      EVP_EncryptUpdate(sealer, nullptr, &n, out, HEADER_SIZE) != 1 ||
+      EVP_EncryptUpdate(sealer, out + HEADER_SIZE, &n, frame.data(), static_cast<int>(frame.size())) != 1 ||
+      EVP_EncryptFinal_ex(sealer, out + HEADER_SIZE + n, &n) != 1 ||
+      EVP_CIPHER_CTX_ctrl(sealer, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, out + HEADER_SIZE + frame.size()) != 1)
+    return 0;
+  return frame.size() + OVERHEAD;
+}
+
+std::optional<Packet> Cipher::open(std::span<u8> packet) noexcept
+{
+  if (packet.size() < OVERHEAD || (packet[0] & 0xC0) != 0x80 || (packet[1] & 0x7F) != PAYLOAD_TYPE)
+    return std::nullopt;
+
+  // csrcs and an extension's preamble are part of the clear header, the extension's body is encrypted with the frame
+  usize aad = HEADER_SIZE + (packet[0] & 0x0F) * 4;
+  usize extension = 0;
+  if (packet[0] & 0x10) {
+    if (packet.size() < aad + 4 + TAG_SIZE + NONCE_SIZE)
+      return std::nullopt;
+    extension = be16(&packet[aad + 2]) * 4;
+    aad += 4;
+  }
+  if (packet.size() < aad + TAG_SIZE + NONCE_SIZE)
+    return std::nullopt;
+  usize length = packet.size() - aad - TAG_SIZE - NONCE_SIZE;
+  if (extension > length)
+    return std::nullopt;
+
+  u8* body = packet.data() + aad;
+  u8* tag = body + length;
+  auto nonceBytes = iv(tag + TAG_SIZE);
+  int n;
+  if (EVP_DecryptInit_ex(opener, nullptr, nullptr, nullptr, nonceBytes.data()) != 1 ||
+      EVP_DecryptUpdate(opener, nullptr, &n, packet.data(), static_cast<int>(aad)) != 1 ||
+      EVP_DecryptUpdate(opener, body, &n, body, static_cast<int>(length)) != 1 ||
+      EVP_CIPHER_CTX_ctrl(opener, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, tag) != 1 ||
+      EVP_DecryptFinal_ex(opener, body + n, &n) != 1)
+    return std::nullopt;
+
+  RtpHeader header{.sequence = be16(&packet[2]), .timestamp = be32(&packet[4]), .ssrc = be32(&packet[8])};
+  return Packet{.header = header, .frame = {body + extension, length - extension}};
+}
+
+std::array<u8, DISCOVERY_SIZE> discoveryRequest(u32 ssrc) noexcept
+{
+  std::array<u8, DISCOVERY_SIZE> out{};
+  putBe16(out.data(), 0x1);
+  putBe16(out.data() + 2, 70);
+  putBe32(out.data() + 4, ssrc);
+  return out;
+}
+
+std::optional<Address> discoveryResponse(std::span<const u8> packet, u32 ssrc) noexcept
+{
+  if (packet.size() != DISCOVERY_SIZE || be16(packet.data()) != 0x2 || be32(packet.data() + 4) != ssrc)
+    return std::nullopt;
+  // a nul-terminated string in a 64 byte field, then the port
+  const char* ip = reinterpret_cast<const char*>(packet.data() + 8);
+  return Address{.ip = std::string(ip, strnlen(ip, 64)), .port = be16(packet.data() + 72)};
+}
+}  // namespace twilight::voice
@@ -0,0 +1,195 @@
+#include "voice/transport.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+#include "utils/random.h"
+
+namespace twilight::voice
+{
+namespace
+{
+struct VoiceMetrics {
+  metrics::Counter& packetsOut = metrics::registry().counter("voice_sent_packets_total");
+  metrics::Counter& packetsIn = metrics::registry().counter("voice_received_packets_total");
+  metrics::Counter& bytesOut = metrics::registry().counter("voice_sent_bytes_total");
+  metrics::Counter& bytesIn = metrics::registry().counter("voice_received_bytes_total");
+  metrics::Counter& rejected = metrics::registry().counter("voice_rejected_packets_total");
+};
+
+// one batch's worth of packet buffers and headers per thread, every transport sending or receiving on it shares them
+struct Batch {
+  std::vector<std::array<u8, MAX_PACKET>> packets = std::vector<std::array<u8, MAX_PACKET>>(Transport::BATCH);
+  std::array<iovec, Transport::BATCH> iov{};
+  std::array<mmsghdr, Transport::BATCH> msgs{};
+};
+}  // namespace
+
+Transport::Transport(const std::string& ip, u16 port, u32 ssrc, u16 jitterDepth)
+  : own(ssrc), sequence(rand<u16>()), timestamp(rand<u32>()), depth(jitterDepth)
+{
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo* res;
+  int err = getaddrinfo(ip.c_str(), std::to_string(port).c_str(), &hints, &res);
+  if (err != 0)
+    throw std::runtime_error("getaddrinfo: " + std::string(gai_strerror(err)));
+
+  for (addrinfo* p = res; p; p = p->ai_next) {
+    sock = ::socket(p->ai_family, p->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, p->ai_protocol);
+    if (sock == -1)
+      continue;
+    if (::connect(sock, p->ai_addr, p->ai_addrlen) == 0) {
+      // expedited forwarding, for networks that honour it
+      int tos = IPTOS_DSCP_EF;
+      if (p->ai_family == AF_INET)
+        setsockopt(sock, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+      break;
+    }
+    ::close(sock);
+    sock = -1;
+  }
+  freeaddrinfo(res);
+  if (sock == -1)
+    throw std::runtime_error("Unable to connect to voice server " + ip);
+}
+
+Transport::~Transport()
+{
+  if (sock != -1)
+    ::close(sock);
+}
+
+std::expected<Address, std::string> Transport::discover(std::chrono::milliseconds timeout)
+{
+  using Clock = std::chrono::steady_clock;
+  auto request = discoveryRequest(own);
+  auto deadline = Clock::now() + timeout;
+  std::array<u8, MAX_PACKET> buf;
+  while (true) {
+    auto now = Clock::now();
+    if (now >= deadline)
+      return std::unexpected("IP discovery timed out");
+    if (::send(sock, request.data(), request.size(), 0) < 0 && errno != EAGAIN)
+      return std::unexpected("Failed to send IP discovery request");
+
+    // UDP may lose either packet, so the request goes out again if nothing came back in a while
+    auto resend = std::min(deadline, now + std::chrono::milliseconds{250});
+    while (Clock::now() < resend) {
+      pollfd p{.fd = sock, .events = POLLIN, .revents = 0};
+      auto left = std::chrono::ceil<std::chrono::milliseconds>(resend - Clock::now());
+      if (::poll(&p, 1, static_cast<int>(left.count())) <= 0)
+        continue;
+      isize n = ::recv(sock, buf.data(), buf.size(), 0);
+      if (n < 0)
+        continue;
+      if (auto address = discoveryResponse({buf.data(), static_cast<usize>(n)}, own))
+        return *address;
+    }
+  }
+}
+
+void Transport::setKey(const Cipher::Key& key) { cipher = std::make_unique<Cipher>(key); }
+
+usize Transport::send(std::span<const std::span<const u8>> frames) noexcept
+{
+  if (!cipher)
+    return 0;
+  thread_local Batch batch;
+  usize sent = 0;
+  while (!frames.empty()) {
+    usize n = 0, bytes = 0;
+    for (; n < BATCH && !frames.empty(); frames = frames.subspan(1)) {
+      std::span<const u8> frame = frames.front();
+      RtpHeader header{.sequence = sequence, .timestamp = timestamp, .ssrc = own};
+      timestamp += FRAME_SAMPLES;
+      if (frame.size() > MAX_FRAME)
+        continue;
+      usize size = cipher->seal(header, frame, batch.packets[n].data());
+      if (!size)
+        continue;
+      ++sequence;
+      batch.iov[n] = {batch.packets[n].data(), size};
+      batch.msgs[n] = {};
+      batch.msgs[n].msg_hdr.msg_iov = &batch.iov[n];
+      batch.msgs[n].msg_hdr.msg_iovlen = 1;
+      bytes += size;
+      ++n;
+    }
+    if (!n)
+      continue;
+    int done = ::sendmmsg(sock, batch.msgs.data(), n, MSG_DONTWAIT);
+    if (done <= 0)
+      break;
+    sent += done;
+    if constexpr (metrics::ENABLED) {
+      if (static_cast<usize>(done) < n) {
+        bytes = 0;
+        for (int i = 0; i < done; ++i) bytes += batch.iov[i].iov_len;
+      }
+      counters.packetsOut.add(done);
+      counters.bytesOut.add(bytes);
+      metrics::cached<VoiceMetrics>().packetsOut.add(done);
+      metrics::cached<VoiceMetrics>().bytesOut.add(bytes);
+    }
+    // the socket buffer is full, what's left is dropped like a lost packet
+    if (static_cast<usize>(done) < n)
+      break;
+  }
+  return sent;
+}
+
+usize Transport::receive() noexcept
+{
+  thread_local Batch batch;
+  for (usize i = 0; i < BATCH; ++i) {
+    batch.iov[i] = {batch.packets[i].data(), MAX_PACKET};
+    batch.msgs[i] = {};
+    batch.msgs[i].msg_hdr.msg_iov = &batch.iov[i];
+    batch.msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  int n = ::recvmmsg(sock, batch.msgs.data(), BATCH, MSG_DONTWAIT, nullptr);
+  if (n <= 0)
+    return 0;
+
+  usize bytes = 0, rejected = 0;
+  {
+    std::lock_guard<std::mutex> lock(speakersMutex);
+    for (int i = 0; i < n; ++i) {
+      std::span<u8> data{batch.packets[i].data(), batch.msgs[i].msg_len};
+      bytes += data.size();
+      auto packet = cipher ? cipher->open(data) : std::nullopt;
+      if (!packet) {
+        ++rejected;
+        continue;
+      }
+      speakers.try_emplace(packet->header.ssrc, depth).first->second.push(packet->header.sequence, packet->frame);
+    }
+  }
+  if constexpr (metrics::ENABLED) {
+    counters.packetsIn.add(n);
+    counters.bytesIn.add(bytes);
+    counters.rejected.add(rejected);
+    metrics::cached<VoiceMetrics>().packetsIn.add(n);
+    metrics::cached<VoiceMetrics>().bytesIn.add(bytes);
+    metrics::cached<VoiceMetrics>().rejected.add(rejected);
+  }
+  return n;
+}
+
+void Transport::forget(u32 ssrc)
+{
+  std::lock_guard<std::mutex> lock(speakersMutex);
+  speakers.erase(ssrc);
+}
+}  // namespace twilight::voice
@@ -1,28 +1,51 @@
 #include "ws/client.h"
 
-#include <endian.h>
 #include <netdb.h>
 
+#include <algorithm>
+
+#include "crypto/sha1.h"
 #include "utils/base64.h"
 #include "utils/bitwise.h"
 #include "utils/random.h"
-#include "utils/sha1.h"
 #include "ws/frame.h"
 
 namespace twilight::ws
 {
-Client::Client(const URI& uri, http::ClientFlags flags) : http::Client(uri, flags), key(rand<u8, 16>())
+namespace
+{
+struct WsMetrics {
+  metrics::Counter& framesIn = metrics::registry().counter("ws_received_frames_total");
+  metrics::Counter& framesOut = metrics::registry().counter("ws_sent_frames_total");
+  metrics::Counter& bytesIn = metrics::registry().counter("ws_received_bytes_total");
+  metrics::Counter& bytesOut = metrics::registry().counter("ws_sent_bytes_total");
+  metrics::Counter& messagesIn = metrics::registry().counter("ws_received_messages_total");
+  // time spent in onmessage handlers
+  metrics::AtomicHistogram& handle = metrics::registry().histogram("ws_handle_ns");
+};
+}  // namespace
+
+Client::Client(const URI& uri, http::ClientFlags flags) : http::Client(uri, flags)
 {
+  secureRandomBytes(key.data(), key.size());
   if (!(flags & http::ClientFlags::NoConnect))
     connect();
 }
 
-bool Client::send(const char* str) const noexcept { return send({.opcode = Opcode::Text, .payload = str}); }
+Client::~Client()
+{
+  listening = false;
+  // unblocks the listener if it's waiting in recv
+  if (sock.fd != -1)
+    ::shutdown(sock.fd, SHUT_RDWR);
+  if (listenFuture.valid())
+    listenFuture.wait();
+}
+
+bool Client::send(const char* str) const noexcept { return send(Opcode::Text, str); }
 
 bool Client::send(const Frame& frame) const noexcept
 {
-  std::string data;
-
   // clang-format off
   u8 header = frame.fin << 7
     | frame.rsv1 << 6
@@ -30,38 +53,45 @@ bool Client::send(const Frame& frame) const noexcept
     | frame.rsv3 << 4
     | (static_cast<u8>(frame.opcode) & 0b00001111);
   // clang-format on
-  data.push_back(header);
-
-  u8 len = 0b10000000;  // 1st bit: mask
-  if (frame.payload.size() <= 125) {
-    len |= static_cast<u8>(frame.payload.size());
-  } else if (frame.payload.size() <= 0xFFFF) {
-    len |= 126;
-  } else {
-    len |= 127;
-  }
-  data.push_back(len);
-
-  if (frame.payload.size() > 125) {
-    if (frame.payload.size() <= 0xFFFF) {
-      u16 sz = htobe16(static_cast<u16>(frame.payload.size()));
-      data.append(reinterpret_cast<char*>(&sz), sizeof(sz));
-    } else {
-      u64 sz = htobe64(frame.payload.size());
-      data.append(reinterpret_cast<char*>(&sz), sizeof(sz));
-    }
-  }
+  return write(header, frame.payload);
+}
 
-  std::array<u8, 4> mask = rand<u8, 4>();
-  data.append(reinterpret_cast<char*>(mask.data()), mask.size());
+bool Client::send(Opcode opcode, std::string_view payload) const noexcept
+{
+  return write(0b10000000 | (static_cast<u8>(opcode) & 0b00001111), payload);
+}
 
-  for (usize i = 0; i < frame.payload.size(); ++i) data.push_back(frame.payload[i] ^ mask[i % 4]);
+bool Client::write(u8 header, std::string_view payload) const noexcept
+{
+  std::lock_guard<std::mutex> lock(sendMutex);
+  wbuf.clear();
+  encodeFrame(wbuf, header, payload, rand<u8, 4>());
+  if (!sendAll(wbuf))
+    return false;
+
+  if constexpr (metrics::ENABLED) {
+    counters.framesOut.add();
+    counters.bytesOut.add(wbuf.size());
+    metrics::cached<WsMetrics>().framesOut.add();
+    metrics::cached<WsMetrics>().bytesOut.add(wbuf.size());
+  }
+  return true;
+}
 
-  return sendAll(data);
+void Client::deliver(const Frame& message) noexcept
+{
+  auto start = metrics::now();
+  onmessage(message);
+  if constexpr (metrics::ENABLED) {
+    counters.messagesIn.add();
+    metrics::cached<WsMetrics>().messagesIn.add();
+    metrics::cached<WsMetrics>().handle.record(metrics::now() - start);
+  }
 }
 
 void Client::connect()
 {
+  http::Client::connect();
   doHandshake();
   onopen();
   listenFuture = std::async(std::launch::async, &Client::listen, this);
@@ -70,59 +100,63 @@ void Client::connect()
 void Client::close() noexcept
 {
   listening = false;
-  send({.opcode = Opcode::Close, .payload = {}});
+  send(Opcode::Close, {});
 }
 
-Frame Client::recvFrame() const
+void Client::fail(u16 status) noexcept
 {
-  constexpr isize CHUNK = 4096;
-  std::string data;
-
-  while (true) {
-    char buf[CHUNK];
-    isize n = recv(buf, CHUNK);
-    if (n <= 0)
-      break;
-    data.append(buf, n);
-    if (n < CHUNK)
-      break;
-  }
-
-  Frame frame;
+  // big-endian
+  char code[2] = {static_cast<char>(status >> 8), static_cast<char>(status & 0xFF)};
+  send(Opcode::Close, std::string_view{code, sizeof(code)});
+  if (listening.exchange(false))
+    onclose();
+}
 
-  if (data.size() < 2) {
-    // not enough data
-    return frame;
+bool Client::fill(usize n) noexcept
+{
+  // one full TLS record
+  constexpr isize CHUNK = 16384;
+
+  while (rbuf.size() - rpos < n) {
+    usize used = rbuf.size();
+    rbuf.resize(used + CHUNK);
+    isize r = recv(rbuf.data() + used, CHUNK);
+    rbuf.resize(used + std::max<isize>(r, 0));
+    if (r <= 0)
+      return false;
   }
+  return true;
+}
 
-  frame.fin = (data[0] & 0b10000000) >> 7;
-  frame.rsv1 = (data[0] & 0b01000000) >> 6;
-  frame.rsv2 = (data[0] & 0b00100000) >> 5;
-  frame.rsv3 = (data[0] & 0b00010000) >> 4;
-  frame.opcode = static_cast<Opcode>(data[0] & 0b00001111);
-
-  usize len = data[1] & 0b01111111;
-
-  usize lenSz = len == 126 ? 2 : len == 127 ? 8 : 0;
-  if (data.size() < 2 + lenSz) {
-    // not enough data
-    return frame;
+std::optional<Frame> Client::recvFrame()
+{
+  // consumed bytes are dropped once nothing is left, or once they'd be worth moving the rest for
+  if (rpos == rbuf.size() || rpos >= 65536) {
+    rbuf.erase(0, rpos);
+    rpos = 0;
   }
 
-  if (lenSz == 2) {
-    len = be16toh(*reinterpret_cast<u16*>(data.data() + 2));
-  } else if (lenSz == 8) {
-    len = be64toh(*reinterpret_cast<u64*>(data.data() + 2));
+  // header, at most 8 bytes of length and the mask
+  constexpr usize MAX_HEADER = 14;
+  usize limit = maxMessage.load(std::memory_order_relaxed) + MAX_HEADER;
+  for (usize need; (need = frameSize(std::string_view{rbuf}.substr(rpos))) > rbuf.size() - rpos;) {
+    if (need > limit) {
+      oversized = true;
+      return std::nullopt;
+    }
+    if (!fill(need))
+      return std::nullopt;
   }
 
-  if (data.size() < 2 + lenSz + len) {
-    // not enough data
-    return frame;
+  Frame frame{.opcode = Opcode::Continuation, .payload = std::pmr::string{&arena}};
+  usize size = decodeFrame(std::string_view{rbuf}.substr(rpos), frame);
+  rpos += size;
+  if constexpr (metrics::ENABLED) {
+    counters.framesIn.add();
+    counters.bytesIn.add(size);
+    metrics::cached<WsMetrics>().framesIn.add();
+    metrics::cached<WsMetrics>().bytesIn.add(size);
   }
-
-  frame.payload.reserve(len);
-  frame.payload.append(data.data() + 2 + lenSz, len);
-
   return frame;
 }
 
@@ -136,34 +170,75 @@ void Client::doHandshake()
     {"Sec-WebSocket-Version", "13"},
   };
 
-  http::Response res = request(uri.path, {.headers = headers});
+  http::Response res = request(uri.target(), {.headers = headers});
 
   if (res.statusCode != 101)
     throw std::runtime_error("Failed to connect to WebSocket server. Status code: " + std::to_string(res.statusCode));
 
-  std::string accept = base64::encode(sha1(base64Key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+  std::string accept = base64::encode(crypto::sha1(base64Key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
   if (res.headers.get("Sec-Websocket-Accept") != accept)
     throw std::runtime_error("Failed to connect to WebSocket server. Accept mismatch.");
+
+  rbuf.assign(res.body);
+  rpos = 0;
 }
 
 void Client::listen() noexcept
 {
   listening = true;
 
+  // a fragmented message being reassembled
+  std::optional<Frame> message;
+
   while (listening) {
-    Frame frame = recvFrame();
+    // the previous message has been handled, its frames can go
+    if (!message)
+      arena.reset();
+
+    std::optional<Frame> frame = recvFrame();
+    if (!frame.has_value()) {
+      // 1009, message too big
+      if (oversized)
+        fail(1009);
+      // connection lost, or closed by the destructor
+      else if (listening.exchange(false))
+        onclose();
+      break;
+    }
 
-    switch (frame.opcode) {
+    switch (frame->opcode) {
     case Opcode::Close:
+      // answered with the status it carried, unless it answers our own
+      if (listening.exchange(false))
+        send(Opcode::Close, frame->payload.size() >= 2 ? std::string_view{frame->payload}.substr(0, 2) : "");
       onclose();
       break;
     case Opcode::Ping:
-      send({.opcode = Opcode::Pong, .payload = frame.payload});
+      send(Opcode::Pong, frame->payload);
       break;
     case Opcode::Pong:
       break;
+    case Opcode::Continuation:
+      // 1002, protocol error: nothing to continue
+      if (!message) {
+        fail(1002);
+        return;
+      }
+      if (message->payload.size() + frame->payload.size() > maxMessage.load(std::memory_order_relaxed)) {
+        fail(1009);
+        return;
+      }
+      message->payload += frame->payload;
+      if (frame->fin) {
+        deliver(*message);
+        message.reset();
+      }
+      break;
     default:
-      onmessage(frame);
+      if (!frame->fin)
+        message.emplace(std::move(*frame));
+      else
+        deliver(*frame);
       break;
     }
   }
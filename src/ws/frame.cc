@@ -1,12 +1,145 @@
 #include "ws/frame.h"
 
+#include <endian.h>
+
+#include <cstring>
 #include <format>
+#include <limits>
 
 namespace twilight::ws
 {
+namespace
+{
+struct Header {
+  // bytes before the payload
+  usize size;
+  u64 length;
+  bool masked;
+};
+
+// reads the header at the start of `data`. `size` is all that's set when `data` is too short for the rest
+Header readHeader(std::string_view data) noexcept
+{
+  u8 b1 = data[1];
+  Header h{.size = 2, .length = b1 & 0b01111111u, .masked = static_cast<bool>(b1 & 0b10000000)};
+  usize lenSz = h.length == 126 ? 2 : h.length == 127 ? 8 : 0;
+  h.size += lenSz + (h.masked ? 4 : 0);
+  if (data.size() < h.size)
+    return h;
+
+  if (lenSz == 2) {
+    u16 sz;
+    std::memcpy(&sz, data.data() + 2, sizeof(sz));
+    h.length = be16toh(sz);
+  } else if (lenSz == 8) {
+    u64 sz;
+    std::memcpy(&sz, data.data() + 2, sizeof(sz));
+    h.length = be64toh(sz);
+  }
+  return h;
+}
+
+// header, at most 8 bytes of length and the mask
+constexpr usize MAX_HEADER = 14;
+
+// writes the header up to the mask, returns its size
+usize writeHeader(char* p, u8 header, usize size, bool masked) noexcept
+{
+  usize n = 0;
+  p[n++] = header;
+
+  u8 len = masked ? 0b10000000 : 0;  // 1st bit: mask
+  if (size <= 125) {
+    p[n++] = len | static_cast<u8>(size);
+  } else if (size <= 0xFFFF) {
+    p[n++] = len | 126;
+    u16 sz = htobe16(static_cast<u16>(size));
+    std::memcpy(p + n, &sz, sizeof(sz));
+    n += sizeof(sz);
+  } else {
+    p[n++] = len | 127;
+    u64 sz = htobe64(size);
+    std::memcpy(p + n, &sz, sizeof(sz));
+    n += sizeof(sz);
+  }
+  return n;
+}
+
+// xors `n` bytes of `in` with `mask` into `out`, which may be `in`
+void applyMask(char* out, const char* in, usize n, std::array<u8, 4> mask) noexcept
+{
+  // the mask repeats every 4 bytes, so it's applied a word at a time
+  u32 mask32;
+  std::memcpy(&mask32, mask.data(), sizeof(mask32));
+  u64 mask64 = u64{mask32} << 32 | mask32;
+  usize i = 0;
+  for (; i + 8 <= n; i += 8) {
+    u64 word;
+    std::memcpy(&word, in + i, sizeof(word));
+    word ^= mask64;
+    std::memcpy(out + i, &word, sizeof(word));
+  }
+  for (; i < n; ++i) out[i] = in[i] ^ mask[i % 4];
+}
+}  // namespace
+
 std::string Frame::toString() const
 {
   return std::format("Frame{{fin={}, rsv1={}, rsv2={}, rsv3={}, opcode=0x{:x}, payload=\"{}\"}}", fin, rsv1, rsv2, rsv3,
     static_cast<u8>(opcode), payload);
 }
+
+usize frameSize(std::string_view data) noexcept
+{
+  if (data.size() < 2)
+    return 2;
+  Header h = readHeader(data);
+  if (data.size() < h.size)
+    return h.size;
+  // a 64-bit length from the peer could wrap the sum
+  return h.length > std::numeric_limits<usize>::max() - h.size ? std::numeric_limits<usize>::max() : h.size + h.length;
+}
+
+usize decodeFrame(std::string_view data, Frame& frame) noexcept
+{
+  u8 b0 = data[0];
+  frame.fin = b0 & 0b10000000;
+  frame.rsv1 = b0 & 0b01000000;
+  frame.rsv2 = b0 & 0b00100000;
+  frame.rsv3 = b0 & 0b00010000;
+  frame.opcode = static_cast<Opcode>(b0 & 0b00001111);
+
+  Header h = readHeader(data);
+  frame.payload.assign(data.data() + h.size, h.length);
+  if (h.masked) {
+    // servers must not mask, but it costs nothing to be lenient
+    std::array<u8, 4> mask;
+    std::memcpy(mask.data(), data.data() + h.size - 4, mask.size());
+    applyMask(frame.payload.data(), frame.payload.data(), h.length, mask);
+  }
+  return h.size + h.length;
+}
+
+void encodeFrame(std::string& out, u8 header, std::string_view payload, std::array<u8, 4> mask) noexcept
+{
+  usize start = out.size();
+  out.resize(start + MAX_HEADER + payload.size());
+  char* p = out.data() + start;
+  usize n = writeHeader(p, header, payload.size(), true);
+  std::memcpy(p + n, mask.data(), mask.size());
+  n += mask.size();
+
+  applyMask(p + n, payload.data(), payload.size(), mask);
+  out.resize(start + n + payload.size());
+}
+
+void encodeFrame(std::string& out, u8 header, std::string_view payload) noexcept
+{
+  usize start = out.size();
+  out.resize(start + MAX_HEADER + payload.size());
+  char* p = out.data() + start;
+  usize n = writeHeader(p, header, payload.size(), false);
+  std::memcpy(p + n, payload.data(), payload.size());
+  out.resize(start + n + payload.size());
+}
 }  // namespace twilight::ws